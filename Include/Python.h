@@ -75,10 +75,12 @@
 #error "PYMALLOC_DEBUG requires WITH_PYMALLOC"
 #endif
 #include "pymath.h"
+#include "pycpu.h"
 #include "pymem.h"
 
 #include "object.h"
 #include "objimpl.h"
+#include "freelist.h"
 
 #include "pydebug.h"
 
@@ -18,6 +18,8 @@ typedef struct {
     PyObject	*cl_getattr;
     PyObject	*cl_setattr;
     PyObject	*cl_delattr;
+    /* The keys shared by the instance dicts; see _PyDict_NewShared() */
+    struct _dictsharedkeys *cl_cached_keys;
 } PyClassObject;
 
 typedef struct {
@@ -14,44 +14,72 @@ extern "C" {
 */
 
 /*
-There are three kinds of slots in the table:
-
-1. Unused.  me_key == me_value == NULL
-   Does not hold an active (key, value) pair now and never did.  Unused can
-   transition to Active upon key insertion.  This is the only case in which
-   me_key is NULL, and is each slot's initial state.
-
-2. Active.  me_key != NULL and me_key != dummy and me_value != NULL
-   Holds an active (key, value) pair.  Active can transition to Dummy upon
-   key deletion.  This is the only case in which me_value != NULL.
-
-3. Dummy.  me_key == dummy and me_value == NULL
-   Previously held an active (key, value) pair, but that was deleted and an
-   active pair has not yet overwritten the slot.  Dummy can transition to
-   Active upon key insertion.  Dummy slots cannot be made Unused again
-   (cannot have me_key set to NULL), else the probe sequence in case of
-   collision would have no way to know they were once active.
-
-Note: .popitem() abuses the me_hash field of an Unused or Dummy slot to
-hold a search finger.  The me_hash field of Unused or Dummy slots has no
-meaning otherwise.
+A dict keeps its items in two tables.  ma_table is a dense array of
+entries, appended to in the order the keys are inserted.  ma_indices is
+the hash table proper: its slots hold indices into ma_table, so a slot
+takes 1, 2, 4 or 8 bytes depending on the size of the table, rather than
+the size of a whole entry.  There are three kinds of slots in ma_indices:
+
+1. Unused.  The slot holds _PyDict_IX_EMPTY.
+   Does not refer to an entry now and never did.  Unused can transition to
+   Active upon key insertion.  This is each slot's initial state.
+
+2. Active.  The slot holds the index of an entry of ma_table.
+   That entry holds an active (key, value) pair.  Active can transition to
+   Dummy upon key deletion.
+
+3. Dummy.  The slot holds _PyDict_IX_DUMMY.
+   Previously referred to an active (key, value) pair, but that was deleted
+   and an active pair has not yet overwritten the slot.  Dummy can transition
+   to Active upon key insertion.  Dummy slots cannot be made Unused again,
+   else the probe sequence in case of collision would have no way to know
+   they were once active.
+
+Deleting a key clears its entry too, leaving a hole in ma_table, so
+iterating over a dict scans the first ma_nentries entries of ma_table
+and skips those whose me_value is NULL.  Holes are squeezed out when the
+table is resized.
+
+A split dict keeps its values apart from its keys, in ma_values, and
+shares both tables with other dicts.  This is used for the instance dicts
+of a class, which usually all have the same keys: the tables are shared
+by all of them and kept by the class, see _PyDict_NewShared().  A key is
+never deleted from shared tables, so they have no Dummy slots and no
+holes; a split dict deletes a key by setting its value to NULL.  The
+value of entry i is ma_values[i], and the me_value fields of a shared
+ma_table are unused.  Iterating over a split dict goes through the shared
+keys in their order, so a dict only stays split while it adds its keys in
+that order; a key that would come before one the dict already has gets
+the dict a table of its own first.
 */
 
 /* PyDict_MINSIZE is the minimum size of a dictionary.  This many slots are
- * allocated directly in the dict object (in the ma_smalltable member).
- * It must be a power of 2, and at least 4.  8 allows dicts with no more
- * than 5 active entries to live in ma_smalltable (and so avoid an
- * additional malloc); instrumentation suggested this suffices for the
- * majority of dicts (consisting mostly of usually-small instance dicts and
- * usually-small dicts created to pass keyword arguments).
+ * allocated directly in the dict object (in the ma_smallindices member),
+ * with room for the entries of as many keys as such a table can hold (in
+ * the ma_smalltable member).  It must be a power of 2, and at least 4.  8
+ * allows dicts with no more than 5 active entries to live in
+ * ma_smalltable (and so avoid an additional malloc); instrumentation
+ * suggested this suffices for the majority of dicts (consisting mostly of
+ * usually-small instance dicts and usually-small dicts created to pass
+ * keyword arguments).
  */
 #define PyDict_MINSIZE 8
 
+/* The number of entries a table of n slots has room for.  We resize the
+   table when it's two-thirds full, to avoid slowing down lookups. */
+#define _PyDict_USABLE(n) (((n) << 1) / 3)
+
+/* The values of slots of ma_indices that don't refer to an entry, and
+   what ma_lookup returns when a comparison raised an exception. */
+#define _PyDict_IX_EMPTY (-1)
+#define _PyDict_IX_DUMMY (-2)
+#define _PyDict_IX_ERROR (-3)
+
+/* The shared tables of split dicts; opaque. */
+typedef struct _dictsharedkeys PyDictSharedKeys;
+
 typedef struct {
-	/* Cached hash code of me_key.  Note that hash codes are C longs.
-	 * We have to use Py_ssize_t instead because dict_popitem() abuses
-	 * me_hash to hold a search finger.
-	 */
+	/* Cached hash code of me_key.  Note that hash codes are C longs. */
 	Py_ssize_t me_hash;
 	PyObject *me_key;
 	PyObject *me_value;
@@ -59,12 +87,12 @@ typedef struct {
 
 /*
 To ensure the lookup algorithm terminates, there must be at least one Unused
-slot (NULL key) in the table.
-The value ma_fill is the number of non-NULL keys (sum of Active and Dummy);
-ma_used is the number of non-NULL, non-dummy keys (== the number of non-NULL
-values == the number of Active items).
-To avoid slowing down lookups on a near-full table, we resize the table when
-it's two-thirds full.
+slot in ma_indices.
+The value ma_fill is the number of slots that aren't Unused (sum of Active
+and Dummy); ma_used is the number of Active slots (== the number of non-NULL
+values).  The table is resized before a new key is added once either
+ma_table is full or ma_fill reaches _PyDict_USABLE(ma_mask + 1), so it is
+never more than two-thirds full.
 */
 typedef struct _dictobject PyDictObject;
 struct _dictobject {
@@ -72,20 +100,42 @@ struct _dictobject {
 	Py_ssize_t ma_fill;  /* # Active + # Dummy */
 	Py_ssize_t ma_used;  /* # Active */
 
-	/* The table contains ma_mask + 1 slots, and that's a power of 2.
+	/* ma_indices contains ma_mask + 1 slots, and that's a power of 2.
 	 * We store the mask instead of the size because the mask is more
 	 * frequently needed.
 	 */
 	Py_ssize_t ma_mask;
 
-	/* ma_table points to ma_smalltable for small tables, else to
-	 * additional malloc'ed memory.  ma_table is never NULL!  This rule
-	 * saves repeated runtime null-tests in the workhorse getitem and
-	 * setitem calls.
+	/* The number of entries of ma_table in use, holes included; the
+	 * next key goes in ma_table[ma_nentries].  ma_table has room for
+	 * _PyDict_USABLE(ma_mask + 1) entries.
+	 */
+	Py_ssize_t ma_nentries;
+
+	/* ma_table and ma_indices point to ma_smalltable and
+	 * ma_smallindices for small tables, else to additional malloc'ed
+	 * memory, or to shared tables for a split dict.  They are never
+	 * NULL!  This rule saves repeated runtime null-tests in the
+	 * workhorse getitem and setitem calls.
 	 */
 	PyDictEntry *ma_table;
-	PyDictEntry *(*ma_lookup)(PyDictObject *mp, PyObject *key, long hash);
-	PyDictEntry ma_smalltable[PyDict_MINSIZE];
+	void *ma_indices;
+
+	/* Return the index in ma_table of the entry for key, whose hash is
+	 * hash; _PyDict_IX_EMPTY if there's none, or _PyDict_IX_ERROR.
+	 */
+	Py_ssize_t (*ma_lookup)(PyDictObject *mp, PyObject *key, long hash);
+
+	/* For a split dict, ma_values holds the value of each entry of
+	 * ma_table, which is shared.  NULL otherwise.
+	 */
+	PyObject **ma_values;
+
+	/* Split dicts are allocated without ma_smalltable, and keep
+	 * ma_values in its place.  Such a dict has ma_truncated set, and
+	 * keeps its table in malloc'ed memory once it stops being split.
+	 */
+	int ma_truncated;
 
 #ifdef WITH_LLVM
 	/* When the dict changes, tell any dependent code objects that whatever
@@ -100,8 +150,16 @@ struct _dictobject {
 	Py_ssize_t ma_watchers_used;
 	Py_ssize_t ma_watchers_allocated;
 #endif
+	PyDictEntry ma_smalltable[_PyDict_USABLE(PyDict_MINSIZE)];
+	signed char ma_smallindices[PyDict_MINSIZE];
 };
 
+/* The value of the entry ix, as returned by mp->ma_lookup(), of the dict
+   mp.  NULL if the entry isn't active. */
+#define _PyDict_VALUE(mp, ix) \
+	((mp)->ma_values == NULL ? (mp)->ma_table[ix].me_value : \
+	 (mp)->ma_values[ix])
+
 PyAPI_DATA(PyTypeObject) PyDict_Type;
 
 #define PyDict_Check(op) \
@@ -126,6 +184,23 @@ PyAPI_FUNC(int) PyDict_Contains(PyObject *mp, PyObject *key);
 PyAPI_FUNC(int) _PyDict_Contains(PyObject *mp, PyObject *key, long hash);
 PyAPI_FUNC(PyObject *) _PyDict_NewPresized(Py_ssize_t minused);
 
+/* Return a new, empty split dict sharing the tables of keys in *cache,
+   which is owned by a class and starts out NULL.  The tables take on
+   the keys set in each of their dicts; when a dict gets a key that
+   doesn't fit in them, that dict stops being split, and the next call
+   replaces *cache with bigger tables, up to a limit.  Once *cache is full
+   and at that limit, this returns an ordinary dict. */
+PyAPI_FUNC(PyObject *) _PyDict_NewShared(PyDictSharedKeys **cache);
+/* Release the tables in *cache, if any, and set *cache to NULL. */
+PyAPI_FUNC(void) _PyDict_ClearSharedKeys(PyDictSharedKeys **cache);
+/* Return the index of the entry for key in the shared ma_table of cache,
+   or -1 if it isn't there.  A key keeps its index for as long as the
+   tables are alive; the value for it in a split dict d sharing them, with
+   d->ma_table == _PyDict_SharedTable(cache), is d->ma_values[index]. */
+PyAPI_FUNC(Py_ssize_t) _PyDict_SharedKeysIndex(PyDictSharedKeys *cache,
+					       PyObject *key);
+PyAPI_FUNC(PyDictEntry *) _PyDict_SharedTable(PyDictSharedKeys *cache);
+
 /* PyDict_Update(mp, other) is equivalent to PyDict_Merge(mp, other, 1). */
 PyAPI_FUNC(int) PyDict_Update(PyObject *mp, PyObject *other);
 
@@ -74,6 +74,10 @@ PyAPI_FUNC(PyObject *) PyEval_EvalFrameEx(struct _frame *f, int exc);
 PyAPI_DATA(volatile int) _Py_Ticker;
 PyAPI_DATA(int) _Py_CheckInterval;
 
+/* how long a thread waiting for the GIL lets the holder keep it */
+PyAPI_FUNC(void) _PyEval_SetSwitchInterval(unsigned long microseconds);
+PyAPI_FUNC(unsigned long) _PyEval_GetSwitchInterval(void);
+
 #ifdef WITH_LLVM
 /* Useful for debugging LLVM: if true, raise an exception if we bail from native
    code back to the interpreter. */
@@ -227,6 +231,8 @@ PyAPI_FUNC(enum _PyUnwindReason) _PyEval_DoRaise(PyObject *type, PyObject *val,
 
 PyAPI_FUNC(int) _PyEval_UnpackIterable(PyObject *, int, PyObject **);
 
+PyAPI_FUNC(PyObject *) _PyEval_ConcatStrings(PyObject *, PyObject *);
+
 PyAPI_FUNC(PyObject *) _PyEval_ImportName(PyObject *level,
                                           PyObject *names,
                                           PyObject *module_name);
@@ -0,0 +1,84 @@
+#ifndef Py_FREELIST_H
+#define Py_FREELIST_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Free lists of dead objects, kept to be reused by the next allocation
+   of an object of the same type and size.
+
+   Each type that wants one declares its own _PyFreeList, or an array of
+   them for objects of several sizes.  A free list holds at most maxfree
+   objects, linked through their first word; the rest of each object,
+   notably ob_type and ob_size, is left as it was.  Objects freed while
+   the list is full go back to the object allocator, which returns
+   emptied pools and arenas to the system, so a burst of short-lived
+   objects doesn't pin its memory for good.  _PyFreeList_Clear() gives
+   back all of a list's objects, e.g. at full collections.
+
+   A free list registers itself the first time an allocation misses it,
+   so that sys._malloc_stats() can report it.  All of this relies on the
+   GIL. */
+
+typedef struct _PyFreeList {
+	void *head;
+	int numfree;
+	int maxfree;
+	const char *name;
+	int gc;			/* objects have a GC header */
+	int registered;
+	/* statistics */
+	Py_ssize_t hits;	/* allocations served by the list */
+	Py_ssize_t misses;	/* allocations the list couldn't serve */
+	Py_ssize_t frees;	/* objects freed, kept or not */
+	struct _PyFreeList *next;	/* next registered free list */
+} _PyFreeList;
+
+/* A static initializer for a free list. */
+#define _PyFreeList_INIT(name, maxfree, gc) \
+	{NULL, 0, (maxfree), (name), (gc), 0, 0, 0, 0, NULL}
+
+/* Set op to an object taken off fl, or to NULL if fl is empty.  The
+   object's fields are as they were when it was freed, except for the
+   first, so it needs a _Py_NewReference() or a PyObject_INIT(). */
+#define _PyFreeList_POP(fl, op) do {				\
+	if (((op) = (fl)->head) != NULL) {			\
+		(fl)->head = *(void **)(op);			\
+		(fl)->numfree--;				\
+		(fl)->hits++;					\
+	}							\
+	else							\
+		_PyFreeList_Miss(fl);				\
+} while (0)
+
+/* Keep the dead object op on fl if there's room, else free it. */
+#define _PyFreeList_FREE(fl, op) do {				\
+	(fl)->frees++;						\
+	if ((fl)->numfree < (fl)->maxfree) {			\
+		*(void **)(op) = (fl)->head;			\
+		(fl)->head = (void *)(op);			\
+		(fl)->numfree++;				\
+	}							\
+	else							\
+		_PyFreeList_Release((fl), (void *)(op));	\
+} while (0)
+
+/* The number of objects allocated through fl that are still alive. */
+#define _PyFreeList_LIVE(fl) ((fl)->hits + (fl)->misses - (fl)->frees)
+
+/* Initialize a free list that couldn't be initialized statically, like
+   those in an array, and register it. */
+PyAPI_FUNC(void) _PyFreeList_Init(_PyFreeList *fl, const char *name,
+				  int maxfree, int gc);
+PyAPI_FUNC(void) _PyFreeList_Miss(_PyFreeList *fl);
+PyAPI_FUNC(void) _PyFreeList_Release(_PyFreeList *fl, void *op);
+/* Free all the objects on fl, and return how many there were. */
+PyAPI_FUNC(int) _PyFreeList_Clear(_PyFreeList *fl);
+/* Return a dict mapping the names of the registered free lists to dicts
+   of their statistics, summed over lists with the same name. */
+PyAPI_FUNC(PyObject *) _PyFreeList_GetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* !Py_FREELIST_H */
@@ -428,6 +428,8 @@ typedef struct _heaptypeobject {
 					  see add_operators() in typeobject.c . */
 	PyBufferProcs as_buffer;
 	PyObject *ht_name, *ht_slots;
+	/* The keys shared by the instance dicts; see _PyDict_NewShared() */
+	struct _dictsharedkeys *ht_cached_keys;
 	/* here are optional user slots, followed by the members. */
 } PyHeapTypeObject;
 
@@ -478,6 +480,9 @@ PyAPI_FUNC(PyObject *) PyObject_GetAttr(PyObject *, PyObject *);
 PyAPI_FUNC(int) PyObject_SetAttr(PyObject *, PyObject *, PyObject *);
 PyAPI_FUNC(int) PyObject_HasAttr(PyObject *, PyObject *);
 PyAPI_FUNC(PyObject **) _PyObject_GetDictPtr(PyObject *);
+/* Return a new, empty dict for obj's __dict__, sharing its keys with the
+   other instances of obj's class if that's a heap type. */
+PyAPI_FUNC(PyObject *) _PyObject_NewInstanceDict(PyObject *obj);
 PyAPI_FUNC(PyObject *) PyObject_SelfIter(PyObject *);
 PyAPI_FUNC(PyObject *) PyObject_GenericGetAttr(PyObject *, PyObject *);
 PyAPI_FUNC(int) PyObject_GenericSetAttr(PyObject *,
@@ -690,7 +695,6 @@ environment the global variable trick is not safe.)
 PyAPI_DATA(Py_ssize_t) _Py_RefTotal;
 PyAPI_FUNC(void) _Py_NegativeRefcount(const char *fname,
 					    int lineno, PyObject *op);
-PyAPI_FUNC(PyObject *) _PyDict_Dummy(void);
 PyAPI_FUNC(PyObject *) _PySet_Dummy(void);
 PyAPI_FUNC(Py_ssize_t) _Py_GetRefTotal(void);
 #define _Py_INC_REFTOTAL	_Py_RefTotal++
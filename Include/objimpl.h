@@ -98,6 +98,42 @@ PyAPI_FUNC(void *) PyObject_Malloc(size_t);
 PyAPI_FUNC(void *) PyObject_Realloc(void *, size_t);
 PyAPI_FUNC(void) PyObject_Free(void *);
 
+/* The caches of free small blocks that hang off each PyThreadState */
+struct _obmalloc_cache;
+PyAPI_FUNC(struct _obmalloc_cache *) _PyObject_NewThreadCache(void);
+PyAPI_FUNC(void) _PyObject_FreeThreadCache(struct _obmalloc_cache *);
+
+/* A snapshot of the small-block allocator's state, for sys._malloc_stats().
+   Blocks sitting in thread caches count as used. */
+#define _PyMalloc_MAX_CLASSES	64
+typedef struct {
+	size_t arena_size;
+	size_t pool_size;
+	size_t arenas;			/* arenas currently allocated */
+	size_t arenas_allocated;	/* arenas ever allocated */
+	size_t arenas_highwater;	/* most arenas allocated at once */
+	size_t pools_free;		/* empty pools, including released ones */
+	size_t pools_released;		/* empty pools given back to the OS */
+	size_t nclasses;
+	struct {
+		size_t size;		/* bytes per block */
+		size_t pools;		/* pools holding blocks of this size */
+		size_t blocks_used;
+		size_t blocks_free;	/* free blocks in those pools */
+		size_t blocks_highwater; /* most blocks used at once */
+	} classes[_PyMalloc_MAX_CLASSES];
+} _PyMallocStats;
+
+/* Fill in *stats and return 0, or return -1 if pymalloc is disabled. */
+PyAPI_FUNC(int) _PyObject_GetMallocStats(_PyMallocStats *stats);
+
+/* Call hook(nbytes) for one PyObject_Malloc() every interval bytes
+   requested, on average, or stop if hook is NULL.  The hook runs inside
+   the allocator with the GIL held, so it must not allocate Python
+   objects. */
+PyAPI_FUNC(void) _PyObject_SetMallocSampling(size_t interval,
+					     void (*hook)(size_t nbytes));
+
 
 /* Macros */
 #ifdef WITH_PYMALLOC
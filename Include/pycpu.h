@@ -0,0 +1,35 @@
+#ifndef Py_PYCPU_H
+#define Py_PYCPU_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Instruction set extensions of the CPU we run on.
+
+   A few hot loops have vectorized versions for x86, built with the
+   compiler's target attribute so that they don't depend on the -m flags
+   Python itself was compiled with.  _PyCPU_Init() fills in
+   _Py_cpu_features at startup, and those loops check it to pick a
+   version; until then, or on other platforms, it is 0 and they run the
+   portable code. */
+
+#define PY_CPU_SSE2	0x1
+#define PY_CPU_AVX2	0x2	/* includes OS support for the YMM registers */
+
+PyAPI_DATA(int) _Py_cpu_features;
+
+PyAPI_FUNC(void) _PyCPU_Init(void);
+
+/* Defined when the compiler can build the vectorized loops. */
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || (defined(__GNUC__) && \
+     (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define Py_HAVE_X86_SIMD 1
+#define Py_TARGET_SSE2 __attribute__((target("sse2")))
+#define Py_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* !Py_PYCPU_H */
@@ -99,6 +99,9 @@ typedef struct _ts {
     PyObject *async_exc; /* Asynchronous exception to raise */
     long thread_id; /* Thread id where this tstate was created */
 
+    /* Free small blocks for PyObject_Malloc, see Objects/obmalloc.c */
+    struct _obmalloc_cache *obmalloc_cache;
+
     /* XXX signal handlers should also be here */
 
 } PyThreadState;
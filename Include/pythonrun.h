@@ -125,6 +125,7 @@ PyAPI_FUNC(void) _PyImportHooks_Init(void);
 PyAPI_FUNC(int) _PyFrame_Init(void);
 PyAPI_FUNC(int) _PyInt_Init(void);
 PyAPI_FUNC(void) _PyFloat_Init(void);
+PyAPI_FUNC(void) _PyTuple_Init(void);
 PyAPI_FUNC(int) PyByteArray_Init(void);
 
 /* Various internal finalizers */
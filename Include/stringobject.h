@@ -43,8 +43,8 @@ typedef struct PyStringObject {
      *     ob_sval[ob_size] == 0.
      *     ob_shash is the hash of the string or -1 if not computed yet.
      *     ob_sstate != 0 iff the string object is in stringobject.c's
-     *       'interned' dictionary; in this case the two references
-     *       from 'interned' to this object are *not counted* in ob_refcnt.
+     *       'interned' table; the reference from 'interned' to this
+     *       object is *not counted* in ob_refcnt.
      */
 } PyStringObject;
 
@@ -82,6 +82,9 @@ PyAPI_FUNC(PyObject *) PyString_DecodeEscape(const char *, Py_ssize_t,
 PyAPI_FUNC(void) PyString_InternInPlace(PyObject **);
 PyAPI_FUNC(void) PyString_InternImmortal(PyObject **);
 PyAPI_FUNC(PyObject *) PyString_InternFromString(const char *);
+PyAPI_FUNC(PyObject *) _PyString_InternFromStringAndSize(const char *,
+                                                         Py_ssize_t);
+PyAPI_FUNC(PyObject *) _PyString_InternStats(void);
 PyAPI_FUNC(void) _Py_ReleaseInternedStrings(void);
 
 /* Use only if you know it's a string */
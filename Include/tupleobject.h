@@ -25,6 +25,7 @@ Keep this in sync with Util/PyTypeBuilder.h.
 
 typedef struct PyTupleObject {
     PyObject_VAR_HEAD
+    long ob_hash;   /* cached hash of an exact tuple, or -1 */
     PyObject *ob_item[1];
 
     /* ob_item contains space for 'ob_size' elements.
@@ -51,8 +52,13 @@ PyAPI_FUNC(PyObject *) PyTuple_Pack(Py_ssize_t, ...);
 #define PyTuple_GET_ITEM(op, i) (((PyTupleObject *)(op))->ob_item[i])
 #define PyTuple_GET_SIZE(op)    Py_SIZE(op)
 
-/* Macro, *only* to be used to fill in brand new tuples */
-#define PyTuple_SET_ITEM(op, i, v) (((PyTupleObject *)(op))->ob_item[i] = v)
+/* Macro, *only* to be used to fill in brand new tuples, or tuples that
+   nothing else refers to.  It forgets any cached hash, since C code that
+   recycles its result tuples (like itertools.izip) refills them this
+   way. */
+#define PyTuple_SET_ITEM(op, i, v) \
+    (((PyTupleObject *)(op))->ob_hash = -1, \
+     ((PyTupleObject *)(op))->ob_item[i] = v)
 
 PyAPI_FUNC(int) PyTuple_ClearFreeList(void);
 
@@ -5,35 +5,41 @@
 # import the error from re
 #from re import error
 
-import numbers, sys
+import sys
 
 class RegexObject(object):
   def __init__(self, pattern, flags):
     # call sre_parse to parse re string into an object
     from sre_parse import parse
-    self.__parsed = parse(pattern, flags)
-    flags = self.__parsed.pattern.flags
+    parsed = parse(pattern, flags)
+    flags = parsed.pattern.flags
+    groups = parsed.pattern.groups-1
+    groupindex = parsed.pattern.groupdict
     # flatten the subpatterns in the sequence
-    processed = self.__flatten_subpatterns(self.__parsed)
+    processed = self.__flatten_subpatterns(parsed)
+    # compile_set puts the flattened patterns together
+    self._flattened = processed
     # compile to native code
     from _llvmre import RegEx
-    self.__re = RegEx(processed, flags, self.__parsed.pattern.groups-1)
+    self.__re = RegEx(processed, flags, groups, groupindex, pattern)
     # expected properties
     self.flags = flags
-    self.groups = self.__parsed.pattern.groups-1
-    self.groupindex = self.__parsed.pattern.groupdict
+    self.groups = groups
+    self.groupindex = groupindex
     self.pattern = pattern
 
+    # these are implemented natively, and so are the match objects they
+    # return
+    self.match = self.__re.match
+    self.search = self.__re.search
+    self.finditer = self.__re.finditer
+    self.scanner = self.__re.scanner
+    self.sub = self.__re.sub
+    self.subn = self.__re.subn
+
     if flags & 128: # SRE_FLAG_DEBUG
       self.__re.dump()
 
-  def __unicode(self, s):
-    '''return @s as a unicode string'''
-    try:
-      return unicode(s)
-    except:
-      return unicode(s, 'latin1')
-
   def __flatten_subpatterns(self, pattern):
     new_pattern = []
     for op, av in pattern:
@@ -71,191 +77,104 @@ class RegexObject(object):
         new_pattern.append((op, av))
     return new_pattern
 
-  def match(self, string, pos=0, endpos=sys.maxsize):
-    endpos = min(endpos, len(string))
-    groups = self.__re.match(self.__unicode(string), pos, endpos)
-    if groups:
-      return MatchObject(self, string, pos, endpos, groups, self.__parsed)
-    else:
-      return None
-
-  def search(self, string, pos=0, endpos=sys.maxsize):
-    endpos = min(endpos, len(string))
-    groups = self.__re.find(self.__unicode(string), pos, endpos)
-    if groups:
-      return MatchObject(self, string, pos, endpos, groups, self.__parsed)
-    else:
-      return None
-
   def split(self, string, maxsplit=0):
-    # find matches for the separator
-    matches = [m for m in self.__finditer(string, count=maxsplit, 
-      ignore_empty=True)]
-    # find the spans of those matches
-    spans = [m.span() for m in matches]
-    # find the spans between those matches
-    spans = reduce(lambda result,span: 
-        result[:-1] + [(result[-1], span[0]), span[1]], spans, [0])
-    spans[-1] = (spans[-1],len(string))
-
-    split = [string[a:b] for a,b in spans]
-    if self.groups:
-      # there are capturing groups, insert them into the result
-      result = []
-      for i in range(len(matches)):
-        result.append(split[i])
-        result.extend(matches[i].groups())
-      result.append(split[-1])
-      return result
-    else:
-      return split
-
-  def __finditer(self, string, pos=0, endpos=sys.maxsize, count=0, ignore_empty=False):
-    endpos = min(endpos, len(string))
-    _pos = pos
-    num = 0
-    while True:
-      groups = self.__re.find(self.__unicode(string), _pos, endpos)
-      if groups:
-        # next time search after this result
-        if groups[0] == groups[1]:
-          _pos = groups[1] + 1
-          # if we should ignore empty matches, skip it
-          if ignore_empty:
-            continue
-        else:
-          _pos = groups[1]
-        # yeild this result
-        yield MatchObject(self, string, pos, endpos, groups, self.__parsed)
-
-        # increment the counter
-        num = num + 1
-        # check the counter
-        if count and num >= count:
-          raise StopIteration
-      else:
-        # no match, stop looking
-        raise StopIteration
+    result = []
+    last = 0
+    n = 0
+    for m in self.finditer(string):
+      if maxsplit and n >= maxsplit:
+        break
+      start, end = m.span()
+      if start == end:
+        # empty matches don't split the string
+        continue
+      result.append(string[last:start])
+      # if there are capturing groups, insert them into the result
+      result.extend(m.groups())
+      last = end
+      n = n + 1
+    result.append(string[last:])
+    return result
 
   def findall(self, string, pos=0, endpos=sys.maxsize):
-    endpos = min(endpos, len(string))
     all = []
     for m in self.finditer(string, pos, endpos):
       if self.groups == 0:
         all.append(m.group(0))
       elif self.groups == 1:
-        all.append(m.group(1))
+        all.append(m.groups('')[0])
       else:
-        all.append(m.groups())
+        all.append(m.groups(''))
     return all
 
-  def finditer(self, string, pos=0, endpos=sys.maxsize):
-    return self.__finditer(string, pos, endpos)
-
-  def sub(self, repl, string, count=0):
-    return self.subn(repl, string, count)[0]
-
-  def subn(self, repl, string, count=0):
-    result = ''
-    pos = 0
-    matched = False
-
-    # find the matches
-    matches = list(self.__finditer(string, count=count))
-
-    # substitute matches for replacements
-    for m in matches:
-      if matched and pos == m.start() and pos == m.end():
-        # ignore empty matches immediately following another match
-        continue
-      matched = True
-      result = result + string[pos:m.start()]
-      if callable(repl):
-        result = result + repl(m)
-      else:
-        result = result + m.expand(repl)
-      pos = m.end()
-    result = result + string[pos:len(string)]
-
-    return (result, len(matches))
-
-
-class MatchObject(object):
-  def __init__(self, regex, string, pos, endpos, groups, parsed):
-    self.__regex = regex
-    self.regs = []
-    self.__parsed = parsed
-    if len(groups) > 3:
-      self.lastindex = groups.pop(-1)
-    else:
-      self.lastindex = None
-    while len(groups) >= 2: self.regs.append((groups.pop(0), groups.pop(0)))
-    self.regs = tuple(self.regs)
-    self.pos = pos
-    self.endpos = endpos
-    self.re = regex.pattern
-    self.string = string
-    self.lastgroup = None
-    for name, num in regex.groupindex.items():
-      if num == self.lastindex:
-        self.lastgroup = name
-        break
-
-  def __groupnum(self, group):
-    '''take a group name (or number) and return the group number'''
-    if isinstance(group, numbers.Integral):
-      return group
-    else:
-      return self.__regex.groupindex[group]
-
-  def span(self, group=0):
-    return self.regs[self.__groupnum(group)]
-
-  def start(self, group=0):
-    return self.span(group)[0]
-
-  def end(self, group=0):
-    return self.span(group)[1]
- 
-  def group(self, *groups):
-    result = []
-    for group in groups:
-      span = self.span(group)
-      if span[0] == -1 or span[1] == -1:
-        result.append(None)
-      else:
-        result.append(self.string[span[0]:span[1]])
-    if len(result) == 1: return result[0]
-    else: return tuple(result)
-
-  def groups(self, default=None):
-    result = []
-    for span in self.regs[1:]:
-      if span[0] == -1 or span[1] == -1:
-        result.append(default)
-      else:
-        result.append(self.string[span[0]:span[1]])
-    return tuple(result)
-
-  def groupdict(self, default=None):
-    result = {}
-    for name, number in self.__regex.groupindex.items():
-      result[name] = self.group(number)
-      if result[name] == None: result[name] = default
-    return result
-
-  def expand(self, template):
-    # reuse SRE's template code
-    from sre_parse import parse_template, expand_template
-    return expand_template(parse_template(template, self.__regex), self)
+# compiled patterns are shared by everything in the process that compiles
+# the same pattern with the same flags, so the native code for a pattern is
+# only generated and optimized once
+_cache = {}
+_MAXCACHE = 500
 
 def compile(pattern, flags=0):
   if isinstance(pattern, RegexObject):
     if flags != pattern.flags:
       raise ValueError()
     return pattern
-  else:
-    return RegexObject(pattern, flags)
+  key = (type(pattern), pattern, flags)
+  p = _cache.get(key)
+  if p is None:
+    p = RegexObject(pattern, flags)
+    if len(_cache) >= _MAXCACHE:
+      _cache.clear()
+    _cache[key] = p
+  return p
+
+class RegexSet(object):
+  '''a list of patterns that are matched against a string together'''
+  def __init__(self, patterns, flags):
+    self.patterns = [compile(pattern, flags) for pattern in patterns]
+    self.flags = flags
+    # match them all in one pass if they can be put into one automaton,
+    # otherwise match each of them in turn
+    from _llvmre import RegExSet
+    try:
+      self.__set = RegExSet([p._flattened for p in self.patterns],
+                            [p.flags for p in self.patterns])
+    except ValueError:
+      self.__set = None
+
+  def matches(self, string, pos=0, endpos=sys.maxsize):
+    '''return (index, span) for each pattern that matches at pos'''
+    if self.__set is not None:
+      return self.__set.match(string, pos, endpos)
+    result = []
+    for i in range(len(self.patterns)):
+      m = self.patterns[i].match(string, pos, endpos)
+      if m is not None:
+        result.append((i, m.span()))
+    return result
+
+  def match(self, string, pos=0, endpos=sys.maxsize):
+    '''return (index, match object) for the first pattern that matches at
+    pos, or None'''
+    if self.__set is not None:
+      candidates = [i for i, span in self.__set.match(string, pos, endpos)]
+    else:
+      candidates = range(len(self.patterns))
+    for i in candidates:
+      m = self.patterns[i].match(string, pos, endpos)
+      if m is not None:
+        return i, m
+    return None
+
+def compile_set(patterns, flags=0):
+  return RegexSet(patterns, flags)
+
+def cached(pattern, flags=0):
+  '''return the compiled pattern if it's already been compiled, otherwise
+  None'''
+  return _cache.get((type(pattern), pattern, flags))
+
+def purge():
+  _cache.clear()
 
 def match(pattern, string, flags=0):
   return compile(pattern, flags).match(string)
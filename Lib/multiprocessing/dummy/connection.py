@@ -48,14 +48,9 @@ class Connection(object):
         self.recv = self.recv_bytes = _in.get
 
     def poll(self, timeout=0.0):
-        if self._in.qsize() > 0:
-            return True
         if timeout <= 0.0:
-            return False
-        self._in.not_empty.acquire()
-        self._in.not_empty.wait(timeout)
-        self._in.not_empty.release()
-        return self._in.qsize() > 0
+            return self._in.qsize() > 0
+        return self._in._wait_not_empty(timeout)
 
     def close(self):
         pass
@@ -586,11 +586,12 @@ class ThreadPool(Pool):
 
     @staticmethod
     def _help_stuff_finish(inqueue, task_handler, size):
-        # put sentinels at head of inqueue to make workers finish
-        inqueue.not_empty.acquire()
+        # drop the pending tasks and put sentinels in inqueue to make
+        # workers finish
         try:
-            inqueue.queue.clear()
-            inqueue.queue.extend([None] * size)
-            inqueue.not_empty.notify_all()
-        finally:
-            inqueue.not_empty.release()
+            while 1:
+                inqueue.get_nowait()
+        except Queue.Empty:
+            pass
+        for i in range(size):
+            inqueue.put(None)
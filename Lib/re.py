@@ -199,6 +199,7 @@ def purge():
     "Clear the regular expression cache"
     _cache.clear()
     _cache_repl.clear()
+    llvmre.purge()
 
 def template(pattern, flags=0):
     "Compile a template pattern, returning a pattern object"
@@ -240,7 +241,10 @@ class Pattern(object):
     if flags & SREONLY:
       self._compile = self._compile_sre
       self._call = self._call_simple
-    elif flags & LLVMREONLY:
+    elif flags & LLVMREONLY or (self._reuse_llvmre and
+                                llvmre.cached(pattern, flags) is not None):
+      # llvmre has already compiled this pattern, there's no point in
+      # starting with SRE
       self._compile = self._compile_llvmre
       self._call = self._call_llvmre
 
@@ -269,6 +273,9 @@ class Pattern(object):
   # by default compile to SRE first
   _compile = None
 
+  # use llvmre straight away for patterns it has already compiled
+  _reuse_llvmre = True
+
   def _call_sre(self, method, *args):
     '''call SRE and possibly compile the llvmre'''
     self.__hitcount = self.__hitcount + 1
@@ -308,6 +315,9 @@ class Pattern(object):
   def subn(self, repl, string, count=0):
     return self._call('subn', repl, string, count)
 
+  def scanner(self, string, pos=0, endpos=sys.maxsize):
+    return self._call('scanner', string, pos, endpos)
+
 
 # read PYTHONRE to decide what to do. PYTHONRE can contain zero or more of:
 #  llvmreonly - only compile to native code, don't use SRE
@@ -366,6 +376,7 @@ def process_PYTHONRE():
     # only and always use sre?
     # don't count hits or anything
     Pattern._call = Pattern._call_simple
+    Pattern._reuse_llvmre = False
   
 process_PYTHONRE()
 
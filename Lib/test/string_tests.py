@@ -210,6 +210,28 @@ class CommonTest(unittest.TestCase):
                 if loc != -1:
                     self.assertEqual(i[loc:loc+len(j)], j)
 
+    def test_find_long(self):
+        # Matches at and around the boundaries of the blocks that the
+        # vectorized searches work on, and at the very end of the target.
+        for n in (15, 16, 17, 31, 32, 33, 64, 100):
+            for k in xrange(n + 1):
+                s = 'a' * k + 'bc' + 'a' * (n - k)
+                self.checkequal(k, s, 'find', 'bc')
+                self.checkequal(k, s, 'find', 'b')
+                self.checkequal(1, s, 'count', 'bc')
+                self.checkequal(1, s, 'count', 'b')
+                self.checkequal(['a' * k, 'a' * (n - k)], s, 'split', 'bc')
+                self.checkequal(['a' * k, 'c' + 'a' * (n - k)], s, 'split', 'b')
+                self.checkequal(-1, s, 'find', 'ba')
+                self.checkequal(-1, s, 'find', 'bc', k + 1)
+                self.checkequal(n, s, 'count', 'a')
+            s = 'x' * n
+            self.checkequal(n, s + 'y', 'find', 'y')
+            self.checkequal(n - 1, s + 'yz', 'find', 'xyz')
+            self.checkequal(-1, s + 'y', 'find', 'yz')
+            self.checkequal(n // 3, s, 'count', 'xxx')
+            self.checkequal(n, s, 'count', 'x')
+
     def test_rfind(self):
         self.checkequal(9,  'abcdefghiabc', 'rfind', 'abc')
         self.checkequal(12, 'abcdefghiabc', 'rfind', '')
@@ -1,7 +1,7 @@
 import unittest
 from test import test_support
 
-import UserDict, random, string
+import UserDict, random, string, sys
 
 
 class DictTest(unittest.TestCase):
@@ -554,6 +554,157 @@ class DictTest(unittest.TestCase):
             pass
         d = {}
 
+    def test_insertion_order(self):
+        # Dicts iterate in the order their keys were inserted, and
+        # popitem() takes the last item.
+        keys = [repr(i) for i in range(1000)]
+        d = {}
+        for k in keys:
+            d[k] = k
+        self.assertEqual(d.keys(), keys)
+        for k in keys[::3]:
+            del d[k]
+        d['x'] = 'x'
+        kept = [k for k in keys if int(k) % 3] + ['x']
+        self.assertEqual(d.keys(), kept)
+        self.assertEqual(list(d.iteritems()), zip(kept, kept))
+        self.assertEqual(d.popitem(), ('x', 'x'))
+        self.assertEqual(d.popitem(), ('998', '998'))
+
+        # So do instance dicts, whatever order the other instances of the
+        # class set their attributes in.
+        class C(object):
+            pass
+        a = C()
+        a.x = a.y = a.z = 1
+        b = C()
+        b.y = b.x = 1
+        self.assertEqual(b.__dict__.keys(), ['y', 'x'])
+        b.z = 1
+        self.assertEqual(b.__dict__.keys(), ['y', 'x', 'z'])
+        self.assertEqual(a.__dict__.keys(), ['x', 'y', 'z'])
+        del a.x
+        a.x = 1
+        self.assertEqual(a.__dict__.keys(), ['y', 'z', 'x'])
+        c = C()
+        c.x = c.y = 1
+        del c.y
+        c.z = c.y = 1
+        self.assertEqual(c.__dict__.keys(), ['x', 'z', 'y'])
+
+    def test_churn(self):
+        # Deleting and inserting keys never fills the table with dummies.
+        d = {'a': 1}
+        for i in range(10000):
+            d[i] = i
+            del d[i]
+        self.assertEqual(d, {'a': 1})
+        self.assert_(sys.getsizeof(d) <= sys.getsizeof({}))
+
+
+
+class SplitDictTest(unittest.TestCase):
+    # Instance dicts share their keys with the other instances of their
+    # class until one of them needs a key the others can't share.
+
+    def make_instances(self, cls, n=3):
+        objs = []
+        for i in range(n):
+            o = cls()
+            o.x = i
+            o.y = i * 2
+            objs.append(o)
+        return objs
+
+    def check_split(self, cls):
+        a, b, c = self.make_instances(cls)
+        self.assertEqual(a.__dict__, {'x': 0, 'y': 0})
+        self.assertEqual(b.__dict__, {'x': 1, 'y': 2})
+        self.assertEqual(sorted(c.__dict__.items()), [('x', 2), ('y', 4)])
+        self.assertEqual(c.__dict__.keys(), b.__dict__.keys())
+        self.assertEqual(list(c.__dict__.itervalues()), [c.__dict__[k]
+                         for k in c.__dict__])
+
+        # Deleting a key leaves the other instances alone.
+        del a.x
+        self.assertFalse(hasattr(a, 'x'))
+        self.assertEqual(a.__dict__, {'y': 0})
+        self.assertEqual(b.x, 1)
+        a.x = 5
+        self.assertEqual(a.__dict__, {'x': 5, 'y': 0})
+        self.assertEqual(a.__dict__.pop('x'), 5)
+        self.assertEqual(a.__dict__, {'y': 0})
+
+        # A key that isn't a string makes the dict stop sharing.
+        b.__dict__[1] = 'one'
+        self.assertEqual(b.__dict__, {1: 'one', 'x': 1, 'y': 2})
+        self.assertEqual(c.__dict__, {'x': 2, 'y': 4})
+
+        c.__dict__.clear()
+        self.assertEqual(c.__dict__, {})
+        c.z = 3
+        self.assertEqual(c.__dict__, {'z': 3})
+
+        d, e = self.make_instances(cls, 2)
+        key, value = d.__dict__.popitem()
+        self.assertEqual(value, 0)
+        self.assertEqual(len(d.__dict__), 1)
+        self.assertFalse(hasattr(d, key))
+        self.assertEqual(getattr(e, key), {'x': 1, 'y': 2}[key])
+        self.assertEqual(e.__dict__.copy(), {'x': 1, 'y': 2})
+        f = {}
+        f.update(e.__dict__)
+        self.assertEqual(f, e.__dict__)
+
+        # More keys than the shared table can hold.
+        for i in range(300):
+            setattr(e, 'a%d' % i, i)
+        self.assertEqual(len(e.__dict__), 302)
+        self.assertEqual(e.a299, 299)
+        g = cls()
+        g.x = 7
+        self.assertEqual(g.__dict__, {'x': 7})
+        self.assertEqual(e.x, 1)
+
+    def test_newstyle_class(self):
+        class C(object):
+            pass
+        self.check_split(C)
+
+    def test_classic_class(self):
+        class C:
+            pass
+        self.check_split(C)
+
+    def test_update_many(self):
+        # Merging more keys than the shared table holds.
+        class C(object):
+            pass
+        a, b = self.make_instances(C, 2)
+        items = dict(('k%d' % i, i) for i in range(100))
+        a.__dict__.update(items)
+        self.assertEqual(len(a.__dict__), 102)
+        self.assertEqual(a.k99, 99)
+        b.__dict__.update(items)
+        self.assertEqual(b.__dict__, dict(items, x=1, y=2))
+
+    def test_sizeof(self):
+        class C(object):
+            pass
+        a, b = self.make_instances(C, 2)
+        self.assertTrue(sys.getsizeof(b.__dict__) < sys.getsizeof({}))
+
+    def test_watched_globals(self):
+        # Functions using a split dict as their globals see it change.
+        class C(object):
+            pass
+        a, b = self.make_instances(C, 2)
+        code = compile('def f(): return x', '<string>', 'exec')
+        exec code in b.__dict__
+        f = b.__dict__['f']
+        self.assertEqual(f(), 1)
+        b.x = 10
+        self.assertEqual(f(), 10)
 
 
 from test import mapping_tests
@@ -570,6 +721,7 @@ class SubclassMappingTests(mapping_tests.BasicTestMappingProtocol):
 def test_main():
     test_support.run_unittest(
         DictTest,
+        SplitDictTest,
         GeneralMappingTests,
         SubclassMappingTests,
     )
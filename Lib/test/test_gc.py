@@ -273,6 +273,59 @@ class GCTests(unittest.TestCase):
         gc.collect(2)
         assertEqual(gc.get_count(), (0, 0, 0))
 
+    def test_pause_target(self):
+        self.assertEqual(gc.get_pause_target(), 0.0)
+        self.assertRaises(ValueError, gc.set_pause_target, -1)
+        class A(list):
+            pass
+        gc.collect()
+        cycles = []
+        for i in range(100):
+            a = A()
+            a.append(a)
+            cycles.append(a)
+        # Move the cycles to the oldest generation, then make them trash.
+        gc.collect(1)
+        wrs = [weakref.ref(a) for a in cycles]
+        del a, cycles[:]
+        # Automatic collections should find them, a slice at a time.
+        longlived = []
+        gc.set_pause_target(1)
+        gc.enable()
+        try:
+            self.assertEqual(gc.get_pause_target(), 1.0)
+            for i in xrange(1000000):
+                longlived.append([i])
+                if i % 1000 == 0 and all(wr() is None for wr in wrs):
+                    break
+        finally:
+            gc.disable()
+            gc.set_pause_target(0)
+        self.assertEqual([wr for wr in wrs if wr() is not None], [])
+        self.assertTrue(longlived[-1] in gc.get_objects())
+
+    def test_freeze(self):
+        class A(list):
+            pass
+        gc.collect()
+        a = A()
+        a.append(a)
+        wr = weakref.ref(a)
+        gc.freeze()
+        try:
+            self.assertTrue(gc.get_freeze_count() > 0)
+            self.assertTrue(a in gc.get_objects())
+            self.assertTrue(a in gc.get_referrers(a))
+            # Frozen cycles are left alone, even by full collections.
+            del a
+            gc.collect()
+            self.assertTrue(wr() is not None)
+        finally:
+            gc.unfreeze()
+        self.assertEqual(gc.get_freeze_count(), 0)
+        gc.collect()
+        self.assertTrue(wr() is None)
+
     def test_trashcan(self):
         class Ouch:
             n = 0
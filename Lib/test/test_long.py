@@ -18,6 +18,7 @@ SHIFT = 15
 BASE = 2 ** SHIFT
 MASK = BASE - 1
 KARATSUBA_CUTOFF = 70   # from longobject.c
+TOOM3_CUTOFF = 450      # from longobject.c
 
 # Max number of base BASE digits to use in test cases.  Doubling
 # this will more than double the runtime.
@@ -164,6 +165,59 @@ class LongTest(unittest.TestCase):
                 self.assertEqual(x, y,
                     Frm("bad result for a*b: a=%r, b=%r, x=%r, y=%r", a, b, x, y))
 
+    def test_toom3(self):
+        digits = [TOOM3_CUTOFF + 1, TOOM3_CUTOFF + 2, TOOM3_CUTOFF * 3,
+                  TOOM3_CUTOFF * 10]
+        for adigits in digits:
+            for bdigits in digits:
+                if bdigits < adigits or 3 * adigits <= 2 * bdigits:
+                    continue
+                # Products of strings of 1 bits, as in test_karatsuba.
+                abits = adigits * SHIFT
+                bbits = bdigits * SHIFT
+                a = (1L << abits) - 1
+                b = (1L << bbits) - 1
+                self.assertEqual(a * b, (1L << (abits + bbits)) -
+                                 (1L << abits) - (1L << bbits) + 1)
+                # Random operands of both signs, checked against the
+                # schoolbook product of their low and high halves.
+                a = self.getran(adigits)
+                b = -self.getran(bdigits)
+                half = 1L << (adigits // 2 * SHIFT)
+                ah, al = divmod(a, half)
+                self.assertEqual(a * b, (ah * b) * half + al * b)
+                self.assertEqual(a * a, (ah * a) * half + al * a)
+                self.assertEqual((a * b) // b, a)
+
+    def test_big_decimal(self):
+        def slow_str(x):
+            # Peel off 50 digits at a time by long division.
+            if x < 0:
+                return '-' + slow_str(-x)
+            chunks = []
+            while x >= 10**50:
+                x, r = divmod(x, 10**50)
+                chunks.append('%050d' % r)
+            chunks.append(str(x))
+            chunks.reverse()
+            return ''.join(chunks)
+
+        values = [10**n + d for n in (300, 1024, 4096, 10000)
+                            for d in (-1, 0, 1)]
+        values += [self.getran(n) for n in (61, 100, 500, 2000)]
+        values += [-x for x in values]
+        for x in values:
+            s = slow_str(x)
+            self.assertEqual(str(x), s)
+            self.assertEqual(repr(x), s + 'L')
+            self.assertEqual(long(s), x)
+            self.assertEqual(long(s + 'L'), x)
+            self.assertEqual(long(' ' + s + ' '), x)
+        s = '0' * 5000 + '1' * 5000
+        self.assertEqual(long(s), long('1' * 5000))
+        self.assertEqual(long('0' * 5000), 0)
+        self.assertRaises(ValueError, long, '1' * 5000 + 'x')
+
     def check_bitop_identities_1(self, x):
         eq = self.assertEqual
         eq(x & 0, 0, Frm("x & 0 != 0 for x=%r", x))
@@ -137,6 +137,21 @@ class StringTestCase(unittest.TestCase):
             self.assertEqual(s, new)
         os.unlink(test_support.TESTFN)
 
+    def test_interned_single_chars(self):
+        # Build the TYPE_INTERNED records without making any one-character
+        # strings, so that loading them creates most of those strings.
+        data = bytearray()
+        for i in range(256):
+            data += bytearray('t\x01\x00\x00\x00')
+            data.append(i)
+        data = str(data)
+        for i in range(256):
+            before = sys._interned_stats()["strings"]
+            s = marshal.loads(data[i * 6:i * 6 + 6])
+            self.assert_(sys._interned_stats()["strings"] <= before + 1)
+            self.assertEqual(ord(s), i)
+            self.assert_(s is intern(chr(i)))
+
 class ExceptionTestCase(unittest.TestCase):
     def test_exceptions(self):
         new = marshal.loads(marshal.dumps(StopIteration))
@@ -189,6 +189,125 @@ class BaseQueueTest(unittest.TestCase, BlockingTestMixin):
         self.simple_queue_test(q)
         self.simple_queue_test(q)
 
+    def test_many_producers_and_consumers(self):
+        # Every item put by a producer must reach exactly one consumer,
+        # with both sides blocking on a queue that is mostly full or empty.
+        q = self.type2test(2)
+        results = []
+        def produce(start):
+            for i in xrange(start, start + 200):
+                q.put(i, timeout=10)
+        def consume():
+            while True:
+                x = q.get(timeout=10)
+                if x is None:
+                    return
+                with self.cumlock:
+                    results.append(x)
+        consumers = [threading.Thread(target=consume) for i in range(3)]
+        producers = [threading.Thread(target=produce, args=(i * 200,))
+                     for i in range(3)]
+        for t in consumers + producers:
+            t.start()
+        for t in producers:
+            t.join()
+        for t in consumers:
+            q.put(None)
+        for t in consumers:
+            t.join()
+        self.assertEquals(sorted(results), range(600))
+
+    def test_hooks_with_threads(self):
+        # The _qsize(), _put() and _get() of a subclass run Python code,
+        # like the comparisons heapq makes for a PriorityQueue, so other
+        # threads get to run in the middle of them.  The queue must still
+        # serialize them.
+        class Item(object):
+            def __init__(self, value):
+                self.value = value
+            def __cmp__(self, other):
+                return cmp(self.value, other.value)
+        q = self.type2test()
+        results = []
+        def produce(start):
+            for i in xrange(start, start + 300):
+                q.put(Item(i))
+        def consume():
+            for i in xrange(300):
+                x = q.get(timeout=10)
+                with self.cumlock:
+                    results.append(x.value)
+        threads = [threading.Thread(target=produce, args=(i * 300,))
+                   for i in range(4)]
+        threads += [threading.Thread(target=consume) for i in range(4)]
+        old_interval = sys.getcheckinterval()
+        sys.setcheckinterval(1)
+        try:
+            for t in threads:
+                t.start()
+            for t in threads:
+                t.join()
+        finally:
+            sys.setcheckinterval(old_interval)
+        self.assertEquals(sorted(results), range(1200))
+        self.assert_(q.empty())
+
+    def test_wait_not_empty(self):
+        # _wait_not_empty() leaves the item in place, and doesn't take the
+        # wakeup of a get() blocked next to it.
+        q = self.type2test()
+        self.assertEquals(q._wait_not_empty(0.01), False)
+        q.put(1)
+        self.assertEquals(q._wait_not_empty(0.01), True)
+        self.assertEquals(q.get_nowait(), 1)
+        results = []
+        getter = threading.Thread(
+            target=lambda: results.append(q.get(timeout=10)))
+        waiter = threading.Thread(
+            target=lambda: results.append(q._wait_not_empty(10)))
+        # The waiter blocks first, so it is the one woken by the put().
+        waiter.start()
+        time.sleep(0.1)
+        getter.start()
+        time.sleep(0.1)
+        q.put(2)
+        getter.join(10)
+        waiter.join(10)
+        self.assertEquals(sorted(results), [True, 2])
+        self.assert_(q.empty())
+
+    def test_locks(self):
+        # Code using the mutex and the conditions of the Python
+        # implementation keeps working, including with threads that were
+        # already waiting when the locks were first asked for.
+        q = self.type2test(2)
+        results = []
+        getter = threading.Thread(target=lambda: results.append(q.get()))
+        getter.start()
+        time.sleep(0.1)
+        q.not_empty.acquire()
+        try:
+            q._put("direct")
+            q.unfinished_tasks += 1
+            q.not_empty.notify()
+        finally:
+            q.not_empty.release()
+        getter.join(10)
+        self.assertEquals(results, ["direct"])
+        self.assert_(q.mutex.acquire(False))
+        q.mutex.release()
+        q.put(1)
+        q.put(2)
+        self.assertRaises(Queue.Full, q.put, 3, timeout=0.01)
+        self.do_blocking_test(q.put, (3,), q.get, ())
+        self.assertEquals(q.qsize(), 2)
+        q.get()
+        q.get()
+        for i in range(4):
+            q.task_done()
+        self.assertRaises(ValueError, q.task_done)
+        q.join()
+
 
 class QueueTest(BaseQueueTest):
     type2test = Queue.Queue
@@ -3,6 +3,7 @@ sys.path = ['.'] + sys.path
 
 from test.test_support import verbose, run_unittest
 import re
+import llvmre
 from re import Scanner
 import sys, os, traceback
 from weakref import proxy
@@ -686,6 +687,129 @@ class ReTests(unittest.TestCase):
         self.assertEqual(pattern.sub('#', '\n'), '#\n#')
 
 
+class LlvmReTests(unittest.TestCase):
+
+    def assertSearch(self, pattern, string, span, flags=0):
+        m = llvmre.compile(pattern, flags).search(string)
+        if span is None:
+            self.assertEqual(m, None)
+        else:
+            self.assertEqual(m.span(), span)
+
+    def test_search_prefix(self):
+        text = 'x' * 1000 + 'abcd' + 'y' * 10
+        self.assertSearch('abc', text, (1000, 1003))
+        self.assertSearch('(ab)cd', text, (1000, 1004))
+        self.assertSearch('ab+c', 'abbc', (0, 4))
+        self.assertSearch('abc', 'ababab', None)
+        self.assertSearch('b', 'aaab', (3, 4))
+        self.assertSearch('^ab', 'cab', None)
+        self.assertSearch('(?i)ab', 'xxAB', (2, 4))
+
+    def test_search_required_literal(self):
+        self.assertSearch('[a-z]+xyz', 'abc' * 100 + 'defxyz', (0, 306))
+        self.assertSearch('[0-9]+xyz', 'abc' * 100 + '123xyz', (300, 306))
+        self.assertSearch('.*abc', 'x' * 100, None)
+        self.assertSearch('.a.bcd', 'zazbcd', (0, 6))
+
+    def test_search_first_set(self):
+        self.assertSearch('[0-9]+', 'abc 123', (4, 7))
+        self.assertSearch('(?:foo|bar)baz', 'foobar barbaz', (7, 13))
+        self.assertSearch('x*y', 'aaaxxy', (3, 6))
+        self.assertSearch('x*y', 'aaay', (3, 4))
+        self.assertSearch('x?', 'abc', (0, 0))
+        self.assertSearch('(?i)[a-c]d', 'xxBD', (2, 4))
+        self.assertSearch('(?i)[A-C]d', 'xxbD', (2, 4))
+        self.assertSearch('[^a]', 'aab', (2, 3))
+        self.assertSearch('\\d', 'ab1', (2, 3))
+
+    def test_match_object(self):
+        p = llvmre.compile('(?P<a>x)(y)?(z)')
+        m = p.match('xz', 0)
+        self.assertEqual(m.group(), 'xz')
+        self.assertEqual(m.group('a', 2, 3), ('x', None, 'z'))
+        self.assertEqual(m.groups(), ('x', None, 'z'))
+        self.assertEqual(m.groups(''), ('x', '', 'z'))
+        self.assertEqual(m.groupdict(), {'a': 'x'})
+        self.assertEqual(m.span(3), (1, 2))
+        self.assertEqual(m.start('a'), 0)
+        self.assertEqual(m.end(), 2)
+        self.assertEqual(m.regs, ((0, 2), (0, 1), (-1, -1), (1, 2)))
+        self.assertEqual(m.string, 'xz')
+        self.assertEqual(m.re.pattern, p.pattern)
+        self.assertEqual(m.expand(r'\3\g<a>'), 'zx')
+        self.assertRaises(IndexError, m.group, 4)
+        self.assertRaises(IndexError, m.group, 'b')
+        self.assertEqual(p.match('xyz', 1), None)
+
+    def test_sub(self):
+        p = llvmre.compile('(a)(b)?')
+        self.assertEqual(p.sub('-', 'xaxabx'), 'x-x-x')
+        self.assertEqual(p.sub(r'<\1>', 'xaxab'), 'x<a>x<a>')
+        self.assertEqual(p.subn(lambda m: m.group().upper(), 'abab'),
+                         ('ABAB', 2))
+        self.assertEqual(p.sub('-', 'aaa', 2), '--a')
+        self.assertEqual(llvmre.compile('x*').sub('-', 'abxd'), '-a-b-d-')
+        self.assertEqual(llvmre.compile('b').sub(u'c', 'abc'), u'acc')
+        self.assertRaises(re.error, p.sub, r'\2', 'a')
+
+    def test_finditer_and_scanner(self):
+        p = llvmre.compile('x*')
+        self.assertEqual([m.span() for m in p.finditer('axx')],
+                         [(0, 0), (1, 3), (3, 3)])
+        self.assertEqual(p.findall('axx'), ['', 'xx', ''])
+        scanner = llvmre.compile(r'\s').scanner('a b')
+        self.assertEqual(scanner.match(), None)
+        self.assertEqual(scanner.search().span(), (1, 2))
+        self.assertEqual(scanner.search(), None)
+        self.assertEqual(llvmre.compile('(,)').split('a,b,c', 1),
+                         ['a', ',', 'b,c'])
+
+    def test_cache(self):
+        p = llvmre.compile('a+b')
+        self.assert_(llvmre.compile('a+b') is p)
+        self.assert_(llvmre.cached('a+b') is p)
+        self.assert_(llvmre.compile('a+b', re.I) is not p)
+        self.assert_(llvmre.compile(u'a+b') is not p)
+        llvmre.purge()
+        self.assertEqual(llvmre.cached('a+b'), None)
+        self.assert_(llvmre.compile('a+b') is not p)
+
+    def test_compile_set(self):
+        for patterns in (['[0-9]+', '[a-z]+', 'ab|abc', '(?i)AB'],
+                         # this one can't be put into one automaton
+                         ['[0-9]+', '[a-z]+', 'ab|abc', '(?i)AB', r'(x)\1']):
+            s = llvmre.compile_set(patterns)
+            self.assertEqual(s.matches('abc1'),
+                             [(1, (0, 3)), (2, (0, 2)), (3, (0, 2))])
+            self.assertEqual(s.matches('abc1', 3), [(0, (3, 4))])
+            self.assertEqual(s.matches('!'), [])
+            i, m = s.match('xyz')
+            self.assertEqual((i, m.group()), (1, 'xyz'))
+            i, m = s.match('ABC')
+            self.assertEqual((i, m.span()), (3, (0, 2)))
+            self.assertEqual(s.match('!'), None)
+
+    def test_dfa(self):
+        # these would backtrack exponentially
+        self.assertSearch('(a|aa)*[cd]', 'a' * 40, None)
+        self.assertSearch('(a|aa)*[cd]', 'a' * 40 + 'd', (0, 41))
+        self.assertEqual(llvmre.compile('(x+x+)+[yz]').match('x' * 40), None)
+        # the same matches as backtracking would find
+        self.assertSearch('a|ab', 'xab', (1, 2))
+        self.assertSearch('ab|a', 'xab', (1, 3))
+        self.assertSearch('(?:a|ab)c', 'abc', (0, 3))
+        self.assertSearch('a+?b*?', 'aab', (0, 1))
+        self.assertSearch('a{2,3}', 'aaaa', (0, 3))
+        self.assertSearch('a{2,3}?', 'aaaa', (0, 2))
+        self.assertSearch('a.*?b', 'xaxxbxb', (1, 5))
+        self.assertSearch(r'\d+\s\w', 'x 12 a', (2, 6))
+        self.assertSearch('.+', 'ab\ncd', (0, 2))
+        self.assertEqual(llvmre.compile('a*b').match('aaab', 1).span(), (1, 4))
+        m = llvmre.compile('(a|aa)*c').search('xaaac')
+        self.assertEqual((m.span(), m.groups()), ((1, 5), ('a',)))
+
+
 def run_re_tests():
     from test.re_tests import benchmarks, tests, SUCCEED, FAIL, SYNTAX_ERROR
     if verbose:
@@ -811,7 +935,7 @@ def run_re_tests():
                     print '=== Fails on unicode-sensitive match', t
 
 def test_main():
-    run_unittest(ReTests)
+    run_unittest(ReTests, LlvmReTests)
     run_re_tests()
 
 if __name__ == "__main__":
@@ -1676,6 +1676,106 @@ class TestGraphs(unittest.TestCase):
 
 #==============================================================================
 
+class TestHomogeneousKeys(unittest.TestCase):
+    # Sets of only strs or only ints take specialized paths for lookups,
+    # for probing one set with another, and for copying and merging; these
+    # compare them with the generic behavior.
+
+    def keys(self, kind, n):
+        if kind == 'int':
+            return [randrange(-3, 3 * n) for i in xrange(n)]
+        if kind == 'str':
+            return [str(randrange(3 * n)) for i in xrange(n)]
+        return [randrange(50), str(randrange(50)), float(randrange(50)),
+                10 ** 20 + randrange(3)][:randrange(1, 5)] * (n // 4)
+
+    def test_operations(self):
+        for trial in xrange(300):
+            kinds = ('int', 'str', 'mixed')
+            a = self.keys(kinds[trial % 3], randrange(60))
+            b = self.keys(kinds[trial // 3 % 3], randrange(60))
+            sa, sb = set(a), set(b)
+            for x in a[::2]:
+                sa.discard(x)
+            la = [x for x in sa]
+            lb = [x for x in sb]
+            self.assertEqual(sorted(sa & sb),
+                             sorted(x for x in la if x in lb))
+            self.assertEqual(sorted(sa - sb),
+                             sorted(x for x in la if x not in lb))
+            self.assertEqual(sorted(sa | sb),
+                             sorted(set(la + lb)))
+            self.assertEqual(sa.issubset(sb), all(x in lb for x in la))
+            self.assertEqual(sa.isdisjoint(sb),
+                             not any(x in lb for x in la))
+            c = set(sa)
+            c &= sb
+            self.assertEqual(c, sa & sb)
+            c = set(sa)
+            c |= sb
+            self.assertEqual(c, sa | sb)
+            self.assertEqual(frozenset(sa), sa)
+
+    def test_int_hash_collisions(self):
+        # -1 and -2 have the same hash.
+        s = set([-1, 0, 1])
+        self.assert_(-2 not in s)
+        self.assert_(-1 in s)
+        s.add(-2)
+        self.assertEqual(len(s), 4)
+        self.assertEqual(s & set([-2, 5]), set([-2]))
+        self.assertEqual(set([-1]) & set([-2]), set())
+        self.assert_(set([-1]).isdisjoint(set([-2])))
+        self.assertEqual(set([-1, -2]) - set([-2]), set([-1]))
+
+    def test_change_of_key_type(self):
+        s = set(range(100))
+        s.add('x')
+        s.add(1.0)
+        self.assertEqual(len(s), 101)
+        self.assert_('x' in s and 50 in s and 2.0 in s)
+        s = set(['a', 'b'])
+        self.assert_(1 not in s)
+        s.add(1)
+        self.assertEqual(s, set(['a', 'b', 1]))
+        class S(str):
+            def __hash__(self):
+                return hash(str(self))
+            def __eq__(self, other):
+                return str(self) == str(other).upper()
+        s = set(['A', 'B'])
+        self.assert_(S('A') in s)
+        self.assertEqual(s & set([S('A')]), set(['A']))
+
+    def test_merge_keeps_own_keys(self):
+        # x |= y keeps x's object where x and y hold equal keys, also when
+        # y is the bigger set.
+        for make in (lambda i: 'k%d' % i, lambda i: 10 ** 6 + i):
+            mine = make(0)
+            theirs = make(int('0'))
+            self.assert_(mine == theirs and mine is not theirs)
+            x = set([mine])
+            x |= set([theirs] + [make(i) for i in range(1, 100)])
+            self.assertEqual(len(x), 100)
+            self.assert_([k for k in x if k == mine][0] is mine)
+
+    def test_large(self):
+        n = 20000
+        a = set(str(i) for i in xrange(0, n, 2))
+        b = set(str(i) for i in xrange(0, n, 3))
+        self.assertEqual(a & b, set(str(i) for i in xrange(0, n, 6)))
+        self.assertEqual(len(a - b), len(a) - len(a & b))
+        c = set(a)
+        c &= b
+        self.assertEqual(c, a & b)
+        self.assert_(c.issubset(a) and c.issubset(b))
+        for i in xrange(0, n, 2):
+            a.discard(str(i))
+        self.assertEqual(a, set())
+        self.assertEqual(set(b), b)
+
+#==============================================================================
+
 def test_main(verbose=None):
     from test import test_sets
     test_classes = (
@@ -1712,6 +1812,7 @@ def test_main(verbose=None):
         TestIdentities,
         TestVariousIteratorArgs,
         TestGraphs,
+        TestHomogeneousKeys,
         )
 
     test_support.run_unittest(*test_classes)
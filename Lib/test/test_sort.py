@@ -265,6 +265,71 @@ class TestDecorateSortUndecorate(unittest.TestCase):
         copy2.sort(key=lambda x: x[0], reverse=True)
         self.assertEqual(data, copy2)
 
+class TestHomogeneous(unittest.TestCase):
+    # Lists whose keys all have the same simple type are sorted with
+    # specialized comparisons, and big int or float lists on unboxed keys;
+    # the results must match the generic cmp-based sort exactly.
+
+    def check_sorts(self, data):
+        expected = sorted(data, cmp=cmp)
+        self.assertEqual(sorted(data), expected)
+        self.assertEqual(sorted(data, reverse=True),
+                         sorted(data, cmp=cmp, reverse=True))
+        index = range(len(data))
+        by_key = sorted(index, key=data.__getitem__)
+        self.assertEqual(by_key,
+                         sorted(index, cmp=lambda i, j: cmp(data[i], data[j])))
+        self.assertEqual(sorted(index, key=data.__getitem__, reverse=True),
+                         sorted(index, cmp=lambda i, j: cmp(data[i], data[j]),
+                                reverse=True))
+
+    def test_small(self):
+        for n in (2, 3, 10, 100, 1000):
+            self.check_sorts([random.randrange(-50, 50) for i in xrange(n)])
+            self.check_sorts([random.choice([-0.0, 0.0, 0.5, -1e300,
+                                             float('inf'), -float('inf')])
+                              for i in xrange(n)])
+            self.check_sorts([random.choice(['', 'a', 'ab', 'b', '\0',
+                                             '\xff', 'a\0'])
+                              for i in xrange(n)])
+
+    def test_large(self):
+        n = 100000
+        self.check_sorts([random.randrange(-1000, 1000) for i in xrange(n)])
+        self.check_sorts([random.randrange(-sys.maxint - 1, sys.maxint)
+                          for i in xrange(n)])
+        self.check_sorts([random.choice([random.random(), -random.random(),
+                                         0.0, -0.0, float('inf')])
+                          for i in xrange(n)])
+        self.check_sorts(range(n) + range(n))
+
+    def test_floats_equal_but_distinct(self):
+        data = [random.choice([0.0, -0.0]) for i in xrange(100000)]
+        random.shuffle(data)
+        expected = [repr(x) for x in data]
+        data.sort()
+        self.assertEqual([repr(x) for x in data], expected)
+
+    def test_nan(self):
+        nan = float('nan')
+        data = [random.random() for i in xrange(100000)] + [nan]
+        random.shuffle(data)
+        data.sort()
+        self.assertEqual(len(data), 100001)
+        self.assertEqual(len([x for x in data if x != x]), 1)
+
+    def test_mixed_and_subclasses(self):
+        class MyInt(int):
+            def __lt__(self, other):
+                return int(self) > int(other)
+        data = [MyInt(i) for i in xrange(10)]
+        data.sort()
+        self.assertEqual(data, range(9, -1, -1))
+        data = [3, 1.5, 2L, True, 0]
+        data.sort()
+        self.assertEqual(data, [0, True, 1.5, 2L, 3])
+        self.assertRaises(TypeError, sorted, [1j, 2j])
+
 #==============================================================================
 
 def test_main(verbose=None):
@@ -272,6 +337,7 @@ def test_main(verbose=None):
         TestBase,
         TestDecorateSortUndecorate,
         TestBugs,
+        TestHomogeneous,
     )
 
     test_support.run_unittest(*test_classes)
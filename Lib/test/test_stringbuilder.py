@@ -0,0 +1,116 @@
+import struct
+import unittest
+from test import test_support
+
+_stringbuilder = test_support.import_module('_stringbuilder')
+StringBuilder = _stringbuilder.StringBuilder
+UnicodeBuilder = _stringbuilder.UnicodeBuilder
+
+
+class BuilderTests(unittest.TestCase):
+
+    def test_empty(self):
+        self.assertEqual(StringBuilder().build(), '')
+        self.assertEqual(UnicodeBuilder().build(), u'')
+        self.assertEqual(type(StringBuilder().build()), str)
+        self.assertEqual(type(UnicodeBuilder().build()), unicode)
+        self.assertEqual(len(StringBuilder()), 0)
+
+    def test_append(self):
+        for builder, s in ((StringBuilder, 'abc'),
+                           (UnicodeBuilder, u'\u20ac')):
+            b = builder()
+            pieces = []
+            for i in xrange(1000):
+                piece = s * (i % 7)
+                b.append(piece)
+                pieces.append(piece)
+                self.assertEqual(len(b), len(''.join(pieces)))
+            self.assertEqual(b.build(), s[:0].join(pieces))
+
+    def test_inplace_concat(self):
+        b = StringBuilder('x')
+        c = b
+        for i in xrange(100):
+            b += 'y'
+        self.assert_(b is c)
+        self.assertEqual(b.build(), 'x' + 'y' * 100)
+
+    def test_build_then_append(self):
+        b = StringBuilder()
+        b.append('abc')
+        first = b.build()
+        self.assert_(b.build() is first)
+        b.append('def')
+        self.assertEqual(b.build(), 'abcdef')
+        self.assertEqual(first, 'abc')
+        u = UnicodeBuilder(u'abc')
+        first = u.build()
+        u.append(u'd')
+        self.assertEqual(u.build(), u'abcd')
+        self.assertEqual(first, u'abc')
+
+    def test_first_append_shared(self):
+        s = 'shared string'
+        b = StringBuilder(s)
+        self.assert_(b.build() is s)
+
+    def test_type_errors(self):
+        self.assertRaises(TypeError, StringBuilder().append, u'x')
+        self.assertRaises(TypeError, StringBuilder().append, 1)
+        self.assertRaises(TypeError, UnicodeBuilder().append, 'x')
+        self.assertRaises(TypeError, StringBuilder, 'a', 'b')
+        self.assertRaises(TypeError, StringBuilder, x='a')
+        self.assertRaises(TypeError, hash, StringBuilder())
+
+    def test_buffer(self):
+        b = StringBuilder('hello')
+        s = b.build()
+        self.assertEqual(str(buffer(b)), 'hello')
+        # Writing through the buffer leaves the built string alone.
+        struct.pack_into('c', b, 0, 'j')
+        self.assertEqual(s, 'hello')
+        self.assertEqual(str(buffer(b)), 'jello')
+        b.append(' world')
+        self.assertEqual(b.build(), 'jello world')
+        self.assertEqual(str(buffer(b)), 'jello world')
+        self.assertRaises(TypeError, struct.pack_into, 'c',
+                          UnicodeBuilder(u'x'), 0, 'y')
+
+
+class ConcatenationTests(unittest.TestCase):
+    # 's += t' on a local resizes s in place when nothing else refers to
+    # it; these check that the result is right either way.
+
+    def test_str_local(self):
+        s = ''
+        for i in xrange(1000):
+            s += str(i % 10)
+        self.assertEqual(s, ''.join(str(i % 10) for i in xrange(1000)))
+
+    def test_unicode_local(self):
+        s = u''
+        keep = []
+        for i in xrange(1000):
+            s += unichr(0x100 + i % 10)
+            if i % 100 == 0:
+                keep.append(s)
+        self.assertEqual(s, u''.join(unichr(0x100 + i % 10)
+                                     for i in xrange(1000)))
+        for i, k in enumerate(keep):
+            self.assertEqual(k, s[:i * 100 + 1])
+
+    def test_unicode_shared_singletons(self):
+        for c in (u'', u'a', u'\xff'):
+            s = c
+            s += u'b'
+            self.assertEqual(s, c + u'b')
+            self.assertEqual(len(c), len(c.encode('utf-8').decode('utf-8')))
+
+
+def test_main():
+    test_support.run_unittest(BuilderTests, ConcatenationTests)
+
+
+if __name__ == "__main__":
+    test_main()
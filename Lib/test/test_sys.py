@@ -197,6 +197,21 @@ class SysModuleTest(unittest.TestCase):
             sys.setcheckinterval(n)
             self.assertEquals(sys.getcheckinterval(), n)
 
+    def test_switchinterval(self):
+        self.assertRaises(TypeError, sys.setswitchinterval)
+        self.assertRaises(TypeError, sys.setswitchinterval, "a")
+        self.assertRaises(ValueError, sys.setswitchinterval, -1.0)
+        self.assertRaises(ValueError, sys.setswitchinterval, 0.0)
+        orig = sys.getswitchinterval()
+        # sanity check
+        self.assertTrue(orig < 0.5, orig)
+        try:
+            for n in 0.00001, 0.05, 3.0, orig:
+                sys.setswitchinterval(n)
+                self.assertAlmostEquals(sys.getswitchinterval(), n)
+        finally:
+            sys.setswitchinterval(orig)
+
     def test_recursionlimit(self):
         self.assertRaises(TypeError, sys.getrecursionlimit, 42)
         oldlimit = sys.getrecursionlimit()
@@ -375,6 +390,68 @@ class SysModuleTest(unittest.TestCase):
     def test_clear_type_cache(self):
         sys._clear_type_cache()
 
+    def test_interned_stats(self):
+        stats = sys._interned_stats()
+        self.assert_(0 <= stats["immortal"] <= stats["strings"])
+        self.assert_(stats["strings"] < stats["slots"])
+        self.assert_(stats["hits"] <= stats["lookups"])
+        # Interning new strings adds them; interning them again hits.
+        names = ["interned stats %d" % i for i in xrange(5000)]
+        interned = map(intern, names)
+        after = sys._interned_stats()
+        self.assert_(after["strings"] >= stats["strings"] + 5000)
+        self.assert_(after["strings"] * 3 < after["slots"] * 2)
+        self.assert_(after["lookups"] >= stats["lookups"] + 5000)
+        again = [intern("interned stats %d" % i) for i in xrange(5000)]
+        for a, b in zip(again, interned):
+            self.assert_(a is b)
+        self.assert_(sys._interned_stats()["hits"] >= after["hits"] + 5000)
+        # Dead strings leave the table.
+        del names, interned, again, a, b
+        self.assert_(sys._interned_stats()["strings"] <=
+                     after["strings"] - 5000)
+
+    def test_malloc_stats(self):
+        stats = sys._malloc_stats()
+        if stats is None:
+            return  # Built without pymalloc.
+        self.assert_(stats["arenas"] > 0)
+        self.assertEqual(stats["arenas"],
+                         stats["arenas_allocated"] - stats["arenas_freed"])
+        self.assert_(stats["arenas_highwater"] >= stats["arenas"])
+        self.assert_(stats["pools_free"] >= stats["pools_released"])
+        classes = stats["size_classes"]
+        self.assertEqual([c["size"] for c in classes],
+                         range(8, 8 * len(classes) + 1, 8))
+        for c in classes:
+            self.assert_(c["blocks_highwater"] >= c["blocks_used"])
+        free_lists = stats["free_lists"]
+        for name in ("int", "float", "tuple"):
+            self.assert_(name in free_lists, name)
+        for name, fl in free_lists.items():
+            self.assert_(0 <= fl["numfree"] <= fl["maxfree"], name)
+        # Keep some objects alive, and see the blocks in use go up.
+        before = sum(c["blocks_used"] for c in classes)
+        keep = ["x%d" % i for i in xrange(10000)]
+        stats = sys._malloc_stats()
+        after = sum(c["blocks_used"] for c in stats["size_classes"])
+        self.assert_(after >= before + 9000, (before, after))
+
+    def test_malloc_sampling(self):
+        if sys._malloc_stats() is None:
+            return  # Built without pymalloc.
+        code = sys._getframe().f_code
+        try:
+            sys._malloc_sampling(1024)
+            line = sys._getframe().f_lineno + 1
+            keep = [(i,) for i in xrange(10000)]
+            samples = sys._malloc_samples()
+        finally:
+            sys._malloc_sampling(0)
+        self.assert_(samples.get((code.co_filename, line), 0) > 0, samples)
+        self.assertEqual(sys._malloc_samples(), {})
+        self.assertRaises(ValueError, sys._malloc_sampling, -1)
+
     def test_ioencoding(self):
         import subprocess,os
         env = dict(os.environ)
@@ -518,7 +595,7 @@ class SizeofTest(unittest.TestCase):
         class class_oldstyle():
             def method():
                 pass
-        check(class_oldstyle, size(h + '6P'))
+        check(class_oldstyle, size(h + '7P'))
         # instance (old-style class)
         check(class_oldstyle(), size(h + '3P'))
         # instancemethod (old-style class)
@@ -564,9 +641,11 @@ class SizeofTest(unittest.TestCase):
             # we assume that sizeof(void*) == sizeof(Py_ssize_t), which is
             # generally true, and put '2P' at the end.
             dict_llvm_suffix = 'P2P'
-        check({}, size(h + '3P2P' + 8*'P2P' + dict_llvm_suffix))
+        check({}, size(h + '4P3P' + 'Pi' + dict_llvm_suffix + 5*'P2P' +
+                       8*'b'))
         x = {1:1, 2:2, 3:3, 4:4, 5:5, 6:6, 7:7, 8:8}
-        check(x, size(h + '3P2P' + 8*'P2P' + dict_llvm_suffix) + 16*size('P2P'))
+        check(x, size(h + '4P3P' + 'Pi' + dict_llvm_suffix + 5*'P2P' +
+                      8*'b') + 16 + 10*size('P2P'))
         del dict_llvm_suffix
         # dictionary-keyiterator
         check({}.iterkeys(), size(h + 'P2PPP'))
@@ -693,14 +772,14 @@ class SizeofTest(unittest.TestCase):
         # super
         check(super(int), size(h + '3P'))
         # tuple
-        check((), size(vh))
-        check((1,2,3), size(vh) + 3*self.P)
+        check((), size(vh + 'l'))
+        check((1,2,3), size(vh + 'l') + 3*self.P)
         # tupleiterator
         check(iter(()), size(h + 'lP'))
         # type
         # (PyTypeObject + PyNumberMethods +  PyMappingMethods +
         #  PySequenceMethods + PyBufferProcs)
-        s = size(vh + 'P2P15Pl4PP9PP11PIP') + size('41P 10P 3P 6P')
+        s = size(vh + 'P2P15Pl4PP9PP11PIP') + size('41P 10P 3P 7P')
         class newstyleclass(object):
             pass
         check(newstyleclass, s)
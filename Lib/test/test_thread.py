@@ -161,8 +161,49 @@ class BarrierTest(BasicThreadTest):
             self.done_mutex.release()
 
 
+class LockTests(unittest.TestCase):
+
+    def test_acquire_timeout(self):
+        lock = thread.allocate_lock()
+        self.assertTrue(lock.acquire(1, 0.5))
+        start = time.time()
+        self.assertFalse(lock.acquire(1, 0.1))
+        self.assertTrue(time.time() - start >= 0.08)
+        lock.release()
+        self.assertTrue(lock.acquire(1, 0.1))
+        lock.release()
+
+    def test_acquire_timeout_released(self):
+        lock = thread.allocate_lock()
+        lock.acquire()
+        done = thread.allocate_lock()
+        done.acquire()
+        def f():
+            time.sleep(0.1)
+            lock.release()
+            done.release()
+        thread.start_new_thread(f, ())
+        self.assertTrue(lock.acquire(1, 10))
+        done.acquire()
+        lock.release()
+
+    def test_acquire_timeout_errors(self):
+        lock = thread.allocate_lock()
+        self.assertRaises(ValueError, lock.acquire, 0, 1)
+        self.assertRaises(ValueError, lock.acquire, 1, -100)
+        self.assertRaises(OverflowError, lock.acquire, 1, 1e100)
+        self.assertRaises(OverflowError, lock.acquire, 1,
+                          thread.TIMEOUT_MAX + 1)
+        self.assertTrue(lock.acquire(1, thread.TIMEOUT_MAX))
+        lock.release()
+        self.assertTrue(lock.acquire(1, -1))
+        lock.release()
+        self.assertTrue(lock.acquire(0, -1))
+        lock.release()
+
+
 def test_main():
-    test_support.run_unittest(ThreadRunningTests, BarrierTest)
+    test_support.run_unittest(ThreadRunningTests, BarrierTest, LockTests)
 
 if __name__ == "__main__":
     test_main()
@@ -71,6 +71,48 @@ class TupleTest(seq_tests.CommonTest):
         collisions = len(inps) - len(set(map(hash, inps)))
         self.assert_(collisions <= 15)
 
+    def test_hash_cached(self):
+        # Tuples of immutable items remember their hash; the cached value
+        # must match a fresh computation and must not survive reuse of the
+        # tuple by C code.
+        t = ('a', 1, u'b', 2.5, None, (3, 'c'), frozenset([4]))
+        self.assertEqual(hash(t), hash(t))
+        self.assertEqual(hash(t), hash(tuple(list(t))))
+
+        class Mutable(object):
+            def __init__(self):
+                self.h = 0
+            def __hash__(self):
+                return self.h
+        m = Mutable()
+        t = (1, m)
+        first = hash(t)
+        m.h = 12345
+        self.assertNotEqual(hash(t), first)
+        self.assertEqual(hash(t), hash((1, m)))
+
+        # Drop each result before asking for the next one, so that izip and
+        # iteritems reuse their result tuple instead of building a new one.
+        import itertools
+        it = itertools.izip(range(5), 'abcde')
+        hashes = [hash(it.next()) for i in range(5)]
+        self.assertEqual(hashes, [hash(p) for p in zip(range(5), 'abcde')])
+        d = dict(zip(range(5), 'abcde'))
+        it = d.iteritems()
+        hashes = [hash(it.next()) for i in range(len(d))]
+        self.assertEqual(hashes, [hash(item) for item in d.items()])
+
+    def test_dict_keys(self):
+        # Keys rebuilt from the same objects match by identity.
+        a, b = 'spam', 10 ** 20
+        d = {(a, b): 1}
+        self.assertEqual(d[(a, b)], 1)
+        self.assertEqual(d[('sp' + 'am', 10 ** 20)], 1)
+        nan = float('nan')
+        d = {(nan, 1): 2}
+        self.assertEqual(d[(nan, 1)], 2)
+        self.assert_((float('nan'), 1) not in d)
+
     def test_repr(self):
         l0 = tuple()
         l2 = (0, 1, 2)
@@ -661,6 +661,39 @@ class UnicodeTest(
         for encoding in ('utf-8',):
             self.assertEqual(unicode(u.encode(encoding),encoding), u)
 
+    def test_codecs_runs(self):
+        # The ASCII, Latin-1 and UTF-8 codecs copy long runs of ASCII or
+        # Latin-1 characters in blocks; put other characters at and
+        # around the block boundaries.
+        for n in (15, 16, 17, 31, 32, 33, 64, 100):
+            for k in xrange(n):
+                for c in (u'\x7f', u'\x80', u'\xff', u'\u20ac',
+                          u'\U00010002'):
+                    u = u'a' * k + c + u'b' * (n - k - 1)
+                    self.assertEqual(u.encode('utf-8').decode('utf-8'), u)
+                    if c < u'\x80':
+                        self.assertEqual(u.encode('ascii'), str(u))
+                        self.assertEqual(str(u).decode('ascii'), u)
+                    else:
+                        self.assertEqual(u.encode('ascii', 'replace'),
+                                         'a' * k + '?' * len(c) +
+                                         'b' * (n - k - 1))
+                        self.assertRaises(UnicodeDecodeError,
+                                          u.encode('utf-8').decode, 'ascii')
+                        self.assertEqual(
+                            u.encode('utf-8').decode('ascii', 'ignore'),
+                            u'a' * k + u'b' * (n - k - 1))
+                    if c < u'\u0100':
+                        self.assertEqual(u.encode('latin-1').decode('latin-1'),
+                                         u)
+                    else:
+                        self.assertEqual(u.encode('latin-1', 'ignore'),
+                                         'a' * k + 'b' * (n - k - 1))
+        s = ''.join(map(chr, range(256))) * 3
+        self.assertEqual(s.decode('latin-1'),
+                         u''.join(map(unichr, range(256))) * 3)
+        self.assertEqual(s.decode('latin-1').encode('latin-1'), s)
+
     def test_codecs_charmap(self):
         # 0-127
         s = ''.join(map(chr, xrange(128)))
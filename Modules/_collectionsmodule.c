@@ -1,5 +1,11 @@
 #include "Python.h"
 #include "structmember.h"
+#ifdef WITH_THREAD
+#include "pythread.h"
+#endif
+#if !defined(HAVE_GETTIMEOFDAY) && defined(HAVE_FTIME)
+#include <sys/timeb.h>
+#endif
 
 /* collections module implementation of a deque() datatype
    Written and maintained by Raymond D. Hettinger <python@rcn.com>
@@ -1418,12 +1424,1118 @@ static PyTypeObject defdict_type = {
 	PyObject_GC_Del,		/* tp_free */
 };
 
+/* Queue type ***************************************************************/
+
+/* A replacement for the Queue class in Queue.py.  Its bookkeeping is
+ * protected by the GIL instead of a mutex, so put() and get() on a queue
+ * that is neither empty nor full never touch a lock.  Only a thread that
+ * has to wait allocates a waiter, links it into the queue's getters,
+ * putters or joiners and blocks on the waiter's lock with the GIL
+ * released.  A thread that changes the queue wakes the first waiter of
+ * the relevant list by unlinking it and releasing its lock.
+ *
+ * A woken thread rechecks the queue before going on, since another thread
+ * may have got there first.  Waiters live on the waiting thread's stack;
+ * they are only touched with the GIL held and are always unlinked before
+ * that thread returns.
+ *
+ * Subclasses may override _init(), _qsize(), _put() and _get() to change
+ * how the items are stored, as with the Python implementation; if they
+ * do, those methods are called for every operation.  Otherwise the items
+ * live in a deque that is manipulated directly.  The overridden methods
+ * run Python code, which lets other threads in, so such a queue is locked
+ * (see below) from the start, like Queue.py holding its mutex around them.
+ *
+ * The mutex, not_empty, not_full and all_tasks_done attributes of the
+ * Python implementation are made from the threading module the first time
+ * one of them is asked for.  From then on the queue is locked: every
+ * operation takes the mutex and waits on the conditions the way Queue.py
+ * did, so that code holding the mutex or notifying a condition keeps
+ * working, only more slowly.  Threads already waiting are woken to start
+ * over on the locks.
+ *
+ * Without threads nothing can change the queue while it is waited on, so
+ * a wait with a timeout sleeps it out, as with dummy_threading, and one
+ * without a timeout raises RuntimeError instead of hanging.
+ */
+
+typedef struct queuewaiter {
+#ifdef WITH_THREAD
+	PyThread_type_lock lock;
+#endif
+	int signalled;
+	struct queuewaiter *prev;
+	struct queuewaiter *next;
+} queuewaiter;
+
+typedef struct {
+	PyObject_HEAD
+	PyObject *queue;	/* the items, as set up by _init() */
+	Py_ssize_t maxsize;
+	Py_ssize_t unfinished_tasks;
+	int overridden;		/* does the type override _init() & co? */
+	queuewaiter getters;	/* list heads of the waiting threads */
+	queuewaiter putters;
+	queuewaiter joiners;
+	PyObject *mutex;	/* the locks of a locked queue, else NULL */
+	PyObject *not_empty;
+	PyObject *not_full;
+	PyObject *all_tasks_done;
+	PyObject *weakreflist;
+} queueobject;
+
+static PyTypeObject queue_type;
+
+static PyObject *queue_empty_exc;
+static PyObject *queue_full_exc;
+
+/* A deadline meaning no timeout */
+#define QUEUE_FOREVER -1.0
+
+/* Returned by queue_wait_ready() when the queue got locked during the
+   wait, so that the operation has to start over on the locks. */
+#define QUEUE_RESTART 2
+
+#ifdef WITH_THREAD
+/* Locks of finished waiters, kept for the next wait */
+#define MAXFREEWAITERLOCKS 16
+static PyThread_type_lock free_waiter_locks[MAXFREEWAITERLOCKS];
+static int num_free_waiter_locks = 0;
+#endif
+
+static double
+queue_time(void)
+{
+#if defined(HAVE_GETTIMEOFDAY)
+	struct timeval t;
+#ifdef GETTIMEOFDAY_NO_TZ
+	if (gettimeofday(&t) == 0)
+#else
+	if (gettimeofday(&t, (struct timezone *)NULL) == 0)
+#endif
+		return (double)t.tv_sec + t.tv_usec * 0.000001;
+	return (double)time(NULL);
+#elif defined(HAVE_FTIME)
+	struct timeb t;
+	ftime(&t);
+	return (double)t.time + (double)t.millitm * 0.001;
+#else
+	return (double)time(NULL);
+#endif
+}
+
+static void
+waiter_unlink(queuewaiter *w)
+{
+	w->prev->next = w->next;
+	w->next->prev = w->prev;
+	w->prev = w->next = w;
+}
+
+/* Block until another thread wakes us through queue_notify(), or until
+   the deadline has passed unless it is QUEUE_FOREVER.  Returns -1 with an
+   exception set on error, 0 otherwise. */
+static int
+queue_wait(queuewaiter *waiters, double deadline)
+{
+#ifdef WITH_THREAD
+	queuewaiter w;
+	PY_TIMEOUT_T microseconds = -1;
+	int got;
+
+	if (deadline != QUEUE_FOREVER) {
+		double remaining = (deadline - queue_time()) * 1e6;
+		if (remaining < 0.0)
+			remaining = 0.0;
+		if (remaining < (double)PY_TIMEOUT_MAX)
+			microseconds = (PY_TIMEOUT_T)remaining;
+	}
+	if (num_free_waiter_locks > 0)
+		w.lock = free_waiter_locks[--num_free_waiter_locks];
+	else {
+		w.lock = PyThread_allocate_lock();
+		if (w.lock == NULL) {
+			PyErr_SetString(PyExc_MemoryError,
+					"can't allocate lock");
+			return -1;
+		}
+	}
+	PyThread_acquire_lock(w.lock, 1);
+	w.signalled = 0;
+	w.prev = waiters->prev;
+	w.next = waiters;
+	waiters->prev->next = &w;
+	waiters->prev = &w;
+
+	Py_BEGIN_ALLOW_THREADS
+	got = PyThread_acquire_lock_timed(w.lock, microseconds);
+	Py_END_ALLOW_THREADS
+
+	/* If we timed out the lock is still held by us, unless we were
+	   woken up in the meantime */
+	if (!w.signalled)
+		waiter_unlink(&w);
+	if (got || !w.signalled)
+		PyThread_release_lock(w.lock);
+	if (num_free_waiter_locks < MAXFREEWAITERLOCKS)
+		free_waiter_locks[num_free_waiter_locks++] = w.lock;
+	else
+		PyThread_free_lock(w.lock);
+	return 0;
+#else
+	PyObject *timemodule, *result;
+	double remaining;
+
+	if (deadline == QUEUE_FOREVER) {
+		PyErr_SetString(PyExc_RuntimeError,
+			"waiting on a queue without threads would never end");
+		return -1;
+	}
+	remaining = deadline - queue_time();
+	if (remaining <= 0.0)
+		return 0;
+	timemodule = PyImport_ImportModuleNoBlock("time");
+	if (timemodule == NULL)
+		return -1;
+	result = PyObject_CallMethod(timemodule, "sleep", "d", remaining);
+	Py_DECREF(timemodule);
+	if (result == NULL)
+		return -1;
+	Py_DECREF(result);
+	return 0;
+#endif
+}
+
+/* Wake up the first thread waiting on waiters, or all of them. */
+static void
+queue_notify(queuewaiter *waiters, int all)
+{
+	while (waiters->next != waiters) {
+		queuewaiter *w = waiters->next;
+		waiter_unlink(w);
+		w->signalled = 1;
+#ifdef WITH_THREAD
+		PyThread_release_lock(w->lock);
+#endif
+		if (!all)
+			break;
+	}
+}
+
+/* The storage primitives behind _qsize(), _put() and _get() */
+
+static Py_ssize_t
+queue_base_size(queueobject *q)
+{
+	if (q->queue == NULL) {
+		PyErr_SetString(PyExc_AttributeError, "queue");
+		return -1;
+	}
+	if (Py_TYPE(q->queue) == &deque_type)
+		return ((dequeobject *)q->queue)->len;
+	return PyObject_Size(q->queue);
+}
+
+static int
+queue_base_put(queueobject *q, PyObject *item)
+{
+	PyObject *result;
+
+	if (q->queue == NULL) {
+		PyErr_SetString(PyExc_AttributeError, "queue");
+		return -1;
+	}
+	if (Py_TYPE(q->queue) == &deque_type)
+		result = deque_append((dequeobject *)q->queue, item);
+	else
+		result = PyObject_CallMethod(q->queue, "append", "O", item);
+	if (result == NULL)
+		return -1;
+	Py_DECREF(result);
+	return 0;
+}
+
+static PyObject *
+queue_base_get(queueobject *q)
+{
+	if (q->queue == NULL) {
+		PyErr_SetString(PyExc_AttributeError, "queue");
+		return NULL;
+	}
+	if (Py_TYPE(q->queue) == &deque_type)
+		return deque_popleft((dequeobject *)q->queue, NULL);
+	return PyObject_CallMethod(q->queue, "popleft", NULL);
+}
+
+/* The same, going through the subclass's methods if it overrides them */
+
+static Py_ssize_t
+queue_size(queueobject *q)
+{
+	PyObject *result;
+	Py_ssize_t n;
+
+	if (!q->overridden)
+		return queue_base_size(q);
+	result = PyObject_CallMethod((PyObject *)q, "_qsize", NULL);
+	if (result == NULL)
+		return -1;
+	n = PyNumber_AsSsize_t(result, PyExc_OverflowError);
+	Py_DECREF(result);
+	if (n < 0 && !PyErr_Occurred())
+		PyErr_SetString(PyExc_ValueError,
+				"_qsize() should return >= 0");
+	return n;
+}
+
+static int
+queue_put_item(queueobject *q, PyObject *item)
+{
+	PyObject *result;
+
+	if (!q->overridden)
+		return queue_base_put(q, item);
+	result = PyObject_CallMethod((PyObject *)q, "_put", "O", item);
+	if (result == NULL)
+		return -1;
+	Py_DECREF(result);
+	return 0;
+}
+
+static PyObject *
+queue_get_item(queueobject *q)
+{
+	if (!q->overridden)
+		return queue_base_get(q);
+	return PyObject_CallMethod((PyObject *)q, "_get", NULL);
+}
+
+/* Can a put (put != 0) or a get (put == 0) go ahead?  Returns 1 if it can,
+   0 if it can't and -1 on error. */
+static int
+queue_ready(queueobject *q, int put)
+{
+	Py_ssize_t n;
+
+	if (put && q->maxsize <= 0)
+		return 1;
+	n = queue_size(q);
+	if (n < 0)
+		return -1;
+	return put ? n != q->maxsize : n != 0;
+}
+
+/* Parse the block and timeout arguments of put() or get() into *blocking
+   and *deadline, which is QUEUE_FOREVER if there is no timeout.  The
+   timeout is ignored unless use_timeout is true, like in Queue.py where
+   put() on an unbounded queue never looks at it.  Returns -1 on error. */
+static int
+queue_deadline(PyObject *block, PyObject *timeout, int use_timeout,
+	       int *blocking, double *deadline)
+{
+	*deadline = QUEUE_FOREVER;
+	*blocking = PyObject_IsTrue(block);
+	if (*blocking < 0)
+		return -1;
+	if (*blocking && timeout != Py_None && use_timeout) {
+		double seconds = PyFloat_AsDouble(timeout);
+		if (seconds == -1.0 && PyErr_Occurred())
+			return -1;
+		if (seconds < 0.0) {
+			PyErr_SetString(PyExc_ValueError,
+					"'timeout' must be a positive number");
+			return -1;
+		}
+		*deadline = queue_time() + seconds;
+	}
+	return 0;
+}
+
+/* Wait until a put or a get can go ahead, until the deadline at most.
+   Returns 1 if it can, 0 if blocking is false or the time is up, -1 on
+   error and QUEUE_RESTART if the queue got locked in the meantime. */
+static int
+queue_wait_ready(queueobject *q, int put, int blocking, double deadline)
+{
+	queuewaiter *waiters = put ? &q->putters : &q->getters;
+	int ready;
+
+	if (!blocking)
+		return queue_ready(q, put);
+	while ((ready = queue_ready(q, put)) == 0) {
+		if (deadline != QUEUE_FOREVER && deadline <= queue_time())
+			return 0;
+		if (queue_wait(waiters, deadline) < 0)
+			return -1;
+		if (q->mutex != NULL)
+			return QUEUE_RESTART;
+	}
+	return ready;
+}
+
+/* Locked queues */
+
+/* Call obj.name(), or obj.name(arg) if arg isn't NULL, for its effect.
+   Returns -1 on error. */
+static int
+queue_call(PyObject *obj, char *name, PyObject *arg)
+{
+	PyObject *result;
+
+	if (arg == NULL)
+		result = PyObject_CallMethod(obj, name, NULL);
+	else
+		result = PyObject_CallMethod(obj, name, "O", arg);
+	if (result == NULL)
+		return -1;
+	Py_DECREF(result);
+	return 0;
+}
+
+/* Release lock, keeping the pending exception if any.  As in a finally
+   clause, an error from the release replaces it.  Returns -1 on error. */
+static int
+queue_release(PyObject *lock)
+{
+	PyObject *type, *value, *tb;
+
+	PyErr_Fetch(&type, &value, &tb);
+	if (queue_call(lock, "release", NULL) < 0) {
+		Py_XDECREF(type);
+		Py_XDECREF(value);
+		Py_XDECREF(tb);
+		return -1;
+	}
+	PyErr_Restore(type, value, tb);
+	return 0;
+}
+
+/* queue_wait_ready() for a locked queue, waiting on cond, which the
+   caller holds. */
+static int
+queue_locked_wait_ready(queueobject *q, int put, PyObject *cond,
+			int blocking, double deadline)
+{
+	PyObject *remaining;
+	int ready, err;
+
+	if (!blocking)
+		return queue_ready(q, put);
+	while ((ready = queue_ready(q, put)) == 0) {
+		if (deadline == QUEUE_FOREVER)
+			err = queue_call(cond, "wait", NULL);
+		else {
+			double seconds = deadline - queue_time();
+			if (seconds <= 0.0)
+				return 0;
+			remaining = PyFloat_FromDouble(seconds);
+			if (remaining == NULL)
+				return -1;
+			err = queue_call(cond, "wait", remaining);
+			Py_DECREF(remaining);
+		}
+		if (err < 0)
+			return -1;
+	}
+	return ready;
+}
+
+/* Give q the mutex and conditions of the Python implementation, which
+   makes it a locked queue.  Returns -1 on error. */
+static int
+queue_make_locks(queueobject *q)
+{
+	PyObject *threading, *mutex, *conds[3];
+	int i;
+
+	threading = PyImport_ImportModuleNoBlock("threading");
+	if (threading == NULL) {
+		if (!PyErr_ExceptionMatches(PyExc_ImportError))
+			return -1;
+		PyErr_Clear();
+		threading = PyImport_ImportModuleNoBlock("dummy_threading");
+		if (threading == NULL)
+			return -1;
+	}
+	mutex = PyObject_CallMethod(threading, "Lock", NULL);
+	for (i = 0; i < 3; i++) {
+		conds[i] = mutex == NULL ? NULL :
+			PyObject_CallMethod(threading, "Condition", "O",
+					    mutex);
+		if (conds[i] == NULL) {
+			while (--i >= 0)
+				Py_DECREF(conds[i]);
+			Py_XDECREF(mutex);
+			Py_DECREF(threading);
+			return -1;
+		}
+	}
+	Py_DECREF(threading);
+	/* Importing threading may have run other threads, which may have
+	   locked q already */
+	if (q->mutex != NULL) {
+		for (i = 0; i < 3; i++)
+			Py_DECREF(conds[i]);
+		Py_DECREF(mutex);
+		return 0;
+	}
+	q->mutex = mutex;
+	q->not_empty = conds[0];
+	q->not_full = conds[1];
+	q->all_tasks_done = conds[2];
+	/* The waiting threads start over on the locks */
+	queue_notify(&q->getters, 1);
+	queue_notify(&q->putters, 1);
+	queue_notify(&q->joiners, 1);
+	return 0;
+}
+
+/* Return the size of a locked queue, or -1 on error. */
+static Py_ssize_t
+queue_locked_size(queueobject *q)
+{
+	Py_ssize_t n;
+
+	if (queue_call(q->mutex, "acquire", NULL) < 0)
+		return -1;
+	n = queue_size(q);
+	if (queue_release(q->mutex) < 0)
+		return -1;
+	return n;
+}
+
+static PyObject *
+queue_locked_put(queueobject *q, PyObject *item, int blocking,
+		 double deadline)
+{
+	int ready;
+
+	if (queue_call(q->not_full, "acquire", NULL) < 0)
+		return NULL;
+	ready = queue_locked_wait_ready(q, 1, q->not_full, blocking,
+					deadline);
+	if (ready == 0)
+		PyErr_SetNone(queue_full_exc);
+	else if (ready > 0) {
+		if (queue_put_item(q, item) < 0)
+			ready = -1;
+		else {
+			q->unfinished_tasks++;
+			if (queue_call(q->not_empty, "notify", NULL) < 0)
+				ready = -1;
+		}
+	}
+	if (queue_release(q->not_full) < 0 || ready <= 0)
+		return NULL;
+	Py_RETURN_NONE;
+}
+
+static PyObject *
+queue_locked_get(queueobject *q, int blocking, double deadline)
+{
+	PyObject *item = NULL;
+	int ready;
+
+	if (queue_call(q->not_empty, "acquire", NULL) < 0)
+		return NULL;
+	ready = queue_locked_wait_ready(q, 0, q->not_empty, blocking,
+					deadline);
+	if (ready == 0)
+		PyErr_SetNone(queue_empty_exc);
+	else if (ready > 0) {
+		item = queue_get_item(q);
+		if (item != NULL &&
+		    queue_call(q->not_full, "notify", NULL) < 0)
+			Py_CLEAR(item);
+	}
+	if (queue_release(q->not_empty) < 0)
+		Py_CLEAR(item);
+	return item;
+}
+
+static PyObject *
+queue_locked_wait_not_empty(queueobject *q, double deadline)
+{
+	int ready;
+
+	if (queue_call(q->not_empty, "acquire", NULL) < 0)
+		return NULL;
+	ready = queue_locked_wait_ready(q, 0, q->not_empty, 1, deadline);
+	/* Whatever woke us may have been meant for a get(): pass it on */
+	if (ready > 0 && queue_call(q->not_empty, "notify", NULL) < 0)
+		ready = -1;
+	if (queue_release(q->not_empty) < 0 || ready < 0)
+		return NULL;
+	return PyBool_FromLong(ready);
+}
+
+static PyObject *
+queue_locked_task_done(queueobject *q)
+{
+	Py_ssize_t unfinished;
+	int err = 0;
+
+	if (queue_call(q->all_tasks_done, "acquire", NULL) < 0)
+		return NULL;
+	unfinished = q->unfinished_tasks - 1;
+	if (unfinished <= 0) {
+		if (unfinished < 0) {
+			PyErr_SetString(PyExc_ValueError,
+					"task_done() called too many times");
+			err = -1;
+		}
+		else
+			err = queue_call(q->all_tasks_done, "notify_all",
+					 NULL);
+	}
+	if (err == 0)
+		q->unfinished_tasks = unfinished;
+	if (queue_release(q->all_tasks_done) < 0 || err < 0)
+		return NULL;
+	Py_RETURN_NONE;
+}
+
+static PyObject *
+queue_locked_join(queueobject *q)
+{
+	int err = 0;
+
+	if (queue_call(q->all_tasks_done, "acquire", NULL) < 0)
+		return NULL;
+	while (q->unfinished_tasks && err == 0)
+		err = queue_call(q->all_tasks_done, "wait", NULL);
+	if (queue_release(q->all_tasks_done) < 0 || err < 0)
+		return NULL;
+	Py_RETURN_NONE;
+}
+
+static PyObject *queue__init(queueobject *q, PyObject *maxsize);
+
+static PyObject *
+queue_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+	queueobject *q;
+
+	q = (queueobject *)type->tp_alloc(type, 0);
+	if (q == NULL)
+		return NULL;
+	q->getters.prev = q->getters.next = &q->getters;
+	q->putters.prev = q->putters.next = &q->putters;
+	q->joiners.prev = q->joiners.next = &q->joiners;
+	return (PyObject *)q;
+}
+
+static int
+queue_init(queueobject *q, PyObject *args, PyObject *kwds)
+{
+	static char *kwlist[] = {"maxsize", NULL};
+	static char *hooks[] = {"_init", "_qsize", "_put", "_get", NULL};
+	Py_ssize_t maxsize = 0;
+	PyObject *result;
+	char **hook;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|n:Queue", kwlist,
+					 &maxsize))
+		return -1;
+
+	q->overridden = 0;
+	if (Py_TYPE(q) != &queue_type) {
+		for (hook = hooks; *hook != NULL; hook++) {
+			PyObject *name = PyString_InternFromString(*hook);
+			if (name == NULL)
+				return -1;
+			if (_PyType_Lookup(Py_TYPE(q), name) !=
+			    _PyType_Lookup(&queue_type, name))
+				q->overridden = 1;
+			Py_DECREF(name);
+		}
+	}
+
+	q->maxsize = maxsize;
+	q->unfinished_tasks = 0;
+	if (q->overridden) {
+		result = PyObject_CallMethod((PyObject *)q, "_init", "n",
+					     maxsize);
+		if (result == NULL)
+			return -1;
+		Py_DECREF(result);
+		if (q->mutex == NULL && queue_make_locks(q) < 0)
+			return -1;
+	}
+	else {
+		result = queue__init(q, NULL);
+		if (result == NULL)
+			return -1;
+		Py_DECREF(result);
+	}
+	return 0;
+}
+
+static int
+queue_traverse(queueobject *q, visitproc visit, void *arg)
+{
+	Py_VISIT(q->queue);
+	Py_VISIT(q->mutex);
+	Py_VISIT(q->not_empty);
+	Py_VISIT(q->not_full);
+	Py_VISIT(q->all_tasks_done);
+	return 0;
+}
+
+static int
+queue_tp_clear(queueobject *q)
+{
+	Py_CLEAR(q->queue);
+	Py_CLEAR(q->not_empty);
+	Py_CLEAR(q->not_full);
+	Py_CLEAR(q->all_tasks_done);
+	Py_CLEAR(q->mutex);
+	return 0;
+}
+
+static void
+queue_dealloc(queueobject *q)
+{
+	PyObject_GC_UnTrack(q);
+	if (q->weakreflist != NULL)
+		PyObject_ClearWeakRefs((PyObject *)q);
+	queue_tp_clear(q);
+	Py_TYPE(q)->tp_free(q);
+}
+
+PyDoc_STRVAR(queue_task_done_doc,
+"Indicate that a formerly enqueued task is complete.\n\
+\n\
+Used by Queue consumer threads.  For each get() used to fetch a task,\n\
+a subsequent call to task_done() tells the queue that the processing\n\
+on the task is complete.\n\
+\n\
+If a join() is currently blocking, it will resume when all items\n\
+have been processed (meaning that a task_done() call was received\n\
+for every item that had been put() into the queue).\n\
+\n\
+Raises a ValueError if called more times than there were items\n\
+placed in the queue.");
+
+static PyObject *
+queue_task_done(queueobject *q)
+{
+	Py_ssize_t unfinished = q->unfinished_tasks - 1;
+
+	if (q->mutex != NULL)
+		return queue_locked_task_done(q);
+	if (unfinished <= 0) {
+		if (unfinished < 0) {
+			PyErr_SetString(PyExc_ValueError,
+					"task_done() called too many times");
+			return NULL;
+		}
+		queue_notify(&q->joiners, 1);
+	}
+	q->unfinished_tasks = unfinished;
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(queue_join_doc,
+"Blocks until all items in the Queue have been gotten and processed.\n\
+\n\
+The count of unfinished tasks goes up whenever an item is added to the\n\
+queue. The count goes down whenever a consumer thread calls task_done()\n\
+to indicate the item was retrieved and all work on it is complete.\n\
+\n\
+When the count of unfinished tasks drops to zero, join() unblocks.");
+
+static PyObject *
+queue_join(queueobject *q)
+{
+	if (q->mutex != NULL)
+		return queue_locked_join(q);
+	while (q->unfinished_tasks) {
+		if (queue_wait(&q->joiners, QUEUE_FOREVER) < 0)
+			return NULL;
+		if (q->mutex != NULL)
+			return queue_locked_join(q);
+	}
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(queue_qsize_doc,
+"Return the approximate size of the queue (not reliable!).");
+
+static PyObject *
+queue_qsize(queueobject *q)
+{
+	Py_ssize_t n = q->mutex ? queue_locked_size(q) : queue_size(q);
+	if (n < 0)
+		return NULL;
+	return PyInt_FromSsize_t(n);
+}
+
+PyDoc_STRVAR(queue_empty_doc,
+"Return True if the queue is empty, False otherwise (not reliable!).");
+
+static PyObject *
+queue_empty(queueobject *q)
+{
+	Py_ssize_t n = q->mutex ? queue_locked_size(q) : queue_size(q);
+	if (n < 0)
+		return NULL;
+	return PyBool_FromLong(n == 0);
+}
+
+PyDoc_STRVAR(queue_full_doc,
+"Return True if the queue is full, False otherwise (not reliable!).");
+
+static PyObject *
+queue_full(queueobject *q)
+{
+	Py_ssize_t n;
+
+	if (q->maxsize <= 0)
+		Py_RETURN_FALSE;
+	n = q->mutex ? queue_locked_size(q) : queue_size(q);
+	if (n < 0)
+		return NULL;
+	return PyBool_FromLong(n == q->maxsize);
+}
+
+static PyObject *
+queue_put_impl(queueobject *q, PyObject *item, PyObject *block,
+	       PyObject *timeout)
+{
+	double deadline;
+	int blocking, ready;
+
+	if (queue_deadline(block, timeout, q->maxsize > 0,
+			   &blocking, &deadline) < 0)
+		return NULL;
+	if (q->mutex != NULL)
+		return queue_locked_put(q, item, blocking, deadline);
+	ready = queue_wait_ready(q, 1, blocking, deadline);
+	if (ready == QUEUE_RESTART)
+		return queue_locked_put(q, item, blocking, deadline);
+	if (ready <= 0) {
+		if (ready == 0)
+			PyErr_SetNone(queue_full_exc);
+		return NULL;
+	}
+	if (queue_put_item(q, item) < 0)
+		return NULL;
+	q->unfinished_tasks++;
+	queue_notify(&q->getters, 0);
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(queue_put_doc,
+"Put an item into the queue.\n\
+\n\
+If optional args 'block' is true and 'timeout' is None (the default),\n\
+block if necessary until a free slot is available. If 'timeout' is\n\
+a positive number, it blocks at most 'timeout' seconds and raises\n\
+the Full exception if no free slot was available within that time.\n\
+Otherwise ('block' is false), put an item on the queue if a free slot\n\
+is immediately available, else raise the Full exception ('timeout'\n\
+is ignored in that case).");
+
+static PyObject *
+queue_put(queueobject *q, PyObject *args, PyObject *kwds)
+{
+	static char *kwlist[] = {"item", "block", "timeout", NULL};
+	PyObject *item, *block = Py_True, *timeout = Py_None;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|OO:put", kwlist,
+					 &item, &block, &timeout))
+		return NULL;
+	return queue_put_impl(q, item, block, timeout);
+}
+
+PyDoc_STRVAR(queue_put_nowait_doc,
+"Put an item into the queue without blocking.\n\
+\n\
+Only enqueue the item if a free slot is immediately available.\n\
+Otherwise raise the Full exception.");
+
+static PyObject *
+queue_put_nowait(queueobject *q, PyObject *item)
+{
+	return queue_put_impl(q, item, Py_False, Py_None);
+}
+
+static PyObject *
+queue_get_impl(queueobject *q, PyObject *block, PyObject *timeout)
+{
+	PyObject *item;
+	double deadline;
+	int blocking, ready;
+
+	if (queue_deadline(block, timeout, 1, &blocking, &deadline) < 0)
+		return NULL;
+	if (q->mutex != NULL)
+		return queue_locked_get(q, blocking, deadline);
+	ready = queue_wait_ready(q, 0, blocking, deadline);
+	if (ready == QUEUE_RESTART)
+		return queue_locked_get(q, blocking, deadline);
+	if (ready <= 0) {
+		if (ready == 0)
+			PyErr_SetNone(queue_empty_exc);
+		return NULL;
+	}
+	item = queue_get_item(q);
+	if (item == NULL)
+		return NULL;
+	queue_notify(&q->putters, 0);
+	return item;
+}
+
+PyDoc_STRVAR(queue_get_doc,
+"Remove and return an item from the queue.\n\
+\n\
+If optional args 'block' is true and 'timeout' is None (the default),\n\
+block if necessary until an item is available. If 'timeout' is\n\
+a positive number, it blocks at most 'timeout' seconds and raises\n\
+the Empty exception if no item was available within that time.\n\
+Otherwise ('block' is false), return an item if one is immediately\n\
+available, else raise the Empty exception ('timeout' is ignored\n\
+in that case).");
+
+static PyObject *
+queue_get(queueobject *q, PyObject *args, PyObject *kwds)
+{
+	static char *kwlist[] = {"block", "timeout", NULL};
+	PyObject *block = Py_True, *timeout = Py_None;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|OO:get", kwlist,
+					 &block, &timeout))
+		return NULL;
+	return queue_get_impl(q, block, timeout);
+}
+
+PyDoc_STRVAR(queue_get_nowait_doc,
+"Remove and return an item from the queue without blocking.\n\
+\n\
+Only get an item if one is immediately available. Otherwise\n\
+raise the Empty exception.");
+
+static PyObject *
+queue_get_nowait(queueobject *q)
+{
+	return queue_get_impl(q, Py_False, Py_None);
+}
+
+PyDoc_STRVAR(queue_wait_not_empty_doc,
+"Wait until the queue holds an item, for at most 'timeout' seconds\n\
+unless 'timeout' is None, and return whether it does.  The item is left\n\
+in the queue.");
+
+static PyObject *
+queue_wait_not_empty(queueobject *q, PyObject *args, PyObject *kwds)
+{
+	static char *kwlist[] = {"timeout", NULL};
+	PyObject *timeout = Py_None;
+	double deadline;
+	int blocking, ready;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O:_wait_not_empty",
+					 kwlist, &timeout))
+		return NULL;
+	if (queue_deadline(Py_True, timeout, 1, &blocking, &deadline) < 0)
+		return NULL;
+	if (q->mutex != NULL)
+		return queue_locked_wait_not_empty(q, deadline);
+	ready = queue_wait_ready(q, 0, 1, deadline);
+	if (ready == QUEUE_RESTART)
+		return queue_locked_wait_not_empty(q, deadline);
+	if (ready < 0)
+		return NULL;
+	/* Whatever woke us may have been meant for a get(): pass it on */
+	if (ready)
+		queue_notify(&q->getters, 0);
+	return PyBool_FromLong(ready);
+}
+
+/* The default queue organization, overridable like in Queue.py */
+
+static PyObject *
+queue__init(queueobject *q, PyObject *maxsize)
+{
+	PyObject *items = deque_new(&deque_type, NULL, NULL);
+	if (items == NULL)
+		return NULL;
+	Py_XDECREF(q->queue);
+	q->queue = items;
+	Py_RETURN_NONE;
+}
+
+static PyObject *
+queue__qsize(queueobject *q)
+{
+	Py_ssize_t n = queue_base_size(q);
+	if (n < 0)
+		return NULL;
+	return PyInt_FromSsize_t(n);
+}
+
+static PyObject *
+queue__put(queueobject *q, PyObject *item)
+{
+	if (queue_base_put(q, item) < 0)
+		return NULL;
+	Py_RETURN_NONE;
+}
+
+static PyObject *
+queue__get(queueobject *q)
+{
+	return queue_base_get(q);
+}
+
+static PyMethodDef queue_methods[] = {
+	{"task_done",	(PyCFunction)queue_task_done,
+		METH_NOARGS,	queue_task_done_doc},
+	{"join",	(PyCFunction)queue_join,
+		METH_NOARGS,	queue_join_doc},
+	{"qsize",	(PyCFunction)queue_qsize,
+		METH_NOARGS,	queue_qsize_doc},
+	{"empty",	(PyCFunction)queue_empty,
+		METH_NOARGS,	queue_empty_doc},
+	{"full",	(PyCFunction)queue_full,
+		METH_NOARGS,	queue_full_doc},
+	{"put",		(PyCFunction)queue_put,
+		METH_VARARGS | METH_KEYWORDS,	queue_put_doc},
+	{"put_nowait",	(PyCFunction)queue_put_nowait,
+		METH_O,		queue_put_nowait_doc},
+	{"get",		(PyCFunction)queue_get,
+		METH_VARARGS | METH_KEYWORDS,	queue_get_doc},
+	{"get_nowait",	(PyCFunction)queue_get_nowait,
+		METH_NOARGS,	queue_get_nowait_doc},
+	{"_wait_not_empty",	(PyCFunction)queue_wait_not_empty,
+		METH_VARARGS | METH_KEYWORDS,	queue_wait_not_empty_doc},
+	{"_init",	(PyCFunction)queue__init,
+		METH_O,		NULL},
+	{"_qsize",	(PyCFunction)queue__qsize,
+		METH_NOARGS,	NULL},
+	{"_put",	(PyCFunction)queue__put,
+		METH_O,		NULL},
+	{"_get",	(PyCFunction)queue__get,
+		METH_NOARGS,	NULL},
+	{NULL,		NULL}	/* sentinel */
+};
+
+static PyMemberDef queue_members[] = {
+	{"queue", T_OBJECT, offsetof(queueobject, queue), 0,
+	 PyDoc_STR("The items, as set up by _init().")},
+	{"maxsize", T_PYSSIZET, offsetof(queueobject, maxsize), 0,
+	 PyDoc_STR("Maximum number of items, unbounded if <= 0.")},
+	{"unfinished_tasks", T_PYSSIZET,
+	 offsetof(queueobject, unfinished_tasks), 0,
+	 PyDoc_STR("Number of items put without a matching task_done().")},
+	{NULL}
+};
+
+/* The locks of a locked queue, made on first use */
+static PyObject *
+queue_get_lock(queueobject *q, void *closure)
+{
+	PyObject *lock;
+
+	if (q->mutex == NULL && queue_make_locks(q) < 0)
+		return NULL;
+	lock = *(PyObject **)((char *)q + (size_t)closure);
+	Py_INCREF(lock);
+	return lock;
+}
+
+static PyGetSetDef queue_getset[] = {
+	{"mutex", (getter)queue_get_lock, NULL,
+	 PyDoc_STR("Lock held whenever the queue is mutating; asking for it\n"
+		   "or one of the conditions makes the queue use them."),
+	 (void *)offsetof(queueobject, mutex)},
+	{"not_empty", (getter)queue_get_lock, NULL,
+	 PyDoc_STR("Condition notified whenever an item is added."),
+	 (void *)offsetof(queueobject, not_empty)},
+	{"not_full", (getter)queue_get_lock, NULL,
+	 PyDoc_STR("Condition notified whenever an item is removed."),
+	 (void *)offsetof(queueobject, not_full)},
+	{"all_tasks_done", (getter)queue_get_lock, NULL,
+	 PyDoc_STR("Condition notified when the unfinished tasks drop to 0."),
+	 (void *)offsetof(queueobject, all_tasks_done)},
+	{NULL}
+};
+
+PyDoc_STRVAR(queue_doc,
+"Create a queue object with a given maximum size.\n\
+\n\
+If maxsize is <= 0, the queue size is infinite.");
+
+static PyTypeObject queue_type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	"Queue.Queue",			/* tp_name */
+	sizeof(queueobject),		/* tp_basicsize */
+	0,				/* tp_itemsize */
+	/* methods */
+	(destructor)queue_dealloc,	/* tp_dealloc */
+	0,				/* tp_print */
+	0,				/* tp_getattr */
+	0,				/* tp_setattr */
+	0,				/* tp_compare */
+	0,				/* tp_repr */
+	0,				/* tp_as_number */
+	0,				/* tp_as_sequence */
+	0,				/* tp_as_mapping */
+	0,				/* tp_hash */
+	0,				/* tp_call */
+	0,				/* tp_str */
+	PyObject_GenericGetAttr,	/* tp_getattro */
+	0,				/* tp_setattro */
+	0,				/* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE | Py_TPFLAGS_HAVE_GC |
+		Py_TPFLAGS_HAVE_WEAKREFS,	/* tp_flags */
+	queue_doc,			/* tp_doc */
+	(traverseproc)queue_traverse,	/* tp_traverse */
+	(inquiry)queue_tp_clear,	/* tp_clear */
+	0,				/* tp_richcompare */
+	offsetof(queueobject, weakreflist),	/* tp_weaklistoffset*/
+	0,				/* tp_iter */
+	0,				/* tp_iternext */
+	queue_methods,			/* tp_methods */
+	queue_members,			/* tp_members */
+	queue_getset,			/* tp_getset */
+	0,				/* tp_base */
+	0,				/* tp_dict */
+	0,				/* tp_descr_get */
+	0,				/* tp_descr_set */
+	0,				/* tp_dictoffset */
+	(initproc)queue_init,		/* tp_init */
+	PyType_GenericAlloc,		/* tp_alloc */
+	queue_new,			/* tp_new */
+	PyObject_GC_Del,		/* tp_free */
+};
+
+static PyObject *
+queue_new_exception(char *name, char *doc)
+{
+	PyObject *dict, *docobj, *exc;
+
+	dict = PyDict_New();
+	if (dict == NULL)
+		return NULL;
+	docobj = PyString_FromString(doc);
+	if (docobj == NULL || PyDict_SetItemString(dict, "__doc__", docobj) < 0)
+		exc = NULL;
+	else
+		exc = PyErr_NewException(name, NULL, dict);
+	Py_XDECREF(docobj);
+	Py_DECREF(dict);
+	return exc;
+}
+
 /* module level code ********************************************************/
 
 PyDoc_STRVAR(module_doc,
 "High performance data structures.\n\
 - deque:        ordered collection accessible from endpoints only\n\
 - defaultdict:  dict subclass with a default value factory\n\
+- Queue:        the Queue module's synchronized queue class\n\
 ");
 
 PyMODINIT_FUNC
@@ -1452,5 +2564,24 @@ init_collections(void)
 	if (PyType_Ready(&dequereviter_type) < 0)
 		return;
 
+	if (PyType_Ready(&queue_type) < 0)
+		return;
+	Py_INCREF(&queue_type);
+	PyModule_AddObject(m, "Queue", (PyObject *)&queue_type);
+
+	queue_empty_exc = queue_new_exception("Queue.Empty",
+		"Exception raised by Queue.get(block=0)/get_nowait().");
+	if (queue_empty_exc == NULL)
+		return;
+	Py_INCREF(queue_empty_exc);
+	PyModule_AddObject(m, "Empty", queue_empty_exc);
+
+	queue_full_exc = queue_new_exception("Queue.Full",
+		"Exception raised by Queue.put(block=0)/put_nowait().");
+	if (queue_full_exc == NULL)
+		return;
+	Py_INCREF(queue_full_exc);
+	PyModule_AddObject(m, "Full", queue_full_exc);
+
 	return;
 }
@@ -61,20 +61,25 @@ llvm_compile(PyObject *self, PyObject *args)
     }
 
     code = (PyCodeObject *)obj;
+    global_llvm_data = PyThreadState_GET()->interp->global_llvm_data;
+    PyGlobalLlvmData_Lock(global_llvm_data);
     if (code->co_llvm_function)
         _LlvmFunction_Dealloc(code->co_llvm_function);
     code->co_llvm_function = _PyCode_ToLlvmIr(code);
-    if (code->co_llvm_function == NULL)
+    if (code->co_llvm_function == NULL) {
+        PyGlobalLlvmData_Unlock(global_llvm_data);
         return NULL;
-    global_llvm_data = PyThreadState_GET()->interp->global_llvm_data;
+    }
     if (code->co_optimization < opt_level &&
         PyGlobalLlvmData_Optimize(global_llvm_data,
                                   code->co_llvm_function, opt_level) < 0) {
+        PyGlobalLlvmData_Unlock(global_llvm_data);
         PyErr_Format(PyExc_ValueError,
                      "Failed to optimize to level %ld", opt_level);
         _LlvmFunction_Dealloc(code->co_llvm_function);
         return NULL;
     }
+    PyGlobalLlvmData_Unlock(global_llvm_data);
 
     return _PyLlvmFunction_FromCodeObject((PyObject *)code);
 }
@@ -1,6 +1,7 @@
 /* _llvmre.cpp */
 
 #include "Python.h"
+#include "structmember.h"
 #include "_llvmfunctionobject.h"
 #include "llvm_compile.h"
 #include "Python/global_llvm_data.h"
@@ -8,7 +9,11 @@
 
 #include "llvm/Support/Debug.h"
 
+#include <algorithm>
+#include <map>
+#include <set>
 #include <string>
+#include <vector>
 
 #include "llvm/Module.h"
 #include "llvm/Function.h"
@@ -29,6 +34,10 @@
 // for SRE_FLAG_*
 #include "sre_constants.h"
 
+// for fastsearch(), used to skip ahead to offsets where a match can start
+#define STRINGLIB_CHAR Py_UNICODE
+#include "Objects/stringlib/fastsearch.h"
+
 using llvm::Module;
 using llvm::Function;
 using llvm::BasicBlock;
@@ -91,7 +100,59 @@ typedef struct {
   /* the root compiled regular expression */
   RegularExpression* re;
 
+  /* the pattern source and a map of group names to group numbers */
+  PyObject* pattern;
+  PyObject* groupindex;
+
+  /* the last replacement template used and its parsed form */
+  PyObject* repl;
+  PyObject* parsed_repl;
+
 } RegEx;
+
+/* the result of successfully matching a RegEx against a string */
+typedef struct {
+  PyObject_VAR_HEAD
+
+  /* the expression that matched and the string it was matched against */
+  RegEx* regex;
+  PyObject* string;
+  Py_ssize_t pos;
+  Py_ssize_t endpos;
+
+  /* the number of groups in the expression */
+  Py_ssize_t groups;
+
+  /* the start and end of the match, the start and end of each group, then
+   * the lastindex. this is the layout RegularExpression::Execute fills in */
+  ReOffset regs[1];
+} MatchObject;
+
+/* the state of repeatedly matching a RegEx along a string */
+typedef struct {
+  PyObject_HEAD
+
+  RegEx* regex;
+  PyObject* string;
+  /* @string as unicode, which is what the compiled code runs on */
+  PyObject* ustring;
+
+  /* where the next match starts and where matching stops */
+  Py_ssize_t pos;
+  Py_ssize_t endpos;
+} ScannerObject;
+
+/* a Python object representing a set of regular expressions that are
+ * matched together */
+typedef struct {
+  PyObject_HEAD
+
+  /* holds the compiled automaton for the whole set */
+  RegularExpression* re;
+
+  /* the number of patterns in the set */
+  Py_ssize_t size;
+} RegExSet;
 #endif /* TESTER */
 
 /* a singleton object representing global state, reusable values and
@@ -235,6 +296,7 @@ class CompiledExpression {
     Value* loadOffset(BasicBlock* block);
     void storeOffset(BasicBlock* block, Value* value);
     BasicBlock* loadCharacter(BasicBlock* block);
+    Value* lowerCharacter(BasicBlock* block, Value* c);
     Function* greedy(Function* repeat, Function* after);
     Function* nongreedy(Function* repeat, Function* after);
     void testRange(BasicBlock* block, Value* c, int from, int to, BasicBlock* member, BasicBlock* nonmember);
@@ -251,6 +313,91 @@ class CompiledExpression {
         BasicBlock* block);
 };
 
+/* a set of characters, as sorted, non-overlapping, inclusive ranges */
+typedef std::vector<std::pair<uint32_t, uint32_t> > CharRanges;
+
+/* a nondeterministic automaton for a pattern without group references or
+ * assertions. when a state splits, the first way out is the one that the
+ * backtracking matcher would try first. */
+class NFA {
+  public:
+    enum Kind { CHARS, SPLIT, EMPTY, MATCH };
+    struct State {
+      Kind kind;
+      // the next states, out1 is only used by SPLIT
+      int out;
+      int out1;
+      // the characters a CHARS state consumes
+      CharRanges chars;
+      // which pattern the state belongs to, for automata built by BuildSet
+      int tag;
+    };
+    std::vector<State> states;
+    int start;
+
+    // build the automaton for @seq, or for @seq read backwards
+    bool Build(PyObject* seq, int flags, bool reverse);
+    // build an automaton that matches each of the patterns in @seqs, using
+    // the corresponding @flags, with states tagged by the pattern's index
+    bool BuildSet(PyObject* seqs, const std::vector<int>& flags);
+
+  private:
+    // a piece of the automaton with exits that are yet to be connected
+    struct Fragment {
+      int start;
+      // (state, is out1) pairs
+      std::vector<std::pair<int, bool> > exits;
+      bool nullable;
+    };
+
+    int flags;
+    bool reverse;
+    int tag;
+
+    int AddState(Kind kind);
+    void Patch(const Fragment& fragment, int target);
+    void Concatenate(Fragment* first, const Fragment& second);
+    void Empty(Fragment* result);
+    void Chars(const CharRanges& chars, Fragment* result);
+    void Optional(Fragment* body, bool is_greedy);
+    bool Sequence(PyObject* seq, Fragment* result);
+    bool Operation(const char* op_str, PyObject* arg, Fragment* result);
+    bool Repeat(PyObject* arg, bool is_greedy, Fragment* result);
+    bool Branch(PyObject* arg, Fragment* result);
+    bool Set(PyObject* arg, CharRanges* chars);
+};
+
+/* a deterministic automaton built from an NFA. each state is the ordered
+ * list of NFA states the backtracking matcher could be in, and the states
+ * after one that matches are dropped, so the automaton ends up at the same
+ * match as the backtracking matcher. */
+class DFA {
+  public:
+    struct State {
+      // the tags of the patterns that have matched in this state
+      std::vector<int> accepting;
+      // the next state for each character class, -1 when matching stops
+      std::vector<int> next;
+    };
+    std::vector<State> states;
+    // character class i is the characters from classes[i] up to the start
+    // of the next class
+    std::vector<uint32_t> classes;
+
+    // build the automaton. if @unanchored a match can start anywhere, if
+    // @longest it finds the longest match instead of the one the
+    // backtracking matcher would. fails if more than @max_states are needed.
+    bool Build(const NFA& nfa, bool unanchored, bool longest, 
+               size_t max_states);
+
+    // the last character in class @i
+    uint32_t ClassEnd(size_t i) const;
+
+  private:
+    void Closure(const NFA& nfa, int state, std::vector<int>& list, 
+                 std::vector<bool>& seen);
+};
+
 
 /* a regular expression */
 class RegularExpression : CompiledExpression {
@@ -260,8 +407,14 @@ class RegularExpression : CompiledExpression {
 
     bool Compile(PyObject* seq, int flags, int groups);
 
-    PyObject* Match(Py_UNICODE* characters, int length, int pos, int end);
-    PyObject* Find(Py_UNICODE* characters, int length, int pos, int end);
+    bool Execute(Py_UNICODE* characters, int pos, int end, bool search,
+                 ReOffset* regs);
+
+    // compile a set of patterns into one automaton, then match all of them
+    // at an offset, filling in the end of each one's match or -1
+    bool CompileSet(PyObject* seqs, const std::vector<int>& flags);
+    void ExecuteSet(Py_UNICODE* characters, int pos, int end, 
+                    ReOffset* ends, int size);
 
     // Unladed Swallow global LLVM data
     PyGlobalLlvmData* global_data;
@@ -284,25 +437,54 @@ class RegularExpression : CompiledExpression {
     Function* find_function;
   private:
     bool CompileFind();
-    ReOffset* AllocateGroupsArray();
-    PyObject* ProcessResult(ReOffset start,
-                            ReOffset result,
-                            ReOffset* groups_array);
+    ReOffset NextCandidate(Py_UNICODE* characters, ReOffset pos, 
+                           ReOffset end);
+    ReOffset Scan(Py_UNICODE* characters, ReOffset pos, ReOffset end,
+                  ReOffset* groups_array, ReOffset* start);
     // the function pointers
     MatchFunction match_fp;
     FindFunction find_fp;
 
+    // if the pattern can be matched with automata, compile them
+    void CompileDFA(PyObject* seq);
+    Function* EmitDFA(const DFA& dfa, const char* name, bool reverse,
+                      bool tagged=false);
+    bool ExecuteDFA(Py_UNICODE* characters, ReOffset pos, ReOffset end,
+                    bool search, ReOffset* groups_array, ReOffset* start,
+                    ReOffset* result);
+    // match at an offset, find the end of the first match after an offset
+    // and find the start of a match that ends at an offset
+    MatchFunction dfa_match_fp;
+    MatchFunction dfa_search_fp;
+    MatchFunction dfa_reverse_fp;
+
     // all of the functions created by this regex
     typedef std::vector<Function*> Functions;
     Functions functions;
 
+    // analyze the pattern to find out where Find() can skip ahead to
+    void AnalyzePattern(PyObject* seq);
+    bool FirstSet(PyObject* seq, Py_ssize_t index);
+    bool FirstSetIn(PyObject* arg);
+    void AddFirstChar(Py_UNICODE c);
+    void AddFirstSetChar(Py_UNICODE lowered);
+
+    // the literal that every match starts with
+    std::vector<Py_UNICODE> prefix;
+    // the longest literal that every match contains
+    std::vector<Py_UNICODE> required;
+    // the characters (by low byte) that a match can start with
+    bool has_first_set;
+    bool first_set[256];
 };
 
 LLVMContext* RegularExpression::context = NULL;
 ExecutionEngine* RegularExpression::ee = NULL;
 
 RegularExpression::RegularExpression() 
-  : CompiledExpression(*this, true), find_function(NULL)
+  : CompiledExpression(*this, true), find_function(NULL), 
+    dfa_match_fp(NULL), dfa_search_fp(NULL), dfa_reverse_fp(NULL),
+    has_first_set(false)
 {
   // use the Unladen Swallow LLVM context
   global_data = PyGlobalLlvmData::Get();
@@ -325,6 +507,8 @@ RegularExpression::RegularExpression()
 
 RegularExpression::~RegularExpression() 
 {
+  PyGlobalLlvmData::ScopedLock lock(global_data);
+
   // first free all of the JIT state associated with this expression
   for (Functions::reverse_iterator i = functions.rbegin(); 
       i < functions.rend(); ++i) {
@@ -332,6 +516,9 @@ RegularExpression::~RegularExpression()
   }
   match_fp = NULL;
   find_fp = NULL;
+  dfa_match_fp = NULL;
+  dfa_search_fp = NULL;
+  dfa_reverse_fp = NULL;
 
   // free the functions associated with this regex
   bool made_changes;
@@ -389,15 +576,278 @@ RegularExpression::Compile(PyObject* seq,
   this->flags = flags;
   this->groups = groups;
 
+  // the pattern's functions go into the interpreter's shared module
+  PyGlobalLlvmData::ScopedLock lock(global_data);
+
   if (CompiledExpression::Compile(seq, 0, false) && CompileFind()) {
     match_fp = (MatchFunction) ee->getPointerToFunction(function);
     find_fp = (FindFunction) ee->getPointerToFunction(find_function);
+    AnalyzePattern(seq);
+    CompileDFA(seq);
     return true;
   } else {
     return false;
   }
 }
 
+// fetch the (op, arg) pair at @index in a pattern sequence. on success new
+// references are returned in @op and @arg.
+static bool
+GetOperation(PyObject* seq, Py_ssize_t index, PyObject** op, PyObject** arg)
+{
+  PyObject* element = PySequence_GetItem(seq, index);
+  if (element == NULL || !PySequence_Check(element) ||
+      PySequence_Size(element) != 2) {
+    Py_XDECREF(element);
+    return false;
+  }
+  *op = PySequence_GetItem(element, 0);
+  *arg = PySequence_GetItem(element, 1);
+  Py_DECREF(element);
+  if (*op == NULL || *arg == NULL || !PyString_Check(*op)) {
+    Py_XDECREF(*op);
+    Py_XDECREF(*arg);
+    return false;
+  }
+  return true;
+}
+
+// lower @c the way SRE does for @flags before comparing it with the members
+// of a case-insensitive set, whose literals and range bounds it lowers the
+// same way
+static Py_UNICODE
+LowerChar(Py_UNICODE c, int flags)
+{
+  if (flags & SRE_FLAG_LOCALE) {
+    return c < 256 ? tolower(c) : c;
+  } else if (flags & SRE_FLAG_UNICODE) {
+    return Py_UNICODE_TOLOWER(c);
+  }
+  return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+// is @op_str an operation that doesn't consume any characters?
+static bool
+IsZeroWidth(const char* op_str)
+{
+  return !strcmp(op_str, "subpattern_begin") ||
+    !strcmp(op_str, "subpattern_end") ||
+    !strcmp(op_str, "at") ||
+    !strcmp(op_str, "assert") ||
+    !strcmp(op_str, "assert_not");
+}
+
+void
+RegularExpression::AnalyzePattern(PyObject* seq)
+{
+  /** look for a literal prefix, a required literal and the set of possible
+   * first characters of @seq so that Find() can skip over offsets where 
+   * the pattern can't match instead of calling the matcher at each one */
+  bool ignorecase = flags & SRE_FLAG_IGNORECASE;
+
+  // find runs of literals in the top level of the pattern. every match
+  // must contain all of them.
+  bool at_start = true;
+  std::vector<Py_UNICODE> run;
+  Py_ssize_t seq_length = PySequence_Size(seq);
+  for (Py_ssize_t index = 0; index <= seq_length; index++) {
+    PyObject *op = NULL, *arg = NULL;
+    bool in_run = false;
+    if (index < seq_length && GetOperation(seq, index, &op, &arg)) {
+      const char* op_str = PyString_AsString(op);
+      if (!strcmp(op_str, "literal") && PyInt_Check(arg)) {
+        Py_UNICODE c = PyInt_AsLong(arg);
+        // case insensitive literals can't be searched for directly
+        if (!ignorecase || Py_UNICODE_TOUPPER(c) == Py_UNICODE_TOLOWER(c)) {
+          run.push_back(c);
+          in_run = true;
+        }
+      } else if (!strcmp(op_str, "subpattern_begin") ||
+          !strcmp(op_str, "subpattern_end") ||
+          (at_start && IsZeroWidth(op_str))) {
+        // group markers don't break up a run of literals, and nothing
+        // zero-width before the first literal moves the start of a match
+        in_run = true;
+      }
+    }
+    Py_XDECREF(op);
+    Py_XDECREF(arg);
+
+    if (!in_run) {
+      if (at_start) {
+        prefix = run;
+      }
+      if (run.size() > required.size()) {
+        required = run;
+      }
+      run.clear();
+      at_start = false;
+    }
+  }
+
+  // the prefix already has to be found by Scan(), only search for the
+  // required literal up front if it's longer
+  if (required.size() <= prefix.size()) {
+    required.clear();
+  }
+
+  // without a prefix to search for, try to find the characters a match can
+  // start with
+  if (prefix.empty()) {
+    memset(first_set, 0, sizeof(first_set));
+    has_first_set = FirstSet(seq, 0);
+  }
+
+  // analysis is best-effort, it doesn't raise exceptions
+  PyErr_Clear();
+}
+
+void
+RegularExpression::AddFirstChar(Py_UNICODE c)
+{
+  first_set[c & 0xff] = true;
+  if (flags & SRE_FLAG_IGNORECASE) {
+    first_set[Py_UNICODE_TOUPPER(c) & 0xff] = true;
+    first_set[Py_UNICODE_TOLOWER(c) & 0xff] = true;
+  }
+}
+
+void
+RegularExpression::AddFirstSetChar(Py_UNICODE lowered)
+{
+  /** add the characters that LowerChar() turns into @lowered, which is how
+   * a case-insensitive set compares them with its members */
+  first_set[lowered & 0xff] = true;
+  for (int c=0; c<256; c++) {
+    if (LowerChar(c, flags) == lowered) {
+      first_set[c] = true;
+    }
+  }
+}
+
+bool
+RegularExpression::FirstSet(PyObject* seq, Py_ssize_t index)
+{
+  /** add the characters that a match of @seq from @index onwards can start
+   * with to first_set. returns false if that can't be determined, or if the
+   * sequence can match the empty string */
+  Py_ssize_t seq_length = PySequence_Size(seq);
+  for (; index < seq_length; index++) {
+    PyObject *op, *arg;
+    if (!GetOperation(seq, index, &op, &arg)) {
+      return false;
+    }
+    const char* op_str = PyString_AsString(op);
+    bool result = false;
+    bool zero_width = false;
+
+    if (!strcmp(op_str, "literal")) {
+      if (PyInt_Check(arg)) {
+        AddFirstChar(PyInt_AsLong(arg));
+        result = true;
+      }
+    } else if (!strcmp(op_str, "in")) {
+      result = FirstSetIn(arg);
+    } else if (!strcmp(op_str, "max_repeat") || 
+        !strcmp(op_str, "min_repeat")) {
+      int min, max;
+      PyObject* sub_pattern;
+      if (PyArg_ParseTuple(arg, "iiO", &min, &max, &sub_pattern)) {
+        // if the repeat is optional, a match can also start with whatever
+        // follows it
+        result = FirstSet(sub_pattern, 0) && 
+          (min > 0 || FirstSet(seq, index+1));
+      }
+    } else if (!strcmp(op_str, "branch")) {
+      PyObject* branches = PyTuple_Check(arg) && PyTuple_Size(arg) == 2 ?
+        PyTuple_GetItem(arg, 1) : NULL;
+      if (branches != NULL && PySequence_Check(branches)) {
+        Py_ssize_t num_branches = PySequence_Size(branches);
+        result = num_branches > 0;
+        for (Py_ssize_t i=0; result && i<num_branches; i++) {
+          PyObject* branch = PySequence_GetItem(branches, i);
+          result = branch != NULL && FirstSet(branch, 0);
+          Py_XDECREF(branch);
+        }
+      }
+    } else if (IsZeroWidth(op_str)) {
+      zero_width = true;
+    }
+    // anything else (any, not_literal, groupref, ...) could start with
+    // any character
+
+    Py_DECREF(op);
+    Py_DECREF(arg);
+    if (!zero_width) {
+      return result;
+    }
+  }
+  // the rest of the pattern can match the empty string
+  return false;
+}
+
+bool
+RegularExpression::FirstSetIn(PyObject* arg)
+{
+  /** add the characters matched by an 'in' operation to first_set */
+  if (!PySequence_Check(arg)) {
+    return false;
+  }
+  bool ignorecase = flags & SRE_FLAG_IGNORECASE;
+  if (ignorecase && (flags & SRE_FLAG_UNICODE)) {
+    // characters outside Latin-1 can lower into the set
+    return false;
+  }
+  Py_ssize_t arg_length = PySequence_Size(arg);
+  for (Py_ssize_t i=0; i<arg_length; i++) {
+    PyObject* item = PySequence_GetItem(arg, i);
+    if (item == NULL || !PyTuple_Check(item) || PyTuple_Size(item) != 2 ||
+        !PyString_Check(PyTuple_GetItem(item, 0))) {
+      Py_XDECREF(item);
+      return false;
+    }
+    const char* op_str = PyString_AsString(PyTuple_GetItem(item, 0));
+    PyObject* op_arg = PyTuple_GetItem(item, 1);
+    bool ok = false;
+    if (!strcmp(op_str, "literal") && PyInt_Check(op_arg)) {
+      Py_UNICODE c = PyInt_AsLong(op_arg);
+      if (ignorecase) {
+        AddFirstSetChar(LowerChar(c, flags));
+      } else {
+        AddFirstChar(c);
+      }
+      ok = true;
+    } else if (!strcmp(op_str, "range")) {
+      int from, to;
+      if (PyArg_ParseTuple(op_arg, "ii", &from, &to)) {
+        // CompiledExpression::in compares lowered characters with the
+        // lowered bounds
+        if (ignorecase) {
+          from = LowerChar(from, flags);
+          to = LowerChar(to, flags);
+        }
+        // a range this big could start with any low byte anyway
+        if (to - from < 256) {
+          for (int c=from; c<=to; c++) {
+            if (ignorecase) {
+              AddFirstSetChar(c);
+            } else {
+              AddFirstChar(c);
+            }
+          }
+          ok = true;
+        }
+      }
+    }
+    // negated sets and categories match too many characters to be useful
+    Py_DECREF(item);
+    if (!ok) {
+      return false;
+    }
+  }
+  return arg_length > 0;
+}
+
 bool
 RegularExpression::CompileFind() 
 {
@@ -476,182 +926,1053 @@ RegularExpression::CompileFind()
   return true;
 }
 
-ReOffset*
-RegularExpression::AllocateGroupsArray()
+ReOffset
+RegularExpression::NextCandidate(Py_UNICODE* characters,
+                                 ReOffset pos,
+                                 ReOffset end)
 {
-  if (groups) {
-    int groups_size = groups*2 + 1;
-    // allocate the array
-    ReOffset* groups_array = new ReOffset[groups_size];
-    // set all members to -1 (aka REM->not_found)
-    for (int i=0; i<groups_size; i++) {
-      groups_array[i] = -1;
+  /** skip ahead from @pos to the next offset where the prefix or a first
+   * character occurs. returns -1 if there isn't one. */
+  if (prefix.size() > 1) {
+    Py_ssize_t i = fastsearch(characters + pos, end - pos, &prefix[0],
+        prefix.size(), FAST_SEARCH);
+    if (i < 0) {
+      return -1;
+    }
+    pos += i;
+  } else if (prefix.size() == 1) {
+    Py_UNICODE c = prefix[0];
+    while (pos < end && characters[pos] != c) {
+      pos++;
     }
-    return groups_array;
   } else {
-    // no array is needed if there are no groups, right?
-    return NULL;
+    while (pos < end && !first_set[characters[pos] & 0xff]) {
+      pos++;
+    }
   }
+  // neither a prefix nor a first character can match at the very end
+  return pos < end ? pos : -1;
 }
 
-PyObject*
-RegularExpression::ProcessResult(ReOffset start,
-                                 ReOffset result,
-                                 ReOffset* groups_array)
-{
-  if (result >= 0) {
-    // matched, return a list of offsets
-    PyObject* groups_list = PyList_New(groups*2 + 3);
-    // r[0] - the start of the whole match
-    PyList_SetItem(groups_list, 0, PyInt_FromLong((long)start));
-    // r[0] - the end of the whole match
-    PyList_SetItem(groups_list, 1, PyInt_FromLong((long)result));
-    // for each group, the start and end offsets
-    if (groups) {
-      for (int i=0; i<groups*2 + 1; i++) {
-        PyList_SetItem(groups_list, i+2, 
-            PyInt_FromLong((long)groups_array[i]));
-      }
-    } else {
-      // if there were no groups still stick a lastindex in there
-      PyList_SetItem(groups_list, 2, PyInt_FromLong(-1L));
+ReOffset
+RegularExpression::Scan(Py_UNICODE* characters,
+                        ReOffset pos,
+                        ReOffset end,
+                        ReOffset* groups_array,
+                        ReOffset* start)
+{
+  /** find a match by skipping to the offsets where the prefix or a first
+   * character occurs and only calling the matcher there. */
+  while ((pos = NextCandidate(characters, pos, end)) >= 0) {
+    ReOffset result = (match_fp)(characters, pos, end, groups_array);
+    if (result != -1) {
+      *start = pos;
+      return result;
     }
+    pos++;
+  }
+  return -1;
+}
 
-    // FIXME: does this leak?
-    Py_INCREF(groups_list);
+bool
+RegularExpression::Execute(Py_UNICODE* characters,
+                           int pos,
+                           int end,
+                           bool search,
+                           ReOffset* regs)
+{
+  /** match the pattern at @pos, or if @search is set find it anywhere 
+   * between @pos and @end. on success @regs holds the start and end of the
+   * match, then the start and end of each group, then the lastindex. */
+  ReOffset start = pos;
+  ReOffset result;
+  // the compiled code fills in the groups and lastindex
+  ReOffset* groups_array = regs + 2;
+  for (int i=0; i<groups*2 + 1; i++) {
+    groups_array[i] = -1;
+  }
 
-    if (groups) {
-      delete[] groups_array;
-    }
-    
-    return groups_list;
+  if (search && !required.empty() && fastsearch(characters + pos, 
+        end - pos, &required[0], required.size(), FAST_SEARCH) < 0) {
+    // a literal that every match contains isn't there
+    result = -1;
+  } else if (dfa_match_fp != NULL && 
+      ExecuteDFA(characters, pos, end, search, groups_array, &start, 
+        &result)) {
+    // the automata found the match, or that there isn't one
+  } else if (!search) {
+    result = (match_fp)(characters, pos, end, groups_array);
+  } else if (!prefix.empty() || has_first_set) {
+    result = Scan(characters, pos, end, groups_array, &start);
   } else {
-    if (groups) {
-      delete[] groups_array;
-    }
-    
-    // no match, return None
-    Py_INCREF(Py_None);
-    return Py_None;
+    result = (find_fp)(characters, pos, end, groups_array, &start);
   }
 
+  if (result < 0) {
+    return false;
+  }
+  regs[0] = start;
+  regs[1] = result;
+  return true;
 }
 
-PyObject*
-RegularExpression::Match(Py_UNICODE* characters, 
-                         int length, 
-                         int pos, 
-                         int end)
-{
-  ReOffset* groups_array = AllocateGroupsArray();
 
-  ReOffset result = (match_fp)(characters, pos, end, groups_array);
+// the largest character a Py_UNICODE can hold
+static const uint32_t MAX_CHAR = Py_UNICODE_SIZE == 2 ? 0xffff : 0xffffffff;
+// sre_parse uses this as the maximum of unbounded repeats
+static const int MAX_REPEAT = 65535;
+// patterns whose automata would be bigger than this are left to the
+// backtracking matcher
+static const size_t NFA_MAX_STATES = 4096;
+static const size_t DFA_MAX_STATES = 256;
+static const size_t DFA_SET_MAX_STATES = 1024;
 
-  return ProcessResult(pos, result, groups_array);
+static void
+AddRange(CharRanges* chars, uint32_t from, uint32_t to)
+{
+  chars->push_back(std::make_pair(from, to));
 }
 
-PyObject*
-RegularExpression::Find(Py_UNICODE* characters, 
-                        int length, 
-                        int pos, 
-                        int end)
+static void
+NormalizeRanges(CharRanges* chars)
 {
-  ReOffset start;
-  ReOffset* groups_array = AllocateGroupsArray();
-  ReOffset result = (find_fp)(characters, pos, end, groups_array, &start);
-  return ProcessResult(start, result, groups_array);
+  /** sort @chars and merge the ranges that overlap or touch */
+  std::sort(chars->begin(), chars->end());
+  CharRanges merged;
+  for (CharRanges::iterator i = chars->begin(); i != chars->end(); ++i) {
+    if (!merged.empty() && (merged.back().second == MAX_CHAR ||
+          i->first <= merged.back().second + 1)) {
+      if (i->second > merged.back().second) {
+        merged.back().second = i->second;
+      }
+    } else {
+      merged.push_back(*i);
+    }
+  }
+  chars->swap(merged);
 }
 
-
-CompiledExpression::CompiledExpression(RegularExpression& re, bool first) 
-  : re(re), first(first) {
+static void
+ComplementRanges(CharRanges* chars)
+{
+  /** replace @chars with every character that isn't in it */
+  NormalizeRanges(chars);
+  CharRanges complement;
+  uint32_t from = 0;
+  for (CharRanges::iterator i = chars->begin(); i != chars->end(); ++i) {
+    if (i->first > from) {
+      AddRange(&complement, from, i->first - 1);
+    }
+    if (i->second == MAX_CHAR) {
+      chars->swap(complement);
+      return;
+    }
+    from = i->second + 1;
+  }
+  AddRange(&complement, from, MAX_CHAR);
+  chars->swap(complement);
 }
 
-CompiledExpression::~CompiledExpression() {
+static bool
+InRanges(const CharRanges& chars, uint32_t c)
+{
+  for (CharRanges::const_iterator i = chars.begin(); i != chars.end(); ++i) {
+    if (c >= i->first && c <= i->second) {
+      return true;
+    }
+  }
+  return false;
 }
 
-
-LLVMContext& 
-CompiledExpression::context() 
+static bool
+CategoryRanges(const char* category, CharRanges* chars)
 {
-  return *re.context;
+  /** add the characters in @category to @chars, using the definitions
+   * CompiledExpression::testCategory uses without LOCALE or UNICODE */
+  if (strncmp(category, "category_", 9)) {
+    return false;
+  }
+  bool negate = !strncmp(category, "category_not_", 13);
+  const char* name = category + (negate ? 13 : 9);
+  CharRanges ranges;
+  if (!strcmp(name, "digit")) {
+    AddRange(&ranges, '0', '9');
+  } else if (!strcmp(name, "word")) {
+    AddRange(&ranges, 'a', 'z');
+    AddRange(&ranges, 'A', 'Z');
+    AddRange(&ranges, '0', '9');
+    AddRange(&ranges, '_', '_');
+  } else if (!strcmp(name, "space")) {
+    // \t \n \v \f \r
+    AddRange(&ranges, '\t', '\r');
+    AddRange(&ranges, ' ', ' ');
+  } else {
+    return false;
+  }
+  if (negate) {
+    ComplementRanges(&ranges);
+  }
+  chars->insert(chars->end(), ranges.begin(), ranges.end());
+  return true;
 }
 
-Value* 
-CompiledExpression::loadOffset(BasicBlock* block) {
-  return new LoadInst(offset_ptr, "offset", block);
+int
+NFA::AddState(Kind kind)
+{
+  State state;
+  state.kind = kind;
+  state.out = -1;
+  state.out1 = -1;
+  state.tag = tag;
+  states.push_back(state);
+  return states.size() - 1;
 }
 
 void
-CompiledExpression::storeOffset(BasicBlock* block, Value* value) {
-  new StoreInst(value, offset_ptr, block);
+NFA::Patch(const Fragment& fragment, int target)
+{
+  /** connect the exits of @fragment to @target */
+  for (size_t i=0; i<fragment.exits.size(); i++) {
+    State& state = states[fragment.exits[i].first];
+    if (fragment.exits[i].second) {
+      state.out1 = target;
+    } else {
+      state.out = target;
+    }
+  }
 }
 
-BasicBlock* 
-CompiledExpression::loadCharacter(BasicBlock* block) {
-  // get the current offset
-  Value* offset = loadOffset(block);
-  // make sure it's not past the end of the string
-  Value* ended = new ICmpInst(*block, ICmpInst::ICMP_UGE, offset, end_offset, 
-      "ended");
-  // if it's ended, return REM->not_found, otherwise, continue
-  // I'm scared this will fuck things up
-  BasicBlock* new_block = createBlock();
-  BranchInst::Create(return_not_found, new_block, ended, block);
-
-  block = new_block;
-
-  // load the character at the right offset
-  Value* c_ptr = GetElementPtrInst::Create(string, offset, "c_ptr", block);
-  character = new LoadInst(c_ptr, "c", block);
-  // increment the offset
-  offset = BinaryOperator::CreateAdd(offset,
-      ConstantInt::get(REM->offsetType, 1), "increment", block);
-  storeOffset(block, offset);
-  return block;
+void
+NFA::Concatenate(Fragment* first, const Fragment& second)
+{
+  Patch(*first, second.start);
+  first->exits = second.exits;
+  first->nullable = first->nullable && second.nullable;
 }
 
-template<typename R, typename A1, bool isSigned, bool toBool>
-Value* 
-CompiledExpression::callGlobalFunction(const char* name, 
-                                       Value*      a1, 
-                                       BasicBlock* block) {
-  // get the Function* for the global function
-  Function* gf = cast<Function>(
-      re.module->getOrInsertFunction(name,
-        PyTypeBuilder<R(A1)>::get(context()))
-      );
-
-  // get the llvm::Type of the argument
-  const Type* A1_type = PyTypeBuilder<A1>::get(context());
+void
+NFA::Empty(Fragment* result)
+{
+  result->start = AddState(EMPTY);
+  result->exits.assign(1, std::make_pair(result->start, false));
+  result->nullable = true;
+}
 
-  // convert the argument to the correct type using correct sign semantics
-  // or leave it if the types already match
-  Value* args[1];
-  if (A1_type == a1->getType()) {
-    args[0] = a1;
-  } else if (isSigned) {
-    args[0] = 
-      new SExtInst(a1, A1_type, "", block);
-  } else {
-    args[0] = 
-      new ZExtInst(a1, A1_type, "", block);
-  }
-  // call the function
-  Value* result = CallInst::Create(gf, args, args+1, "result", block);
+void
+NFA::Chars(const CharRanges& chars, Fragment* result)
+{
+  result->start = AddState(CHARS);
+  states[result->start].chars = chars;
+  NormalizeRanges(&states[result->start].chars);
+  result->exits.assign(1, std::make_pair(result->start, false));
+  result->nullable = false;
+}
 
-  if (toBool) {
-    // cast an integer result to boolean. we do this often
-    return new ICmpInst(*block, ICmpInst::ICMP_NE,
-      result, ConstantInt::get(PyTypeBuilder<R>::get(context()), 0),
-      "result_bool");
+void
+NFA::Optional(Fragment* body, bool is_greedy)
+{
+  /** make @body optional, trying it before skipping it if @is_greedy */
+  int split = AddState(SPLIT);
+  if (is_greedy) {
+    states[split].out = body->start;
+    body->exits.push_back(std::make_pair(split, true));
   } else {
-    return result;
+    states[split].out1 = body->start;
+    body->exits.push_back(std::make_pair(split, false));
   }
+  body->start = split;
+  body->nullable = true;
 }
 
-
-Function*
+bool
+NFA::Build(PyObject* seq, int flags, bool reverse)
+{
+  /** build the automaton. returns false if the pattern uses something that
+   * an automaton can't match, or if it would be too big */
+  this->flags = flags;
+  this->reverse = reverse;
+  tag = 0;
+
+  Fragment pattern;
+  if (!Sequence(seq, &pattern)) {
+    return false;
+  }
+  Patch(pattern, AddState(MATCH));
+  start = pattern.start;
+  return true;
+}
+
+bool
+NFA::BuildSet(PyObject* seqs, const std::vector<int>& flags)
+{
+  /** build the automaton for a set of patterns. like a branch each pattern
+   * hangs off a split, but each one has its own MATCH state */
+  reverse = false;
+  Py_ssize_t num_patterns = PySequence_Size(seqs);
+  if (num_patterns < 1 || (size_t)num_patterns != flags.size()) {
+    return false;
+  }
+  int previous = -1;
+  for (Py_ssize_t i=0; i<num_patterns; i++) {
+    this->flags = flags[i];
+    tag = i;
+    PyObject* seq = PySequence_GetItem(seqs, i);
+    Fragment pattern;
+    bool ok = seq != NULL && Sequence(seq, &pattern);
+    Py_XDECREF(seq);
+    if (!ok) {
+      return false;
+    }
+    Patch(pattern, AddState(MATCH));
+    int entry = pattern.start;
+    if (i+1 < num_patterns) {
+      entry = AddState(SPLIT);
+      states[entry].out = pattern.start;
+    }
+    if (previous < 0) {
+      start = entry;
+    } else {
+      states[previous].out1 = entry;
+    }
+    previous = entry;
+  }
+  return true;
+}
+
+bool
+NFA::Sequence(PyObject* seq, Fragment* result)
+{
+  /** build a fragment that matches each operation in @seq in turn, from
+   * the last to the first for a reverse automaton */
+  if (!PySequence_Check(seq)) {
+    return false;
+  }
+  Empty(result);
+  Py_ssize_t seq_length = PySequence_Size(seq);
+  for (Py_ssize_t i=0; i<seq_length; i++) {
+    PyObject *op, *arg;
+    if (!GetOperation(seq, reverse ? seq_length-1-i : i, &op, &arg)) {
+      return false;
+    }
+    Fragment fragment;
+    bool ok = Operation(PyString_AsString(op), arg, &fragment);
+    Py_DECREF(op);
+    Py_DECREF(arg);
+    if (!ok || states.size() > NFA_MAX_STATES) {
+      return false;
+    }
+    Concatenate(result, fragment);
+  }
+  return true;
+}
+
+bool
+NFA::Operation(const char* op_str, PyObject* arg, Fragment* result)
+{
+  CharRanges chars;
+  if (!strcmp(op_str, "literal") || !strcmp(op_str, "not_literal")) {
+    if (!PyInt_Check(arg)) {
+      return false;
+    }
+    Py_UNICODE c = PyInt_AsLong(arg);
+    Py_UNICODE upper, lower;
+    // the same characters that CompiledExpression::literal compares with
+    if (flags & SRE_FLAG_IGNORECASE && 
+        (upper=Py_UNICODE_TOUPPER(c)) != (lower=Py_UNICODE_TOLOWER(c))) {
+      AddRange(&chars, upper, upper);
+      AddRange(&chars, lower, lower);
+    } else {
+      AddRange(&chars, c, c);
+    }
+    if (!strcmp(op_str, "not_literal")) {
+      ComplementRanges(&chars);
+    }
+  } else if (!strcmp(op_str, "any")) {
+    if (flags & SRE_FLAG_DOTALL) {
+      AddRange(&chars, 0, MAX_CHAR);
+    } else {
+      AddRange(&chars, '\n', '\n');
+      ComplementRanges(&chars);
+    }
+  } else if (!strcmp(op_str, "in")) {
+    if (!Set(arg, &chars)) {
+      return false;
+    }
+  } else if (!strcmp(op_str, "max_repeat")) {
+    return Repeat(arg, true, result);
+  } else if (!strcmp(op_str, "min_repeat")) {
+    return Repeat(arg, false, result);
+  } else if (!strcmp(op_str, "branch")) {
+    return Branch(arg, result);
+  } else if (!strcmp(op_str, "subpattern_begin") || 
+      !strcmp(op_str, "subpattern_end")) {
+    // the automaton only finds the span of the match
+    Empty(result);
+    return true;
+  } else {
+    // group references and assertions need the backtracking matcher
+    return false;
+  }
+  Chars(chars, result);
+  return true;
+}
+
+bool
+NFA::Set(PyObject* arg, CharRanges* chars)
+{
+  /** find the characters that an 'in' operation matches */
+  // leave case-insensitive sets to CompiledExpression::in, which folds
+  // case the way SRE does
+  if (flags & SRE_FLAG_IGNORECASE || !PySequence_Check(arg)) {
+    return false;
+  }
+  bool negate = false;
+  Py_ssize_t arg_length = PySequence_Size(arg);
+  for (Py_ssize_t i=0; i<arg_length; i++) {
+    PyObject* item = PySequence_GetItem(arg, i);
+    if (item == NULL || !PyTuple_Check(item) || PyTuple_Size(item) != 2 ||
+        !PyString_Check(PyTuple_GetItem(item, 0))) {
+      Py_XDECREF(item);
+      return false;
+    }
+    const char* op_str = PyString_AsString(PyTuple_GetItem(item, 0));
+    PyObject* op_arg = PyTuple_GetItem(item, 1);
+    bool ok = true;
+    if (i == 0 && !strcmp(op_str, "negate")) {
+      negate = true;
+    } else if (!strcmp(op_str, "literal") && PyInt_Check(op_arg)) {
+      AddRange(chars, PyInt_AsLong(op_arg), PyInt_AsLong(op_arg));
+    } else if (!strcmp(op_str, "range")) {
+      int from, to;
+      ok = PyArg_ParseTuple(op_arg, "ii", &from, &to);
+      if (ok) {
+        AddRange(chars, from, to);
+      }
+    } else if (!strcmp(op_str, "category")) {
+      // locale and unicode categories are decided by calling functions
+      ok = PyString_Check(op_arg) && 
+        !(flags & (SRE_FLAG_LOCALE | SRE_FLAG_UNICODE)) &&
+        CategoryRanges(PyString_AsString(op_arg), chars);
+    } else {
+      ok = false;
+    }
+    Py_DECREF(item);
+    if (!ok) {
+      return false;
+    }
+  }
+  if (negate) {
+    ComplementRanges(chars);
+  }
+  return true;
+}
+
+bool
+NFA::Repeat(PyObject* arg, bool is_greedy, Fragment* result)
+{
+  /** expand a repeat into copies of the repeated pattern, each one after
+   * the minimum optional */
+  int min, max;
+  PyObject* sub_pattern;
+  if (!PyArg_ParseTuple(arg, "iiO", &min, &max, &sub_pattern)) {
+    return false;
+  }
+  // the repeated pattern is never allowed to match the empty string, the
+  // backtracking matchers treat that specially
+  Fragment body;
+  Empty(result);
+  for (int i=0; i<min; i++) {
+    if (!Sequence(sub_pattern, &body) || body.nullable ||
+        states.size() > NFA_MAX_STATES) {
+      return false;
+    }
+    Concatenate(result, body);
+  }
+
+  if (max == MAX_REPEAT) {
+    // loop back to a split after each repetition
+    if (!Sequence(sub_pattern, &body) || body.nullable) {
+      return false;
+    }
+    Fragment loop;
+    loop.start = AddState(SPLIT);
+    loop.nullable = true;
+    Patch(body, loop.start);
+    if (is_greedy) {
+      states[loop.start].out = body.start;
+      loop.exits.assign(1, std::make_pair(loop.start, true));
+    } else {
+      states[loop.start].out1 = body.start;
+      loop.exits.assign(1, std::make_pair(loop.start, false));
+    }
+    Concatenate(result, loop);
+  } else if (max > min) {
+    // nest the optional repetitions, like (x(x(x)?)?)?
+    Fragment optional;
+    for (int i=0; i<max-min; i++) {
+      if (!Sequence(sub_pattern, &body) || body.nullable ||
+          states.size() > NFA_MAX_STATES) {
+        return false;
+      }
+      if (i > 0) {
+        Concatenate(&body, optional);
+      }
+      Optional(&body, is_greedy);
+      optional = body;
+    }
+    Concatenate(result, optional);
+  }
+  return true;
+}
+
+bool
+NFA::Branch(PyObject* arg, Fragment* result)
+{
+  /** try each alternative in turn, each hangs off a split whose second way
+   * out leads to the next one */
+  PyObject* branches = PyTuple_Check(arg) && PyTuple_Size(arg) == 2 ?
+    PyTuple_GetItem(arg, 1) : NULL;
+  if (branches == NULL || !PySequence_Check(branches)) {
+    return false;
+  }
+  Py_ssize_t num_branches = PySequence_Size(branches);
+  if (num_branches < 1) {
+    return false;
+  }
+  result->exits.clear();
+  result->nullable = false;
+  int previous = -1;
+  for (Py_ssize_t i=0; i<num_branches; i++) {
+    PyObject* branch = PySequence_GetItem(branches, i);
+    Fragment alternative;
+    bool ok = branch != NULL && Sequence(branch, &alternative);
+    Py_XDECREF(branch);
+    if (!ok) {
+      return false;
+    }
+    int entry = alternative.start;
+    if (i+1 < num_branches) {
+      entry = AddState(SPLIT);
+      states[entry].out = alternative.start;
+    }
+    if (previous < 0) {
+      result->start = entry;
+    } else {
+      states[previous].out1 = entry;
+    }
+    previous = entry;
+    result->exits.insert(result->exits.end(), alternative.exits.begin(),
+        alternative.exits.end());
+    result->nullable = result->nullable || alternative.nullable;
+  }
+  return true;
+}
+
+// the tags of the MATCH states in a list of NFA states
+static std::vector<int>
+Accepting(const NFA& nfa, const std::vector<int>& list)
+{
+  std::vector<int> tags;
+  for (size_t i=0; i<list.size(); i++) {
+    if (nfa.states[list[i]].kind == NFA::MATCH) {
+      tags.push_back(nfa.states[list[i]].tag);
+    }
+  }
+  return tags;
+}
+
+// drop the NFA states after a pattern's MATCH state that belong to the same
+// pattern, the backtracking matcher would never get to them
+static void
+DropAfterMatch(const NFA& nfa, std::vector<int>& list)
+{
+  std::set<int> matched;
+  size_t kept = 0;
+  for (size_t i=0; i<list.size(); i++) {
+    const NFA::State& state = nfa.states[list[i]];
+    if (matched.count(state.tag)) {
+      continue;
+    }
+    if (state.kind == NFA::MATCH) {
+      matched.insert(state.tag);
+    }
+    list[kept++] = list[i];
+  }
+  list.resize(kept);
+}
+
+void
+DFA::Closure(const NFA& nfa, 
+             int state, 
+             std::vector<int>& list, 
+             std::vector<bool>& seen)
+{
+  /** add the states reachable from @state without consuming characters to
+   * @list, in the order the backtracking matcher would try them */
+  if (seen[state]) {
+    return;
+  }
+  seen[state] = true;
+  const NFA::State& s = nfa.states[state];
+  if (s.kind == NFA::SPLIT) {
+    Closure(nfa, s.out, list, seen);
+    Closure(nfa, s.out1, list, seen);
+  } else if (s.kind == NFA::EMPTY) {
+    Closure(nfa, s.out, list, seen);
+  } else {
+    list.push_back(state);
+  }
+}
+
+uint32_t
+DFA::ClassEnd(size_t i) const
+{
+  return i+1 < classes.size() ? classes[i+1] - 1 : MAX_CHAR;
+}
+
+bool
+DFA::Build(const NFA& nfa, 
+           bool unanchored, 
+           bool longest, 
+           size_t max_states)
+{
+  // split the characters into classes that each NFA state either matches
+  // all of or none of
+  std::set<uint32_t> boundaries;
+  boundaries.insert(0);
+  for (size_t s=0; s<nfa.states.size(); s++) {
+    const CharRanges& chars = nfa.states[s].chars;
+    for (CharRanges::const_iterator i = chars.begin(); i != chars.end(); ++i) {
+      boundaries.insert(i->first);
+      if (i->second < MAX_CHAR) {
+        boundaries.insert(i->second + 1);
+      }
+    }
+  }
+  classes.assign(boundaries.begin(), boundaries.end());
+  size_t num_classes = classes.size();
+
+  std::vector<std::vector<bool> > consumes(nfa.states.size());
+  for (size_t s=0; s<nfa.states.size(); s++) {
+    if (nfa.states[s].kind == NFA::CHARS) {
+      consumes[s].resize(num_classes);
+      for (size_t c=0; c<num_classes; c++) {
+        consumes[s][c] = InRanges(nfa.states[s].chars, classes[c]);
+      }
+    }
+  }
+
+  // each DFA state is a list of NFA states and, when searching, whether a
+  // match has been found yet. once it has no more searches are started.
+  typedef std::pair<std::vector<int>, bool> Key;
+  std::map<Key, int> numbers;
+  std::vector<Key> keys;
+  std::vector<bool> seen(nfa.states.size());
+
+  Key initial;
+  Closure(nfa, nfa.start, initial.first, seen);
+  if (!longest) {
+    DropAfterMatch(nfa, initial.first);
+  }
+  initial.second = unanchored && !Accepting(nfa, initial.first).empty();
+  numbers[initial] = 0;
+  keys.push_back(initial);
+
+  states.clear();
+  for (size_t n=0; n<keys.size(); n++) {
+    Key key = keys[n];
+    State state;
+    state.accepting = Accepting(nfa, key.first);
+    state.next.resize(num_classes, -1);
+
+    for (size_t c=0; c<num_classes; c++) {
+      Key next;
+      seen.assign(seen.size(), false);
+      for (size_t i=0; i<key.first.size(); i++) {
+        int s = key.first[i];
+        if (nfa.states[s].kind == NFA::CHARS && consumes[s][c]) {
+          Closure(nfa, nfa.states[s].out, next.first, seen);
+        }
+      }
+      if (unanchored && !key.second) {
+        // a match starting at the next offset is tried after all of the
+        // ones that started earlier
+        Closure(nfa, nfa.start, next.first, seen);
+      }
+      if (!longest) {
+        DropAfterMatch(nfa, next.first);
+      }
+      if (next.first.empty()) {
+        // nothing can match any more
+        continue;
+      }
+      next.second = unanchored && 
+        (key.second || !Accepting(nfa, next.first).empty());
+
+      std::map<Key, int>::iterator found = numbers.find(next);
+      if (found != numbers.end()) {
+        state.next[c] = found->second;
+      } else if (keys.size() < max_states) {
+        state.next[c] = numbers[next] = keys.size();
+        keys.push_back(next);
+      } else {
+        return false;
+      }
+    }
+    states.push_back(state);
+  }
+  return true;
+}
+
+void
+RegularExpression::CompileDFA(PyObject* seq)
+{
+  /** a pattern without group references or assertions can be matched by
+   * deterministic automata in time linear in the length of the string, no
+   * matter how much the backtracking matcher would backtrack. compile one
+   * that matches at an offset, one that finds the end of the first match
+   * after an offset, and one that reads backwards from the end of that
+   * match to find its start. the automata only find the span though: the
+   * groups of a pattern that has any are filled in by running the
+   * backtracking matcher from the start of the span, so only group-free
+   * patterns are guaranteed to match in linear time. */
+  NFA forward, backward;
+  DFA match_dfa, search_dfa, reverse_dfa;
+  if (forward.Build(seq, flags, false) &&
+      backward.Build(seq, flags, true) &&
+      match_dfa.Build(forward, false, false, DFA_MAX_STATES) &&
+      search_dfa.Build(forward, true, false, DFA_MAX_STATES) &&
+      reverse_dfa.Build(backward, false, true, DFA_MAX_STATES)) {
+    dfa_match_fp = (MatchFunction) ee->getPointerToFunction(
+        EmitDFA(match_dfa, "dfa_match", false));
+    dfa_search_fp = (MatchFunction) ee->getPointerToFunction(
+        EmitDFA(search_dfa, "dfa_search", false));
+    dfa_reverse_fp = (MatchFunction) ee->getPointerToFunction(
+        EmitDFA(reverse_dfa, "dfa_reverse", true));
+  }
+
+  // patterns that can't be matched this way are left to backtracking
+  PyErr_Clear();
+}
+
+Function*
+RegularExpression::EmitDFA(const DFA& dfa, 
+                           const char* name, 
+                           bool reverse,
+                           bool tagged)
+{
+  /** compile @dfa to a function with a block for each state that switches
+   * on the next character. the function returns the offset at the last
+   * accepting state it passes through, or -1. a @reverse automaton reads
+   * backwards from the offset down to the end offset. if @tagged, the 
+   * offset is also stored in the groups argument at the index of each
+   * pattern that matches. */
+  Function* function = createFunction(name, false);
+  Function::arg_iterator func_args = function->arg_begin();
+  Value* string = func_args++;
+  string->setName("string");
+  Value* offset = func_args++;
+  offset->setName("offset");
+  Value* end_offset = func_args++;
+  end_offset->setName("end_offset");
+  Value* ends = func_args++;
+  ends->setName("ends");
+
+  // create basic blocks
+  BasicBlock* entry = BasicBlock::Create(*context, "entry", function);
+  BasicBlock* done = BasicBlock::Create(*context, "done", function);
+  std::vector<BasicBlock*> blocks;
+  for (size_t i=0; i<dfa.states.size(); i++) {
+    blocks.push_back(BasicBlock::Create(*context, "state", function));
+  }
+
+  // create the entry BasicBlock
+  Value* offset_ptr = new AllocaInst(REM->offsetType, "offset_ptr", entry);
+  new StoreInst(offset, offset_ptr, entry);
+  Value* last_ptr = new AllocaInst(REM->offsetType, "last_ptr", entry);
+  new StoreInst(REM->not_found, last_ptr, entry);
+  BranchInst::Create(blocks[0], entry);
+
+  // create the done BasicBlock
+  ReturnInst::Create(*context, new LoadInst(last_ptr, "last", done), done);
+
+  for (size_t i=0; i<dfa.states.size(); i++) {
+    const DFA::State& state = dfa.states[i];
+    BasicBlock* block = blocks[i];
+    BasicBlock* read = BasicBlock::Create(*context, "read", function);
+
+    // remember where the last match was, and stop at the end of the string
+    offset = new LoadInst(offset_ptr, "offset", block);
+    if (!state.accepting.empty()) {
+      new StoreInst(offset, last_ptr, block);
+    }
+    for (size_t j=0; tagged && j<state.accepting.size(); j++) {
+      Value* end_ptr = GetElementPtrInst::Create(ends,
+          ConstantInt::get(REM->offsetType, state.accepting[j]), "end_ptr",
+          block);
+      new StoreInst(offset, end_ptr, block);
+    }
+    Value* ended = new ICmpInst(*block, 
+        reverse ? ICmpInst::ICMP_ULE : ICmpInst::ICMP_UGE, offset, 
+        end_offset, "ended");
+    BranchInst::Create(done, read, ended, block);
+
+    // read the next character
+    if (reverse) {
+      offset = BinaryOperator::CreateSub(offset,
+          ConstantInt::get(REM->offsetType, 1), "offset", read);
+    }
+    Value* c_ptr = GetElementPtrInst::Create(string, offset, "c_ptr", read);
+    Value* c = new LoadInst(c_ptr, "c", read);
+    if (!reverse) {
+      offset = BinaryOperator::CreateAdd(offset,
+          ConstantInt::get(REM->offsetType, 1), "offset", read);
+    }
+    new StoreInst(offset, offset_ptr, read);
+
+    // the next state that the most characters lead to is the default
+    std::map<int, uint64_t> coverage;
+    for (size_t k=0; k<dfa.classes.size(); k++) {
+      coverage[state.next[k]] += (uint64_t)dfa.ClassEnd(k) - dfa.classes[k] + 1;
+    }
+    int default_next = coverage.begin()->first;
+    for (std::map<int, uint64_t>::iterator j = coverage.begin(); 
+        j != coverage.end(); ++j) {
+      if (j->second > coverage[default_next]) {
+        default_next = j->first;
+      }
+    }
+
+    // test for the big classes with range comparisons, then switch on the
+    // characters of the small ones
+    std::vector<size_t> cases;
+    size_t num_cases = 0;
+    for (size_t k=0; k<dfa.classes.size(); k++) {
+      int next = state.next[k];
+      if (next == default_next) {
+        continue;
+      }
+      uint32_t from = dfa.classes[k];
+      uint32_t to = dfa.ClassEnd(k);
+      if (to - from < 16) {
+        cases.push_back(k);
+        num_cases += to - from + 1;
+        continue;
+      }
+      BasicBlock* more_tests = BasicBlock::Create(*context, "more_tests", 
+          function);
+      Value* is_ge = new ICmpInst(*read, ICmpInst::ICMP_UGE, c,
+          ConstantInt::get(REM->charType, from), "is_ge");
+      Value* is_le = new ICmpInst(*read, ICmpInst::ICMP_ULE, c,
+          ConstantInt::get(REM->charType, to), "is_le");
+      Value* in_class = BinaryOperator::CreateAnd(is_ge, is_le, "in_class", 
+          read);
+      BranchInst::Create(next < 0 ? done : blocks[next], more_tests, 
+          in_class, read);
+      read = more_tests;
+    }
+    SwitchInst* switch_ = SwitchInst::Create(c, 
+        default_next < 0 ? done : blocks[default_next], num_cases, read);
+    for (size_t j=0; j<cases.size(); j++) {
+      size_t k = cases[j];
+      int next = state.next[k];
+      for (uint32_t n=0; n<=dfa.ClassEnd(k) - dfa.classes[k]; n++) {
+        switch_->addCase(ConstantInt::get(REM->charType, dfa.classes[k] + n),
+            next < 0 ? done : blocks[next]);
+      }
+    }
+  }
+
+  REM->optimize(function);
+  return function;
+}
+
+bool
+RegularExpression::ExecuteDFA(Py_UNICODE* characters,
+                              ReOffset pos,
+                              ReOffset end,
+                              bool search,
+                              ReOffset* groups_array,
+                              ReOffset* start,
+                              ReOffset* result)
+{
+  /** find the span of a match with the automata, then fill in the groups
+   * by running the backtracking matcher from its start. returns false if
+   * the backtracking matcher doesn't find the same span, then the caller
+   * should use the backtracking matcher for the whole thing. */
+  if (!search) {
+    *start = pos;
+    *result = (dfa_match_fp)(characters, pos, end, NULL);
+  } else {
+    // a match can't start before the first candidate offset
+    if (!prefix.empty() || has_first_set) {
+      pos = NextCandidate(characters, pos, end);
+    }
+    *result = pos < 0 ? -1 : (dfa_search_fp)(characters, pos, end, NULL);
+    if (*result >= 0) {
+      *start = (dfa_reverse_fp)(characters, *result, pos, NULL);
+    }
+  }
+
+  if (*result < 0 || groups == 0 ||
+      (match_fp)(characters, *start, end, groups_array) == *result) {
+    return true;
+  }
+  for (int i=0; i<groups*2 + 1; i++) {
+    groups_array[i] = -1;
+  }
+  return false;
+}
+
+bool
+RegularExpression::CompileSet(PyObject* seqs, const std::vector<int>& flags)
+{
+  /** compile an automaton that matches all of the patterns in @seqs at
+   * once, keeping track of which of them have matched. only patterns that
+   * CompileDFA could compile can be put together. */
+  NFA nfa;
+  DFA dfa;
+  bool compiled = nfa.BuildSet(seqs, flags) &&
+    dfa.Build(nfa, false, false, DFA_SET_MAX_STATES);
+  if (compiled) {
+    PyGlobalLlvmData::ScopedLock lock(global_data);
+    dfa_match_fp = (MatchFunction) ee->getPointerToFunction(
+        EmitDFA(dfa, "dfa_set", false, true));
+  }
+  PyErr_Clear();
+  return compiled;
+}
+
+void
+RegularExpression::ExecuteSet(Py_UNICODE* characters,
+                              int pos,
+                              int end,
+                              ReOffset* ends,
+                              int size)
+{
+  for (int i=0; i<size; i++) {
+    ends[i] = -1;
+  }
+  (dfa_match_fp)(characters, pos, end, ends);
+}
+
+
+CompiledExpression::CompiledExpression(RegularExpression& re, bool first) 
+  : re(re), first(first) {
+}
+
+CompiledExpression::~CompiledExpression() {
+}
+
+
+LLVMContext& 
+CompiledExpression::context() 
+{
+  return *re.context;
+}
+
+Value* 
+CompiledExpression::loadOffset(BasicBlock* block) {
+  return new LoadInst(offset_ptr, "offset", block);
+}
+
+void
+CompiledExpression::storeOffset(BasicBlock* block, Value* value) {
+  new StoreInst(value, offset_ptr, block);
+}
+
+BasicBlock* 
+CompiledExpression::loadCharacter(BasicBlock* block) {
+  // get the current offset
+  Value* offset = loadOffset(block);
+  // make sure it's not past the end of the string
+  Value* ended = new ICmpInst(*block, ICmpInst::ICMP_UGE, offset, end_offset, 
+      "ended");
+  // if it's ended, return REM->not_found, otherwise, continue
+  // I'm scared this will fuck things up
+  BasicBlock* new_block = createBlock();
+  BranchInst::Create(return_not_found, new_block, ended, block);
+
+  block = new_block;
+
+  // load the character at the right offset
+  Value* c_ptr = GetElementPtrInst::Create(string, offset, "c_ptr", block);
+  character = new LoadInst(c_ptr, "c", block);
+  // increment the offset
+  offset = BinaryOperator::CreateAdd(offset,
+      ConstantInt::get(REM->offsetType, 1), "increment", block);
+  storeOffset(block, offset);
+  return block;
+}
+
+Value*
+CompiledExpression::lowerCharacter(BasicBlock* block, Value* c)
+{
+  /** in @block, compute what LowerChar() would return for @c */
+  Value* lowered;
+  if (re.flags & SRE_FLAG_LOCALE) {
+    lowered = callGlobalFunction<int,int,false,false>(
+        "_PyLlvm_LOCALE_TOLOWER", c, block);
+  } else if (re.flags & SRE_FLAG_UNICODE) {
+    lowered = callGlobalFunction<int,Py_UNICODE,false,false>(
+        "_PyLlvm_UNICODE_TOLOWER", c, block);
+  } else {
+    // 'A' <= c <= 'Z' as a single unsigned comparison
+    Value* letter = BinaryOperator::CreateSub(c,
+        ConstantInt::get(REM->charType, 'A'), "letter", block);
+    Value* is_upper = new ICmpInst(*block, ICmpInst::ICMP_ULE, letter,
+        ConstantInt::get(REM->charType, 'Z' - 'A'), "is_upper");
+    Value* lower = BinaryOperator::CreateAdd(c,
+        ConstantInt::get(REM->charType, 'a' - 'A'), "lower", block);
+    return SelectInst::Create(is_upper, lower, c, "lowered", block);
+  }
+  if (lowered->getType() != REM->charType) {
+    lowered = new TruncInst(lowered, REM->charType, "lowered", block);
+  }
+  return lowered;
+}
+
+template<typename R, typename A1, bool isSigned, bool toBool>
+Value* 
+CompiledExpression::callGlobalFunction(const char* name, 
+                                       Value*      a1, 
+                                       BasicBlock* block) {
+  // get the Function* for the global function
+  Function* gf = cast<Function>(
+      re.module->getOrInsertFunction(name,
+        PyTypeBuilder<R(A1)>::get(context()))
+      );
+
+  // get the llvm::Type of the argument
+  const Type* A1_type = PyTypeBuilder<A1>::get(context());
+
+  // convert the argument to the correct type using correct sign semantics
+  // or leave it if the types already match
+  Value* args[1];
+  if (A1_type == a1->getType()) {
+    args[0] = a1;
+  } else if (isSigned) {
+    args[0] = 
+      new SExtInst(a1, A1_type, "", block);
+  } else {
+    args[0] = 
+      new ZExtInst(a1, A1_type, "", block);
+  }
+  // call the function
+  Value* result = CallInst::Create(gf, args, args+1, "result", block);
+
+  if (toBool) {
+    // cast an integer result to boolean. we do this often
+    return new ICmpInst(*block, ICmpInst::ICMP_NE,
+      result, ConstantInt::get(PyTypeBuilder<R>::get(context()), 0),
+      "result_bool");
+  } else {
+    return result;
+  }
+}
+
+
+Function*
 CompiledExpression::greedy(Function* repeat, Function* after) 
 {
   // create the function
@@ -1177,6 +2498,11 @@ CompiledExpression::in(BasicBlock* block, PyObject* arg) {
   // get the next character
   block = loadCharacter(block);
 
+  // like SRE, compare the lower case of the character with the set's
+  // literals and ranges lowered the same way
+  bool ignorecase = re.flags & SRE_FLAG_IGNORECASE;
+  Value* c = ignorecase ? lowerCharacter(block, character) : character;
+
   // create a block where more tests can take place (ie: ranges, categories)
   BasicBlock* more_tests = createBlock("more_tests");
 
@@ -1184,9 +2510,12 @@ CompiledExpression::in(BasicBlock* block, PyObject* arg) {
   BasicBlock* matched = createBlock("matched");
 
   // create a switch instruction to use for all the literals
-  SwitchInst* switch_ = SwitchInst::Create(character, more_tests, 
+  SwitchInst* switch_ = SwitchInst::Create(c, more_tests, 
       PySequence_Size(arg), block);
 
+  // literals that are the same once lowered only get one switch case
+  std::set<Py_UNICODE> cases;
+
   // [^...] ?
   bool negate = false;
 
@@ -1231,8 +2560,14 @@ CompiledExpression::in(BasicBlock* block, PyObject* arg) {
       }
 
       // add a switch case
-      switch_->addCase(ConstantInt::get(REM->charType, PyInt_AsLong(op_arg)),
-          negate?return_not_found:matched);
+      Py_UNICODE literal = PyInt_AsLong(op_arg);
+      if (ignorecase) {
+        literal = LowerChar(literal, re.flags);
+      }
+      if (cases.insert(literal).second) {
+        switch_->addCase(ConstantInt::get(REM->charType, literal),
+            negate?return_not_found:matched);
+      }
     } else if (!strcmp(op_str, "range")) {
       // parse the start and end of the range
       int from, to;
@@ -1241,8 +2576,12 @@ CompiledExpression::in(BasicBlock* block, PyObject* arg) {
         Py_XDECREF(item);
         return NULL;
       }
+      if (ignorecase) {
+        from = LowerChar(from, re.flags);
+        to = LowerChar(to, re.flags);
+      }
       BasicBlock* yet_more_tests = createBlock("more_tests");
-      testRange(more_tests, character, from, to, 
+      testRange(more_tests, c, from, to, 
           negate ? return_not_found : matched, yet_more_tests);
       more_tests = yet_more_tests;
     } else if (!strcmp(op_str, "category")) {
@@ -1253,7 +2592,7 @@ CompiledExpression::in(BasicBlock* block, PyObject* arg) {
       }
       const char* category_name = PyString_AsString(op_arg);
       BasicBlock* yet_more_tests = createBlock("more_tests");
-      if (!testCategory(more_tests, character, category_name, 
+      if (!testCategory(more_tests, c, category_name, 
             negate?return_not_found:matched, yet_more_tests)) {
         Py_XDECREF(item);
         return false;
@@ -1927,22 +3266,592 @@ CompiledExpression::assert_(BasicBlock* block, PyObject* arg, bool assert_not) {
   Value* assert_result = CallInst::Create(compiled.function, 
       args.begin(), args.end(), "assert_result", block);
 
-  // did it fail?
-  Value* assert_not_found = new ICmpInst(*block, ICmpInst::ICMP_EQ,
-      assert_result, REM->not_found, "assert_not_found");
+  // did it fail?
+  Value* assert_not_found = new ICmpInst(*block, ICmpInst::ICMP_EQ,
+      assert_result, REM->not_found, "assert_not_found");
+
+  // create a block for continuation
+  BasicBlock* next = createBlock("block");
+  if (assert_not) {
+    BranchInst::Create(next, return_not_found, assert_not_found, block);
+  } else {
+    BranchInst::Create(return_not_found, next, assert_not_found, block);
+  }
+
+  return next;
+}
+
+#ifndef TESTER
+
+// get @string as unicode for the compiled code to run on
+static PyObject*
+as_unicode(PyObject* string)
+{
+  if (PyUnicode_Check(string)) {
+    Py_INCREF(string);
+    return string;
+  } else if (PyString_Check(string)) {
+    // byte strings have one character per byte
+    return PyUnicode_DecodeLatin1(PyString_AS_STRING(string),
+        PyString_GET_SIZE(string), NULL);
+  }
+  // like SRE, treat anything else with a buffer as bytes
+  const void* buffer;
+  Py_ssize_t length;
+  if (PyObject_AsReadBuffer(string, &buffer, &length) < 0) {
+    PyErr_SetString(PyExc_TypeError, "expected string or buffer");
+    return NULL;
+  }
+  return PyUnicode_DecodeLatin1((const char*)buffer, length, NULL);
+}
+
+// clamp @pos and @endpos to the bounds of a string of @length characters
+static void
+adjust_bounds(Py_ssize_t length, Py_ssize_t* pos, Py_ssize_t* endpos)
+{
+  if (*pos < 0) {
+    *pos = 0;
+  } else if (*pos > length) {
+    *pos = length;
+  }
+  if (*endpos < 0) {
+    *endpos = 0;
+  } else if (*endpos > length) {
+    *endpos = length;
+  }
+}
+
+// join the pieces in @list using an empty string of @string's type
+static PyObject*
+join_list(PyObject* list, PyObject* string)
+{
+  PyObject* separator = PySequence_GetSlice(string, 0, 0);
+  if (separator == NULL) {
+    return NULL;
+  }
+  PyObject* result = PyObject_CallMethod(separator, (char*)"join",
+      (char*)"O", list);
+  Py_DECREF(separator);
+  return result;
+}
+
+// raise sre_constants.error, the exception re users expect
+static void
+set_sre_error(const char* message)
+{
+  PyObject* module = PyImport_ImportModule("sre_constants");
+  if (module == NULL) {
+    return;
+  }
+  PyObject* error = PyObject_GetAttrString(module, "error");
+  Py_DECREF(module);
+  if (error != NULL) {
+    PyErr_SetString(error, message);
+    Py_DECREF(error);
+  }
+}
+
+static bool
+RegEx_check(RegEx* self)
+{
+  if (self->re == NULL) {
+    PyErr_SetString(PyExc_ValueError, "RegEx has not been compiled");
+    return false;
+  }
+  return true;
+}
+
+// parse the replacement template @repl, reusing the last one parsed if it's
+// the same
+static PyObject*
+RegEx_template(RegEx* self, PyObject* repl)
+{
+  if (self->repl != NULL && Py_TYPE(self->repl) == Py_TYPE(repl)) {
+    int same = PyObject_RichCompareBool(self->repl, repl, Py_EQ);
+    if (same < 0) {
+      return NULL;
+    } else if (same) {
+      Py_INCREF(self->parsed_repl);
+      return self->parsed_repl;
+    }
+  }
+
+  // sre_parse.parse_template knows the template syntax, it only needs
+  // the groupindex of the pattern
+  PyObject* sre_parse = PyImport_ImportModule("sre_parse");
+  if (sre_parse == NULL) {
+    return NULL;
+  }
+  PyObject* parsed = PyObject_CallMethod(sre_parse, (char*)"parse_template",
+      (char*)"OO", repl, self);
+  Py_DECREF(sre_parse);
+  if (parsed == NULL) {
+    return NULL;
+  }
+  // it returns a tuple: ([(index, group), ...], [literal or None, ...])
+  if (!PyTuple_Check(parsed) || PyTuple_GET_SIZE(parsed) != 2 ||
+      !PyList_Check(PyTuple_GET_ITEM(parsed, 0)) ||
+      !PyList_Check(PyTuple_GET_ITEM(parsed, 1))) {
+    _PyErr_SetString(PyExc_TypeError, "Unexpected template");
+    Py_DECREF(parsed);
+    return NULL;
+  }
+
+  Py_XDECREF(self->repl);
+  Py_XDECREF(self->parsed_repl);
+  Py_INCREF(repl);
+  self->repl = repl;
+  Py_INCREF(parsed);
+  self->parsed_repl = parsed;
+  return parsed;
+}
+
+static PyObject*
+Match_getslice(MatchObject* self, Py_ssize_t index, PyObject* def)
+{
+  ReOffset start = self->regs[index*2];
+  ReOffset end = self->regs[index*2 + 1];
+  if (start < 0 || end < 0) {
+    // the group didn't participate in the match
+    Py_INCREF(def);
+    return def;
+  }
+  return PySequence_GetSlice(self->string, start, end);
+}
+
+// expand a parsed template, returning a string of @self->string's type
+static PyObject*
+Match_expand_parsed(MatchObject* self, PyObject* parsed)
+{
+  PyObject* groups = PyTuple_GET_ITEM(parsed, 0);
+  // copy the literals, the group references get filled in
+  PyObject* literals = PyList_GetSlice(PyTuple_GET_ITEM(parsed, 1), 0,
+      PY_SSIZE_T_MAX);
+  if (literals == NULL) {
+    return NULL;
+  }
+
+  for (Py_ssize_t i=0; i<PyList_GET_SIZE(groups); i++) {
+    Py_ssize_t index, group;
+    if (!PyArg_ParseTuple(PyList_GET_ITEM(groups, i), "nn", &index, &group)) {
+      Py_DECREF(literals);
+      return NULL;
+    }
+    if (group < 0 || group > self->groups ||
+        index < 0 || index >= PyList_GET_SIZE(literals)) {
+      set_sre_error("invalid group reference");
+      Py_DECREF(literals);
+      return NULL;
+    }
+    PyObject* item = Match_getslice(self, group, Py_None);
+    if (item == Py_None) {
+      Py_DECREF(item);
+      set_sre_error("unmatched group");
+    }
+    if (item == Py_None || item == NULL) {
+      Py_DECREF(literals);
+      return NULL;
+    }
+    PyList_SetItem(literals, index, item);
+  }
+
+  PyObject* result = join_list(literals, self->string);
+  Py_DECREF(literals);
+  return result;
+}
+
+static void
+Match_dealloc(MatchObject* self)
+{
+  Py_XDECREF(self->regex);
+  Py_XDECREF(self->string);
+  PyObject_Del(self);
+}
+
+// get the number of the group named or numbered @group, or -1 on error
+static Py_ssize_t
+Match_getindex(MatchObject* self, PyObject* group)
+{
+  Py_ssize_t index = -1;
+  if (PyInt_Check(group) || PyLong_Check(group)) {
+    index = PyInt_AsSsize_t(group);
+  } else if (self->regex->groupindex != NULL) {
+    PyObject* number = PyDict_GetItem(self->regex->groupindex, group);
+    if (number != NULL && (PyInt_Check(number) || PyLong_Check(number))) {
+      index = PyInt_AsSsize_t(number);
+    }
+  }
+  if (index < 0 || index > self->groups) {
+    PyErr_Clear();
+    PyErr_SetString(PyExc_IndexError, "no such group");
+    return -1;
+  }
+  return index;
+}
+
+static PyObject*
+Match_group(MatchObject* self, PyObject* args)
+{
+  Py_ssize_t size = PyTuple_GET_SIZE(args);
+  if (size == 0) {
+    return Match_getslice(self, 0, Py_None);
+  } else if (size == 1) {
+    Py_ssize_t index = Match_getindex(self, PyTuple_GET_ITEM(args, 0));
+    return index < 0 ? NULL : Match_getslice(self, index, Py_None);
+  }
+
+  PyObject* result = PyTuple_New(size);
+  if (result == NULL) {
+    return NULL;
+  }
+  for (Py_ssize_t i=0; i<size; i++) {
+    Py_ssize_t index = Match_getindex(self, PyTuple_GET_ITEM(args, i));
+    PyObject* item = index < 0 ? NULL : Match_getslice(self, index, Py_None);
+    if (item == NULL) {
+      Py_DECREF(result);
+      return NULL;
+    }
+    PyTuple_SET_ITEM(result, i, item);
+  }
+  return result;
+}
+
+static PyObject*
+Match_groups(MatchObject* self, PyObject* args, PyObject* kwds)
+{
+  PyObject* def = Py_None;
+  static const char *kwlist[] = {"default", NULL};
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", (char**)kwlist, &def)) {
+    return NULL;
+  }
+
+  PyObject* result = PyTuple_New(self->groups);
+  if (result == NULL) {
+    return NULL;
+  }
+  for (Py_ssize_t i=0; i<self->groups; i++) {
+    PyObject* item = Match_getslice(self, i+1, def);
+    if (item == NULL) {
+      Py_DECREF(result);
+      return NULL;
+    }
+    PyTuple_SET_ITEM(result, i, item);
+  }
+  return result;
+}
+
+static PyObject*
+Match_groupdict(MatchObject* self, PyObject* args, PyObject* kwds)
+{
+  PyObject* def = Py_None;
+  static const char *kwlist[] = {"default", NULL};
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "|O", (char**)kwlist, &def)) {
+    return NULL;
+  }
+
+  PyObject* result = PyDict_New();
+  if (result == NULL || self->regex->groupindex == NULL) {
+    return result;
+  }
+  PyObject *name, *number;
+  Py_ssize_t pos = 0;
+  while (PyDict_Next(self->regex->groupindex, &pos, &name, &number)) {
+    Py_ssize_t index = Match_getindex(self, number);
+    PyObject* item = index < 0 ? NULL : Match_getslice(self, index, def);
+    if (item == NULL || PyDict_SetItem(result, name, item) < 0) {
+      Py_XDECREF(item);
+      Py_DECREF(result);
+      return NULL;
+    }
+    Py_DECREF(item);
+  }
+  return result;
+}
+
+// parse the optional group argument to start(), end() and span()
+static Py_ssize_t
+Match_getindex_arg(MatchObject* self, PyObject* args)
+{
+  PyObject* group = NULL;
+  if (!PyArg_UnpackTuple(args, "group", 0, 1, &group)) {
+    return -1;
+  }
+  return group == NULL ? 0 : Match_getindex(self, group);
+}
+
+static PyObject*
+Match_start(MatchObject* self, PyObject* args)
+{
+  Py_ssize_t index = Match_getindex_arg(self, args);
+  return index < 0 ? NULL : PyInt_FromLong(self->regs[index*2]);
+}
+
+static PyObject*
+Match_end(MatchObject* self, PyObject* args)
+{
+  Py_ssize_t index = Match_getindex_arg(self, args);
+  return index < 0 ? NULL : PyInt_FromLong(self->regs[index*2 + 1]);
+}
+
+static PyObject*
+Match_span(MatchObject* self, PyObject* args)
+{
+  Py_ssize_t index = Match_getindex_arg(self, args);
+  if (index < 0) {
+    return NULL;
+  }
+  return Py_BuildValue("ii", self->regs[index*2], self->regs[index*2 + 1]);
+}
+
+static PyObject*
+Match_expand(MatchObject* self, PyObject* template_)
+{
+  PyObject* parsed = RegEx_template(self->regex, template_);
+  if (parsed == NULL) {
+    return NULL;
+  }
+  PyObject* result = Match_expand_parsed(self, parsed);
+  Py_DECREF(parsed);
+  return result;
+}
+
+static PyObject*
+Match_get_lastindex(MatchObject* self, void* closure)
+{
+  ReOffset lastindex = self->regs[self->groups*2 + 2];
+  if (lastindex < 0) {
+    Py_RETURN_NONE;
+  }
+  return PyInt_FromLong(lastindex);
+}
+
+static PyObject*
+Match_get_lastgroup(MatchObject* self, void* closure)
+{
+  ReOffset lastindex = self->regs[self->groups*2 + 2];
+  if (lastindex >= 0 && self->regex->groupindex != NULL) {
+    PyObject *name, *number;
+    Py_ssize_t pos = 0;
+    while (PyDict_Next(self->regex->groupindex, &pos, &name, &number)) {
+      if (PyInt_Check(number) && PyInt_AS_LONG(number) == lastindex) {
+        Py_INCREF(name);
+        return name;
+      }
+    }
+  }
+  Py_RETURN_NONE;
+}
+
+static PyObject*
+Match_get_regs(MatchObject* self, void* closure)
+{
+  PyObject* regs = PyTuple_New(self->groups + 1);
+  if (regs == NULL) {
+    return NULL;
+  }
+  for (Py_ssize_t i=0; i<=self->groups; i++) {
+    PyObject* item = Py_BuildValue("ii", self->regs[i*2], self->regs[i*2 + 1]);
+    if (item == NULL) {
+      Py_DECREF(regs);
+      return NULL;
+    }
+    PyTuple_SET_ITEM(regs, i, item);
+  }
+  return regs;
+}
+
+static PyMethodDef Match_methods[] = {
+  {"group", (PyCFunction)Match_group, METH_VARARGS,
+   "Return one or more subgroups of the match", },
+  {"groups", (PyCFunction)Match_groups, METH_VARARGS|METH_KEYWORDS,
+   "Return a tuple of all the subgroups of the match", },
+  {"groupdict", (PyCFunction)Match_groupdict, METH_VARARGS|METH_KEYWORDS,
+   "Return a dictionary of all the named subgroups of the match", },
+  {"start", (PyCFunction)Match_start, METH_VARARGS,
+   "Return the start of a group in the match", },
+  {"end", (PyCFunction)Match_end, METH_VARARGS,
+   "Return the end of a group in the match", },
+  {"span", (PyCFunction)Match_span, METH_VARARGS,
+   "Return the start and end of a group in the match", },
+  {"expand", (PyCFunction)Match_expand, METH_O,
+   "Substitute the groups of the match into a template", },
+  {NULL}  /* Sentinel */
+};
+
+static PyMemberDef Match_members[] = {
+  {(char*)"string", T_OBJECT, offsetof(MatchObject, string), READONLY},
+  {(char*)"re", T_OBJECT, offsetof(MatchObject, regex), READONLY},
+  {(char*)"pos", T_PYSSIZET, offsetof(MatchObject, pos), READONLY},
+  {(char*)"endpos", T_PYSSIZET, offsetof(MatchObject, endpos), READONLY},
+  {NULL}  /* Sentinel */
+};
+
+static PyGetSetDef Match_getset[] = {
+  {(char*)"lastindex", (getter)Match_get_lastindex, NULL,
+   (char*)"The number of the last group that matched"},
+  {(char*)"lastgroup", (getter)Match_get_lastgroup, NULL,
+   (char*)"The name of the last group that matched"},
+  {(char*)"regs", (getter)Match_get_regs, NULL,
+   (char*)"The spans of the match and of each group"},
+  {NULL}  /* Sentinel */
+};
+
+static PyTypeObject MatchType = {
+  PyObject_HEAD_INIT(NULL)
+  0,                         /*ob_size*/
+  "llvmre.Match",            /*tp_name*/
+  sizeof(MatchObject) - sizeof(ReOffset), /*tp_basicsize*/
+  sizeof(ReOffset),          /*tp_itemsize*/
+  (destructor)Match_dealloc, /*tp_dealloc*/
+  0,                         /*tp_print*/
+  0,                         /*tp_getattr*/
+  0,                         /*tp_setattr*/
+  0,                         /*tp_compare*/
+  0,                         /*tp_repr*/
+  0,                         /*tp_as_number*/
+  0,                         /*tp_as_sequence*/
+  0,                         /*tp_as_mapping*/
+  0,                         /*tp_hash */
+  0,                         /*tp_call*/
+  0,                         /*tp_str*/
+  0,                         /*tp_getattro*/
+  0,                         /*tp_setattro*/
+  0,                         /*tp_as_buffer*/
+  Py_TPFLAGS_DEFAULT,        /*tp_flags*/
+  "Match objects",           /* tp_doc */
+  0,                         /* tp_traverse */
+  0,                         /* tp_clear */
+  0,                         /* tp_richcompare */
+  0,                         /* tp_weaklistoffset */
+  0,                         /* tp_iter */
+  0,                         /* tp_iternext */
+  Match_methods,             /* tp_methods */
+  Match_members,             /* tp_members */
+  Match_getset,              /* tp_getset */
+};
+
+// match @self against @ustring, returning a match object for @string, None
+// if there's no match or NULL on error
+static PyObject*
+RegEx_execute(RegEx* self,
+              PyObject* string,
+              PyObject* ustring,
+              Py_ssize_t pos,
+              Py_ssize_t endpos,
+              bool search)
+{
+  if (pos > endpos) {
+    Py_RETURN_NONE;
+  }
+
+  int groups = self->re->groups;
+  MatchObject* match = PyObject_NewVar(MatchObject, &MatchType,
+      groups*2 + 3);
+  if (match == NULL) {
+    return NULL;
+  }
+
+  if (!self->re->Execute(PyUnicode_AS_UNICODE(ustring), pos, endpos, search,
+        match->regs)) {
+    PyObject_Del(match);
+    Py_RETURN_NONE;
+  }
+
+  Py_INCREF(self);
+  match->regex = self;
+  Py_INCREF(string);
+  match->string = string;
+  match->pos = pos;
+  match->endpos = endpos;
+  match->groups = groups;
+  return (PyObject*)match;
+}
 
-  // create a block for continuation
-  BasicBlock* next = createBlock("block");
-  if (assert_not) {
-    BranchInst::Create(next, return_not_found, assert_not_found, block);
+static void
+Scanner_dealloc(ScannerObject* self)
+{
+  Py_XDECREF(self->regex);
+  Py_XDECREF(self->string);
+  Py_XDECREF(self->ustring);
+  PyObject_Del(self);
+}
+
+static PyObject*
+Scanner_next(ScannerObject* self, bool search)
+{
+  PyObject* match = RegEx_execute(self->regex, self->string, self->ustring,
+      self->pos, self->endpos, search);
+  if (match == NULL) {
+    return NULL;
+  } else if (match == Py_None) {
+    // a search found nothing more, a match moves on a character
+    self->pos = search ? self->endpos + 1 : self->pos + 1;
   } else {
-    BranchInst::Create(return_not_found, next, assert_not_found, block);
+    ReOffset start = ((MatchObject*)match)->regs[0];
+    ReOffset end = ((MatchObject*)match)->regs[1];
+    // don't find an empty match again
+    self->pos = start == end ? end + 1 : end;
   }
+  return match;
+}
 
-  return next;
+static PyObject*
+Scanner_match(ScannerObject* self)
+{
+  return Scanner_next(self, false);
 }
 
-#ifndef TESTER
+static PyObject*
+Scanner_search(ScannerObject* self)
+{
+  return Scanner_next(self, true);
+}
+
+static PyMethodDef Scanner_methods[] = {
+  {"match", (PyCFunction)Scanner_match, METH_NOARGS,
+   "Match the pattern at the current position", },
+  {"search", (PyCFunction)Scanner_search, METH_NOARGS,
+   "Find the next match of the pattern", },
+  {NULL}  /* Sentinel */
+};
+
+static PyMemberDef Scanner_members[] = {
+  {(char*)"pattern", T_OBJECT, offsetof(ScannerObject, regex), READONLY},
+  {NULL}  /* Sentinel */
+};
+
+static PyTypeObject ScannerType = {
+  PyObject_HEAD_INIT(NULL)
+  0,                         /*ob_size*/
+  "llvmre.Scanner",          /*tp_name*/
+  sizeof(ScannerObject),     /*tp_basicsize*/
+  0,                         /*tp_itemsize*/
+  (destructor)Scanner_dealloc, /*tp_dealloc*/
+  0,                         /*tp_print*/
+  0,                         /*tp_getattr*/
+  0,                         /*tp_setattr*/
+  0,                         /*tp_compare*/
+  0,                         /*tp_repr*/
+  0,                         /*tp_as_number*/
+  0,                         /*tp_as_sequence*/
+  0,                         /*tp_as_mapping*/
+  0,                         /*tp_hash */
+  0,                         /*tp_call*/
+  0,                         /*tp_str*/
+  0,                         /*tp_getattro*/
+  0,                         /*tp_setattro*/
+  0,                         /*tp_as_buffer*/
+  Py_TPFLAGS_DEFAULT,        /*tp_flags*/
+  "Scanner objects",         /* tp_doc */
+  0,                         /* tp_traverse */
+  0,                         /* tp_clear */
+  0,                         /* tp_richcompare */
+  0,                         /* tp_weaklistoffset */
+  0,                         /* tp_iter */
+  0,                         /* tp_iternext */
+  Scanner_methods,           /* tp_methods */
+  Scanner_members,           /* tp_members */
+};
 
 static PyObject *
 RegEx_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
@@ -1962,21 +3871,29 @@ static int
 RegEx_init(RegEx *self, PyObject *args, PyObject *kwds)
 {
   PyObject *seq=NULL;
+  PyObject *groupindex=NULL;
+  PyObject *pattern=Py_None;
   int flags, groups;
 
-  static const char *kwlist[] = {"seq", "flags", "groups", NULL};
+  static const char *kwlist[] = {"seq", "flags", "groups", "groupindex",
+    "pattern", NULL};
 
-  if (!PyArg_ParseTupleAndKeywords(args, kwds, "Oii", (char**)kwlist, 
-        &seq, &flags, &groups)) {
-    return -1; 
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "Oii|O!O", (char**)kwlist,
+        &seq, &flags, &groups, &PyDict_Type, &groupindex, &pattern)) {
+    return -1;
   }
-  
+
   // make sure we got a sequence
   if (!PySequence_Check(seq)) {
     _PyErr_SetString(PyExc_TypeError, "Expected a sequence");
     return -1;
   }
 
+  if (self->re == NULL) {
+    _PyErr_SetString(PyExc_ValueError, "RegEx can't be recompiled");
+    return -1;
+  }
+
   Py_INCREF(seq);
   if (!self->re->Compile(seq, flags, groups)) {
     delete self->re;
@@ -1986,7 +3903,19 @@ RegEx_init(RegEx *self, PyObject *args, PyObject *kwds)
   }
   Py_DECREF(seq);
 
-  return 0;
+  Py_XDECREF(self->pattern);
+  Py_INCREF(pattern);
+  self->pattern = pattern;
+
+  Py_XDECREF(self->groupindex);
+  if (groupindex != NULL) {
+    Py_INCREF(groupindex);
+    self->groupindex = groupindex;
+  } else {
+    self->groupindex = PyDict_New();
+  }
+
+  return self->groupindex != NULL ? 0 : -1;
 }
 
 static void
@@ -1995,6 +3924,11 @@ RegEx_dealloc(RegEx* self)
   if (self && self->re) {
     delete self->re;
   }
+  Py_XDECREF(self->pattern);
+  Py_XDECREF(self->groupindex);
+  Py_XDECREF(self->repl);
+  Py_XDECREF(self->parsed_repl);
+  Py_TYPE(self)->tp_free((PyObject*)self);
 }
 
 static PyObject*
@@ -2007,46 +3941,275 @@ RegEx_dump(RegEx* self) {
 }
 
 static PyObject*
-RegEx_match(RegEx* self, PyObject* args) {
-  Py_UNICODE* characters;
-  int length, pos, end;
-  if (!PyArg_ParseTuple(args, "u#ii", &characters, &length, &pos, &end)) {
+RegEx_match_or_search(RegEx* self, PyObject* args, PyObject* kwds,
+    bool search) {
+  PyObject* string;
+  Py_ssize_t pos = 0, endpos = PY_SSIZE_T_MAX;
+
+  static const char *kwlist[] = {"string", "pos", "endpos", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|nn", (char**)kwlist,
+        &string, &pos, &endpos) || !RegEx_check(self)) {
     return NULL;
   }
 
-  if (self->re) {
-    return self->re->Match(characters, length, pos, end);
-  } else {
+  PyObject* ustring = as_unicode(string);
+  if (ustring == NULL) {
     return NULL;
   }
+  adjust_bounds(PyUnicode_GET_SIZE(ustring), &pos, &endpos);
+  PyObject* result = RegEx_execute(self, string, ustring, pos, endpos,
+      search);
+  Py_DECREF(ustring);
+  return result;
+}
+
+static PyObject*
+RegEx_match(RegEx* self, PyObject* args, PyObject* kwds) {
+  return RegEx_match_or_search(self, args, kwds, false);
 }
 
+static PyObject*
+RegEx_search(RegEx* self, PyObject* args, PyObject* kwds) {
+  return RegEx_match_or_search(self, args, kwds, true);
+}
 
 static PyObject*
-RegEx_find(RegEx* self, PyObject* args) {
-  Py_UNICODE* characters;
-  int length, pos, end;
-  if (!PyArg_ParseTuple(args, "u#ii", &characters, &length, &pos, &end)) {
+RegEx_scanner(RegEx* self, PyObject* args, PyObject* kwds) {
+  PyObject* string;
+  Py_ssize_t pos = 0, endpos = PY_SSIZE_T_MAX;
+
+  static const char *kwlist[] = {"string", "pos", "endpos", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|nn", (char**)kwlist,
+        &string, &pos, &endpos) || !RegEx_check(self)) {
     return NULL;
   }
 
-  if (self->re) {
-    return self->re->Find(characters, length, pos, end);
-  } else {
+  PyObject* ustring = as_unicode(string);
+  if (ustring == NULL) {
+    return NULL;
+  }
+
+  ScannerObject* scanner = PyObject_New(ScannerObject, &ScannerType);
+  if (scanner == NULL) {
+    Py_DECREF(ustring);
+    return NULL;
+  }
+  Py_INCREF(self);
+  scanner->regex = self;
+  Py_INCREF(string);
+  scanner->string = string;
+  scanner->ustring = ustring;
+  adjust_bounds(PyUnicode_GET_SIZE(ustring), &pos, &endpos);
+  scanner->pos = pos;
+  scanner->endpos = endpos;
+  return (PyObject*)scanner;
+}
+
+static PyObject*
+RegEx_finditer(RegEx* self, PyObject* args, PyObject* kwds) {
+  PyObject* scanner = RegEx_scanner(self, args, kwds);
+  if (scanner == NULL) {
+    return NULL;
+  }
+
+  // iterate by calling scanner.search() until it returns None
+  PyObject* search = PyObject_GetAttrString(scanner, "search");
+  Py_DECREF(scanner);
+  if (search == NULL) {
+    return NULL;
+  }
+  PyObject* iterator = PyCallIter_New(search, Py_None);
+  Py_DECREF(search);
+  return iterator;
+}
+
+static PyObject*
+RegEx_subx(RegEx* self, PyObject* args, PyObject* kwds, bool subn) {
+  PyObject* repl;
+  PyObject* string;
+  Py_ssize_t count = 0;
+
+  static const char *kwlist[] = {"repl", "string", "count", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|n", (char**)kwlist,
+        &repl, &string, &count) || !RegEx_check(self)) {
+    return NULL;
+  }
+
+  // the replacement is either the result of calling @repl with each match,
+  // a template with group references or a constant
+  PyObject* parsed = NULL;
+  PyObject* literal = NULL;
+  if (!PyCallable_Check(repl)) {
+    parsed = RegEx_template(self, repl);
+    if (parsed == NULL) {
+      return NULL;
+    }
+    if (PyList_GET_SIZE(PyTuple_GET_ITEM(parsed, 0)) == 0) {
+      literal = join_list(PyTuple_GET_ITEM(parsed, 1), repl);
+      if (literal == NULL) {
+        Py_DECREF(parsed);
+        return NULL;
+      }
+    }
+  }
+
+  PyObject* result = NULL;
+  PyObject* list = NULL;
+  PyObject* ustring = as_unicode(string);
+  if (ustring != NULL) {
+    list = PyList_New(0);
+  }
+  if (list == NULL) {
+    goto done;
+  }
+
+  {
+    Py_ssize_t length = PyUnicode_GET_SIZE(ustring);
+    Py_ssize_t pos = 0;  // where to search from
+    Py_ssize_t last = 0; // the end of the last replaced match
+    Py_ssize_t n = 0;    // the number of replacements made
+    while (!count || n < count) {
+      PyObject* match = RegEx_execute(self, string, ustring, pos, length,
+          true);
+      if (match == NULL) {
+        goto done;
+      } else if (match == Py_None) {
+        Py_DECREF(match);
+        break;
+      }
+      Py_ssize_t start = ((MatchObject*)match)->regs[0];
+      Py_ssize_t end = ((MatchObject*)match)->regs[1];
+
+      PyObject* item = NULL;
+      if (last < start) {
+        // the text before the match
+        item = PySequence_GetSlice(string, last, start);
+        if (item == NULL || PyList_Append(list, item) < 0) {
+          Py_XDECREF(item);
+          Py_DECREF(match);
+          goto done;
+        }
+        Py_DECREF(item);
+      } else if (last == start && start == end && n > 0) {
+        // ignore an empty match straight after the previous match
+        pos = end + 1;
+        Py_DECREF(match);
+        continue;
+      }
+
+      if (literal != NULL) {
+        Py_INCREF(literal);
+        item = literal;
+      } else if (parsed != NULL) {
+        item = Match_expand_parsed((MatchObject*)match, parsed);
+      } else {
+        item = PyObject_CallFunctionObjArgs(repl, match, NULL);
+      }
+      Py_DECREF(match);
+      if (item == NULL) {
+        goto done;
+      }
+      if (item != Py_None && PyList_Append(list, item) < 0) {
+        Py_DECREF(item);
+        goto done;
+      }
+      Py_DECREF(item);
+
+      last = end;
+      n++;
+      // don't find an empty match again
+      pos = start == end ? end + 1 : end;
+    }
+
+    // the text after the last match
+    if (last < length) {
+      PyObject* item = PySequence_GetSlice(string, last, length);
+      if (item == NULL || PyList_Append(list, item) < 0) {
+        Py_XDECREF(item);
+        goto done;
+      }
+      Py_DECREF(item);
+    }
+
+    PyObject* joined = join_list(list, string);
+    if (joined != NULL) {
+      result = subn ? Py_BuildValue("Nn", joined, n) : joined;
+    }
+  }
+
+done:
+  Py_XDECREF(list);
+  Py_XDECREF(ustring);
+  Py_XDECREF(literal);
+  Py_XDECREF(parsed);
+  return result;
+}
+
+static PyObject*
+RegEx_sub(RegEx* self, PyObject* args, PyObject* kwds) {
+  return RegEx_subx(self, args, kwds, false);
+}
+
+static PyObject*
+RegEx_subn(RegEx* self, PyObject* args, PyObject* kwds) {
+  return RegEx_subx(self, args, kwds, true);
+}
+
+static PyObject*
+RegEx_get_flags(RegEx* self, void* closure) {
+  return RegEx_check(self) ? PyInt_FromLong(self->re->flags) : NULL;
+}
+
+static PyObject*
+RegEx_get_groups(RegEx* self, void* closure) {
+  return RegEx_check(self) ? PyInt_FromLong(self->re->groups) : NULL;
+}
+
+static PyObject*
+RegEx_get_groupindex(RegEx* self, void* closure) {
+  if (!RegEx_check(self)) {
     return NULL;
   }
+  Py_INCREF(self->groupindex);
+  return self->groupindex;
 }
 
 static PyMethodDef RegEx_methods[] = {
   {"dump", (PyCFunction)RegEx_dump, METH_NOARGS,
    "Dump the LLVM code for the RegEx", },
-  {"match", (PyCFunction)RegEx_match, METH_VARARGS,
+  {"match", (PyCFunction)RegEx_match, METH_VARARGS|METH_KEYWORDS,
    "Match the pattern against the start of a string", },
-  {"find", (PyCFunction)RegEx_find, METH_VARARGS,
+  {"search", (PyCFunction)RegEx_search, METH_VARARGS|METH_KEYWORDS,
    "Find the pattern in a string", },
+  {"scanner", (PyCFunction)RegEx_scanner, METH_VARARGS|METH_KEYWORDS,
+   "Return a scanner for successive matches in a string", },
+  {"finditer", (PyCFunction)RegEx_finditer, METH_VARARGS|METH_KEYWORDS,
+   "Return an iterator over the matches in a string", },
+  {"sub", (PyCFunction)RegEx_sub, METH_VARARGS|METH_KEYWORDS,
+   "Replace the matches in a string", },
+  {"subn", (PyCFunction)RegEx_subn, METH_VARARGS|METH_KEYWORDS,
+   "Replace the matches in a string, returning the number replaced too", },
   {NULL}  /* Sentinel */
 };
-  
+
+static PyMemberDef RegEx_members[] = {
+  {(char*)"pattern", T_OBJECT, offsetof(RegEx, pattern), READONLY},
+  {NULL}  /* Sentinel */
+};
+
+static PyGetSetDef RegEx_getset[] = {
+  {(char*)"flags", (getter)RegEx_get_flags, NULL,
+   (char*)"The flags the RegEx was compiled with"},
+  {(char*)"groups", (getter)RegEx_get_groups, NULL,
+   (char*)"The number of groups in the RegEx"},
+  {(char*)"groupindex", (getter)RegEx_get_groupindex, NULL,
+   (char*)"A dictionary mapping group names to group numbers"},
+  {NULL}  /* Sentinel */
+};
+
 static PyTypeObject RegExType = {
   PyObject_HEAD_INIT(NULL)
   0,                         /*ob_size*/
@@ -2077,8 +4240,8 @@ static PyTypeObject RegExType = {
   0,                         /* tp_iter */
   0,                         /* tp_iternext */
   RegEx_methods,             /* tp_methods */
-  0/*RegEx_members*/,             /* tp_members */
-  0,                         /* tp_getset */
+  RegEx_members,             /* tp_members */
+  RegEx_getset,              /* tp_getset */
   0,                         /* tp_base */
   0,                         /* tp_dict */
   0,                         /* tp_descr_get */
@@ -2089,6 +4252,176 @@ static PyTypeObject RegExType = {
   RegEx_new,                 /* tp_new */
 };
 
+static PyObject *
+RegExSet_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+  RegExSet *self;
+
+  self = (RegExSet *)type->tp_alloc(type, 0);
+  if (self != NULL) {
+    self->re = new RegularExpression();
+  }
+
+  return (PyObject *)self;
+}
+
+static int
+RegExSet_init(RegExSet *self, PyObject *args, PyObject *kwds)
+{
+  PyObject *seqs, *flags_seq;
+
+  static const char *kwlist[] = {"seqs", "flags", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO", (char**)kwlist,
+        &seqs, &flags_seq)) {
+    return -1;
+  }
+
+  if (!PySequence_Check(seqs) || !PySequence_Check(flags_seq)) {
+    _PyErr_SetString(PyExc_TypeError, "Expected a sequence");
+    return -1;
+  }
+
+  if (self->re == NULL) {
+    _PyErr_SetString(PyExc_ValueError, "RegExSet can't be recompiled");
+    return -1;
+  }
+
+  // the flags each pattern was parsed with
+  std::vector<int> flags;
+  Py_ssize_t num_flags = PySequence_Size(flags_seq);
+  for (Py_ssize_t i=0; i<num_flags; i++) {
+    PyObject* item = PySequence_GetItem(flags_seq, i);
+    flags.push_back(item != NULL ? PyInt_AsLong(item) : -1);
+    Py_XDECREF(item);
+    if (PyErr_Occurred()) {
+      return -1;
+    }
+  }
+
+  if (!self->re->CompileSet(seqs, flags)) {
+    delete self->re;
+    self->re = NULL;
+    PyErr_SetString(PyExc_ValueError, 
+        "patterns can't be compiled into one automaton");
+    return -1;
+  }
+  self->size = flags.size();
+  return 0;
+}
+
+static void
+RegExSet_dealloc(RegExSet* self)
+{
+  if (self && self->re) {
+    delete self->re;
+  }
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyObject*
+RegExSet_match(RegExSet* self, PyObject* args, PyObject* kwds) {
+  PyObject* string;
+  Py_ssize_t pos = 0, endpos = PY_SSIZE_T_MAX;
+
+  static const char *kwlist[] = {"string", "pos", "endpos", NULL};
+
+  if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|nn", (char**)kwlist,
+        &string, &pos, &endpos)) {
+    return NULL;
+  }
+  if (self->re == NULL) {
+    PyErr_SetString(PyExc_ValueError, "RegExSet has not been compiled");
+    return NULL;
+  }
+
+  PyObject* ustring = as_unicode(string);
+  if (ustring == NULL) {
+    return NULL;
+  }
+  adjust_bounds(PyUnicode_GET_SIZE(ustring), &pos, &endpos);
+
+  PyObject* result = PyList_New(0);
+  if (result == NULL || pos > endpos) {
+    Py_DECREF(ustring);
+    return result;
+  }
+
+  std::vector<ReOffset> ends(self->size);
+  self->re->ExecuteSet(PyUnicode_AS_UNICODE(ustring), pos, endpos, &ends[0],
+      self->size);
+  Py_DECREF(ustring);
+
+  // (index, (start, end)) for each pattern that matched
+  for (Py_ssize_t i=0; i<self->size; i++) {
+    if (ends[i] < 0) {
+      continue;
+    }
+    PyObject* item = Py_BuildValue("n(nn)", i, pos, (Py_ssize_t)ends[i]);
+    if (item == NULL || PyList_Append(result, item) < 0) {
+      Py_XDECREF(item);
+      Py_DECREF(result);
+      return NULL;
+    }
+    Py_DECREF(item);
+  }
+  return result;
+}
+
+static PyMethodDef RegExSet_methods[] = {
+  {"match", (PyCFunction)RegExSet_match, METH_VARARGS|METH_KEYWORDS,
+   "Match every pattern in the set at the start of a string, returning "
+   "(index, span) for each one that matches", },
+  {NULL}  /* Sentinel */
+};
+
+static PyMemberDef RegExSet_members[] = {
+  {(char*)"size", T_PYSSIZET, offsetof(RegExSet, size), READONLY},
+  {NULL}  /* Sentinel */
+};
+
+static PyTypeObject RegExSetType = {
+  PyObject_HEAD_INIT(NULL)
+  0,                         /*ob_size*/
+  "llvmre.RegExSet",         /*tp_name*/
+  sizeof(RegExSet),          /*tp_basicsize*/
+  0,                         /*tp_itemsize*/
+  (destructor)RegExSet_dealloc, /*tp_dealloc*/
+  0,                         /*tp_print*/
+  0,                         /*tp_getattr*/
+  0,                         /*tp_setattr*/
+  0,                         /*tp_compare*/
+  0,                         /*tp_repr*/
+  0,                         /*tp_as_number*/
+  0,                         /*tp_as_sequence*/
+  0,                         /*tp_as_mapping*/
+  0,                         /*tp_hash */
+  0,                         /*tp_call*/
+  0,                         /*tp_str*/
+  0,                         /*tp_getattro*/
+  0,                         /*tp_setattro*/
+  0,                         /*tp_as_buffer*/
+  Py_TPFLAGS_DEFAULT,        /*tp_flags*/
+  "RegExSet objects",        /* tp_doc */
+  0,                         /* tp_traverse */
+  0,                         /* tp_clear */
+  0,                         /* tp_richcompare */
+  0,                         /* tp_weaklistoffset */
+  0,                         /* tp_iter */
+  0,                         /* tp_iternext */
+  RegExSet_methods,          /* tp_methods */
+  RegExSet_members,          /* tp_members */
+  0,                         /* tp_getset */
+  0,                         /* tp_base */
+  0,                         /* tp_dict */
+  0,                         /* tp_descr_get */
+  0,                         /* tp_descr_set */
+  0,                         /* tp_dictoffset */
+  (initproc)RegExSet_init,   /* tp_init */
+  0,                         /* tp_alloc */
+  RegExSet_new,              /* tp_new */
+};
+
 static PyMethodDef llvmre_methods[] = {
   {NULL}  /* Sentinel */
 };
@@ -2098,11 +4431,14 @@ static PyMethodDef llvmre_methods[] = {
 #endif
 
 PyMODINIT_FUNC
-init_llvmre(void) 
+init_llvmre(void)
 {
   PyObject* m;
 
-  if (PyType_Ready(&RegExType) < 0)
+  if (PyType_Ready(&RegExType) < 0 ||
+      PyType_Ready(&MatchType) < 0 ||
+      PyType_Ready(&ScannerType) < 0 ||
+      PyType_Ready(&RegExSetType) < 0)
     return;
 
   m = Py_InitModule3("_llvmre", llvmre_methods,
@@ -2110,7 +4446,10 @@ init_llvmre(void)
 
   Py_INCREF(&RegExType);
   PyModule_AddObject(m, "RegEx", (PyObject *)&RegExType);
+  Py_INCREF(&RegExSetType);
+  PyModule_AddObject(m, "RegExSet", (PyObject *)&RegExSetType);
 
+  PyGlobalLlvmData::ScopedLock lock(PyGlobalLlvmData::Get());
   REM = new RegularExpressionModule();
   // FIXME: deallocate REM on Python module destruction
 }
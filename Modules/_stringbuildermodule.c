@@ -0,0 +1,471 @@
+#include "Python.h"
+
+/* _stringbuilder module: mutable builders for str and unicode objects.
+
+   A builder keeps what has been appended to it in an over-allocated str
+   or unicode object, which grows by half again whenever it fills up, so
+   that n appends take O(n) time in total however they are spread out.
+   build() trims that object to its used length, which realloc() usually
+   does without moving it, and returns it.  The builder keeps the result
+   as its value, marked shared, and copies it only if more is appended
+   later.
+
+   A StringBuilder also exports its used part as a writable buffer.
+   While buffers are exported, appends that would have to reallocate the
+   value fail, and so does build(), which would freeze memory that
+   someone may still write to.
+*/
+
+/* smallest object allocated to hold a builder's value */
+#define MINALLOC 16
+
+typedef struct {
+	PyObject_HEAD
+	PyObject *value;	/* NULL, or the str or unicode being built */
+	Py_ssize_t len;		/* characters of value in use */
+	int is_unicode;		/* value is unicode rather than str */
+	int shared;		/* value may be referenced elsewhere */
+	Py_ssize_t exports;	/* how many buffers are exported */
+} builderobject;
+
+static PyTypeObject stringbuilder_type;
+static PyTypeObject unicodebuilder_type;
+
+static Py_ssize_t
+builder_allocated(builderobject *b)
+{
+	if (b->value == NULL)
+		return 0;
+	if (b->is_unicode)
+		return PyUnicode_GET_SIZE(b->value);
+	return PyString_GET_SIZE(b->value);
+}
+
+/* Make b->value a private object with room for at least need
+   characters. */
+static int
+builder_reserve(builderobject *b, Py_ssize_t need)
+{
+	Py_ssize_t alloc;
+	PyObject *v;
+
+	if (!b->shared && need <= builder_allocated(b))
+		return 0;
+	if (b->exports > 0) {
+		PyErr_SetString(PyExc_BufferError,
+			"Existing exports of data: object cannot be re-sized");
+		return -1;
+	}
+
+	alloc = need + (need >> 1);
+	if (alloc < need)
+		alloc = need;
+	if (alloc < MINALLOC)
+		alloc = MINALLOC;
+
+	if (b->value != NULL && !b->shared) {
+		/* The builder holds the only reference, so resize in place. */
+		if (b->is_unicode)
+			return PyUnicode_Resize(&b->value, alloc);
+		if (_PyString_Resize(&b->value, alloc) < 0) {
+			/* _PyString_Resize() freed the old value. */
+			b->len = 0;
+			return -1;
+		}
+		return 0;
+	}
+
+	if (b->is_unicode) {
+		v = PyUnicode_FromUnicode(NULL, alloc);
+		if (v == NULL)
+			return -1;
+		if (b->len > 0)
+			Py_UNICODE_COPY(PyUnicode_AS_UNICODE(v),
+					PyUnicode_AS_UNICODE(b->value), b->len);
+	}
+	else {
+		v = PyString_FromStringAndSize(NULL, alloc);
+		if (v == NULL)
+			return -1;
+		if (b->len > 0)
+			memcpy(PyString_AS_STRING(v),
+			       PyString_AS_STRING(b->value), b->len);
+	}
+	Py_XDECREF(b->value);
+	b->value = v;
+	b->shared = 0;
+	return 0;
+}
+
+static int
+builder_append_obj(builderobject *b, PyObject *s)
+{
+	Py_ssize_t n;
+
+	if (b->is_unicode ? !PyUnicode_Check(s) : !PyString_Check(s)) {
+		PyErr_Format(PyExc_TypeError,
+			     "can only append %s to a %s, not %.200s",
+			     b->is_unicode ? "unicode" : "str",
+			     Py_TYPE(b)->tp_name, Py_TYPE(s)->tp_name);
+		return -1;
+	}
+	n = b->is_unicode ? PyUnicode_GET_SIZE(s) : PyString_GET_SIZE(s);
+	if (n == 0)
+		return 0;
+
+	if (b->value == NULL && b->exports == 0 &&
+	    (b->is_unicode ? PyUnicode_CheckExact(s) :
+			     PyString_CheckExact(s))) {
+		/* The first append can share the object; build() may then
+		   return it as it is. */
+		Py_INCREF(s);
+		b->value = s;
+		b->len = n;
+		b->shared = 1;
+		return 0;
+	}
+
+	if (b->len + n < 0) {
+		PyErr_SetString(PyExc_OverflowError,
+				"builder has grown too large");
+		return -1;
+	}
+	if (builder_reserve(b, b->len + n) < 0)
+		return -1;
+	if (b->is_unicode)
+		Py_UNICODE_COPY(PyUnicode_AS_UNICODE(b->value) + b->len,
+				PyUnicode_AS_UNICODE(s), n);
+	else
+		memcpy(PyString_AS_STRING(b->value) + b->len,
+		       PyString_AS_STRING(s), n);
+	b->len += n;
+	return 0;
+}
+
+static PyObject *
+builder_new(PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+	builderobject *b;
+	PyObject *initial = NULL;
+
+	if (!_PyArg_NoKeywords(type->tp_name, kwds))
+		return NULL;
+	if (!PyArg_UnpackTuple(args, type->tp_name, 0, 1, &initial))
+		return NULL;
+
+	b = (builderobject *)type->tp_alloc(type, 0);
+	if (b == NULL)
+		return NULL;
+	b->value = NULL;
+	b->len = 0;
+	b->is_unicode = (type == &unicodebuilder_type);
+	b->shared = 0;
+	b->exports = 0;
+
+	if (initial != NULL && builder_append_obj(b, initial) < 0) {
+		Py_DECREF(b);
+		return NULL;
+	}
+	return (PyObject *)b;
+}
+
+static void
+builder_dealloc(builderobject *b)
+{
+	if (b->exports > 0) {
+		PyErr_SetString(PyExc_SystemError,
+			"deallocated builder object has exported buffers");
+		PyErr_Print();
+	}
+	Py_XDECREF(b->value);
+	Py_TYPE(b)->tp_free((PyObject *)b);
+}
+
+static PyObject *
+builder_append(builderobject *b, PyObject *s)
+{
+	if (builder_append_obj(b, s) < 0)
+		return NULL;
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(append_doc,
+"B.append(s) -- append s to the end of the builder");
+
+static PyObject *
+builder_build(builderobject *b, PyObject *unused)
+{
+	if (b->value == NULL) {
+		if (b->is_unicode)
+			return PyUnicode_FromUnicode(NULL, 0);
+		return PyString_FromStringAndSize(NULL, 0);
+	}
+	if (!b->shared) {
+		if (b->exports > 0) {
+			PyErr_SetString(PyExc_BufferError,
+				"cannot build while buffers are exported");
+			return NULL;
+		}
+		if (b->is_unicode) {
+			if (PyUnicode_Resize(&b->value, b->len) < 0)
+				return NULL;
+		}
+		else if (_PyString_Resize(&b->value, b->len) < 0) {
+			b->len = 0;
+			return NULL;
+		}
+		b->shared = 1;
+	}
+	Py_INCREF(b->value);
+	return b->value;
+}
+
+PyDoc_STRVAR(build_doc,
+"B.build() -> str or unicode\n\
+\n\
+Return everything appended so far.  This does not copy the data, and\n\
+the builder can still be appended to afterwards.");
+
+static PyMethodDef builder_methods[] = {
+	{"append",	(PyCFunction)builder_append,
+		METH_O,		append_doc},
+	{"build",	(PyCFunction)builder_build,
+		METH_NOARGS,	build_doc},
+	{NULL,		NULL}	/* sentinel */
+};
+
+static Py_ssize_t
+builder_length(builderobject *b)
+{
+	return b->len;
+}
+
+static PyObject *
+builder_inplace_concat(builderobject *b, PyObject *s)
+{
+	if (builder_append_obj(b, s) < 0)
+		return NULL;
+	Py_INCREF(b);
+	return (PyObject *)b;
+}
+
+static PySequenceMethods builder_as_sequence = {
+	(lenfunc)builder_length,	/* sq_length */
+	0,				/* sq_concat */
+	0,				/* sq_repeat */
+	0,				/* sq_item */
+	0,				/* sq_slice */
+	0,				/* sq_ass_item */
+	0,				/* sq_ass_slice */
+	0,				/* sq_contains */
+	(binaryfunc)builder_inplace_concat,	/* sq_inplace_concat */
+	0,				/* sq_inplace_repeat */
+};
+
+/* Buffer interface of StringBuilder.  Exported buffers are always
+   writable, so they need a private value, which builder_reserve() makes
+   if build() has handed the current one out. */
+
+static char *
+builder_data(builderobject *b, int writable)
+{
+	if (writable && b->shared && builder_reserve(b, b->len) < 0)
+		return NULL;
+	if (b->value == NULL)
+		return "";
+	return PyString_AS_STRING(b->value);
+}
+
+static Py_ssize_t
+builder_getreadbuf(builderobject *b, Py_ssize_t index, const void **ptr)
+{
+	if (index != 0) {
+		PyErr_SetString(PyExc_SystemError,
+				"accessing non-existent builder segment");
+		return -1;
+	}
+	*ptr = builder_data(b, 0);
+	return b->len;
+}
+
+static Py_ssize_t
+builder_getwritebuf(builderobject *b, Py_ssize_t index, const void **ptr)
+{
+	if (index != 0) {
+		PyErr_SetString(PyExc_SystemError,
+				"accessing non-existent builder segment");
+		return -1;
+	}
+	*ptr = builder_data(b, 1);
+	if (*ptr == NULL)
+		return -1;
+	return b->len;
+}
+
+static Py_ssize_t
+builder_getsegcount(builderobject *b, Py_ssize_t *lenp)
+{
+	if (lenp)
+		*lenp = b->len;
+	return 1;
+}
+
+static int
+builder_getbuffer(builderobject *b, Py_buffer *view, int flags)
+{
+	char *ptr;
+	int ret;
+
+	if (view == NULL) {
+		b->exports++;
+		return 0;
+	}
+	ptr = builder_data(b, 1);
+	if (ptr == NULL)
+		return -1;
+	ret = PyBuffer_FillInfo(view, (PyObject *)b, ptr, b->len, 0, flags);
+	if (ret >= 0)
+		b->exports++;
+	return ret;
+}
+
+static void
+builder_releasebuffer(builderobject *b, Py_buffer *view)
+{
+	b->exports--;
+}
+
+static PyBufferProcs builder_as_buffer = {
+	(readbufferproc)builder_getreadbuf,
+	(writebufferproc)builder_getwritebuf,
+	(segcountproc)builder_getsegcount,
+	(charbufferproc)builder_getreadbuf,
+	(getbufferproc)builder_getbuffer,
+	(releasebufferproc)builder_releasebuffer,
+};
+
+PyDoc_STRVAR(stringbuilder_doc,
+"StringBuilder([s]) -> new str builder\n\
+\n\
+Collect str pieces with append() or += in amortized constant time per\n\
+character, and turn them into one str with build().");
+
+static PyTypeObject stringbuilder_type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	"_stringbuilder.StringBuilder",	/* tp_name */
+	sizeof(builderobject),		/* tp_basicsize */
+	0,				/* tp_itemsize */
+	/* methods */
+	(destructor)builder_dealloc,	/* tp_dealloc */
+	0,				/* tp_print */
+	0,				/* tp_getattr */
+	0,				/* tp_setattr */
+	0,				/* tp_compare */
+	0,				/* tp_repr */
+	0,				/* tp_as_number */
+	&builder_as_sequence,		/* tp_as_sequence */
+	0,				/* tp_as_mapping */
+	(hashfunc)PyObject_HashNotImplemented,	/* tp_hash */
+	0,				/* tp_call */
+	0,				/* tp_str */
+	PyObject_GenericGetAttr,	/* tp_getattro */
+	0,				/* tp_setattro */
+	&builder_as_buffer,		/* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER,	/* tp_flags */
+	stringbuilder_doc,		/* tp_doc */
+	0,				/* tp_traverse */
+	0,				/* tp_clear */
+	0,				/* tp_richcompare */
+	0,				/* tp_weaklistoffset */
+	0,				/* tp_iter */
+	0,				/* tp_iternext */
+	builder_methods,		/* tp_methods */
+	0,				/* tp_members */
+	0,				/* tp_getset */
+	0,				/* tp_base */
+	0,				/* tp_dict */
+	0,				/* tp_descr_get */
+	0,				/* tp_descr_set */
+	0,				/* tp_dictoffset */
+	0,				/* tp_init */
+	PyType_GenericAlloc,		/* tp_alloc */
+	builder_new,			/* tp_new */
+	PyObject_Del,			/* tp_free */
+};
+
+PyDoc_STRVAR(unicodebuilder_doc,
+"UnicodeBuilder([s]) -> new unicode builder\n\
+\n\
+Collect unicode pieces with append() or += in amortized constant time\n\
+per character, and turn them into one unicode object with build().");
+
+static PyTypeObject unicodebuilder_type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	"_stringbuilder.UnicodeBuilder",	/* tp_name */
+	sizeof(builderobject),		/* tp_basicsize */
+	0,				/* tp_itemsize */
+	/* methods */
+	(destructor)builder_dealloc,	/* tp_dealloc */
+	0,				/* tp_print */
+	0,				/* tp_getattr */
+	0,				/* tp_setattr */
+	0,				/* tp_compare */
+	0,				/* tp_repr */
+	0,				/* tp_as_number */
+	&builder_as_sequence,		/* tp_as_sequence */
+	0,				/* tp_as_mapping */
+	(hashfunc)PyObject_HashNotImplemented,	/* tp_hash */
+	0,				/* tp_call */
+	0,				/* tp_str */
+	PyObject_GenericGetAttr,	/* tp_getattro */
+	0,				/* tp_setattro */
+	0,				/* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT,		/* tp_flags */
+	unicodebuilder_doc,		/* tp_doc */
+	0,				/* tp_traverse */
+	0,				/* tp_clear */
+	0,				/* tp_richcompare */
+	0,				/* tp_weaklistoffset */
+	0,				/* tp_iter */
+	0,				/* tp_iternext */
+	builder_methods,		/* tp_methods */
+	0,				/* tp_members */
+	0,				/* tp_getset */
+	0,				/* tp_base */
+	0,				/* tp_dict */
+	0,				/* tp_descr_get */
+	0,				/* tp_descr_set */
+	0,				/* tp_dictoffset */
+	0,				/* tp_init */
+	PyType_GenericAlloc,		/* tp_alloc */
+	builder_new,			/* tp_new */
+	PyObject_Del,			/* tp_free */
+};
+
+PyDoc_STRVAR(module_doc,
+"Builders that concatenate many strings in linear time.\n\
+\n\
+StringBuilder collects str pieces and UnicodeBuilder unicode pieces;\n\
+build() returns the result without copying it.");
+
+PyMODINIT_FUNC
+init_stringbuilder(void)
+{
+	PyObject *m;
+
+	m = Py_InitModule3("_stringbuilder", NULL, module_doc);
+	if (m == NULL)
+		return;
+
+	if (PyType_Ready(&stringbuilder_type) < 0)
+		return;
+	Py_INCREF(&stringbuilder_type);
+	PyModule_AddObject(m, "StringBuilder",
+			   (PyObject *)&stringbuilder_type);
+
+	if (PyType_Ready(&unicodebuilder_type) < 0)
+		return;
+	Py_INCREF(&unicodebuilder_type);
+	PyModule_AddObject(m, "UnicodeBuilder",
+			   (PyObject *)&unicodebuilder_type);
+}
@@ -112,6 +112,43 @@ static Py_ssize_t long_lived_pending = 0;
 */
 
 
+/* Incremental collection.
+
+   When pause_target is non-zero, full collections are done a slice at a
+   time instead of all at once, so that no single pause takes much longer
+   than pause_target milliseconds.  A full pass begins when the oldest
+   generation would have been collected; from then on, every collection of
+   the middle generation becomes an increment of the pass instead.  Each
+   increment examines the young generations, the next slice of the old
+   generation's objects that haven't been visited yet in this pass, and the
+   unvisited objects these refer to, for as long as its budget lasts; the
+   budget is sized from the time earlier increments took.  That set is
+   collected just like a younger generation: anything referenced from
+   outside it counts as reachable, so no write barrier is needed, but a
+   garbage cycle is only found if it fits whole in one increment.  The
+   survivors are moved to old_visited, and the pass ends once the old
+   generation has been used up; old_visited then becomes the old generation
+   again.  An explicit gc.collect() is always a complete full collection.
+*/
+static double pause_target = 0.0;	/* milliseconds; 0 disables */
+static int incremental_pass = 0;	/* is a pass in progress? */
+static PyGC_Head old_visited = {{&old_visited, &old_visited, 0}};
+static Py_ssize_t increment_budget = 20000;	/* work per increment */
+static Py_ssize_t visited_total = 0;	/* survivors of this pass */
+
+/* The least work an increment is given, and the fewest old objects it
+ * examines, so that a pass always makes progress. */
+#define MIN_INCREMENT_BUDGET	10000
+#define MIN_INCREMENT_SLICE	100
+
+/* Objects that gc.freeze() has moved out of the generations, typically
+   those made while a program starts up.  Collections never examine them or
+   write to them, so after a fork their pages stay shared, but they still
+   count as tracked.  gc.unfreeze() moves them to the oldest generation.
+*/
+static PyGC_Head permanent_generation = {{&permanent_generation,
+					  &permanent_generation, 0}};
+
 /* set for debugging information */
 #define DEBUG_STATS		(1<<0) /* print collection statistics */
 #define DEBUG_COLLECTABLE	(1<<1) /* print collectable objects */
@@ -164,17 +201,34 @@ GC_TENTATIVELY_UNREACHABLE
     Only objects with GC_TENTATIVELY_UNREACHABLE still set are candidates
     for collection.  If it's decided not to collect such an object (e.g.,
     it has a __del__ method), its gc_refs is restored to GC_REACHABLE again.
+
+GC_VISITED
+    Incremental collection marks the objects of the oldest generation that
+    a pass has visited with visited_mark, which is GC_REACHABLE and
+    GC_VISITED by turns, so that the marks needn't be reset when a pass
+    ends.  Otherwise, GC_VISITED means the same as GC_REACHABLE.
+
+GC_FROZEN
+    The object is in the permanent generation.  It's reachable, but it
+    never takes part in a collection, so it can't be pulled into one.
 ----------------------------------------------------------------------------
 */
 #define GC_UNTRACKED			_PyGC_REFS_UNTRACKED
 #define GC_REACHABLE			_PyGC_REFS_REACHABLE
 #define GC_TENTATIVELY_UNREACHABLE	_PyGC_REFS_TENTATIVELY_UNREACHABLE
+#define GC_VISITED			(-5)
+#define GC_FROZEN			(-6)
 
 #define IS_TRACKED(o) ((AS_GC(o))->gc.gc_refs != GC_UNTRACKED)
-#define IS_REACHABLE(o) ((AS_GC(o))->gc.gc_refs == GC_REACHABLE)
+#define IS_REACHABLE(o) ((AS_GC(o))->gc.gc_refs == GC_REACHABLE || \
+			 (AS_GC(o))->gc.gc_refs == GC_VISITED || \
+			 (AS_GC(o))->gc.gc_refs == GC_FROZEN)
 #define IS_TENTATIVELY_UNREACHABLE(o) ( \
 	(AS_GC(o))->gc.gc_refs == GC_TENTATIVELY_UNREACHABLE)
 
+/* the gc_refs of the objects in old_visited */
+static Py_ssize_t visited_mark = GC_REACHABLE;
+
 /*** list functions ***/
 
 static void
@@ -288,7 +342,7 @@ update_refs(PyGC_Head *containers)
 {
 	PyGC_Head *gc = containers->gc.gc_next;
 	for (; gc != containers; gc = gc->gc.gc_next) {
-		assert(gc->gc.gc_refs == GC_REACHABLE);
+		assert(IS_REACHABLE(FROM_GC(gc)));
 		gc->gc.gc_refs = Py_REFCNT(FROM_GC(gc));
 		/* Python's cyclic gc should never see an incoming refcount
 		 * of 0:  if something decref'ed to 0, it should have been
@@ -330,6 +384,48 @@ visit_decref(PyObject *op, void *data)
 	return 0;
 }
 
+/* The state of an increment while subtract_increment() builds it.  Work
+ * is counted as objects traversed plus references followed.
+ */
+struct increment_state {
+	PyGC_Head *increment;
+	Py_ssize_t budget;	/* work the increment may take */
+	Py_ssize_t work;	/* work done so far */
+	Py_ssize_t base;	/* work not charged to the budget */
+	Py_ssize_t slice;	/* # objects taken from the old generation */
+	Py_ssize_t pulled;	/* # objects pulled in through references */
+};
+
+/* A traversal callback for subtract_increment.  Like visit_decref, but a
+ * tracked object from outside the increment that this pass hasn't visited
+ * yet is first pulled into it, as long as there is budget left, counting
+ * each object pulled in so far against it too.
+ */
+static int
+visit_pull(PyObject *op, struct increment_state *state)
+{
+        assert(op != NULL);
+	state->work++;
+	if (PyObject_IS_GC(op)) {
+		PyGC_Head *gc = AS_GC(op);
+		if ((gc->gc.gc_refs == GC_REACHABLE ||
+		     gc->gc.gc_refs == GC_VISITED) &&
+		    gc->gc.gc_refs != visited_mark &&
+		    state->work - state->base + state->pulled <
+		    state->budget) {
+			/* It goes to the end of the list being traversed,
+			 * so its own references get subtracted in turn. */
+			gc_list_move(gc, state->increment);
+			gc->gc.gc_refs = Py_REFCNT(op);
+			state->pulled++;
+		}
+		assert(gc->gc.gc_refs != 0); /* else refcount was too small */
+		if (gc->gc.gc_refs > 0)
+			gc->gc.gc_refs--;
+	}
+	return 0;
+}
+
 /* Subtract internal references from gc_refs.  After this, gc_refs is >= 0
  * for all objects in containers, and is GC_REACHABLE for all tracked gc
  * objects not in containers.  The ones with gc_refs > 0 are directly
@@ -348,6 +444,62 @@ subtract_refs(PyGC_Head *containers)
 	}
 }
 
+/* Like subtract_refs, for an increment whose objects have had their
+ * gc_refs updated.  The first `initial` objects are always traversed, and
+ * their work isn't charged to the budget.  After that, while the work
+ * stays under half the budget, the oldest objects of pending are added to
+ * the increment too, and objects that those in it refer to are pulled in
+ * until the budget is spent.  At that point, the objects left untraversed
+ * go back to the front of pending.  Either way, references that aren't
+ * followed only make objects look reachable from outside.
+ */
+static void
+subtract_increment(PyGC_Head *increment, PyGC_Head *pending,
+		   struct increment_state *state, Py_ssize_t initial)
+{
+	traverseproc traverse;
+	PyGC_Head *gc = increment->gc.gc_next;
+	PyGC_Head *last;
+
+	state->increment = increment;
+	for (;;) {
+		if (gc == increment) {
+			if (gc_list_is_empty(pending) ||
+			    state->work - state->base >= state->budget / 2)
+				return;
+			gc = pending->gc.gc_next;
+			gc_list_move(gc, increment);
+			gc->gc.gc_refs = Py_REFCNT(FROM_GC(gc));
+			assert(gc->gc.gc_refs != 0);
+			state->slice++;
+		}
+		if (initial == 0 && state->work - state->base >= state->budget)
+			break;
+		traverse = Py_TYPE(FROM_GC(gc))->tp_traverse;
+		(void) traverse(FROM_GC(gc),
+			       (visitproc)visit_pull,
+			       state);
+		state->work++;
+		if (initial > 0) {
+			initial--;
+			state->base = state->work;
+		}
+		gc = gc->gc.gc_next;
+	}
+
+	/* Give back the objects from gc on. */
+	last = increment->gc.gc_prev;
+	increment->gc.gc_prev = gc->gc.gc_prev;
+	gc->gc.gc_prev->gc.gc_next = increment;
+	last->gc.gc_next = pending->gc.gc_next;
+	last->gc.gc_next->gc.gc_prev = last;
+	pending->gc.gc_next = gc;
+	gc->gc.gc_prev = pending;
+	for (; gc != last->gc.gc_next; gc = gc->gc.gc_next)
+		gc->gc.gc_refs = visited_mark == GC_REACHABLE ? GC_VISITED :
+								GC_REACHABLE;
+}
+
 /* A traversal callback for move_unreachable. */
 static int
 visit_reachable(PyObject *op, PyGC_Head *reachable)
@@ -385,6 +537,8 @@ visit_reachable(PyObject *op, PyGC_Head *reachable)
 		 else {
 		 	assert(gc_refs > 0
 		 	       || gc_refs == GC_REACHABLE
+		 	       || gc_refs == GC_VISITED
+		 	       || gc_refs == GC_FROZEN
 		 	       || gc_refs == GC_UNTRACKED);
 		 }
 	}
@@ -673,7 +827,10 @@ handle_weakrefs(PyGC_Head *unreachable, PyGC_Head *old)
 		Py_DECREF(op);
 		if (wrcb_to_call.gc.gc_next == gc) {
 			/* object is still alive -- move it */
-			gc_list_move(gc, old);
+			if (gc->gc.gc_refs == GC_FROZEN)
+				gc_list_move(gc, &permanent_generation);
+			else
+				gc_list_move(gc, old);
 		}
 		else
 			++num_freed;
@@ -789,20 +946,17 @@ clear_freelists(void)
 	(void)PyFloat_ClearFreeList();
 }
 
-/* This is the main function.  Read this to understand how the
- * collection process works. */
+/* Deal with the unreachable objects found by a collection: free what can
+ * be freed, and move the rest to old.  Returns the number of unreachable
+ * objects.
+ */
 static Py_ssize_t
-collect(int generation)
+collect_unreachable(PyGC_Head *unreachable, PyGC_Head *old, double t1)
 {
-	int i;
 	Py_ssize_t m = 0; /* # objects collected */
 	Py_ssize_t n = 0; /* # unreachable objects that couldn't be collected */
-	PyGC_Head *young; /* the generation we are examining */
-	PyGC_Head *old; /* next older generation */
-	PyGC_Head unreachable; /* non-problematic unreachable trash */
 	PyGC_Head finalizers;  /* objects with, & reachable from, __del__ */
 	PyGC_Head *gc;
-	double t1 = 0.0;
 
 	if (delstr == NULL) {
 		delstr = PyString_InternFromString("__del__");
@@ -810,73 +964,6 @@ collect(int generation)
 			Py_FatalError("gc couldn't allocate \"__del__\"");
 	}
 
-	if (debug & DEBUG_STATS) {
-		if (tmod != NULL) {
-			PyObject *f = PyObject_CallMethod(tmod, "time", NULL);
-			if (f == NULL) {
-				PyErr_Clear();
-			}
-			else {
-				t1 = PyFloat_AsDouble(f);
-				Py_DECREF(f);
-			}
-		}
-		PySys_WriteStderr("gc: collecting generation %d...\n",
-				  generation);
-		PySys_WriteStderr("gc: objects in each generation:");
-		for (i = 0; i < NUM_GENERATIONS; i++)
-			PySys_WriteStderr(" %" PY_FORMAT_SIZE_T "d",
-					  gc_list_size(GEN_HEAD(i)));
-		PySys_WriteStderr("\n");
-	}
-
-	/* update collection and allocation counters */
-	if (generation+1 < NUM_GENERATIONS)
-		generations[generation+1].count += 1;
-	for (i = 0; i <= generation; i++)
-		generations[i].count = 0;
-
-	/* merge younger generations with one we are currently collecting */
-	for (i = 0; i < generation; i++) {
-		gc_list_merge(GEN_HEAD(i), GEN_HEAD(generation));
-	}
-
-	/* handy references */
-	young = GEN_HEAD(generation);
-	if (generation < NUM_GENERATIONS-1)
-		old = GEN_HEAD(generation+1);
-	else
-		old = young;
-
-	/* Using ob_refcnt and gc_refs, calculate which objects in the
-	 * container set are reachable from outside the set (i.e., have a
-	 * refcount greater than 0 when all the references within the
-	 * set are taken into account).
-	 */
-	update_refs(young);
-	subtract_refs(young);
-
-	/* Leave everything reachable from outside young in young, and move
-	 * everything else (in young) to unreachable.
-	 * NOTE:  This used to move the reachable objects into a reachable
-	 * set instead.  But most things usually turn out to be reachable,
-	 * so it's more efficient to move the unreachable things.
-	 */
-	gc_list_init(&unreachable);
-	move_unreachable(young, &unreachable);
-
-	/* Move reachable objects to next generation. */
-	if (young != old) {
-		if (generation == NUM_GENERATIONS - 2) {
-			long_lived_pending += gc_list_size(young);
-		}
-		gc_list_merge(young, old);
-	}
-	else {
-		long_lived_pending = 0;
-		long_lived_total = gc_list_size(young);
-	}
-
 	/* All objects in unreachable are trash, but objects reachable from
 	 * finalizers can't safely be deleted.  Python programmers should take
 	 * care not to create such things.  For Python, finalizers means
@@ -885,7 +972,7 @@ collect(int generation)
 	 * handle_weakrefs().
  	 */
 	gc_list_init(&finalizers);
-	move_finalizers(&unreachable, &finalizers);
+	move_finalizers(unreachable, &finalizers);
 	/* finalizers contains the unreachable objects with a finalizer;
 	 * unreachable objects reachable *from* those are also uncollectable,
 	 * and we move those into the finalizers list too.
@@ -895,7 +982,7 @@ collect(int generation)
 	/* Collect statistics on collectable objects found and print
 	 * debugging information.
 	 */
-	for (gc = unreachable.gc.gc_next; gc != &unreachable;
+	for (gc = unreachable->gc.gc_next; gc != unreachable;
 			gc = gc->gc.gc_next) {
 		m++;
 		if (debug & DEBUG_COLLECTABLE) {
@@ -915,13 +1002,13 @@ collect(int generation)
 	}
 
 	/* Clear weakrefs and invoke callbacks as necessary. */
-	m += handle_weakrefs(&unreachable, old);
+	m += handle_weakrefs(unreachable, old);
 
 	/* Call tp_clear on objects in the unreachable set.  This will cause
 	 * the reference cycles to be broken.  It may also cause some objects
 	 * in finalizers to be freed.
 	 */
-	delete_garbage(&unreachable, old);
+	delete_garbage(unreachable, old);
 
 	/* Collect statistics on uncollectable objects found and print
 	 * debugging information. */
@@ -949,12 +1036,6 @@ collect(int generation)
 	 */
 	(void)handle_finalizers(&finalizers, old);
 
-	/* Clear free list only during the collection of the higest
-	 * generation */
-	if (generation == NUM_GENERATIONS-1) {
-		clear_freelists();
-	}
-
 	if (PyErr_Occurred()) {
 		if (gc_str == NULL)
 			gc_str = PyString_FromString("garbage collection");
@@ -964,6 +1045,232 @@ collect(int generation)
 	return n+m;
 }
 
+/* Start timing a collection for DEBUG_STATS, and print the generations'
+ * sizes.
+ */
+static double
+debug_stats_start(void)
+{
+	int i;
+	Py_ssize_t size;
+	double t1 = 0.0;
+
+	if (tmod != NULL) {
+		PyObject *f = PyObject_CallMethod(tmod, "time", NULL);
+		if (f == NULL) {
+			PyErr_Clear();
+		}
+		else {
+			t1 = PyFloat_AsDouble(f);
+			Py_DECREF(f);
+		}
+	}
+	PySys_WriteStderr("gc: objects in each generation:");
+	for (i = 0; i < NUM_GENERATIONS; i++) {
+		size = gc_list_size(GEN_HEAD(i));
+		if (i == NUM_GENERATIONS-1)
+			size += gc_list_size(&old_visited);
+		PySys_WriteStderr(" %" PY_FORMAT_SIZE_T "d", size);
+	}
+	PySys_WriteStderr("\n");
+	return t1;
+}
+
+/* This is the main function.  Read this to understand how the
+ * collection process works. */
+static Py_ssize_t
+collect(int generation)
+{
+	int i;
+	Py_ssize_t n;
+	PyGC_Head *young; /* the generation we are examining */
+	PyGC_Head *old; /* next older generation */
+	PyGC_Head unreachable; /* non-problematic unreachable trash */
+	double t1 = 0.0;
+
+	if (debug & DEBUG_STATS) {
+		PySys_WriteStderr("gc: collecting generation %d...\n",
+				  generation);
+		t1 = debug_stats_start();
+	}
+
+	/* a full collection ends any incremental pass, and examines the
+	 * objects that the pass has already visited too */
+	if (generation == NUM_GENERATIONS-1) {
+		gc_list_merge(&old_visited, GEN_HEAD(generation));
+		incremental_pass = 0;
+		visited_mark = GC_REACHABLE;
+	}
+
+	/* update collection and allocation counters */
+	if (generation+1 < NUM_GENERATIONS)
+		generations[generation+1].count += 1;
+	for (i = 0; i <= generation; i++)
+		generations[i].count = 0;
+
+	/* merge younger generations with one we are currently collecting */
+	for (i = 0; i < generation; i++) {
+		gc_list_merge(GEN_HEAD(i), GEN_HEAD(generation));
+	}
+
+	/* handy references */
+	young = GEN_HEAD(generation);
+	if (generation < NUM_GENERATIONS-1)
+		old = GEN_HEAD(generation+1);
+	else
+		old = young;
+
+	/* Using ob_refcnt and gc_refs, calculate which objects in the
+	 * container set are reachable from outside the set (i.e., have a
+	 * refcount greater than 0 when all the references within the
+	 * set are taken into account).
+	 */
+	update_refs(young);
+	subtract_refs(young);
+
+	/* Leave everything reachable from outside young in young, and move
+	 * everything else (in young) to unreachable.
+	 * NOTE:  This used to move the reachable objects into a reachable
+	 * set instead.  But most things usually turn out to be reachable,
+	 * so it's more efficient to move the unreachable things.
+	 */
+	gc_list_init(&unreachable);
+	move_unreachable(young, &unreachable);
+
+	/* Move reachable objects to next generation. */
+	if (young != old) {
+		if (generation == NUM_GENERATIONS - 2) {
+			long_lived_pending += gc_list_size(young);
+		}
+		gc_list_merge(young, old);
+	}
+	else {
+		long_lived_pending = 0;
+		long_lived_total = gc_list_size(young);
+	}
+
+	n = collect_unreachable(&unreachable, old, t1);
+
+	/* Clear free list only during the collection of the higest
+	 * generation */
+	if (generation == NUM_GENERATIONS-1) {
+		clear_freelists();
+	}
+	return n;
+}
+
+/* The time in milliseconds, for fitting increments to pause_target. */
+static double
+increment_clock(void)
+{
+#ifdef HAVE_GETTIMEOFDAY
+	struct timeval t;
+#ifdef GETTIMEOFDAY_NO_TZ
+	gettimeofday(&t);
+#else
+	gettimeofday(&t, (struct timezone *)NULL);
+#endif
+	return (double)t.tv_sec * 1000.0 + (double)t.tv_usec * 0.001;
+#else
+	return (double)clock() * 1000.0 / CLOCKS_PER_SEC;
+#endif
+}
+
+/* Collect the next increment of an incremental pass over the oldest
+ * generation, starting a new pass if none is in progress.  See the notes
+ * about pause_target at the top of this file. */
+static Py_ssize_t
+collect_increment(void)
+{
+	int i;
+	Py_ssize_t n;
+	Py_ssize_t young_size; /* # objects from the younger generations */
+	Py_ssize_t slice;
+	Py_ssize_t budget;
+	PyGC_Head *pending = GEN_HEAD(NUM_GENERATIONS-1);
+	PyGC_Head increment; /* the objects we are examining */
+	PyGC_Head unreachable; /* non-problematic unreachable trash */
+	PyGC_Head *gc;
+	struct increment_state state;
+	double t1 = 0.0;
+	double start, elapsed;
+
+	if (debug & DEBUG_STATS) {
+		PySys_WriteStderr("gc: collecting increment%s...\n",
+				  incremental_pass ? "" : " of a new pass");
+		t1 = debug_stats_start();
+	}
+	start = increment_clock();
+
+	if (!incremental_pass) {
+		incremental_pass = 1;
+		visited_mark = visited_mark == GC_REACHABLE ? GC_VISITED :
+							      GC_REACHABLE;
+		visited_total = long_lived_total + long_lived_pending;
+		generations[NUM_GENERATIONS-1].count = 0;
+	}
+	for (i = 0; i < NUM_GENERATIONS-1; i++)
+		generations[i].count = 0;
+
+	/* The increment is made of the younger generations, the next
+	 * slice of the objects not visited yet in this pass, and as much
+	 * of what these refer to as the budget allows.
+	 */
+	gc_list_init(&increment);
+	for (slice = 0; slice < MIN_INCREMENT_SLICE; slice++) {
+		if (gc_list_is_empty(pending))
+			break;
+		gc_list_move(pending->gc.gc_next, &increment);
+	}
+	for (i = 0; i < NUM_GENERATIONS-1; i++)
+		gc_list_merge(GEN_HEAD(i), &increment);
+	young_size = gc_list_size(&increment) - slice;
+	update_refs(&increment);
+	state.budget = increment_budget;
+	state.work = 0;
+	state.base = 0;
+	state.slice = slice;
+	state.pulled = 0;
+	subtract_increment(&increment, pending, &state, slice + young_size);
+
+	gc_list_init(&unreachable);
+	move_unreachable(&increment, &unreachable);
+	if (visited_mark != GC_REACHABLE) {
+		for (gc = increment.gc.gc_next; gc != &increment;
+		     gc = gc->gc.gc_next)
+			gc->gc.gc_refs = visited_mark;
+	}
+	gc_list_merge(&increment, &old_visited);
+
+	n = collect_unreachable(&unreachable, &old_visited, t1);
+	visited_total += young_size - n;
+
+	if (gc_list_is_empty(pending)) {
+		/* The pass is over; everything left has been visited. */
+		gc_list_merge(&old_visited, pending);
+		incremental_pass = 0;
+		long_lived_pending = 0;
+		long_lived_total = visited_total > 0 ? visited_total : 0;
+		clear_freelists();
+	}
+
+	/* Size the next increment to fit the pause target, at the rate
+	 * this one went at, leaving time for the younger generations. */
+	elapsed = increment_clock() - start;
+	if (elapsed > 0.0)
+		budget = (Py_ssize_t)(state.work * (pause_target / elapsed)) -
+			 state.base;
+	else
+		budget = increment_budget * 2;
+	budget = (increment_budget + budget) / 2;
+	if (budget < MIN_INCREMENT_BUDGET)
+		budget = MIN_INCREMENT_BUDGET;
+	if (budget > PY_SSIZE_T_MAX / 4)
+		budget = PY_SSIZE_T_MAX / 4;
+	increment_budget = budget;
+	return n;
+}
+
 static Py_ssize_t
 collect_generations(void)
 {
@@ -982,7 +1289,16 @@ collect_generations(void)
 			if (i == NUM_GENERATIONS - 1
 			    && long_lived_pending < long_lived_total / 4)
 				continue;
-			n = collect(i);
+			/* With a pause target, full collections are done
+			   incrementally, and while a pass is in progress the
+			   collections of the middle generation do its
+			   increments. */
+			if (pause_target > 0.0 &&
+			    (i == NUM_GENERATIONS - 1 ||
+			     (incremental_pass && i == NUM_GENERATIONS - 2)))
+				n = collect_increment();
+			else
+				n = collect(i);
 			break;
 		}
 	}
@@ -1135,6 +1451,41 @@ gc_get_thresh(PyObject *self, PyObject *noargs)
 			     generations[2].threshold);
 }
 
+PyDoc_STRVAR(gc_set_pause_target__doc__,
+"set_pause_target(ms) -> None\n"
+"\n"
+"Collect the oldest generation incrementally, aiming to pause for no more\n"
+"than ms milliseconds at a time.  Zero makes full collections happen all\n"
+"at once again.\n");
+
+static PyObject *
+gc_set_pause_target(PyObject *self, PyObject *args)
+{
+	double ms;
+
+	if (!PyArg_ParseTuple(args, "d:set_pause_target", &ms))
+		return NULL;
+	if (ms < 0.0) {
+		PyErr_SetString(PyExc_ValueError,
+				"pause target must be non-negative");
+		return NULL;
+	}
+	pause_target = ms;
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+PyDoc_STRVAR(gc_get_pause_target__doc__,
+"get_pause_target() -> ms\n"
+"\n"
+"Return the current pause target for incremental collections\n");
+
+static PyObject *
+gc_get_pause_target(PyObject *self, PyObject *noargs)
+{
+	return PyFloat_FromDouble(pause_target);
+}
+
 PyDoc_STRVAR(gc_get_count__doc__,
 "get_count() -> (count0, count1, count2)\n"
 "\n"
@@ -1149,6 +1500,70 @@ gc_get_count(PyObject *self, PyObject *noargs)
 			     generations[2].count);
 }
 
+PyDoc_STRVAR(gc_freeze__doc__,
+"freeze() -> None\n"
+"\n"
+"Move all the objects tracked by the collector to a permanent generation,\n"
+"which collections ignore.\n");
+
+static PyObject *
+gc_freeze(PyObject *self, PyObject *noargs)
+{
+	int i;
+	PyGC_Head *gc;
+
+	/* Mark the new objects before appending them, so the ones already
+	 * frozen aren't written to again. */
+	gc_list_merge(&old_visited, GEN_HEAD(NUM_GENERATIONS-1));
+	incremental_pass = 0;
+	visited_mark = GC_REACHABLE;
+	for (i = 0; i < NUM_GENERATIONS; i++) {
+		for (gc = GEN_HEAD(i)->gc.gc_next; gc != GEN_HEAD(i);
+		     gc = gc->gc.gc_next)
+			gc->gc.gc_refs = GC_FROZEN;
+		gc_list_merge(GEN_HEAD(i), &permanent_generation);
+		generations[i].count = 0;
+	}
+	long_lived_total = 0;
+	long_lived_pending = 0;
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+PyDoc_STRVAR(gc_unfreeze__doc__,
+"unfreeze() -> None\n"
+"\n"
+"Move the objects in the permanent generation back to the oldest\n"
+"generation.\n");
+
+static PyObject *
+gc_unfreeze(PyObject *self, PyObject *noargs)
+{
+	PyGC_Head *gc;
+	Py_ssize_t n = 0;
+
+	for (gc = permanent_generation.gc.gc_next;
+	     gc != &permanent_generation; gc = gc->gc.gc_next) {
+		gc->gc.gc_refs = GC_REACHABLE;
+		n++;
+	}
+	gc_list_merge(&permanent_generation, GEN_HEAD(NUM_GENERATIONS-1));
+	long_lived_pending += n;
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+PyDoc_STRVAR(gc_get_freeze_count__doc__,
+"get_freeze_count() -> int\n"
+"\n"
+"Return the number of objects in the permanent generation.\n");
+
+static PyObject *
+gc_get_freeze_count(PyObject *self, PyObject *noargs)
+{
+	return PyInt_FromSsize_t(gc_list_size(&permanent_generation));
+}
+
 static int
 referrersvisit(PyObject* obj, PyObject *objs)
 {
@@ -1195,6 +1610,11 @@ gc_get_referrers(PyObject *self, PyObject *args)
 			return NULL;
 		}
 	}
+	if (!(gc_referrers_for(args, &old_visited, result)) ||
+	    !(gc_referrers_for(args, &permanent_generation, result))) {
+		Py_DECREF(result);
+		return NULL;
+	}
 	return result;
 }
 
@@ -1256,6 +1676,11 @@ gc_get_objects(PyObject *self, PyObject *noargs)
 			return NULL;
 		}
 	}
+	if (append_objects(result, &old_visited) ||
+	    append_objects(result, &permanent_generation)) {
+		Py_DECREF(result);
+		return NULL;
+	}
 	return result;
 }
 
@@ -1272,6 +1697,11 @@ PyDoc_STRVAR(gc__doc__,
 "get_debug() -- Get debugging flags.\n"
 "set_threshold() -- Set the collection thresholds.\n"
 "get_threshold() -- Return the current the collection thresholds.\n"
+"set_pause_target() -- Collect the oldest generation incrementally.\n"
+"get_pause_target() -- Return the current pause target.\n"
+"freeze() -- Make collections ignore all the objects tracked so far.\n"
+"unfreeze() -- Make collections examine the frozen objects again.\n"
+"get_freeze_count() -- Return the number of frozen objects.\n"
 "get_objects() -- Return a list of all objects tracked by the collector.\n"
 "get_referrers() -- Return the list of objects that refer to an object.\n"
 "get_referents() -- Return the list of objects that an object refers to.\n");
@@ -1285,8 +1715,16 @@ static PyMethodDef GcMethods[] = {
 	{"get_count",	   gc_get_count,  METH_NOARGS,  gc_get_count__doc__},
 	{"set_threshold",  gc_set_thresh, METH_VARARGS, gc_set_thresh__doc__},
 	{"get_threshold",  gc_get_thresh, METH_NOARGS,  gc_get_thresh__doc__},
+	{"set_pause_target", gc_set_pause_target, METH_VARARGS,
+		gc_set_pause_target__doc__},
+	{"get_pause_target", gc_get_pause_target, METH_NOARGS,
+		gc_get_pause_target__doc__},
 	{"collect",	   (PyCFunction)gc_collect,
          	METH_VARARGS | METH_KEYWORDS,           gc_collect__doc__},
+	{"freeze",	   gc_freeze,	  METH_NOARGS,  gc_freeze__doc__},
+	{"unfreeze",	   gc_unfreeze,	  METH_NOARGS,  gc_unfreeze__doc__},
+	{"get_freeze_count", gc_get_freeze_count, METH_NOARGS,
+		gc_get_freeze_count__doc__},
 	{"get_objects",    gc_get_objects,METH_NOARGS,  gc_get_objects__doc__},
 	{"get_referrers",  gc_get_referrers, METH_VARARGS,
 		gc_get_referrers__doc__},
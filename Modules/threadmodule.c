@@ -38,19 +38,49 @@ static PyObject *
 lock_PyThread_acquire_lock(lockobject *self, PyObject *args)
 {
 	int i = 1;
+	double timeout = -1;
+	PY_TIMEOUT_T microseconds;
 
-	if (!PyArg_ParseTuple(args, "|i:acquire", &i))
+	if (!PyArg_ParseTuple(args, "|id:acquire", &i, &timeout))
 		return NULL;
 
-	Py_BEGIN_ALLOW_THREADS
-	i = PyThread_acquire_lock(self->lock_lock, i);
-	Py_END_ALLOW_THREADS
+	if (!i && timeout != -1) {
+		PyErr_SetString(PyExc_ValueError, "can't specify a timeout "
+				"for a non-blocking call");
+		return NULL;
+	}
+	if (timeout < 0 && timeout != -1) {
+		PyErr_SetString(PyExc_ValueError, "timeout value must be "
+				"strictly positive");
+		return NULL;
+	}
+	if (!i)
+		microseconds = 0;
+	else if (timeout == -1)
+		microseconds = -1;
+	else {
+		timeout *= 1e6;
+		if (timeout >= (double) PY_TIMEOUT_MAX) {
+			PyErr_SetString(PyExc_OverflowError,
+					"timeout value is too large");
+			return NULL;
+		}
+		microseconds = (PY_TIMEOUT_T) timeout;
+	}
+
+	/* Only release the GIL if we have to wait */
+	i = PyThread_acquire_lock_timed(self->lock_lock, 0);
+	if (!i && microseconds != 0) {
+		Py_BEGIN_ALLOW_THREADS
+		i = PyThread_acquire_lock_timed(self->lock_lock, microseconds);
+		Py_END_ALLOW_THREADS
+	}
 
 	return PyBool_FromLong((long)i);
 }
 
 PyDoc_STRVAR(acquire_doc,
-"acquire([wait]) -> None or bool\n\
+"acquire([wait[, timeout]]) -> None or bool\n\
 (acquire_lock() is an obsolete synonym)\n\
 \n\
 Lock the lock.  Without argument, this blocks if the lock is already\n\
@@ -58,6 +88,8 @@ locked (even by the same thread), waiting for another thread to release\n\
 the lock, and return None once the lock is acquired.\n\
 With an argument, this will only block if the argument is true,\n\
 and the return value reflects whether the lock is acquired.\n\
+If timeout is given and positive, a blocking call gives up after\n\
+waiting that many seconds.\n\
 The blocking operation is not interruptible.");
 
 static PyObject *
@@ -731,6 +763,12 @@ initthread(void)
 	if (PyModule_AddObject(m, "_local", (PyObject *)&localtype) < 0)
 		return;
 
+	/* The longest timeout lock.acquire() accepts, in seconds */
+	if (PyModule_AddObject(m, "TIMEOUT_MAX",
+			       PyFloat_FromDouble(
+					(double)(PY_TIMEOUT_MAX / 1000000))) < 0)
+		return;
+
 	/* Initialize the C thread library */
 	PyThread_init_thread();
 }
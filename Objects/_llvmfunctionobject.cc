@@ -84,6 +84,8 @@ _LlvmFunction_New(void *llvm_function)
 void
 _LlvmFunction_Dealloc(_LlvmFunction *functionobj)
 {
+    // Another thread may be emitting code into the same module.
+    PyGlobalLlvmData::ScopedLock lock(PyGlobalLlvmData::Get());
     llvm::Function *function = functionobj->lf_function;
     // Clear the AssertingVH to avoid crashing when we delete the function.
     functionobj->lf_function = NULL;
@@ -141,14 +143,11 @@ clear_body(llvm::Function *function)
         globals_vect.begin(), globals_vect.end(), "", entry);
 }
 
-PyEvalFrameFunction
-_LlvmFunction_Jit(_LlvmFunction *function_obj)
+// Emits machine code for function and clears its body.  This doesn't
+// touch any Python objects, so it can run without the GIL.
+static PyEvalFrameFunction
+emit_machine_code(llvm::ExecutionEngine *engine, llvm::Function *function)
 {
-    llvm::Function *function = (llvm::Function *)function_obj->lf_function;
-    PyGlobalLlvmData *global_llvm_data =
-        PyThreadState_GET()->interp->global_llvm_data;
-    llvm::ExecutionEngine *engine = global_llvm_data->getExecutionEngine();
-
     PyEvalFrameFunction native_func;
 #ifdef Py_WITH_INSTRUMENTATION
     llvm::MachineCodeInfo code_info;
@@ -171,6 +170,32 @@ _LlvmFunction_Jit(_LlvmFunction *function_obj)
     return native_func;
 }
 
+PyEvalFrameFunction
+_LlvmFunction_Jit(_LlvmFunction *function_obj)
+{
+    PyGlobalLlvmData *global_llvm_data =
+        PyThreadState_GET()->interp->global_llvm_data;
+    llvm::ExecutionEngine *engine = global_llvm_data->getExecutionEngine();
+
+    PyGlobalLlvmData::ScopedLock lock(global_llvm_data);
+    llvm::Function *function = (llvm::Function *)function_obj->lf_function;
+    // Another thread may have emitted this function while we waited for
+    // the lock, and cleared its body since.
+    PyEvalFrameFunction native_func =
+        (PyEvalFrameFunction)engine->getPointerToGlobalIfAvailable(function);
+    if (native_func != NULL)
+        return native_func;
+
+    // Let any other threads run while we work.  The lock keeps them
+    // from changing the module under us.
+    if (!PyEval_ThreadsInitialized())
+        return emit_machine_code(engine, function);
+    Py_BEGIN_ALLOW_THREADS
+    native_func = emit_machine_code(engine, function);
+    Py_END_ALLOW_THREADS
+    return native_func;
+}
+
 int
 _LlvmFunction_Optimize(PyGlobalLlvmData *global_data,
                        _LlvmFunction *llvm_function,
@@ -229,6 +254,9 @@ llvmfunction_str(PyLlvmFunctionObject *functionobj)
     // them. Compile the code object back to IR, then throw that IR away. We
     // assume that people aren't printing out code objects in tight loops.
     PyCodeObject *code = functionobj->code_object;
+    // Keep other threads from compiling this code object while its
+    // fields are swapped out.
+    PyGlobalLlvmData::ScopedLock lock(PyGlobalLlvmData::Get());
     _LlvmFunction *cur_function = code->co_llvm_function;
     int cur_opt_level = code->co_optimization;
     // Null these out to trick _PyCode_ToOptimizedLlvmIr() into recompiling
@@ -2174,22 +2174,21 @@ Py_LOCAL_INLINE(PyObject *)
 split_char(const char *s, Py_ssize_t len, char ch, Py_ssize_t maxcount)
 {
     register Py_ssize_t i, j, count = 0;
+    Py_ssize_t pos;
     PyObject *str;
     PyObject *list = PyList_New(PREALLOC_SIZE(maxcount));
 
     if (list == NULL)
         return NULL;
 
-    i = j = 0;
-    while ((j < len) && (maxcount-- > 0)) {
-        for(; j < len; j++) {
-            /* I found that using memchr makes no difference */
-            if (s[j] == ch) {
-                SPLIT_ADD(s, i, j);
-                i = j = j + 1;
-                break;
-            }
-        }
+    i = 0;
+    while (maxcount-- > 0) {
+        pos = fastsearch(s+i, len-i, &ch, 1, FAST_SEARCH);
+        if (pos < 0)
+            break;
+        j = i+pos;
+        SPLIT_ADD(s, i, j);
+        i = j + 1;
     }
     if (i <= len) {
         SPLIT_ADD(s, i, len);
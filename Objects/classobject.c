@@ -4,14 +4,12 @@
 #include "Python.h"
 #include "structmember.h"
 
-/* Free list for method objects to safe malloc/free overhead
- * The im_self element is used to chain the elements.
- */
-static PyMethodObject *free_list;
-static int numfree = 0;
+/* Free list for method objects to safe malloc/free overhead */
 #ifndef PyMethod_MAXFREELIST
 #define PyMethod_MAXFREELIST 256
 #endif
+static _PyFreeList free_list = _PyFreeList_INIT("instancemethod",
+						PyMethod_MAXFREELIST, 1);
 
 #define TP_DESCR_GET(t) \
     (PyType_HasFeature(t, Py_TPFLAGS_HAVE_CLASS) ? (t)->tp_descr_get : NULL)
@@ -130,6 +128,7 @@ alloc_error:
 	Py_XINCREF(op->cl_getattr);
 	Py_XINCREF(op->cl_setattr);
 	Py_XINCREF(op->cl_delattr);
+	op->cl_cached_keys = NULL;
 	_PyObject_GC_TRACK(op);
 	return (PyObject *) op;
 }
@@ -194,6 +193,7 @@ class_dealloc(PyClassObject *op)
 	Py_XDECREF(op->cl_getattr);
 	Py_XDECREF(op->cl_setattr);
 	Py_XDECREF(op->cl_delattr);
+	_PyDict_ClearSharedKeys(&op->cl_cached_keys);
 	PyObject_GC_Del(op);
 }
 
@@ -509,7 +509,8 @@ PyInstance_NewRaw(PyObject *klass, PyObject *dict)
 		return NULL;
 	}
 	if (dict == NULL) {
-		dict = PyDict_New();
+		dict = _PyDict_NewShared(
+			&((PyClassObject *)klass)->cl_cached_keys);
 		if (dict == NULL)
 			return NULL;
 	}
@@ -2230,12 +2231,9 @@ PyMethod_New(PyObject *func, PyObject *self, PyObject *klass)
 		PyErr_BadInternalCall();
 		return NULL;
 	}
-	im = free_list;
-	if (im != NULL) {
-		free_list = (PyMethodObject *)(im->im_self);
+	_PyFreeList_POP(&free_list, im);
+	if (im != NULL)
 		PyObject_INIT(im, &PyMethod_Type);
-		numfree--;
-	}
 	else {
 		im = PyObject_GC_New(PyMethodObject, &PyMethod_Type);
 		if (im == NULL)
@@ -2364,14 +2362,7 @@ instancemethod_dealloc(register PyMethodObject *im)
 	Py_DECREF(im->im_func);
 	Py_XDECREF(im->im_self);
 	Py_XDECREF(im->im_class);
-	if (numfree < PyMethod_MAXFREELIST) {
-		im->im_self = (PyObject *)free_list;
-		free_list = im;
-		numfree++;
-	}
-	else {
-		PyObject_GC_Del(im);
-	}
+	_PyFreeList_FREE(&free_list, im);
 }
 
 static int
@@ -2654,16 +2645,7 @@ PyTypeObject PyMethod_Type = {
 int
 PyMethod_ClearFreeList(void)
 {
-	int freelist_size = numfree;
-	
-	while (free_list) {
-		PyMethodObject *im = free_list;
-		free_list = (PyMethodObject *)(im->im_self);
-		PyObject_GC_Del(im);
-		numfree--;
-	}
-	assert(numfree == 0);
-	return freelist_size;
+	return _PyFreeList_Clear(&free_list);
 }
 
 void
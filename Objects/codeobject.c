@@ -257,22 +257,29 @@ _PyCode_ToOptimizedLlvmIr(PyCodeObject *code, int new_opt_level)
 	// exec.
 	if (code->co_flags & CO_USES_EXEC)
 		return 1;
+	global_llvm_data = PyThreadState_GET()->interp->global_llvm_data;
+	/* Optimizing releases the GIL.  Keep the LLVM lock until it's done
+	   so no other thread JITs the function half-optimized. */
+	PyGlobalLlvmData_Lock(global_llvm_data);
 	if (code->co_llvm_function == NULL) {
 		code->co_llvm_function = _PyCode_ToLlvmIr(code);
-		if (code->co_llvm_function == NULL)
+		if (code->co_llvm_function == NULL) {
+			PyGlobalLlvmData_Unlock(global_llvm_data);
 			return -1;
+		}
 	}
-	global_llvm_data = PyThreadState_GET()->interp->global_llvm_data;
 	if (code->co_optimization < new_opt_level &&
 	    PyGlobalLlvmData_Optimize(global_llvm_data,
 				      code->co_llvm_function,
 				      new_opt_level) < 0) {
+		PyGlobalLlvmData_Unlock(global_llvm_data);
 		PyErr_Format(PyExc_SystemError,
 			     "Failed to optimize to level %d",
 			     new_opt_level);
 		return -1;
 	}
 	code->co_optimization = new_opt_level;
+	PyGlobalLlvmData_Unlock(global_llvm_data);
 	return 0;
 }
 #else
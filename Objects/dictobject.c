@@ -8,6 +8,7 @@
 */
 
 #include "Python.h"
+#include <stddef.h>	/* For offsetof */
 
 
 /* Set a key error with the specified argument, wrapping it in a
@@ -134,21 +135,69 @@ practice, this probably won't make a lick of difference for many years (at
 which point everyone will have terabytes of RAM on 64-bit boxes).
 */
 
-/* Object used as dummy key to fill deleted entries */
-static PyObject *dummy = NULL; /* Initialized by first call to newPyDictObject() */
+#define IX_EMPTY _PyDict_IX_EMPTY
+#define IX_DUMMY _PyDict_IX_DUMMY
+#define IX_ERROR _PyDict_IX_ERROR
+#define USABLE(n) _PyDict_USABLE(n)
+
+/* The slots of ma_indices are as narrow as the indices of the entries of
+   ma_table allow: one byte each for tables of up to 128 slots, then two,
+   then four, then a Py_ssize_t.  Tables are always accessed through
+   these, which dispatch on the table's mask. */
+static size_t
+ix_size(size_t mask)
+{
+	if (mask < 0x80)
+		return 1;
+	if (mask < 0x8000)
+		return 2;
+#if SIZEOF_SIZE_T > 4
+	if (mask < 0x80000000UL)
+		return 4;
+#endif
+	return sizeof(Py_ssize_t);
+}
 
-#ifdef Py_REF_DEBUG
-PyObject *
-_PyDict_Dummy(void)
+Py_LOCAL_INLINE(Py_ssize_t)
+get_index(void *indices, size_t mask, size_t i)
 {
-	return dummy;
+	if (mask < 0x80)
+		return ((signed char *)indices)[i];
+	if (mask < 0x8000)
+		return ((short *)indices)[i];
+#if SIZEOF_SIZE_T > 4
+	if (mask < 0x80000000UL)
+		return ((int *)indices)[i];
+#endif
+	return ((Py_ssize_t *)indices)[i];
 }
+
+Py_LOCAL_INLINE(void)
+set_index(void *indices, size_t mask, size_t i, Py_ssize_t ix)
+{
+	if (mask < 0x80)
+		((signed char *)indices)[i] = (signed char)ix;
+	else if (mask < 0x8000)
+		((short *)indices)[i] = (short)ix;
+#if SIZEOF_SIZE_T > 4
+	else if (mask < 0x80000000UL)
+		((int *)indices)[i] = (int)ix;
 #endif
+	else
+		((Py_ssize_t *)indices)[i] = ix;
+}
+
+/* The number of bytes taken by the tables of a dict whose ma_indices has
+   size slots; ma_table follows ma_indices in a single block. */
+#define TABLES_NBYTES(size) \
+	((size) * ix_size((size) - 1) + USABLE(size) * sizeof(PyDictEntry))
 
 /* forward declarations */
-static PyDictEntry *lookdict_string(PyDictObject *mp, PyObject *key, long hash);
+static Py_ssize_t lookdict_string(PyDictObject *mp, PyObject *key, long hash);
 static void notify_watchers(PyDictObject *self);
 static void del_watchers_array(PyDictObject *self);
+static int dictresize(PyDictObject *mp, Py_ssize_t minused);
+static void shared_keys_decref(PyDictSharedKeys *dk);
 
 #ifdef SHOW_CONVERSION_COUNTS
 static long created = 0L;
@@ -187,20 +236,50 @@ show_alloc(void)
    can save a little time over what PyDict_New does because it's guaranteed
    that the PyDictObject struct is already zeroed out.
    Everyone except dict_new() should use EMPTY_TO_MINSIZE (unless they have
-   an excellent reason not to).
+   an excellent reason not to).  Only the first ma_nentries entries of
+   ma_table are ever looked at, so ma_smalltable needn't be cleared.
 */
 
 #define INIT_NONZERO_DICT_SLOTS(mp) do {				\
 	(mp)->ma_table = (mp)->ma_smalltable;				\
+	(mp)->ma_indices = (mp)->ma_smallindices;			\
 	(mp)->ma_mask = PyDict_MINSIZE - 1;				\
+	memset((mp)->ma_smallindices, 0xff,				\
+	       sizeof((mp)->ma_smallindices));				\
     } while(0)
 
 #define EMPTY_TO_MINSIZE(mp) do {					\
-	memset((mp)->ma_smalltable, 0, sizeof((mp)->ma_smalltable));	\
-	(mp)->ma_used = (mp)->ma_fill = 0;				\
+	(mp)->ma_used = (mp)->ma_fill = (mp)->ma_nentries = 0;		\
 	INIT_NONZERO_DICT_SLOTS(mp);					\
     } while(0)
 
+/* The value of entry i of mp's table, split or not.  An lvalue. */
+#define DICT_VALUE(mp, i)						\
+	(*((mp)->ma_values != NULL ? &(mp)->ma_values[i]		\
+				   : &(mp)->ma_table[i].me_value))
+
+/* The tables shared by split dicts.  dk_refcnt counts the dicts sharing
+   them, plus one for the cache that hands them out; see
+   _PyDict_NewShared().  Keys are only ever added to them, and only exact
+   strings, so that lookdict_string() can serve split dicts. */
+struct _dictsharedkeys {
+	Py_ssize_t dk_refcnt;
+	Py_ssize_t dk_size;	/* number of slots, a power of 2 */
+	Py_ssize_t dk_nkeys;	/* number of keys */
+	int dk_full;		/* a dict had a key that didn't fit */
+	PyDictEntry *dk_entries;	/* USABLE(dk_size) of them */
+	signed char dk_indices[1];	/* dk_size slots, then dk_entries */
+};
+
+/* The shared keys whose dk_indices is indices */
+#define SHARED_KEYS(indices) \
+	((PyDictSharedKeys *)((char *)(indices) - \
+			      offsetof(PyDictSharedKeys, dk_indices)))
+
+/* Full shared tables are replaced by ones twice their size, up to this
+   many slots; after that, their cache hands out ordinary dicts. */
+#define SHARED_KEYS_MAXSIZE 128
+
 /* Dictionary reuse scheme to save calls to malloc, free, and memset */
 #ifndef PyDict_MAXFREELIST
 #define PyDict_MAXFREELIST 80
@@ -224,10 +303,10 @@ PyObject *
 PyDict_New(void)
 {
 	register PyDictObject *mp;
-	if (dummy == NULL) { /* Auto-initialize dummy */
-		dummy = PyString_FromString("<dummy key>");
-		if (dummy == NULL)
-			return NULL;
+#if defined(SHOW_CONVERSION_COUNTS) || defined(SHOW_ALLOC_COUNT)
+	static int initialized = 0;
+	if (!initialized) {
+		initialized = 1;
 #ifdef SHOW_CONVERSION_COUNTS
 		Py_AtExit(show_counts);
 #endif
@@ -235,21 +314,12 @@ PyDict_New(void)
 		Py_AtExit(show_alloc);
 #endif
 	}
+#endif
 	if (numfree) {
 		mp = free_list[--numfree];
 		assert (mp != NULL);
 		assert (Py_TYPE(mp) == &PyDict_Type);
 		_Py_NewReference((PyObject *)mp);
-		if (mp->ma_fill) {
-			EMPTY_TO_MINSIZE(mp);
-		} else {
-			/* At least set ma_table and ma_mask; these are wrong
-			   if an empty but presized dict is added to freelist */
-			INIT_NONZERO_DICT_SLOTS(mp);
-		}
-		assert (mp->ma_used == 0);
-		assert (mp->ma_table == mp->ma_smalltable);
-		assert (mp->ma_mask == PyDict_MINSIZE - 1);
 #ifdef SHOW_ALLOC_COUNT
 		count_reuse++;
 #endif
@@ -257,12 +327,14 @@ PyDict_New(void)
 		mp = PyObject_GC_New(PyDictObject, &PyDict_Type);
 		if (mp == NULL)
 			return NULL;
-		EMPTY_TO_MINSIZE(mp);
 #ifdef SHOW_ALLOC_COUNT
 		count_alloc++;
 #endif
 	}
+	EMPTY_TO_MINSIZE(mp);
 	mp->ma_lookup = lookdict_string;
+	mp->ma_values = NULL;
+	mp->ma_truncated = 0;
 #ifdef WITH_LLVM
 	mp->ma_watchers = NULL;
 	mp->ma_watchers_used = 0;
@@ -275,6 +347,26 @@ PyDict_New(void)
 	return (PyObject *)mp;
 }
 
+/* Composite keys are often built afresh for every lookup from the same
+   objects.  Two exact tuples holding identical items are equal, since
+   PyObject_RichCompareBool() takes identical objects to be equal, so
+   lookdict() can match them without the generic comparison. */
+Py_LOCAL_INLINE(int)
+tuple_items_identical(PyObject *a, PyObject *b)
+{
+	Py_ssize_t i, n;
+
+	if (!PyTuple_CheckExact(a) || !PyTuple_CheckExact(b))
+		return 0;
+	n = PyTuple_GET_SIZE(a);
+	if (PyTuple_GET_SIZE(b) != n)
+		return 0;
+	for (i = 0; i < n; i++)
+		if (PyTuple_GET_ITEM(a, i) != PyTuple_GET_ITEM(b, i))
+			return 0;
+	return 1;
+}
+
 /*
 The basic lookup function used by all operations.
 This is based on Algorithm D from Knuth Vol. 3, Sec. 6.4.
@@ -290,89 +382,66 @@ All arithmetic on hash should ignore overflow.
 contributions by Reimer Behrends, Jyrki Alakuijala, Vladimir Marangozov and
 Christian Tismer).
 
-lookdict() is general-purpose, and may return NULL if (and only if) a
+lookdict() is general-purpose, and may return IX_ERROR if (and only if) a
 comparison raises an exception (this was new in Python 2.5).
 lookdict_string() below is specialized to string keys, comparison of which can
-never raise an exception; that function can never return NULL.  For both, when
-the key isn't found a PyDictEntry* is returned for which the me_value field is
-NULL; this is the slot in the dict at which the key would have been found, and
-the caller can (if it wishes) add the <key, value> pair to the returned
-PyDictEntry*.
+never raise an exception; that function can never return IX_ERROR.  Both
+return the index in ma_table of the entry for the key, or IX_EMPTY when
+the key isn't found; find_empty_slot() then gives the slot of ma_indices
+at which the caller can (if it wishes) add the <key, value> pair.  For a
+split dict, the key may be found but have no value in the dict; read the
+value with _PyDict_VALUE() rather than from me_value.
 */
-static PyDictEntry *
+static Py_ssize_t
 lookdict(PyDictObject *mp, PyObject *key, register long hash)
 {
 	register size_t i;
 	register size_t perturb;
-	register PyDictEntry *freeslot;
 	register size_t mask = (size_t)mp->ma_mask;
 	PyDictEntry *ep0 = mp->ma_table;
+	void *indices = mp->ma_indices;
 	register PyDictEntry *ep;
+	register Py_ssize_t ix;
 	register int cmp;
 	PyObject *startkey;
 
 	i = (size_t)hash & mask;
-	ep = &ep0[i];
-	if (ep->me_key == NULL || ep->me_key == key)
-		return ep;
-
-	if (ep->me_key == dummy)
-		freeslot = ep;
-	else {
-		if (ep->me_hash == hash) {
-			startkey = ep->me_key;
-			Py_INCREF(startkey);
-			cmp = PyObject_RichCompareBool(startkey, key, Py_EQ);
-			Py_DECREF(startkey);
-			if (cmp < 0)
-				return NULL;
-			if (ep0 == mp->ma_table && ep->me_key == startkey) {
-				if (cmp > 0)
-					return ep;
-			}
-			else {
-				/* The compare did major nasty stuff to the
-				 * dict:  start over.
-				 * XXX A clever adversary could prevent this
-				 * XXX from terminating.
- 				 */
- 				return lookdict(mp, key, hash);
- 			}
-		}
-		freeslot = NULL;
-	}
-
-	/* In the loop, me_key == dummy is by far (factor of 100s) the
-	   least likely outcome, so test for that last. */
 	for (perturb = hash; ; perturb >>= PERTURB_SHIFT) {
-		i = (i << 2) + i + perturb + 1;
-		ep = &ep0[i & mask];
-		if (ep->me_key == NULL)
-			return freeslot == NULL ? ep : freeslot;
-		if (ep->me_key == key)
-			return ep;
-		if (ep->me_hash == hash && ep->me_key != dummy) {
-			startkey = ep->me_key;
-			Py_INCREF(startkey);
-			cmp = PyObject_RichCompareBool(startkey, key, Py_EQ);
-			Py_DECREF(startkey);
-			if (cmp < 0)
-				return NULL;
-			if (ep0 == mp->ma_table && ep->me_key == startkey) {
-				if (cmp > 0)
-					return ep;
+		ix = get_index(indices, mask, i & mask);
+		if (ix == IX_EMPTY)
+			return IX_EMPTY;
+		/* Dummy slots are by far (factor of 100s) the least likely
+		   outcome, so they just fall through. */
+		if (ix >= 0) {
+			ep = &ep0[ix];
+			if (ep->me_key == key)
+				return ix;
+			if (ep->me_hash == hash) {
+				startkey = ep->me_key;
+				if (tuple_items_identical(startkey, key))
+					return ix;
+				Py_INCREF(startkey);
+				cmp = PyObject_RichCompareBool(startkey, key,
+							       Py_EQ);
+				Py_DECREF(startkey);
+				if (cmp < 0)
+					return IX_ERROR;
+				if (ep0 == mp->ma_table &&
+				    ep->me_key == startkey) {
+					if (cmp > 0)
+						return ix;
+				}
+				else {
+					/* The compare did major nasty stuff
+					 * to the dict:  start over.
+					 * XXX A clever adversary could prevent
+					 * XXX this from terminating.
+					 */
+					return lookdict(mp, key, hash);
+				}
 			}
-			else {
-				/* The compare did major nasty stuff to the
-				 * dict:  start over.
-				 * XXX A clever adversary could prevent this
-				 * XXX from terminating.
- 				 */
- 				return lookdict(mp, key, hash);
- 			}
 		}
-		else if (ep->me_key == dummy && freeslot == NULL)
-			freeslot = ep;
+		i = (i << 2) + i + perturb + 1;
 	}
 	assert(0);	/* NOT REACHED */
 	return 0;
@@ -387,15 +456,16 @@ lookdict(PyDictObject *mp, PyObject *key, register long hash)
  *
  * This is valuable because dicts with only string keys are very common.
  */
-static PyDictEntry *
+static Py_ssize_t
 lookdict_string(PyDictObject *mp, PyObject *key, register long hash)
 {
 	register size_t i;
 	register size_t perturb;
-	register PyDictEntry *freeslot;
 	register size_t mask = (size_t)mp->ma_mask;
 	PyDictEntry *ep0 = mp->ma_table;
+	void *indices = mp->ma_indices;
 	register PyDictEntry *ep;
+	register Py_ssize_t ix;
 
 	/* Make sure this function doesn't have to handle non-string keys,
 	   including subclasses of str; e.g., one reason to subclass
@@ -409,39 +479,89 @@ lookdict_string(PyDictObject *mp, PyObject *key, register long hash)
 		return lookdict(mp, key, hash);
 	}
 	i = hash & mask;
-	ep = &ep0[i];
-	if (ep->me_key == NULL || ep->me_key == key)
-		return ep;
-	if (ep->me_key == dummy)
-		freeslot = ep;
-	else {
-		if (ep->me_hash == hash && _PyString_Eq(ep->me_key, key))
-			return ep;
-		freeslot = NULL;
-	}
-
-	/* In the loop, me_key == dummy is by far (factor of 100s) the
-	   least likely outcome, so test for that last. */
 	for (perturb = hash; ; perturb >>= PERTURB_SHIFT) {
+		ix = get_index(indices, mask, i & mask);
+		if (ix == IX_EMPTY)
+			return IX_EMPTY;
+		if (ix >= 0) {
+			ep = &ep0[ix];
+			if (ep->me_key == key ||
+			    (ep->me_hash == hash &&
+			     _PyString_Eq(ep->me_key, key)))
+				return ix;
+		}
 		i = (i << 2) + i + perturb + 1;
-		ep = &ep0[i & mask];
-		if (ep->me_key == NULL)
-			return freeslot == NULL ? ep : freeslot;
-		if (ep->me_key == key
-		    || (ep->me_hash == hash
-		        && ep->me_key != dummy
-			&& _PyString_Eq(ep->me_key, key)))
-			return ep;
-		if (ep->me_key == dummy && freeslot == NULL)
-			freeslot = ep;
 	}
 	assert(0);	/* NOT REACHED */
 	return 0;
 }
 
+/*
+Return the slot of indices, a table of mask + 1 slots, at which a key
+with the given hash, known to be absent from it, can be added: the first
+Unused or Dummy slot of its probe sequence.
+*/
+static size_t
+find_empty_slot(void *indices, size_t mask, long hash)
+{
+	register size_t i;
+	register size_t perturb;
+
+	i = hash & mask;
+	for (perturb = hash; get_index(indices, mask, i & mask) >= 0;
+	     perturb >>= PERTURB_SHIFT)
+		i = (i << 2) + i + perturb + 1;
+	return i & mask;
+}
+
+/* Return the slot of indices that refers to entry ix, whose hash is hash. */
+static size_t
+lookdict_index(void *indices, size_t mask, long hash, Py_ssize_t ix)
+{
+	register size_t i;
+	register size_t perturb;
+
+	i = hash & mask;
+	for (perturb = hash; get_index(indices, mask, i & mask) != ix;
+	     perturb >>= PERTURB_SHIFT) {
+		assert(get_index(indices, mask, i & mask) != IX_EMPTY);
+		i = (i << 2) + i + perturb + 1;
+	}
+	return i & mask;
+}
+
+/* Fill indices, a table of mask + 1 slots, with the slots of the n
+   entries of ep0, which have no holes.  No refcounts are changed. */
+static void
+build_indices(void *indices, size_t mask, PyDictEntry *ep0, Py_ssize_t n)
+{
+	Py_ssize_t ix;
+
+	memset(indices, 0xff, (mask + 1) * ix_size(mask));
+	for (ix = 0; ix < n; ix++)
+		set_index(indices, mask,
+			  find_empty_slot(indices, mask, (long)ep0[ix].me_hash),
+			  ix);
+}
+
+/* Does the split dict mp have a value for an entry after entry ix? */
+static int
+has_values_after(PyDictObject *mp, Py_ssize_t ix)
+{
+	Py_ssize_t n = SHARED_KEYS(mp->ma_indices)->dk_nkeys;
+
+	while (++ix < n) {
+		if (mp->ma_values[ix] != NULL)
+			return 1;
+	}
+	return 0;
+}
+
 /*
 Internal routine to insert a new item into the table.
-Used both by the internal resize routine and by the public insert routine.
+Used by the public insert routine, and by those that fill a dict they
+made room in.  The key goes at the end of ma_table; if ma_table is full,
+the dict is resized first, so that this never fails for want of room.
 Eats a reference to key and one to value.
 Returns -1 if an error occurred; return 0 on success; return 1 on success if
 the insert didn't actually change the dict.
@@ -451,154 +571,224 @@ insertdict(register PyDictObject *mp, PyObject *key, long hash, PyObject *value)
 {
 	PyObject *old_value;
 	register PyDictEntry *ep;
-	typedef PyDictEntry *(*lookupfunc)(PyDictObject *, PyObject *, long);
+	register Py_ssize_t ix;
+	size_t i;
 
 	assert(mp->ma_lookup != NULL);
-	ep = mp->ma_lookup(mp, key, hash);
-	if (ep == NULL) {
+	ix = mp->ma_lookup(mp, key, hash);
+	if (ix == IX_ERROR) {
 		Py_DECREF(key);
 		Py_DECREF(value);
 		return -1;
 	}
-	if (ep->me_value != NULL) {
+	if (mp->ma_values != NULL) {
+		/* A split dict.  Its tables have no dummies and no holes. */
+		PyObject **vp;
+		if (ix == IX_EMPTY) {
+			PyDictSharedKeys *dk = SHARED_KEYS(mp->ma_indices);
+			if (!PyString_CheckExact(key) ||
+			    dk->dk_nkeys >= USABLE(dk->dk_size)) {
+				/* The key doesn't belong in the shared
+				   tables, so give the dict its own. */
+				if (PyString_CheckExact(key))
+					dk->dk_full = 1;
+				if (dictresize(mp, 4 * (mp->ma_used + 1))) {
+					Py_DECREF(key);
+					Py_DECREF(value);
+					return -1;
+				}
+				return insertdict(mp, key, hash, value);
+			}
+			ix = dk->dk_nkeys++;
+			i = find_empty_slot(dk->dk_indices,
+					    (size_t)(dk->dk_size - 1), hash);
+			set_index(dk->dk_indices, (size_t)(dk->dk_size - 1),
+				  i, ix);
+			Py_INCREF(key);
+			ep = &dk->dk_entries[ix];
+			ep->me_key = key;
+			ep->me_hash = (Py_ssize_t)hash;
+		}
+		else if (mp->ma_values[ix] == NULL &&
+			 has_values_after(mp, ix)) {
+			/* The key would come before keys added after it:
+			   give the dict its own table to keep their order. */
+			if (dictresize(mp, 4 * (mp->ma_used + 1))) {
+				Py_DECREF(key);
+				Py_DECREF(value);
+				return -1;
+			}
+			return insertdict(mp, key, hash, value);
+		}
+		vp = &mp->ma_values[ix];
+		old_value = *vp;
+		*vp = value;
+		Py_DECREF(key);
+		if (old_value == NULL) {
+			mp->ma_used++;
+			mp->ma_fill++;
+			return 0;
+		}
+		Py_DECREF(old_value); /* which **CAN** re-enter */
+		return old_value == value;
+	}
+	if (ix >= 0) {
+		ep = &mp->ma_table[ix];
 		old_value = ep->me_value;
 		ep->me_value = value;
 		Py_DECREF(old_value); /* which **CAN** re-enter */
 		Py_DECREF(key);
 		return old_value == value;
 	}
-	else {
-		if (ep->me_key == NULL)
-			mp->ma_fill++;
-		else {
-			assert(ep->me_key == dummy);
-			Py_DECREF(dummy);
+	if (mp->ma_nentries >= USABLE(mp->ma_mask + 1) ||
+	    mp->ma_fill >= USABLE(mp->ma_mask + 1)) {
+		/* ma_table is full, or ma_indices is too full of dummies to
+		 * keep probe sequences short.  Normally, resizing quadruples
+		 * the size, but it's also possible for the dict to shrink (if
+		 * ma_nentries is much larger than ma_used, meaning a lot of
+		 * dict keys have been deleted).
+		 *
+		 * Quadrupling the size improves average dictionary sparseness
+		 * (reducing collisions) at the cost of some memory.  It also
+		 * halves the number of expensive resize operations in a
+		 * growing dictionary.
+		 *
+		 * Very large dictionaries (over 50K items) use doubling
+		 * instead.  This may help applications with severe memory
+		 * constraints.
+		 */
+		if (dictresize(mp, (mp->ma_used > 50000 ? 2 : 4) *
+				   mp->ma_used)) {
+			Py_DECREF(key);
+			Py_DECREF(value);
+			return -1;
 		}
-		ep->me_key = key;
-		ep->me_hash = (Py_ssize_t)hash;
-		ep->me_value = value;
-		mp->ma_used++;
 	}
-	return 0;
-}
-
-/*
-Internal routine used by dictresize() to insert an item which is
-known to be absent from the dict.  This routine also assumes that
-the dict contains no deleted entries.  Besides the performance benefit,
-using insertdict() in dictresize() is dangerous (SF bug #1456209).
-Note that no refcounts are changed by this routine; if needed, the caller
-is responsible for incref'ing `key` and `value`.
-*/
-static void
-insertdict_clean(register PyDictObject *mp, PyObject *key, long hash,
-		 PyObject *value)
-{
-	register size_t i;
-	register size_t perturb;
-	register size_t mask = (size_t)mp->ma_mask;
-	PyDictEntry *ep0 = mp->ma_table;
-	register PyDictEntry *ep;
-
-	i = hash & mask;
-	ep = &ep0[i];
-	for (perturb = hash; ep->me_key != NULL; perturb >>= PERTURB_SHIFT) {
-		i = (i << 2) + i + perturb + 1;
-		ep = &ep0[i & mask];
-	}
-	assert(ep->me_value == NULL);
-	mp->ma_fill++;
+	i = find_empty_slot(mp->ma_indices, (size_t)mp->ma_mask, hash);
+	if (get_index(mp->ma_indices, (size_t)mp->ma_mask, i) == IX_EMPTY)
+		mp->ma_fill++;
+	ix = mp->ma_nentries++;
+	set_index(mp->ma_indices, (size_t)mp->ma_mask, i, ix);
+	ep = &mp->ma_table[ix];
 	ep->me_key = key;
 	ep->me_hash = (Py_ssize_t)hash;
 	ep->me_value = value;
 	mp->ma_used++;
+	return 0;
+}
+
+/* Remove entry ix of the combined dict mp, leaving a hole in ma_table, and
+   return its key and value through *pkey and *pvalue; the caller owns the
+   references. */
+static void
+delete_entry(PyDictObject *mp, Py_ssize_t ix, PyObject **pkey,
+	     PyObject **pvalue)
+{
+	PyDictEntry *ep = &mp->ma_table[ix];
+	size_t i;
+
+	assert(mp->ma_values == NULL);
+	i = lookdict_index(mp->ma_indices, (size_t)mp->ma_mask,
+			   (long)ep->me_hash, ix);
+	set_index(mp->ma_indices, (size_t)mp->ma_mask, i, IX_DUMMY);
+	*pkey = ep->me_key;
+	*pvalue = ep->me_value;
+	ep->me_key = NULL;
+	ep->me_value = NULL;
+	mp->ma_used--;
+	/* The last entry can be reused right away. */
+	if (ix == mp->ma_nentries - 1)
+		mp->ma_nentries--;
 }
 
 /*
 Restructure the table by allocating a new table and reinserting all
-items again.  When entries have been deleted, the new table may
+items again.  This squeezes the holes out of ma_table, keeping the order
+of the items.  When entries have been deleted, the new table may
 actually be smaller than the old one.
 */
 static int
 dictresize(PyDictObject *mp, Py_ssize_t minused)
 {
-	Py_ssize_t newsize;
-	PyDictEntry *oldtable, *newtable, *ep;
-	Py_ssize_t i;
+	Py_ssize_t newsize, n, i;
+	PyDictEntry *oldtable, *newtable;
+	void *oldindices, *newindices;
+	PyObject **oldvalues;
 	int is_oldtable_malloced;
-	PyDictEntry small_copy[PyDict_MINSIZE];
 
 	assert(minused >= 0);
 
-	/* Find the smallest table size > minused. */
+	/* Find the smallest table size > minused, with room for the items. */
 	for (newsize = PyDict_MINSIZE;
-	     newsize <= minused && newsize > 0;
+	     (newsize <= minused || USABLE(newsize) <= mp->ma_used) &&
+	     newsize > 0;
 	     newsize <<= 1)
 		;
-	if (newsize <= 0) {
+	if (newsize <= 0 ||
+	    (size_t)USABLE(newsize) > PY_SSIZE_T_MAX / (2*sizeof(PyDictEntry))) {
 		PyErr_NoMemory();
 		return -1;
 	}
 
 	/* Get space for a new table. */
 	oldtable = mp->ma_table;
+	oldindices = mp->ma_indices;
+	oldvalues = mp->ma_values;
 	assert(oldtable != NULL);
-	is_oldtable_malloced = oldtable != mp->ma_smalltable;
+	assert(oldvalues == NULL || mp->ma_truncated);
+	is_oldtable_malloced = (oldtable != mp->ma_smalltable &&
+				oldvalues == NULL);
 
-	if (newsize == PyDict_MINSIZE) {
-		/* A large table is shrinking, or we can't get any smaller. */
+	if (newsize == PyDict_MINSIZE && !mp->ma_truncated) {
+		/* A large table is shrinking, or we can't get any smaller.
+		   In the latter case, the entries are squeezed in place. */
 		newtable = mp->ma_smalltable;
-		if (newtable == oldtable) {
-			if (mp->ma_fill == mp->ma_used) {
-				/* No dummies, so no point doing anything. */
-				return 0;
-			}
-			/* We're not going to resize it, but rebuild the
-			   table anyway to purge old dummy entries.
-			   Subtle:  This is *necessary* if fill==size,
-			   as lookdict needs at least one virgin slot to
-			   terminate failing searches.  If fill < size, it's
-			   merely desirable, as dummies slow searches. */
-			assert(mp->ma_fill > mp->ma_used);
-			memcpy(small_copy, oldtable, sizeof(small_copy));
-			oldtable = small_copy;
-		}
+		newindices = mp->ma_smallindices;
 	}
 	else {
-		newtable = PyMem_NEW(PyDictEntry, newsize);
-		if (newtable == NULL) {
+		newindices = PyMem_MALLOC(TABLES_NBYTES(newsize));
+		if (newindices == NULL) {
 			PyErr_NoMemory();
 			return -1;
 		}
-	}
-
-	/* Make the dict empty, using the new table. */
-	assert(newtable != oldtable);
-	mp->ma_table = newtable;
-	mp->ma_mask = newsize - 1;
-	memset(newtable, 0, sizeof(PyDictEntry) * newsize);
-	mp->ma_used = 0;
-	i = mp->ma_fill;
-	mp->ma_fill = 0;
-
-	/* Copy the data over; this is refcount-neutral for active entries;
-	   dummy entries aren't copied over, of course */
-	for (ep = oldtable; i > 0; ep++) {
-		if (ep->me_value != NULL) {	/* active entry */
-			--i;
-			insertdict_clean(mp, ep->me_key, (long)ep->me_hash,
-					 ep->me_value);
+		newtable = (PyDictEntry *)((char *)newindices +
+					   newsize * ix_size(newsize - 1));
+	}
+
+	/* Copy the active entries over, in order; this is refcount-neutral,
+	   except that a split dict gets a table of its own, and the keys stay
+	   in the shared table as well. */
+	n = 0;
+	if (oldvalues != NULL) {
+		for (i = 0; i < mp->ma_nentries; i++) {
+			if (oldvalues[i] != NULL) {
+				newtable[n].me_hash = oldtable[i].me_hash;
+				newtable[n].me_key = oldtable[i].me_key;
+				newtable[n].me_value = oldvalues[i];
+				Py_INCREF(newtable[n].me_key);
+				n++;
+			}
 		}
-		else if (ep->me_key != NULL) {	/* dummy entry */
-			--i;
-			assert(ep->me_key == dummy);
-			Py_DECREF(ep->me_key);
+	}
+	else {
+		for (i = 0; i < mp->ma_nentries; i++) {
+			if (oldtable[i].me_value != NULL)
+				newtable[n++] = oldtable[i];
 		}
-		/* else key == value == NULL:  nothing to do */
 	}
+	assert(n == mp->ma_used);
 
-	if (is_oldtable_malloced)
-		PyMem_DEL(oldtable);
+	mp->ma_table = newtable;
+	mp->ma_indices = newindices;
+	mp->ma_mask = newsize - 1;
+	mp->ma_values = NULL;
+	mp->ma_fill = mp->ma_used = mp->ma_nentries = n;
+	build_indices(newindices, (size_t)(newsize - 1), newtable, n);
+
+	if (oldvalues != NULL)
+		shared_keys_decref(SHARED_KEYS(oldindices));
+	else if (is_oldtable_malloced)
+		PyMem_FREE(oldindices);
 	return 0;
 }
 
@@ -619,6 +809,159 @@ _PyDict_NewPresized(Py_ssize_t minused)
 	return op;
 }
 
+/* Split dicts */
+
+static PyDictSharedKeys *
+new_shared_keys(Py_ssize_t size)
+{
+	PyDictSharedKeys *dk;
+	size_t ixbytes = size * ix_size(size - 1);
+
+	dk = (PyDictSharedKeys *)PyMem_MALLOC(
+		offsetof(PyDictSharedKeys, dk_indices) +
+		TABLES_NBYTES(size));
+	if (dk == NULL) {
+		PyErr_NoMemory();
+		return NULL;
+	}
+	dk->dk_refcnt = 1;
+	dk->dk_size = size;
+	dk->dk_nkeys = 0;
+	dk->dk_full = 0;
+	dk->dk_entries = (PyDictEntry *)(dk->dk_indices + ixbytes);
+	memset(dk->dk_indices, 0xff, ixbytes);
+	memset(dk->dk_entries, 0, USABLE(size) * sizeof(PyDictEntry));
+	return dk;
+}
+
+static void
+shared_keys_decref(PyDictSharedKeys *dk)
+{
+	Py_ssize_t i;
+
+	assert(dk->dk_refcnt > 0);
+	if (--dk->dk_refcnt > 0)
+		return;
+	for (i = 0; i < dk->dk_nkeys; i++)
+		Py_DECREF(dk->dk_entries[i].me_key);
+	PyMem_FREE(dk);
+}
+
+/* Return new shared tables twice the size of dk's, with the same keys at
+   the same indices. */
+static PyDictSharedKeys *
+grow_shared_keys(PyDictSharedKeys *dk)
+{
+	PyDictSharedKeys *newdk;
+	Py_ssize_t i;
+
+	newdk = new_shared_keys(dk->dk_size * 2);
+	if (newdk == NULL)
+		return NULL;
+	for (i = 0; i < dk->dk_nkeys; i++) {
+		newdk->dk_entries[i] = dk->dk_entries[i];
+		Py_INCREF(newdk->dk_entries[i].me_key);
+	}
+	newdk->dk_nkeys = dk->dk_nkeys;
+	build_indices(newdk->dk_indices, (size_t)(newdk->dk_size - 1),
+		      newdk->dk_entries, newdk->dk_nkeys);
+	return newdk;
+}
+
+PyObject *
+_PyDict_NewShared(PyDictSharedKeys **cache)
+{
+	PyDictSharedKeys *dk = *cache;
+	PyDictObject *mp;
+	Py_ssize_t nvalues;
+
+	if (dk == NULL || dk->dk_full) {
+		if (dk != NULL && dk->dk_size >= SHARED_KEYS_MAXSIZE)
+			return PyDict_New();
+		dk = dk == NULL ? new_shared_keys(PyDict_MINSIZE)
+				: grow_shared_keys(dk);
+		if (dk == NULL)
+			return NULL;
+		if (*cache != NULL)
+			shared_keys_decref(*cache);
+		*cache = dk;
+	}
+
+	/* The values go where ma_smalltable would be. */
+	nvalues = USABLE(dk->dk_size);
+	mp = (PyDictObject *)_PyObject_GC_Malloc(
+		offsetof(PyDictObject, ma_smalltable) +
+		nvalues * sizeof(PyObject *));
+	if (mp == NULL)
+		return NULL;
+	PyObject_INIT(mp, &PyDict_Type);
+	dk->dk_refcnt++;
+	mp->ma_used = mp->ma_fill = 0;
+	mp->ma_mask = dk->dk_size - 1;
+	mp->ma_nentries = nvalues;
+	mp->ma_table = dk->dk_entries;
+	mp->ma_indices = dk->dk_indices;
+	mp->ma_lookup = lookdict_string;
+	mp->ma_values = (PyObject **)mp->ma_smalltable;
+	memset(mp->ma_values, 0, nvalues * sizeof(PyObject *));
+	mp->ma_truncated = 1;
+#ifdef WITH_LLVM
+	mp->ma_watchers = NULL;
+	mp->ma_watchers_used = 0;
+	mp->ma_watchers_allocated = 0;
+#endif
+#ifdef SHOW_CONVERSION_COUNTS
+	++created;
+#endif
+	_PyObject_GC_TRACK(mp);
+	return (PyObject *)mp;
+}
+
+void
+_PyDict_ClearSharedKeys(PyDictSharedKeys **cache)
+{
+	PyDictSharedKeys *dk = *cache;
+
+	if (dk != NULL) {
+		*cache = NULL;
+		shared_keys_decref(dk);
+	}
+}
+
+Py_ssize_t
+_PyDict_SharedKeysIndex(PyDictSharedKeys *dk, PyObject *key)
+{
+	register size_t i;
+	register size_t perturb;
+	register size_t mask;
+	register Py_ssize_t ix;
+	register PyDictEntry *ep;
+	long hash;
+
+	/* The tables only hold exact strings; see lookdict_string(). */
+	if (dk == NULL || !PyString_CheckExact(key))
+		return -1;
+	hash = PyObject_Hash(key);
+	mask = (size_t)(dk->dk_size - 1);
+	i = hash & mask;
+	for (perturb = hash; ; perturb >>= PERTURB_SHIFT) {
+		ix = get_index(dk->dk_indices, mask, i & mask);
+		if (ix == IX_EMPTY)
+			return -1;
+		ep = &dk->dk_entries[ix];
+		if (ep->me_key == key ||
+		    (ep->me_hash == hash && _PyString_Eq(ep->me_key, key)))
+			return ix;
+		i = (i << 2) + i + perturb + 1;
+	}
+}
+
+PyDictEntry *
+_PyDict_SharedTable(PyDictSharedKeys *dk)
+{
+	return dk == NULL ? NULL : dk->dk_entries;
+}
+
 /* Note that, for historical reasons, PyDict_GetItem() suppresses all errors
  * that may occur (originally dicts supported only string keys, and exceptions
  * weren't possible).  So, while the original intent was that a NULL return
@@ -634,7 +977,7 @@ PyDict_GetItem(PyObject *op, PyObject *key)
 {
 	long hash;
 	PyDictObject *mp = (PyDictObject *)op;
-	PyDictEntry *ep;
+	Py_ssize_t ix;
 	PyThreadState *tstate;
 	if (!PyDict_Check(op))
 		return NULL;
@@ -656,20 +999,21 @@ PyDict_GetItem(PyObject *op, PyObject *key)
 		/* preserve the existing exception */
 		PyObject *err_type, *err_value, *err_tb;
 		PyErr_Fetch(&err_type, &err_value, &err_tb);
-		ep = (mp->ma_lookup)(mp, key, hash);
+		ix = (mp->ma_lookup)(mp, key, hash);
 		/* ignore errors */
 		PyErr_Restore(err_type, err_value, err_tb);
-		if (ep == NULL)
+		if (ix < 0)
 			return NULL;
 	}
 	else {
-		ep = (mp->ma_lookup)(mp, key, hash);
-		if (ep == NULL) {
-			PyErr_Clear();
+		ix = (mp->ma_lookup)(mp, key, hash);
+		if (ix < 0) {
+			if (ix == IX_ERROR)
+				PyErr_Clear();
 			return NULL;
 		}
 	}
-	return ep->me_value;
+	return _PyDict_VALUE(mp, ix);
 }
 
 /* CAUTION: PyDict_SetItem() must guarantee that it won't resize the
@@ -683,7 +1027,6 @@ PyDict_SetItem(register PyObject *op, PyObject *key, PyObject *value)
 {
 	register PyDictObject *mp;
 	register long hash;
-	register Py_ssize_t n_used;
 	int status;
 
 	if (!PyDict_Check(op)) {
@@ -704,7 +1047,6 @@ PyDict_SetItem(register PyObject *op, PyObject *key, PyObject *value)
 			return -1;
 	}
 	assert(mp->ma_fill <= mp->ma_mask);  /* at least one empty slot */
-	n_used = mp->ma_used;
 	Py_INCREF(value);
 	Py_INCREF(key);
 	status = insertdict(mp, key, hash, value);
@@ -712,23 +1054,7 @@ PyDict_SetItem(register PyObject *op, PyObject *key, PyObject *value)
 		return -1;
 	else if (status == 0)
 		notify_watchers(mp);
-	/* If we added a key, we can safely resize.  Otherwise just return!
-	 * If fill >= 2/3 size, adjust size.  Normally, this doubles or
-	 * quaduples the size, but it's also possible for the dict to shrink
-	 * (if ma_fill is much larger than ma_used, meaning a lot of dict
-	 * keys have been * deleted).
-	 *
-	 * Quadrupling the size improves average dictionary sparseness
-	 * (reducing collisions) at the cost of some memory and iteration
-	 * speed (which loops over every possible entry).  It also halves
-	 * the number of expensive resize operations in a growing dictionary.
-	 *
-	 * Very large dictionaries (over 50K items) use doubling instead.
-	 * This may help applications with severe memory constraints.
-	 */
-	if (!(mp->ma_used > n_used && mp->ma_fill*3 >= (mp->ma_mask+1)*2))
-		return 0;
-	return dictresize(mp, (mp->ma_used > 50000 ? 2 : 4) * mp->ma_used);
+	return 0;
 }
 
 int
@@ -736,7 +1062,7 @@ PyDict_DelItem(PyObject *op, PyObject *key)
 {
 	register PyDictObject *mp;
 	register long hash;
-	register PyDictEntry *ep;
+	register Py_ssize_t ix;
 	PyObject *old_value, *old_key;
 
 	if (!PyDict_Check(op)) {
@@ -751,50 +1077,83 @@ PyDict_DelItem(PyObject *op, PyObject *key)
 			return -1;
 	}
 	mp = (PyDictObject *)op;
-	ep = (mp->ma_lookup)(mp, key, hash);
-	if (ep == NULL)
+	ix = (mp->ma_lookup)(mp, key, hash);
+	if (ix == IX_ERROR)
 		return -1;
-	if (ep->me_value == NULL) {
+	if (ix == IX_EMPTY || _PyDict_VALUE(mp, ix) == NULL) {
 		set_key_error(key);
 		return -1;
 	}
-	old_key = ep->me_key;
-	Py_INCREF(dummy);
-	ep->me_key = dummy;
-	old_value = ep->me_value;
-	ep->me_value = NULL;
-	mp->ma_used--;
+	if (mp->ma_values != NULL) {
+		/* The key stays in the shared table. */
+		old_value = mp->ma_values[ix];
+		mp->ma_values[ix] = NULL;
+		mp->ma_used--;
+		mp->ma_fill--;
+		Py_DECREF(old_value);
+		notify_watchers(mp);
+		return 0;
+	}
+	delete_entry(mp, ix, &old_key, &old_value);
 	Py_DECREF(old_value);
 	Py_DECREF(old_key);
 	notify_watchers(mp);
 	return 0;
 }
 
+/* Clear a dict that has no ma_smalltable to fall back on, one item at a
+ * time, so that it stays consistent if a decref mutates it.  A combined
+ * table keeps its size, with dummies in place of the keys.
+ */
+static void
+clear_in_place(PyDictObject *mp)
+{
+	Py_ssize_t i;
+	PyObject *key, *value;
+
+	for (i = 0; mp->ma_used > 0 && i < mp->ma_nentries; i++) {
+		value = DICT_VALUE(mp, i);
+		if (value == NULL)
+			continue;
+		if (mp->ma_values != NULL) {
+			mp->ma_values[i] = NULL;
+			mp->ma_used--;
+			mp->ma_fill--;
+			Py_DECREF(value);
+		}
+		else {
+			delete_entry(mp, i, &key, &value);
+			Py_DECREF(value);
+			Py_DECREF(key);
+		}
+	}
+}
+
 void
 PyDict_Clear(PyObject *op)
 {
 	PyDictObject *mp;
 	PyDictEntry *ep, *table;
+	void *indices;
 	int table_is_malloced;
-	Py_ssize_t fill;
-	PyDictEntry small_copy[PyDict_MINSIZE];
-#ifdef Py_DEBUG
-	Py_ssize_t i, n;
-#endif
+	Py_ssize_t n;
+	PyDictEntry small_copy[USABLE(PyDict_MINSIZE)];
 
 	if (!PyDict_Check(op))
 		return;
 	mp = (PyDictObject *)op;
-#ifdef Py_DEBUG
-	n = mp->ma_mask + 1;
-	i = 0;
-#endif
 
 	/* Clear the list of watching code objects. */
 	notify_watchers(mp);
 	del_watchers_array(mp);
 
+	if (mp->ma_truncated) {
+		clear_in_place(mp);
+		return;
+	}
+
 	table = mp->ma_table;
+	indices = mp->ma_indices;
 	assert(table != NULL);
 	table_is_malloced = table != mp->ma_smalltable;
 
@@ -804,16 +1163,16 @@ PyDict_Clear(PyObject *op)
 	 * clearing the slots, and never refer to anything via mp->xxx while
 	 * clearing.
 	 */
-	fill = mp->ma_fill;
+	n = mp->ma_nentries;
 	if (table_is_malloced)
 		EMPTY_TO_MINSIZE(mp);
 
-	else if (fill > 0) {
+	else if (mp->ma_fill > 0) {
 		/* It's a small table with something that needs to be cleared.
 		 * Afraid the only safe way is to copy the dict entries into
 		 * another small table first.
 		 */
-		memcpy(small_copy, table, sizeof(small_copy));
+		memcpy(small_copy, table, n * sizeof(PyDictEntry));
 		table = small_copy;
 		EMPTY_TO_MINSIZE(mp);
 	}
@@ -822,29 +1181,19 @@ PyDict_Clear(PyObject *op)
 	/* Now we can finally clear things.  If C had refcounts, we could
 	 * assert that the refcount on table is 1 now, i.e. that this function
 	 * has unique access to it, so decref side-effects can't alter it.
+	 * Holes have neither key nor value.
 	 */
-	for (ep = table; fill > 0; ++ep) {
-#ifdef Py_DEBUG
-		assert(i < n);
-		++i;
-#endif
-		if (ep->me_key) {
-			--fill;
-			Py_DECREF(ep->me_key);
-			Py_XDECREF(ep->me_value);
-		}
-#ifdef Py_DEBUG
-		else
-			assert(ep->me_value == NULL);
-#endif
+	for (ep = table; n > 0; ++ep, --n) {
+		Py_XDECREF(ep->me_key);
+		Py_XDECREF(ep->me_value);
 	}
 
 	if (table_is_malloced)
-		PyMem_DEL(table);
+		PyMem_FREE(indices);
 }
 
 /*
- * Iterate over a dict.  Use like so:
+ * Iterate over a dict, in the order the keys were inserted.  Use like so:
  *
  *     Py_ssize_t i;
  *     PyObject *key, *value;
@@ -862,25 +1211,25 @@ int
 PyDict_Next(PyObject *op, Py_ssize_t *ppos, PyObject **pkey, PyObject **pvalue)
 {
 	register Py_ssize_t i;
-	register Py_ssize_t mask;
-	register PyDictEntry *ep;
+	register Py_ssize_t n;
+	register PyDictObject *mp;
 
 	if (!PyDict_Check(op))
 		return 0;
 	i = *ppos;
 	if (i < 0)
 		return 0;
-	ep = ((PyDictObject *)op)->ma_table;
-	mask = ((PyDictObject *)op)->ma_mask;
-	while (i <= mask && ep[i].me_value == NULL)
+	mp = (PyDictObject *)op;
+	n = mp->ma_nentries;
+	while (i < n && DICT_VALUE(mp, i) == NULL)
 		i++;
 	*ppos = i+1;
-	if (i > mask)
+	if (i >= n)
 		return 0;
 	if (pkey)
-		*pkey = ep[i].me_key;
+		*pkey = mp->ma_table[i].me_key;
 	if (pvalue)
-		*pvalue = ep[i].me_value;
+		*pvalue = DICT_VALUE(mp, i);
 	return 1;
 }
 
@@ -889,26 +1238,26 @@ int
 _PyDict_Next(PyObject *op, Py_ssize_t *ppos, PyObject **pkey, PyObject **pvalue, long *phash)
 {
 	register Py_ssize_t i;
-	register Py_ssize_t mask;
-	register PyDictEntry *ep;
+	register Py_ssize_t n;
+	register PyDictObject *mp;
 
 	if (!PyDict_Check(op))
 		return 0;
 	i = *ppos;
 	if (i < 0)
 		return 0;
-	ep = ((PyDictObject *)op)->ma_table;
-	mask = ((PyDictObject *)op)->ma_mask;
-	while (i <= mask && ep[i].me_value == NULL)
+	mp = (PyDictObject *)op;
+	n = mp->ma_nentries;
+	while (i < n && DICT_VALUE(mp, i) == NULL)
 		i++;
 	*ppos = i+1;
-	if (i > mask)
+	if (i >= n)
 		return 0;
-        *phash = (long)(ep[i].me_hash);
+        *phash = (long)(mp->ma_table[i].me_hash);
 	if (pkey)
-		*pkey = ep[i].me_key;
+		*pkey = mp->ma_table[i].me_key;
 	if (pvalue)
-		*pvalue = ep[i].me_value;
+		*pvalue = DICT_VALUE(mp, i);
 	return 1;
 }
 
@@ -918,7 +1267,7 @@ static void
 dict_dealloc(register PyDictObject *mp)
 {
 	register PyDictEntry *ep;
-	Py_ssize_t fill = mp->ma_fill;
+	register Py_ssize_t n = mp->ma_nentries;
 
 	/* De-optimize any optimized code objects. */
 	notify_watchers(mp);
@@ -926,16 +1275,22 @@ dict_dealloc(register PyDictObject *mp)
 
  	PyObject_GC_UnTrack(mp);
 	Py_TRASHCAN_SAFE_BEGIN(mp)
-	for (ep = mp->ma_table; fill > 0; ep++) {
-		if (ep->me_key) {
-			--fill;
-			Py_DECREF(ep->me_key);
+	if (mp->ma_values != NULL) {
+		register PyObject **vp;
+		for (vp = mp->ma_values; n > 0; vp++, n--)
+			Py_XDECREF(*vp);
+		shared_keys_decref(SHARED_KEYS(mp->ma_indices));
+	}
+	else {
+		for (ep = mp->ma_table; n > 0; ep++, n--) {
+			Py_XDECREF(ep->me_key);
 			Py_XDECREF(ep->me_value);
 		}
+		if (mp->ma_table != mp->ma_smalltable)
+			PyMem_FREE(mp->ma_indices);
 	}
-	if (mp->ma_table != mp->ma_smalltable)
-		PyMem_DEL(mp->ma_table);
-	if (numfree < PyDict_MAXFREELIST && Py_TYPE(mp) == &PyDict_Type)
+	if (numfree < PyDict_MAXFREELIST && Py_TYPE(mp) == &PyDict_Type &&
+	    !mp->ma_truncated)
 		free_list[numfree++] = mp;
 	else
 		Py_TYPE(mp)->tp_free((PyObject *)mp);
@@ -963,9 +1318,9 @@ dict_print(register PyDictObject *mp, register FILE *fp, register int flags)
 	fprintf(fp, "{");
 	Py_END_ALLOW_THREADS
 	any = 0;
-	for (i = 0; i <= mp->ma_mask; i++) {
+	for (i = 0; i < mp->ma_nentries; i++) {
 		PyDictEntry *ep = mp->ma_table + i;
-		PyObject *pvalue = ep->me_value;
+		PyObject *pvalue = DICT_VALUE(mp, i);
 		if (pvalue != NULL) {
 			/* Prevent PyObject_Repr from deleting value during
 			   key format */
@@ -1088,7 +1443,7 @@ dict_subscript(PyDictObject *mp, register PyObject *key)
 {
 	PyObject *v;
 	long hash;
-	PyDictEntry *ep;
+	Py_ssize_t ix;
 	assert(mp->ma_table != NULL);
 	if (!PyString_CheckExact(key) ||
 	    (hash = ((PyStringObject *) key)->ob_shash) == -1) {
@@ -1096,10 +1451,10 @@ dict_subscript(PyDictObject *mp, register PyObject *key)
 		if (hash == -1)
 			return NULL;
 	}
-	ep = (mp->ma_lookup)(mp, key, hash);
-	if (ep == NULL)
+	ix = (mp->ma_lookup)(mp, key, hash);
+	if (ix == IX_ERROR)
 		return NULL;
-	v = ep->me_value;
+	v = ix < 0 ? NULL : _PyDict_VALUE(mp, ix);
 	if (v == NULL) {
 		if (!PyDict_CheckExact(mp)) {
 			/* Look up __missing__ method if we're a subclass. */
@@ -1142,7 +1497,7 @@ dict_keys(register PyDictObject *mp)
 	register PyObject *v;
 	register Py_ssize_t i, j;
 	PyDictEntry *ep;
-	Py_ssize_t mask, n;
+	Py_ssize_t nentries, n;
 
   again:
 	n = mp->ma_used;
@@ -1157,9 +1512,9 @@ dict_keys(register PyDictObject *mp)
 		goto again;
 	}
 	ep = mp->ma_table;
-	mask = mp->ma_mask;
-	for (i = 0, j = 0; i <= mask; i++) {
-		if (ep[i].me_value != NULL) {
+	nentries = mp->ma_nentries;
+	for (i = 0, j = 0; i < nentries; i++) {
+		if (DICT_VALUE(mp, i) != NULL) {
 			PyObject *key = ep[i].me_key;
 			Py_INCREF(key);
 			PyList_SET_ITEM(v, j, key);
@@ -1175,8 +1530,7 @@ dict_values(register PyDictObject *mp)
 {
 	register PyObject *v;
 	register Py_ssize_t i, j;
-	PyDictEntry *ep;
-	Py_ssize_t mask, n;
+	Py_ssize_t nentries, n;
 
   again:
 	n = mp->ma_used;
@@ -1190,11 +1544,10 @@ dict_values(register PyDictObject *mp)
 		Py_DECREF(v);
 		goto again;
 	}
-	ep = mp->ma_table;
-	mask = mp->ma_mask;
-	for (i = 0, j = 0; i <= mask; i++) {
-		if (ep[i].me_value != NULL) {
-			PyObject *value = ep[i].me_value;
+	nentries = mp->ma_nentries;
+	for (i = 0, j = 0; i < nentries; i++) {
+		PyObject *value = DICT_VALUE(mp, i);
+		if (value != NULL) {
 			Py_INCREF(value);
 			PyList_SET_ITEM(v, j, value);
 			j++;
@@ -1209,7 +1562,7 @@ dict_items(register PyDictObject *mp)
 {
 	register PyObject *v;
 	register Py_ssize_t i, j, n;
-	Py_ssize_t mask;
+	Py_ssize_t nentries;
 	PyObject *item, *key, *value;
 	PyDictEntry *ep;
 
@@ -1239,9 +1592,9 @@ dict_items(register PyDictObject *mp)
 	}
 	/* Nothing we do below makes any function calls. */
 	ep = mp->ma_table;
-	mask = mp->ma_mask;
-	for (i = 0, j = 0; i <= mask; i++) {
-		if ((value=ep[i].me_value) != NULL) {
+	nentries = mp->ma_nentries;
+	for (i = 0, j = 0; i < nentries; i++) {
+		if ((value=DICT_VALUE(mp, i)) != NULL) {
 			key = ep[i].me_key;
 			item = PyList_GET_ITEM(v, j);
 			Py_INCREF(key);
@@ -1462,6 +1815,7 @@ PyDict_Merge(PyObject *a, PyObject *b, int override)
 	register PyDictObject *mp, *other;
 	register Py_ssize_t i;
 	PyDictEntry *entry;
+	PyObject *value;
 
 	/* We accept for the argument either a concrete dictionary object,
 	 * or an abstract "mapping" object.  For the former, we can do
@@ -1486,22 +1840,27 @@ PyDict_Merge(PyObject *a, PyObject *b, int override)
 			override = 1;
 		/* Do one big resize at the start, rather than
 		 * incrementally resizing as we insert new items.  Expect
-		 * that there will be no (or few) overlapping keys.
+		 * that there will be no (or few) overlapping keys.  A
+		 * split dict may stay split, so it is left to insertdict()
+		 * to resize it if it stops sharing its keys along the way.
 		 */
-		if ((mp->ma_fill + other->ma_used)*3 >= (mp->ma_mask+1)*2) {
+		if (mp->ma_values == NULL &&
+		    mp->ma_nentries + other->ma_used >
+		    USABLE(mp->ma_mask + 1)) {
 		   if (dictresize(mp, (mp->ma_used + other->ma_used)*2) != 0)
 			   return -1;
 		}
-		for (i = 0; i <= other->ma_mask; i++) {
+		for (i = 0; i < other->ma_nentries; i++) {
 			entry = &other->ma_table[i];
-			if (entry->me_value != NULL &&
+			value = DICT_VALUE(other, i);
+			if (value != NULL &&
 			    (override ||
 			     PyDict_GetItem(a, entry->me_key) == NULL)) {
 				Py_INCREF(entry->me_key);
-				Py_INCREF(entry->me_value);
+				Py_INCREF(value);
 				if (insertdict(mp, entry->me_key,
 					       (long)entry->me_hash,
-					       entry->me_value) < 0)
+					       value) < 0)
 					return -1;
 			}
 		}
@@ -1634,9 +1993,9 @@ characterize(PyDictObject *a, PyDictObject *b, PyObject **pval)
 	Py_ssize_t i;
 	int cmp;
 
-	for (i = 0; i <= a->ma_mask; i++) {
+	for (i = 0; i < a->ma_nentries; i++) {
 		PyObject *thiskey, *thisaval, *thisbval;
-		if (a->ma_table[i].me_value == NULL)
+		if (DICT_VALUE(a, i) == NULL)
 			continue;
 		thiskey = a->ma_table[i].me_key;
 		Py_INCREF(thiskey);  /* keep alive across compares */
@@ -1647,8 +2006,8 @@ characterize(PyDictObject *a, PyDictObject *b, PyObject **pval)
 				goto Fail;
 			}
 			if (cmp > 0 ||
-			    i > a->ma_mask ||
-			    a->ma_table[i].me_value == NULL)
+			    i >= a->ma_nentries ||
+			    DICT_VALUE(a, i) == NULL)
 			{
 				/* Not the *smallest* a key; or maybe it is
 				 * but the compare shrunk the dict so we can't
@@ -1662,7 +2021,7 @@ characterize(PyDictObject *a, PyDictObject *b, PyObject **pval)
 		}
 
 		/* Compare a[thiskey] to b[thiskey]; cmp <- true iff equal. */
-		thisaval = a->ma_table[i].me_value;
+		thisaval = DICT_VALUE(a, i);
 		assert(thisaval);
 		Py_INCREF(thisaval);   /* keep alive */
 		thisbval = PyDict_GetItem((PyObject *)b, thiskey);
@@ -1762,8 +2121,8 @@ dict_equal(PyDictObject *a, PyDictObject *b)
 		return 0;
 
 	/* Same # of entries -- check all of 'em.  Exit early on any diff. */
-	for (i = 0; i <= a->ma_mask; i++) {
-		PyObject *aval = a->ma_table[i].me_value;
+	for (i = 0; i < a->ma_nentries; i++) {
+		PyObject *aval = DICT_VALUE(a, i);
 		if (aval != NULL) {
 			int cmp;
 			PyObject *bval;
@@ -1819,7 +2178,7 @@ static PyObject *
 dict_contains(register PyDictObject *mp, PyObject *key)
 {
 	long hash;
-	PyDictEntry *ep;
+	Py_ssize_t ix;
 
 	if (!PyString_CheckExact(key) ||
 	    (hash = ((PyStringObject *) key)->ob_shash) == -1) {
@@ -1827,10 +2186,10 @@ dict_contains(register PyDictObject *mp, PyObject *key)
 		if (hash == -1)
 			return NULL;
 	}
-	ep = (mp->ma_lookup)(mp, key, hash);
-	if (ep == NULL)
+	ix = (mp->ma_lookup)(mp, key, hash);
+	if (ix == IX_ERROR)
 		return NULL;
-	return PyBool_FromLong(ep->me_value != NULL);
+	return PyBool_FromLong(ix >= 0 && _PyDict_VALUE(mp, ix) != NULL);
 }
 
 static PyObject *
@@ -1847,7 +2206,7 @@ dict_get(register PyDictObject *mp, PyObject *key, PyObject *failobj)
 {
 	PyObject *val = NULL;
 	long hash;
-	PyDictEntry *ep;
+	Py_ssize_t ix;
 
 	if (failobj == NULL)
 		failobj = Py_None;
@@ -1858,10 +2217,10 @@ dict_get(register PyDictObject *mp, PyObject *key, PyObject *failobj)
 		if (hash == -1)
 			return NULL;
 	}
-	ep = (mp->ma_lookup)(mp, key, hash);
-	if (ep == NULL)
+	ix = (mp->ma_lookup)(mp, key, hash);
+	if (ix == IX_ERROR)
 		return NULL;
-	val = ep->me_value;
+	val = ix < 0 ? NULL : _PyDict_VALUE(mp, ix);
 	if (val == NULL)
 		val = failobj;
 	Py_INCREF(val);
@@ -1874,7 +2233,7 @@ dict_setdefault(register PyDictObject *mp, PyObject *key, PyObject *failobj)
 {
 	PyObject *val = NULL;
 	long hash;
-	PyDictEntry *ep;
+	Py_ssize_t ix;
 
 	if (failobj == NULL)
 		failobj = Py_None;
@@ -1885,10 +2244,10 @@ dict_setdefault(register PyDictObject *mp, PyObject *key, PyObject *failobj)
 		if (hash == -1)
 			return NULL;
 	}
-	ep = (mp->ma_lookup)(mp, key, hash);
-	if (ep == NULL)
+	ix = (mp->ma_lookup)(mp, key, hash);
+	if (ix == IX_ERROR)
 		return NULL;
-	val = ep->me_value;
+	val = ix < 0 ? NULL : _PyDict_VALUE(mp, ix);
 	if (val == NULL) {
 		val = failobj;
 		if (PyDict_SetItem((PyObject*)mp, key, failobj))
@@ -1910,7 +2269,7 @@ static PyObject *
 dict_pop(PyDictObject *mp, PyObject *key, PyObject *deflt)
 {
 	long hash;
-	PyDictEntry *ep;
+	Py_ssize_t ix;
 	PyObject *old_value, *old_key;
 
 	if (mp->ma_used == 0) {
@@ -1928,10 +2287,10 @@ dict_pop(PyDictObject *mp, PyObject *key, PyObject *deflt)
 		if (hash == -1)
 			return NULL;
 	}
-	ep = (mp->ma_lookup)(mp, key, hash);
-	if (ep == NULL)
+	ix = (mp->ma_lookup)(mp, key, hash);
+	if (ix == IX_ERROR)
 		return NULL;
-	if (ep->me_value == NULL) {
+	if (ix == IX_EMPTY || _PyDict_VALUE(mp, ix) == NULL) {
 		if (deflt) {
 			Py_INCREF(deflt);
 			return deflt;
@@ -1939,12 +2298,16 @@ dict_pop(PyDictObject *mp, PyObject *key, PyObject *deflt)
 		set_key_error(key);
 		return NULL;
 	}
-	old_key = ep->me_key;
-	Py_INCREF(dummy);
-	ep->me_key = dummy;
-	old_value = ep->me_value;
-	ep->me_value = NULL;
-	mp->ma_used--;
+	if (mp->ma_values != NULL) {
+		/* The key stays in the shared table. */
+		old_value = mp->ma_values[ix];
+		mp->ma_values[ix] = NULL;
+		mp->ma_used--;
+		mp->ma_fill--;
+		notify_watchers(mp);
+		return old_value;
+	}
+	delete_entry(mp, ix, &old_key, &old_value);
 	Py_DECREF(old_key);
 	notify_watchers(mp);
 	return old_value;
@@ -1953,9 +2316,8 @@ dict_pop(PyDictObject *mp, PyObject *key, PyObject *deflt)
 static PyObject *
 dict_popitem(PyDictObject *mp)
 {
-	Py_ssize_t i = 0;
-	PyDictEntry *ep;
-	PyObject *res;
+	Py_ssize_t i;
+	PyObject *res, *key, *value;
 
 	/* Allocate the result tuple before checking the size.  Believe it
 	 * or not, this allocation could trigger a garbage collection which
@@ -1975,36 +2337,20 @@ dict_popitem(PyDictObject *mp)
 				"popitem(): dictionary is empty");
 		return NULL;
 	}
-	/* Set ep to "the first" dict entry with a value.  We abuse the hash
-	 * field of slot 0 to hold a search finger:
-	 * If slot 0 has a value, use slot 0.
-	 * Else slot 0 is being used to hold a search finger,
-	 * and we use its hash value as the first index to look.
-	 */
-	ep = &mp->ma_table[0];
-	if (ep->me_value == NULL) {
-		i = ep->me_hash;
-		/* The hash field may be a real hash value, or it may be a
-		 * legit search finger, or it may be a once-legit search
-		 * finger that's out of bounds now because it wrapped around
-		 * or the table shrunk -- simply make sure it's in bounds now.
-		 */
-		if (i > mp->ma_mask || i < 1)
-			i = 1;	/* skip slot 0 */
-		while ((ep = &mp->ma_table[i])->me_value == NULL) {
-			i++;
-			if (i > mp->ma_mask)
-				i = 1;
-		}
+	/* Pop the last item, so that a loop of popitem()s takes linear
+	 * time; only a table of our own can lose entries. */
+	if (mp->ma_values != NULL && dictresize(mp, mp->ma_used)) {
+		Py_DECREF(res);
+		return NULL;
 	}
-	PyTuple_SET_ITEM(res, 0, ep->me_key);
-	PyTuple_SET_ITEM(res, 1, ep->me_value);
-	Py_INCREF(dummy);
-	ep->me_key = dummy;
-	ep->me_value = NULL;
-	mp->ma_used--;
-	assert(mp->ma_table[0].me_value == NULL);
-	mp->ma_table[0].me_hash = i + 1;  /* next place to start */
+	i = mp->ma_nentries - 1;
+	while (mp->ma_table[i].me_value == NULL)
+		i--;
+	delete_entry(mp, i, &key, &value);
+	/* Trailing holes need not be scanned again. */
+	mp->ma_nentries = i;
+	PyTuple_SET_ITEM(res, 0, key);
+	PyTuple_SET_ITEM(res, 1, value);
 	notify_watchers(mp);
 	return res;
 }
@@ -2187,9 +2533,17 @@ dict_sizeof(PyDictObject *mp)
 {
 	Py_ssize_t res;
 
+	if (mp->ma_truncated) {
+		res = offsetof(PyDictObject, ma_smalltable);
+		if (mp->ma_values != NULL)
+			res += USABLE(mp->ma_mask + 1) * sizeof(PyObject *);
+		else
+			res += TABLES_NBYTES(mp->ma_mask + 1);
+		return PyInt_FromSsize_t(res);
+	}
 	res = sizeof(PyDictObject);
 	if (mp->ma_table != mp->ma_smalltable)
-		res = res + (mp->ma_mask + 1) * sizeof(PyDictEntry);
+		res = res + TABLES_NBYTES(mp->ma_mask + 1);
 	return PyInt_FromSsize_t(res);
 }
 
@@ -2298,7 +2652,7 @@ PyDict_Contains(PyObject *op, PyObject *key)
 {
 	long hash;
 	PyDictObject *mp = (PyDictObject *)op;
-	PyDictEntry *ep;
+	Py_ssize_t ix;
 
 	if (!PyString_CheckExact(key) ||
 	    (hash = ((PyStringObject *) key)->ob_shash) == -1) {
@@ -2306,8 +2660,10 @@ PyDict_Contains(PyObject *op, PyObject *key)
 		if (hash == -1)
 			return -1;
 	}
-	ep = (mp->ma_lookup)(mp, key, hash);
-	return ep == NULL ? -1 : (ep->me_value != NULL);
+	ix = (mp->ma_lookup)(mp, key, hash);
+	if (ix == IX_ERROR)
+		return -1;
+	return ix >= 0 && _PyDict_VALUE(mp, ix) != NULL;
 }
 
 /* Internal version of PyDict_Contains used when the hash value is already known */
@@ -2315,10 +2671,12 @@ int
 _PyDict_Contains(PyObject *op, PyObject *key, long hash)
 {
 	PyDictObject *mp = (PyDictObject *)op;
-	PyDictEntry *ep;
+	Py_ssize_t ix;
 
-	ep = (mp->ma_lookup)(mp, key, hash);
-	return ep == NULL ? -1 : (ep->me_value != NULL);
+	ix = (mp->ma_lookup)(mp, key, hash);
+	if (ix == IX_ERROR)
+		return -1;
+	return ix >= 0 && _PyDict_VALUE(mp, ix) != NULL;
 }
 
 /* Hack to implement "key in dict" */
@@ -2524,7 +2882,7 @@ static PyMethodDef dictiter_methods[] = {
 static PyObject *dictiter_iternextkey(dictiterobject *di)
 {
 	PyObject *key;
-	register Py_ssize_t i, mask;
+	register Py_ssize_t i, n;
 	register PyDictEntry *ep;
 	PyDictObject *d = di->di_dict;
 
@@ -2543,11 +2901,11 @@ static PyObject *dictiter_iternextkey(dictiterobject *di)
 	if (i < 0)
 		goto fail;
 	ep = d->ma_table;
-	mask = d->ma_mask;
-	while (i <= mask && ep[i].me_value == NULL)
+	n = d->ma_nentries;
+	while (i < n && DICT_VALUE(d, i) == NULL)
 		i++;
 	di->di_pos = i+1;
-	if (i > mask)
+	if (i >= n)
 		goto fail;
 	di->len--;
 	key = ep[i].me_key;
@@ -2596,8 +2954,7 @@ PyTypeObject PyDictIterKey_Type = {
 static PyObject *dictiter_iternextvalue(dictiterobject *di)
 {
 	PyObject *value;
-	register Py_ssize_t i, mask;
-	register PyDictEntry *ep;
+	register Py_ssize_t i, n;
 	PyDictObject *d = di->di_dict;
 
 	if (d == NULL)
@@ -2612,13 +2969,12 @@ static PyObject *dictiter_iternextvalue(dictiterobject *di)
 	}
 
 	i = di->di_pos;
-	mask = d->ma_mask;
-	if (i < 0 || i > mask)
+	n = d->ma_nentries;
+	if (i < 0 || i >= n)
 		goto fail;
-	ep = d->ma_table;
-	while ((value=ep[i].me_value) == NULL) {
+	while ((value=DICT_VALUE(d, i)) == NULL) {
 		i++;
-		if (i > mask)
+		if (i >= n)
 			goto fail;
 	}
 	di->di_pos = i+1;
@@ -2668,7 +3024,7 @@ PyTypeObject PyDictIterValue_Type = {
 static PyObject *dictiter_iternextitem(dictiterobject *di)
 {
 	PyObject *key, *value, *result = di->di_result;
-	register Py_ssize_t i, mask;
+	register Py_ssize_t i, n;
 	register PyDictEntry *ep;
 	PyDictObject *d = di->di_dict;
 
@@ -2687,11 +3043,11 @@ static PyObject *dictiter_iternextitem(dictiterobject *di)
 	if (i < 0)
 		goto fail;
 	ep = d->ma_table;
-	mask = d->ma_mask;
-	while (i <= mask && ep[i].me_value == NULL)
+	n = d->ma_nentries;
+	while (i < n && DICT_VALUE(d, i) == NULL)
 		i++;
 	di->di_pos = i+1;
-	if (i > mask)
+	if (i >= n)
 		goto fail;
 
 	if (result->ob_refcnt == 1) {
@@ -2705,7 +3061,7 @@ static PyObject *dictiter_iternextitem(dictiterobject *di)
 	}
 	di->len--;
 	key = ep[i].me_key;
-	value = ep[i].me_value;
+	value = DICT_VALUE(d, i);
 	Py_INCREF(key);
 	Py_INCREF(value);
 	PyTuple_SET_ITEM(result, 0, key);
@@ -381,7 +381,6 @@ static PyGetSetDef frame_getsetlist[] = {
    a stack frame is on the free list, only the following members have
    a meaning:
 	ob_type		== &Frametype
-	f_back		next item on free list, or NULL
 	f_stacksize	size of value stack
 	ob_size		size of localsplus
    Note that the value and block stacks are preserved -- this can save
@@ -398,11 +397,12 @@ static PyGetSetDef frame_getsetlist[] = {
    frames could provoke free_list into growing without bound.
 */
 
-static PyFrameObject *free_list = NULL;
-static int numfree = 0;		/* number of frames currently in free_list */
-/* max value for numfree */
+/* max number of frames on free_list */
 #define PyFrame_MAXFREELIST 200	
 
+static _PyFreeList free_list = _PyFreeList_INIT("frame",
+						PyFrame_MAXFREELIST, 1);
+
 static void
 frame_dealloc(PyFrameObject *f)
 {
@@ -434,13 +434,8 @@ frame_dealloc(PyFrameObject *f)
 	co = f->f_code;
 	if (co->co_zombieframe == NULL)
 		co->co_zombieframe = f;
-	else if (numfree < PyFrame_MAXFREELIST) {
-		++numfree;
-		f->f_back = free_list;
-		free_list = f;
-	}
-	else 
-		PyObject_GC_Del(f);
+	else
+		_PyFreeList_FREE(&free_list, f);
 
 	Py_DECREF(co);
 	Py_TRASHCAN_SAFE_END(f)
@@ -649,7 +644,8 @@ PyFrame_New(PyThreadState *tstate, PyCodeObject *code, PyObject *globals,
 		nfrees = PyTuple_GET_SIZE(code->co_freevars);
 		extras = code->co_stacksize + code->co_nlocals + ncells +
 		    nfrees;
-		if (free_list == NULL) {
+		_PyFreeList_POP(&free_list, f);
+		if (f == NULL) {
 		    f = PyObject_GC_NewVar(PyFrameObject, &PyFrame_Type,
 			extras);
 		    if (f == NULL) {
@@ -658,10 +654,6 @@ PyFrame_New(PyThreadState *tstate, PyCodeObject *code, PyObject *globals,
 		    }
 		}
 		else {
-		    assert(numfree > 0);
-		    --numfree;
-		    f = free_list;
-		    free_list = free_list->f_back;
 		    if (Py_SIZE(f) < extras) {
 			    f = PyObject_GC_Resize(PyFrameObject, f, extras);
 			    if (f == NULL) {
@@ -950,16 +942,7 @@ PyFrame_LocalsToFast(PyFrameObject *f, int clear)
 int
 PyFrame_ClearFreeList(void)
 {
-	int freelist_size = numfree;
-	
-	while (free_list != NULL) {
-		PyFrameObject *f = free_list;
-		free_list = free_list->f_back;
-		PyObject_GC_Del(f);
-		--numfree;
-	}
-	assert(numfree == 0);
-	return freelist_size;
+	return _PyFreeList_Clear(&free_list);
 }
 
 void
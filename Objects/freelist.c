@@ -0,0 +1,107 @@
+/* Free lists of dead objects; see freelist.h */
+
+#include "Python.h"
+
+/* Every free list that has been used, for _PyFreeList_GetStats() */
+static _PyFreeList *registered_lists = NULL;
+
+static void
+register_list(_PyFreeList *fl)
+{
+	fl->registered = 1;
+	fl->next = registered_lists;
+	registered_lists = fl;
+}
+
+void
+_PyFreeList_Init(_PyFreeList *fl, const char *name, int maxfree, int gc)
+{
+	assert(fl->numfree == 0);
+	fl->name = name;
+	fl->maxfree = maxfree;
+	fl->gc = gc;
+	if (!fl->registered)
+		register_list(fl);
+}
+
+void
+_PyFreeList_Miss(_PyFreeList *fl)
+{
+	fl->misses++;
+	if (!fl->registered && fl->name != NULL)
+		register_list(fl);
+}
+
+void
+_PyFreeList_Release(_PyFreeList *fl, void *op)
+{
+	if (fl->gc)
+		PyObject_GC_Del(op);
+	else
+		PyObject_Free(op);
+}
+
+int
+_PyFreeList_Clear(_PyFreeList *fl)
+{
+	int freelist_size = fl->numfree;
+	void *op;
+
+	while ((op = fl->head) != NULL) {
+		fl->head = *(void **)op;
+		_PyFreeList_Release(fl, op);
+		fl->numfree--;
+	}
+	assert(fl->numfree == 0);
+	return freelist_size;
+}
+
+static int
+add_stat(PyObject *stats, const char *key, Py_ssize_t value)
+{
+	PyObject *v = PyDict_GetItemString(stats, key);
+	int err;
+
+	if (v != NULL)
+		value += PyInt_AsSsize_t(v);
+	v = PyInt_FromSsize_t(value);
+	if (v == NULL)
+		return -1;
+	err = PyDict_SetItemString(stats, key, v);
+	Py_DECREF(v);
+	return err;
+}
+
+PyObject *
+_PyFreeList_GetStats(void)
+{
+	PyObject *result, *stats;
+	_PyFreeList *fl;
+
+	result = PyDict_New();
+	if (result == NULL)
+		return NULL;
+	for (fl = registered_lists; fl != NULL; fl = fl->next) {
+		stats = PyDict_GetItemString(result, fl->name);
+		if (stats == NULL) {
+			stats = PyDict_New();
+			if (stats == NULL ||
+			    PyDict_SetItemString(result, fl->name, stats) < 0) {
+				Py_XDECREF(stats);
+				goto error;
+			}
+			Py_DECREF(stats);
+		}
+		if (add_stat(stats, "numfree", fl->numfree) < 0 ||
+		    add_stat(stats, "maxfree", fl->maxfree) < 0 ||
+		    add_stat(stats, "hits", fl->hits) < 0 ||
+		    add_stat(stats, "misses", fl->misses) < 0 ||
+		    add_stat(stats, "frees", fl->frees) < 0)
+			goto error;
+	}
+	return result;
+
+error:
+	Py_DECREF(result);
+	return NULL;
+}
@@ -8,6 +8,10 @@
 #include <sys/types.h>		/* For size_t */
 #endif
 
+#ifdef WITH_THREAD
+#include "pythread.h"
+#endif
+
 /* Ensure ob_item has room for at least newsize elements, and set
  * ob_size to newsize.  If newsize > ob_size on entry, the content
  * of the new slots at exit is undefined heap trash; it's the caller's
@@ -969,10 +973,100 @@ reverse_slice(PyObject **lo, PyObject **hi)
  * pieces to this algorithm; read listsort.txt for overviews and details.
  */
 
+/* Special wrapper to support stable sorting using the decorate-sort-undecorate
+   pattern.  Holds a key which is used for comparisons and the original record
+   which is returned during the undecorate phase.  By exposing only the key
+   during comparisons, the underlying sort stability characteristics are left
+   unchanged.  Also, if a custom comparison function is used, it will only see
+   the key instead of a full record. */
+
+typedef struct {
+	PyObject_HEAD
+	PyObject *key;
+	PyObject *value;
+} sortwrapperobject;
+
+/* The maximum number of entries in a MergeState's pending-runs stack.
+ * This is enough to sort arrays of size up to about
+ *     32 * phi ** MAX_MERGE_PENDING
+ * where phi ~= 1.618.  85 is ridiculouslylarge enough, good for an array
+ * with 2**64 elements.
+ */
+#define MAX_MERGE_PENDING 85
+
+/* When we get into galloping mode, we stay there until both runs win less
+ * often than MIN_GALLOP consecutive times.  See listsort.txt for more info.
+ */
+#define MIN_GALLOP 7
+
+/* Avoid malloc for small temp arrays. */
+#define MERGESTATE_TEMP_SIZE 256
+
+/* One MergeState exists on the stack per invocation of mergesort.  It's just
+ * a convenient way to pass state around among the helper functions.
+ */
+struct s_slice {
+	PyObject **base;
+	Py_ssize_t len;
+};
+
+typedef struct s_MergeState {
+	/* The user-supplied comparison function. or NULL if none given. */
+	PyObject *compare;
+
+	/* The "<" used for every comparison; see merge_select_compare(). */
+	int (*key_compare)(PyObject *, PyObject *, struct s_MergeState *);
+
+	/* True if the items are sortwrappers whose keys can be compared
+	 * directly, i.e. there's a key function but no cmp function.
+	 */
+	int unwrap;
+
+	/* This controls when we get *into* galloping mode.  It's initialized
+	 * to MIN_GALLOP.  merge_lo and merge_hi tend to nudge it higher for
+	 * random data, and lower for highly structured data.
+	 */
+	Py_ssize_t min_gallop;
+
+	/* 'a' is temp storage to help with merges.  It contains room for
+	 * alloced entries.
+	 */
+	PyObject **a;	/* may point to temparray below */
+	Py_ssize_t alloced;
+
+	/* A stack of n pending runs yet to be merged.  Run #i starts at
+	 * address base[i] and extends for len[i] elements.  It's always
+	 * true (so long as the indices are in bounds) that
+	 *
+	 *     pending[i].base + pending[i].len == pending[i+1].base
+	 *
+	 * so we could cut the storage for this, but it's a minor amount,
+	 * and keeping all the info explicit simplifies the code.
+	 */
+	int n;
+	struct s_slice pending[MAX_MERGE_PENDING];
+
+	/* 'a' points to this when possible, rather than muck with malloc. */
+	PyObject *temparray[MERGESTATE_TEMP_SIZE];
+} MergeState;
+
+/* Conceptually a MergeState's constructor. */
+static void
+merge_init(MergeState *ms, PyObject *compare, int unwrap)
+{
+	assert(ms != NULL);
+	ms->compare = compare;
+	ms->key_compare = NULL;
+	ms->unwrap = unwrap;
+	ms->a = ms->temparray;
+	ms->alloced = MERGESTATE_TEMP_SIZE;
+	ms->n = 0;
+	ms->min_gallop = MIN_GALLOP;
+}
+
 /* Comparison function.  Takes care of calling a user-supplied
  * comparison function (any callable Python object), which must not be
- * NULL (use the ISLT macro if you don't know, or call PyObject_RichCompareBool
- * with Py_LT if you know it's NULL).
+ * NULL (use the ISLT macro if you don't know).
  * Returns -1 on error, 1 if x < y, 0 if x >= y.
  */
 static int
@@ -1009,20 +1103,106 @@ islt(PyObject *x, PyObject *y, PyObject *compare)
 	return i < 0;
 }
 
-/* If COMPARE is NULL, calls PyObject_RichCompareBool with Py_LT, else calls
- * islt.  This avoids a layer of function call in the usual case, and
- * sorting does many comparisons.
- * Returns -1 on error, 1 if x < y, 0 if x >= y.
+/* The "<" used by the sort is picked once per sort by
+ * merge_select_compare(), and all comparisons go through ms->key_compare.
+ * When every key has the same type and that type is int, float or str,
+ * the kernels below compare the C values directly: there is no rich
+ * comparison dispatch and no bool to unpack, and no Python code can run
+ * during the sort.  Anything else goes through PyObject_RichCompareBool,
+ * or through islt() if the user supplied a cmp function.
+ *
+ * If the list was decorated for a key function and there's no cmp
+ * function, ms->unwrap is set and the kernels look straight through the
+ * sortwrappers at the keys.
+ *
+ * Each returns -1 on error, 1 if x < y, 0 if x >= y.
  */
-#define ISLT(X, Y, COMPARE) ((COMPARE) == NULL ?			\
-			     PyObject_RichCompareBool(X, Y, Py_LT) :	\
-			     islt(X, Y, COMPARE))
+#define SORTKEY(MS, X) ((MS)->unwrap ? ((sortwrapperobject *)(X))->key : (X))
+
+static int
+cmp_islt(PyObject *x, PyObject *y, MergeState *ms)
+{
+	return islt(x, y, ms->compare);
+}
+
+static int
+object_islt(PyObject *x, PyObject *y, MergeState *ms)
+{
+	return PyObject_RichCompareBool(SORTKEY(ms, x), SORTKEY(ms, y), Py_LT);
+}
+
+static int
+int_islt(PyObject *x, PyObject *y, MergeState *ms)
+{
+	return PyInt_AS_LONG(SORTKEY(ms, x)) < PyInt_AS_LONG(SORTKEY(ms, y));
+}
+
+/* Same answer as float_richcompare(), NaNs included. */
+static int
+float_islt(PyObject *x, PyObject *y, MergeState *ms)
+{
+	return PyFloat_AS_DOUBLE(SORTKEY(ms, x)) <
+	       PyFloat_AS_DOUBLE(SORTKEY(ms, y));
+}
+
+/* Same answer as string_richcompare(). */
+static int
+string_islt(PyObject *x, PyObject *y, MergeState *ms)
+{
+	PyStringObject *a = (PyStringObject *)SORTKEY(ms, x);
+	PyStringObject *b = (PyStringObject *)SORTKEY(ms, y);
+	Py_ssize_t len_a = Py_SIZE(a), len_b = Py_SIZE(b);
+	int c;
+
+	/* ob_sval is NUL-terminated, so peeking at the first byte is safe
+	 * even for empty strings. */
+	c = Py_CHARMASK(*a->ob_sval) - Py_CHARMASK(*b->ob_sval);
+	if (c == 0) {
+		c = memcmp(a->ob_sval, b->ob_sval,
+			   len_a < len_b ? len_a : len_b);
+		if (c == 0)
+			return len_a < len_b;
+	}
+	return c < 0;
+}
+
+/* Pick ms->key_compare for sorting the n items starting at lo. */
+static void
+merge_select_compare(MergeState *ms, PyObject **lo, Py_ssize_t n)
+{
+	PyTypeObject *type;
+	Py_ssize_t i;
+
+	if (ms->compare != NULL) {
+		ms->key_compare = cmp_islt;
+		return;
+	}
+	ms->key_compare = object_islt;
+	if (n < 2)
+		return;
+	type = Py_TYPE(SORTKEY(ms, lo[0]));
+	if (type != &PyInt_Type && type != &PyFloat_Type &&
+	    type != &PyString_Type)
+		return;
+	for (i = 1; i < n; i++) {
+		if (Py_TYPE(SORTKEY(ms, lo[i])) != type)
+			return;
+	}
+	if (type == &PyInt_Type)
+		ms->key_compare = int_islt;
+	else if (type == &PyFloat_Type)
+		ms->key_compare = float_islt;
+	else
+		ms->key_compare = string_islt;
+}
+
+#define ISLT(X, Y, MS) ((*(MS)->key_compare)(X, Y, MS))
 
 /* Compare X to Y via "<".  Goto "fail" if the comparison raises an
    error.  Else "k" is set to true iff X<Y, and an "if (k)" block is
    started.  It makes more sense in context <wink>.  X and Y are PyObject*s.
 */
-#define IFLT(X, Y) if ((k = ISLT(X, Y, compare)) < 0) goto fail;  \
+#define IFLT(X, Y) if ((k = ISLT(X, Y, ms)) < 0) goto fail;  \
 		   if (k)
 
 /* binarysort is the best method for sorting small arrays: it does
@@ -1037,8 +1217,7 @@ islt(PyObject *x, PyObject *y, PyObject *compare)
    the input (nothing is lost or duplicated).
 */
 static int
-binarysort(PyObject **lo, PyObject **hi, PyObject **start, PyObject *compare)
-     /* compare -- comparison function object, or NULL for default */
+binarysort(PyObject **lo, PyObject **hi, PyObject **start, MergeState *ms)
 {
 	register Py_ssize_t k;
 	register PyObject **l, **p, **r;
@@ -1103,7 +1282,7 @@ elements to get out of order).
 Returns -1 in case of error.
 */
 static Py_ssize_t
-count_run(PyObject **lo, PyObject **hi, PyObject *compare, int *descending)
+count_run(PyObject **lo, PyObject **hi, MergeState *ms, int *descending)
 {
 	Py_ssize_t k;
 	Py_ssize_t n;
@@ -1158,7 +1337,7 @@ key, and the last n-k should follow key.
 Returns -1 on error.  See listsort.txt for info on the method.
 */
 static Py_ssize_t
-gallop_left(PyObject *key, PyObject **a, Py_ssize_t n, Py_ssize_t hint, PyObject *compare)
+gallop_left(PyObject *key, PyObject **a, Py_ssize_t n, Py_ssize_t hint, MergeState *ms)
 {
 	Py_ssize_t ofs;
 	Py_ssize_t lastofs;
@@ -1249,7 +1428,7 @@ we're sticking to "<" comparisons that it's much harder to follow if
 written as one routine with yet another "left or right?" flag.
 */
 static Py_ssize_t
-gallop_right(PyObject *key, PyObject **a, Py_ssize_t n, Py_ssize_t hint, PyObject *compare)
+gallop_right(PyObject *key, PyObject **a, Py_ssize_t n, Py_ssize_t hint, MergeState *ms)
 {
 	Py_ssize_t ofs;
 	Py_ssize_t lastofs;
@@ -1325,74 +1504,6 @@ fail:
 	return -1;
 }
 
-/* The maximum number of entries in a MergeState's pending-runs stack.
- * This is enough to sort arrays of size up to about
- *     32 * phi ** MAX_MERGE_PENDING
- * where phi ~= 1.618.  85 is ridiculouslylarge enough, good for an array
- * with 2**64 elements.
- */
-#define MAX_MERGE_PENDING 85
-
-/* When we get into galloping mode, we stay there until both runs win less
- * often than MIN_GALLOP consecutive times.  See listsort.txt for more info.
- */
-#define MIN_GALLOP 7
-
-/* Avoid malloc for small temp arrays. */
-#define MERGESTATE_TEMP_SIZE 256
-
-/* One MergeState exists on the stack per invocation of mergesort.  It's just
- * a convenient way to pass state around among the helper functions.
- */
-struct s_slice {
-	PyObject **base;
-	Py_ssize_t len;
-};
-
-typedef struct s_MergeState {
-	/* The user-supplied comparison function. or NULL if none given. */
-	PyObject *compare;
-
-	/* This controls when we get *into* galloping mode.  It's initialized
-	 * to MIN_GALLOP.  merge_lo and merge_hi tend to nudge it higher for
-	 * random data, and lower for highly structured data.
-	 */
-	Py_ssize_t min_gallop;
-
-	/* 'a' is temp storage to help with merges.  It contains room for
-	 * alloced entries.
-	 */
-	PyObject **a;	/* may point to temparray below */
-	Py_ssize_t alloced;
-
-	/* A stack of n pending runs yet to be merged.  Run #i starts at
-	 * address base[i] and extends for len[i] elements.  It's always
-	 * true (so long as the indices are in bounds) that
-	 *
-	 *     pending[i].base + pending[i].len == pending[i+1].base
-	 *
-	 * so we could cut the storage for this, but it's a minor amount,
-	 * and keeping all the info explicit simplifies the code.
-	 */
-	int n;
-	struct s_slice pending[MAX_MERGE_PENDING];
-
-	/* 'a' points to this when possible, rather than muck with malloc. */
-	PyObject *temparray[MERGESTATE_TEMP_SIZE];
-} MergeState;
-
-/* Conceptually a MergeState's constructor. */
-static void
-merge_init(MergeState *ms, PyObject *compare)
-{
-	assert(ms != NULL);
-	ms->compare = compare;
-	ms->a = ms->temparray;
-	ms->alloced = MERGESTATE_TEMP_SIZE;
-	ms->n = 0;
-	ms->min_gallop = MIN_GALLOP;
-}
-
 /* Free all the temp memory owned by the MergeState.  This must be called
  * when you're done with a MergeState, and may be called before then if
  * you want to free the temp memory early.
@@ -1447,7 +1558,6 @@ merge_lo(MergeState *ms, PyObject **pa, Py_ssize_t na,
                          PyObject **pb, Py_ssize_t nb)
 {
 	Py_ssize_t k;
-	PyObject *compare;
 	PyObject **dest;
 	int result = -1;	/* guilty until proved innocent */
 	Py_ssize_t min_gallop;
@@ -1467,7 +1577,6 @@ merge_lo(MergeState *ms, PyObject **pa, Py_ssize_t na,
 		goto CopyB;
 
 	min_gallop = ms->min_gallop;
-	compare = ms->compare;
 	for (;;) {
 		Py_ssize_t acount = 0;	/* # of times A won in a row */
 		Py_ssize_t bcount = 0;	/* # of times B won in a row */
@@ -1477,7 +1586,7 @@ merge_lo(MergeState *ms, PyObject **pa, Py_ssize_t na,
 		 */
  		for (;;) {
  			assert(na > 1 && nb > 0);
-	 		k = ISLT(*pb, *pa, compare);
+	 		k = ISLT(*pb, *pa, ms);
 			if (k) {
 				if (k < 0)
 					goto Fail;
@@ -1512,7 +1621,7 @@ merge_lo(MergeState *ms, PyObject **pa, Py_ssize_t na,
  			assert(na > 1 && nb > 0);
 			min_gallop -= min_gallop > 1;
 	 		ms->min_gallop = min_gallop;
-			k = gallop_right(*pb, pa, na, 0, compare);
+			k = gallop_right(*pb, pa, na, 0, ms);
 			acount = k;
 			if (k) {
 				if (k < 0)
@@ -1535,7 +1644,7 @@ merge_lo(MergeState *ms, PyObject **pa, Py_ssize_t na,
 			if (nb == 0)
 				goto Succeed;
 
- 			k = gallop_left(*pa, pb, nb, 0, compare);
+ 			k = gallop_left(*pa, pb, nb, 0, ms);
  			bcount = k;
 			if (k) {
 				if (k < 0)
@@ -1579,7 +1688,6 @@ static Py_ssize_t
 merge_hi(MergeState *ms, PyObject **pa, Py_ssize_t na, PyObject **pb, Py_ssize_t nb)
 {
 	Py_ssize_t k;
-	PyObject *compare;
 	PyObject **dest;
 	int result = -1;	/* guilty until proved innocent */
 	PyObject **basea;
@@ -1604,7 +1712,6 @@ merge_hi(MergeState *ms, PyObject **pa, Py_ssize_t na, PyObject **pb, Py_ssize_t
 		goto CopyA;
 
 	min_gallop = ms->min_gallop;
-	compare = ms->compare;
 	for (;;) {
 		Py_ssize_t acount = 0;	/* # of times A won in a row */
 		Py_ssize_t bcount = 0;	/* # of times B won in a row */
@@ -1614,7 +1721,7 @@ merge_hi(MergeState *ms, PyObject **pa, Py_ssize_t na, PyObject **pb, Py_ssize_t
 		 */
  		for (;;) {
  			assert(na > 0 && nb > 1);
-	 		k = ISLT(*pb, *pa, compare);
+	 		k = ISLT(*pb, *pa, ms);
 			if (k) {
 				if (k < 0)
 					goto Fail;
@@ -1649,7 +1756,7 @@ merge_hi(MergeState *ms, PyObject **pa, Py_ssize_t na, PyObject **pb, Py_ssize_t
  			assert(na > 0 && nb > 1);
 			min_gallop -= min_gallop > 1;
 	 		ms->min_gallop = min_gallop;
-			k = gallop_right(*pb, basea, na, na-1, compare);
+			k = gallop_right(*pb, basea, na, na-1, ms);
 			if (k < 0)
 				goto Fail;
 			k = na - k;
@@ -1667,7 +1774,7 @@ merge_hi(MergeState *ms, PyObject **pa, Py_ssize_t na, PyObject **pb, Py_ssize_t
 			if (nb == 1)
 				goto CopyA;
 
- 			k = gallop_left(*pa, baseb, nb, nb-1, compare);
+ 			k = gallop_left(*pa, baseb, nb, nb-1, ms);
 			if (k < 0)
 				goto Fail;
 			k = nb - k;
@@ -1719,7 +1826,6 @@ merge_at(MergeState *ms, Py_ssize_t i)
 	PyObject **pa, **pb;
 	Py_ssize_t na, nb;
 	Py_ssize_t k;
-	PyObject *compare;
 
 	assert(ms != NULL);
 	assert(ms->n >= 2);
@@ -1745,8 +1851,7 @@ merge_at(MergeState *ms, Py_ssize_t i)
 	/* Where does b start in a?  Elements in a before that can be
 	 * ignored (already in place).
 	 */
-	compare = ms->compare;
-	k = gallop_right(*pb, pa, na, 0, compare);
+	k = gallop_right(*pb, pa, na, 0, ms);
 	if (k < 0)
 		return -1;
 	pa += k;
@@ -1757,7 +1862,7 @@ merge_at(MergeState *ms, Py_ssize_t i)
 	/* Where does a end in b?  Elements in b after that can be
 	 * ignored (already in place).
 	 */
-	nb = gallop_left(pa[na-1], pb, nb, nb-1, compare);
+	nb = gallop_left(pa[na-1], pb, nb, nb-1, ms);
 	if (nb <= 0)
 		return nb;
 
@@ -1848,18 +1953,273 @@ merge_compute_minrun(Py_ssize_t n)
 	return n + r;
 }
 
-/* Special wrapper to support stable sorting using the decorate-sort-undecorate
-   pattern.  Holds a key which is used for comparisons and the original record
-   which is returned during the undecorate phase.  By exposing only the key
-   during comparisons, the underlying sort stability characteristics are left
-   unchanged.  Also, if a custom comparison function is used, it will only see
-   the key instead of a full record. */
+#if defined(WITH_THREAD) && defined(HAVE_LONG_LONG) && \
+    SIZEOF_LONG_LONG == 8 && SIZEOF_DOUBLE == 8
+#define PARALLEL_SORT
+#endif
+
+#ifdef PARALLEL_SORT
+
+/* Big lists whose keys are all ints or all floats are sorted on unboxed
+ * keys instead: each item becomes a (key, object) slot, the two halves of
+ * the slot array are sorted on two threads, and the two halves of the
+ * final merge are produced on two threads as well.  None of this touches
+ * a Python object, so it runs without the GIL.  The result is the same
+ * stable order timsort would produce.
+ *
+ * Lists shorter than PARALLEL_SORT_MIN aren't worth a thread.  Lists that
+ * are mostly made of long ascending or descending runs are left to
+ * timsort, which handles them in close to linear time; the unboxed sort
+ * is an ordinary O(n log n) mergesort.
+ */
+#define PARALLEL_SORT_MIN (1 << 16)
+
+/* Runs of this length are sorted by insertion before merging starts. */
+#define SLOT_RUN 32
 
 typedef struct {
-	PyObject_HEAD
-	PyObject *key;
-	PyObject *value;
-} sortwrapperobject;
+	PY_LONG_LONG key;
+	PyObject *obj;
+} sortslot;
+
+/* Stable merge of a[0:na] and b[0:nb], writing the n smallest results to
+ * dest[0:n].
+ */
+static void
+slot_merge_front(sortslot *a, Py_ssize_t na, sortslot *b, Py_ssize_t nb,
+		 sortslot *dest, Py_ssize_t n)
+{
+	sortslot *aend = a + na, *bend = b + nb, *dend = dest + n;
+
+	while (dest < dend && a < aend && b < bend) {
+		if (b->key < a->key)
+			*dest++ = *b++;
+		else
+			*dest++ = *a++;
+	}
+	while (dest < dend && a < aend)
+		*dest++ = *a++;
+	while (dest < dend)
+		*dest++ = *b++;
+}
+
+/* Stable merge of a[0:na] and b[0:nb], writing the n largest results to
+ * dest[0:n].  Together with slot_merge_front() this splits one merge
+ * between two threads.
+ */
+static void
+slot_merge_back(sortslot *a, Py_ssize_t na, sortslot *b, Py_ssize_t nb,
+		sortslot *dest, Py_ssize_t n)
+{
+	sortslot *pa = a + na, *pb = b + nb, *pd = dest + n;
+
+	while (pd > dest && pa > a && pb > b) {
+		if (pb[-1].key < pa[-1].key)
+			*--pd = *--pa;
+		else
+			*--pd = *--pb;
+	}
+	while (pd > dest && pb > b)
+		*--pd = *--pb;
+	while (pd > dest)
+		*--pd = *--pa;
+}
+
+/* Stable sort of a[0:n], using tmp[0:n] as scratch space. */
+static void
+slot_sort(sortslot *a, sortslot *tmp, Py_ssize_t n)
+{
+	sortslot *src, *dst, *t;
+	Py_ssize_t lo, mid, hi, i, j, width;
+
+	for (lo = 0; lo < n; lo += SLOT_RUN) {
+		hi = lo + SLOT_RUN < n ? lo + SLOT_RUN : n;
+		for (i = lo + 1; i < hi; i++) {
+			sortslot x = a[i];
+			for (j = i; j > lo && x.key < a[j-1].key; j--)
+				a[j] = a[j-1];
+			a[j] = x;
+		}
+	}
+	src = a;
+	dst = tmp;
+	for (width = SLOT_RUN; width < n; width *= 2) {
+		for (lo = 0; lo < n; lo += 2 * width) {
+			mid = lo + width < n ? lo + width : n;
+			hi = mid + width < n ? mid + width : n;
+			slot_merge_front(src + lo, mid - lo, src + mid, hi - mid,
+					 dst + lo, hi - lo);
+		}
+		t = src;
+		src = dst;
+		dst = t;
+	}
+	if (src != a)
+		memcpy(a, src, n * sizeof(sortslot));
+}
+
+/* One thread's share of parallel_sort(). */
+typedef struct {
+	sortslot *a, *b, *dest;
+	Py_ssize_t na, nb, n;
+} slotjob;
+
+static void
+slot_sort_job(void *arg)
+{
+	slotjob *job = (slotjob *)arg;
+	slot_sort(job->a, job->dest, job->na);
+}
+
+static void
+slot_merge_front_job(void *arg)
+{
+	slotjob *job = (slotjob *)arg;
+	slot_merge_front(job->a, job->na, job->b, job->nb, job->dest, job->n);
+}
+
+static void
+slot_merge_back_job(void *arg)
+{
+	slotjob *job = (slotjob *)arg;
+	slot_merge_back(job->a, job->na, job->b, job->nb, job->dest, job->n);
+}
+
+typedef struct {
+	void (*func)(void *);
+	void *arg;
+	PyThread_type_lock done;
+} sorthelper;
+
+static void
+sorthelper_run(void *arg)
+{
+	sorthelper *helper = (sorthelper *)arg;
+	helper->func(helper->arg);
+	PyThread_release_lock(helper->done);
+}
+
+/* Run f(farg) on a helper thread and g(garg) on this one, returning when
+ * both are done.  If no thread can be started, both run here.
+ */
+static void
+sort_run_pair(PyThread_type_lock done, void (*f)(void *), void *farg,
+	      void (*g)(void *), void *garg)
+{
+	sorthelper helper;
+
+	helper.func = f;
+	helper.arg = farg;
+	helper.done = done;
+	PyThread_acquire_lock(done, 1);
+	if (PyThread_start_new_thread(sorthelper_run, &helper) == -1) {
+		PyThread_release_lock(done);
+		f(farg);
+		g(garg);
+		return;
+	}
+	g(garg);
+	PyThread_acquire_lock(done, 1);
+	PyThread_release_lock(done);
+}
+
+/* Sort the n items starting at items on unboxed keys, as described above.
+ * Returns 0 if the items were sorted, or -1 (without an exception set) if
+ * this method doesn't apply and the caller should run timsort instead.
+ */
+static int
+parallel_sort(MergeState *ms, PyObject **items, Py_ssize_t n)
+{
+	sortslot *slots, *tmp;
+	slotjob left, right;
+	PyThread_type_lock done;
+	Py_ssize_t i, half, turns = 0;
+	int isfloat, up, prev_up = 1;
+
+	if (n < PARALLEL_SORT_MIN)
+		return -1;
+	if (ms->key_compare == int_islt)
+		isfloat = 0;
+	else if (ms->key_compare == float_islt)
+		isfloat = 1;
+	else
+		return -1;
+	if ((size_t)n > PY_SSIZE_T_MAX / (2 * sizeof(sortslot)))
+		return -1;
+	slots = (sortslot *)PyMem_MALLOC(2 * n * sizeof(sortslot));
+	if (slots == NULL)
+		return -1;
+	tmp = slots + n;
+
+	for (i = 0; i < n; i++) {
+		PyObject *key = SORTKEY(ms, items[i]);
+		PY_LONG_LONG k;
+
+		if (isfloat) {
+			/* Map the double to an integer with the same order.
+			 * NaNs have no place in that order, and -0.0 must tie
+			 * with 0.0.
+			 */
+			double d = PyFloat_AS_DOUBLE(key);
+			if (Py_IS_NAN(d))
+				goto not_applicable;
+			if (d == 0.0)
+				d = 0.0;
+			memcpy(&k, &d, sizeof(k));
+			if (k < 0)
+				k ^= PY_LLONG_MAX;
+		}
+		else
+			k = PyInt_AS_LONG(key);
+		slots[i].key = k;
+		slots[i].obj = items[i];
+		if (i > 0) {
+			up = k >= slots[i-1].key;
+			turns += up != prev_up;
+			prev_up = up;
+		}
+	}
+	/* Random data changes direction about twice in every three items. */
+	if (turns < n / 16)
+		goto not_applicable;
+	done = PyThread_allocate_lock();
+	if (done == NULL)
+		goto not_applicable;
+
+	half = n / 2;
+	Py_BEGIN_ALLOW_THREADS
+	left.a = slots;
+	left.na = half;
+	left.dest = tmp;
+	right.a = slots + half;
+	right.na = n - half;
+	right.dest = tmp + half;
+	sort_run_pair(done, slot_sort_job, &right, slot_sort_job, &left);
+
+	left.b = right.b = slots + half;
+	left.nb = right.nb = n - half;
+	left.na = right.na = half;
+	right.a = slots;
+	left.n = half;
+	right.n = n - half;
+	sort_run_pair(done, slot_merge_back_job, &right,
+		      slot_merge_front_job, &left);
+	Py_END_ALLOW_THREADS
+	PyThread_free_lock(done);
+
+	for (i = 0; i < n; i++)
+		items[i] = tmp[i].obj;
+	PyMem_FREE(slots);
+	return 0;
+
+not_applicable:
+	PyMem_FREE(slots);
+	return -1;
+}
+
+#endif /* PARALLEL_SORT */
+
+/* The sortwrapper type; see the comment above sortwrapperobject. */
 
 PyDoc_STRVAR(sortwrapper_doc, "Object wrapper with a custom sort key.");
 static PyObject *
@@ -2104,12 +2464,18 @@ listsort(PyListObject *self, PyObject *args, PyObject *kwds)
 	if (reverse && saved_ob_size > 1)
 		reverse_slice(saved_ob_item, saved_ob_item + saved_ob_size);
 
-	merge_init(&ms, compare);
+	merge_init(&ms, compare, compare == NULL && keyfunc != NULL);
 
 	nremaining = saved_ob_size;
 	if (nremaining < 2)
 		goto succeed;
 
+	merge_select_compare(&ms, saved_ob_item, saved_ob_size);
+#ifdef PARALLEL_SORT
+	if (parallel_sort(&ms, saved_ob_item, saved_ob_size) == 0)
+		goto succeed;
+#endif
+
 	/* March over the array once, left to right, finding natural runs,
 	 * and extending short natural runs to minrun elements.
 	 */
@@ -2121,7 +2487,7 @@ listsort(PyListObject *self, PyObject *args, PyObject *kwds)
 		Py_ssize_t n;
 
 		/* Identify next run. */
-		n = count_run(lo, hi, compare, &descending);
+		n = count_run(lo, hi, &ms, &descending);
 		if (n < 0)
 			goto fail;
 		if (descending)
@@ -2130,7 +2496,7 @@ listsort(PyListObject *self, PyObject *args, PyObject *kwds)
 		if (n < minrun) {
 			const Py_ssize_t force = nremaining <= minrun ?
 	 			  	  nremaining : minrun;
-			if (binarysort(lo, lo + force, lo + n, compare) < 0)
+			if (binarysort(lo, lo + force, lo + n, &ms) < 0)
 				goto fail;
 			n = force;
 		}
@@ -2198,6 +2564,7 @@ dsu_fail:
 }
 #undef IFLT
 #undef ISLT
+#undef SORTKEY
 
 int
 PyList_Sort(PyObject *v)
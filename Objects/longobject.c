@@ -16,6 +16,18 @@
 #define KARATSUBA_CUTOFF 70
 #define KARATSUBA_SQUARE_CUTOFF (2 * KARATSUBA_CUTOFF)
 
+/* Above TOOM3_CUTOFF digits, k_mul switches to Toom-Cook 3-way
+ * multiplication for operands of comparable size.
+ */
+#define TOOM3_CUTOFF 450
+
+/* Conversions between longs and decimal strings divide and conquer past
+ * DECIMAL_FORMAT_CUTOFF digits of the long when formatting, and past
+ * DECIMAL_PARSE_CUTOFF decimal digits when parsing.
+ */
+#define DECIMAL_FORMAT_CUTOFF 60
+#define DECIMAL_PARSE_CUTOFF 800
+
 /* For exponentiation, use the binary left-to-right algorithm
  * unless the exponent contains more than FIVEARY_CUTOFF digits.
  * In that case, do 5 bits at a time.  The potential drawback is that
@@ -35,6 +47,8 @@ static PyLongObject *long_normalize(PyLongObject *);
 static PyLongObject *mul1(PyLongObject *, wdigit);
 static PyLongObject *muladd1(PyLongObject *, wdigit, wdigit);
 static PyLongObject *divrem1(PyLongObject *, digit, digit *);
+static int long_to_decimal(PyLongObject *, char **);
+static PyLongObject *long_from_decimal(char **);
 
 #define SIGCHECK(PyTryBlock) \
 	if (--_Py_Ticker < 0) { \
@@ -1269,6 +1283,13 @@ _PyLong_Format(PyObject *aa, int base, int addL, int newstyle)
 					 	accum > 0);
 		}
 	}
+	else if (base == 10 && size_a > DECIMAL_FORMAT_CUTOFF) {
+		/* Large decimal conversions divide and conquer. */
+		if (long_to_decimal(a, &p) < 0) {
+			Py_DECREF(str);
+			return NULL;
+		}
+	}
 	else {
 		/* Not 0, and base not a power of 2.  Divide repeatedly by
 		   base, but for speed use the highest power of base that
@@ -1507,6 +1528,9 @@ PyLong_FromString(char *str, char **pend, int base)
 	start = str;
 	if ((base & (base - 1)) == 0)
 		z = long_from_binary_base(&str, base);
+	else if (base == 10 &&
+		 strspn(str, "0123456789") > DECIMAL_PARSE_CUTOFF)
+		z = long_from_decimal(&str);
 	else {
 /***
 Binary bases can be converted in time linear in the number of digits, because
@@ -2263,6 +2287,7 @@ kmul_split(PyLongObject *n, Py_ssize_t size, PyLongObject **high, PyLongObject *
 }
 
 static PyLongObject *k_lopsided_mul(PyLongObject *a, PyLongObject *b);
+static PyLongObject *toom3_mul(PyLongObject *a, PyLongObject *b);
 
 /* Karatsuba multiplication.  Ignores the input signs, and returns the
  * absolute value of the product (or NULL if error).
@@ -2321,6 +2346,12 @@ k_mul(PyLongObject *a, PyLongObject *b)
 	if (2 * asize <= bsize)
 		return k_lopsided_mul(a, b);
 
+	/* Past TOOM3_CUTOFF, Toom-3 beats Karatsuba when the operands are
+	 * close enough in size for each to split in three.
+	 */
+	if (asize > TOOM3_CUTOFF && 3 * asize > 2 * bsize)
+		return toom3_mul(a, b);
+
 	/* Split a & b into hi & lo pieces. */
 	shift = bsize >> 1;
 	if (kmul_split(a, shift, &ah, &al) < 0) goto fail;
@@ -2543,6 +2574,614 @@ k_lopsided_mul(PyLongObject *a, PyLongObject *b)
 	return NULL;
 }
 
+/* Replace the long *x by the new reference v, or go to fail if v is NULL.
+   Used by the routines below, which juggle many temporaries. */
+#define LONG_SET(x, v) do {					\
+		PyLongObject *long_set_tmp = (PyLongObject *)(v);	\
+		if (long_set_tmp == NULL)				\
+			goto fail;					\
+		Py_XDECREF(x);						\
+		(x) = long_set_tmp;					\
+	} while (0)
+
+/* Divide x by a digit n that divides it exactly, keeping the sign of x. */
+static PyLongObject *
+divexact1(PyLongObject *x, digit n)
+{
+	PyLongObject *z;
+	digit rem;
+
+	z = divrem1(x, n, &rem);
+	assert(z == NULL || rem == 0);
+	if (z != NULL && Py_SIZE(x) < 0)
+		Py_SIZE(z) = -Py_SIZE(z);
+	return z;
+}
+
+/* Signed product of a and b via k_mul. */
+static PyLongObject *
+toom3_signed_mul(PyLongObject *a, PyLongObject *b)
+{
+	PyLongObject *z;
+
+	z = k_mul(a, b);
+	if (z != NULL && (Py_SIZE(a) ^ Py_SIZE(b)) < 0)
+		Py_SIZE(z) = -Py_SIZE(z);
+	return z;
+}
+
+/* Split |n| into three pieces n2*X**2 + n1*X + n0, X being PyLong_BASE**k,
+ * and store new references to the values of that polynomial at 0, 1, -1,
+ * -2 and infinity in v[0..4].  Returns 0 on success, -1 on failure, in
+ * which case v is all NULL.
+ */
+static int
+toom3_eval(PyLongObject *n, Py_ssize_t k, PyLongObject *v[5])
+{
+	PyLongObject *n0 = NULL, *n1 = NULL, *n2 = NULL, *lo = NULL;
+	PyLongObject *t = NULL;
+	int i;
+
+	for (i = 0; i < 5; i++)
+		v[i] = NULL;
+	if (kmul_split(n, 2*k, &n2, &lo) < 0)
+		return -1;
+	if (kmul_split(lo, k, &n1, &n0) < 0)
+		goto fail;
+
+	LONG_SET(t, x_add(n0, n2));		/* n0 + n2 */
+	LONG_SET(v[1], x_add(t, n1));		/* n(1) */
+	LONG_SET(v[2], x_sub(t, n1));		/* n(-1) */
+	LONG_SET(t, long_add(v[2], n2));
+	LONG_SET(t, long_add(t, t));
+	LONG_SET(v[3], long_sub(t, n0));	/* n(-2) = 2*(n(-1) + n2) - n0 */
+	Py_DECREF(t);
+	Py_DECREF(lo);
+	Py_DECREF(n1);
+	v[0] = n0;
+	v[4] = n2;
+	return 0;
+
+ fail:
+	Py_XDECREF(t);
+	Py_XDECREF(lo);
+	Py_XDECREF(n0);
+	Py_XDECREF(n1);
+	Py_XDECREF(n2);
+	for (i = 0; i < 5; i++)
+		Py_CLEAR(v[i]);
+	return -1;
+}
+
+/* Toom-Cook 3-way multiplication.  Ignores the input signs, and returns
+ * the absolute value of the product (or NULL if error).  Both inputs are
+ * split in three pieces of k digits, viewed as quadratics in X =
+ * PyLong_BASE**k, and the quartic product is recovered from its values
+ * at 0, 1, -1, -2 and infinity, which costs 5 multiplications on numbers
+ * a third of the size instead of Karatsuba's 9.  The interpolation
+ * sequence is Bodrato's, "Towards Optimal Toom-Cook Multiplication for
+ * Univariate and Multivariate Polynomials in Characteristic 2 and 0"
+ * (WAIFI 2007), which only needs exact divisions by 2 and 3.
+ * Requires asize > TOOM3_CUTOFF and the operands not to be lopsided.
+ */
+static PyLongObject *
+toom3_mul(PyLongObject *a, PyLongObject *b)
+{
+	Py_ssize_t asize = ABS(Py_SIZE(a));
+	Py_ssize_t bsize = ABS(Py_SIZE(b));
+	PyLongObject *va[5], *vb[5], *r[5];
+	PyLongObject *r1 = NULL, *r2 = NULL, *r3 = NULL;
+	PyLongObject *t = NULL, *u = NULL;
+	PyLongObject *ret = NULL;
+	PyLongObject *c[5];
+	Py_ssize_t k;
+	int i;
+
+	for (i = 0; i < 5; i++)
+		vb[i] = r[i] = NULL;
+	k = (MAX(asize, bsize) + 2) / 3;
+
+	/* Evaluate; squaring only needs one set of values. */
+	if (toom3_eval(a, k, va) < 0)
+		return NULL;
+	if (a == b) {
+		for (i = 0; i < 5; i++) {
+			vb[i] = va[i];
+			Py_INCREF(vb[i]);
+		}
+	}
+	else if (toom3_eval(b, k, vb) < 0)
+		goto fail;
+
+	/* Multiply pointwise.  When squaring, va[i] is vb[i], so k_mul
+	 * sees the squares as such.
+	 */
+	for (i = 0; i < 5; i++) {
+		r[i] = toom3_signed_mul(va[i], vb[i]);
+		if (r[i] == NULL)
+			goto fail;
+	}
+	for (i = 0; i < 5; i++) {
+		Py_CLEAR(va[i]);
+		Py_CLEAR(vb[i]);
+	}
+
+	/* Interpolate.  r[0..4] hold the product at 0, 1, -1, -2, infinity:
+	 *     r3 <- (r(-2) - r(1)) / 3
+	 *     r1 <- (r(1) - r(-1)) / 2
+	 *     r2 <- r(-1) - r(0)
+	 *     r3 <- (r2 - r3) / 2 + 2*r(inf)
+	 *     r2 <- r2 + r1 - r(inf)
+	 *     r1 <- r1 - r3
+	 * leaving the coefficients r(0), r1, r2, r3, r(inf).
+	 */
+	LONG_SET(t, long_sub(r[3], r[1]));
+	LONG_SET(r3, divexact1(t, 3));
+	LONG_SET(t, long_sub(r[1], r[2]));
+	LONG_SET(r1, divexact1(t, 2));
+	LONG_SET(r2, long_sub(r[2], r[0]));
+	LONG_SET(t, long_sub(r2, r3));
+	LONG_SET(t, divexact1(t, 2));
+	LONG_SET(u, long_add(r[4], r[4]));
+	LONG_SET(r3, long_add(t, u));
+	LONG_SET(t, long_add(r2, r1));
+	LONG_SET(r2, long_sub(t, r[4]));
+	LONG_SET(r1, long_sub(r1, r3));
+
+	/* Recompose.  The coefficients are those of the product of two
+	 * polynomials with non-negative coefficients, so each is
+	 * non-negative, and each fits in the result at its offset.
+	 */
+	ret = _PyLong_New(asize + bsize);
+	if (ret == NULL)
+		goto fail;
+	memset(ret->ob_digit, 0, Py_SIZE(ret) * sizeof(digit));
+	c[0] = r[0];
+	c[1] = r1;
+	c[2] = r2;
+	c[3] = r3;
+	c[4] = r[4];
+	for (i = 0; i < 5; i++) {
+		assert(Py_SIZE(c[i]) >= 0);
+		assert(i*k + Py_SIZE(c[i]) <= Py_SIZE(ret));
+		if (Py_SIZE(c[i]) > 0)
+			(void)v_iadd(ret->ob_digit + i*k, Py_SIZE(ret) - i*k,
+				     c[i]->ob_digit, Py_SIZE(c[i]));
+	}
+	ret = long_normalize(ret);
+
+ fail:
+	for (i = 0; i < 5; i++) {
+		Py_XDECREF(va[i]);
+		Py_XDECREF(vb[i]);
+		Py_XDECREF(r[i]);
+	}
+	Py_XDECREF(r1);
+	Py_XDECREF(r2);
+	Py_XDECREF(r3);
+	Py_XDECREF(t);
+	Py_XDECREF(u);
+	return ret;
+}
+
+/* Decimal conversion of large longs.
+ *
+ * The schoolbook conversions between longs and decimal strings in
+ * _PyLong_Format and PyLong_FromString take time quadratic in the number
+ * of digits.  Past a cutoff, these routines divide and conquer instead:
+ * a number of up to 2*m decimal digits is split as hi * 10**m + lo, m
+ * being DECIMAL_LEAF << level, and the halves are handled recursively.
+ * Parsing then costs a multiplication per split.  Formatting costs a
+ * division per split, done as two multiplications by a reciprocal of
+ * 10**m computed with a Newton step, so both run in a small multiple of
+ * the time of a k_mul of the full size.
+ *
+ * The powers 10**(DECIMAL_LEAF << level) and their reciprocals are cached
+ * across calls for the POW10_KEEP smallest levels, and only for the
+ * length of a conversion for the larger ones.
+ */
+
+/* Number of decimal digits handled by the quadratic leaf routines. */
+#define DECIMAL_LEAF 256
+
+/* Enough digits to hold any value below 10**DECIMAL_LEAF, log2(10) being
+   less than 10/3. */
+#define DECIMAL_LEAF_SIZE \
+	((DECIMAL_LEAF * 10 / 3 + PyLong_SHIFT - 1) / PyLong_SHIFT + 1)
+
+/* The largest power of 10 that fits in a digit, and its exponent. */
+#if PyLong_SHIFT == 15
+#define DECIMAL_BASE 10000
+#define DECIMAL_BASE_DIGITS 4
+#elif PyLong_SHIFT == 30
+#define DECIMAL_BASE 1000000000
+#define DECIMAL_BASE_DIGITS 9
+#else
+#error "DECIMAL_BASE undefined for this PyLong_SHIFT"
+#endif
+
+/* Below this many digits, reciprocals are computed by long division. */
+#define RECIPROCAL_CUTOFF (2 * KARATSUBA_CUTOFF)
+
+#define POW10_LEVELS (8 * SIZEOF_SIZE_T)
+#define POW10_KEEP 8
+
+/* pow10_cache[level] is 10**(DECIMAL_LEAF << level) once computed, and
+   pow10_recip[level] its long_reciprocal(). */
+static PyLongObject *pow10_cache[POW10_LEVELS];
+static PyLongObject *pow10_recip[POW10_LEVELS];
+
+/* Return a borrowed reference to 10**(DECIMAL_LEAF << level). */
+static PyLongObject *
+get_pow10(int level)
+{
+	PyLongObject *z, *p;
+	int i;
+
+	assert(level >= 0 && level < POW10_LEVELS);
+	if (pow10_cache[level] != NULL)
+		return pow10_cache[level];
+	if (level == 0) {
+		z = (PyLongObject *)PyLong_FromLong(1L);
+		for (i = 0; z != NULL && i < DECIMAL_LEAF; i++) {
+			p = mul1(z, 10);
+			Py_DECREF(z);
+			z = p;
+		}
+	}
+	else {
+		p = get_pow10(level - 1);
+		if (p == NULL)
+			return NULL;
+		z = k_mul(p, p);
+	}
+	pow10_cache[level] = z;
+	return z;
+}
+
+/* Drop the cached powers above POW10_KEEP after a conversion. */
+static void
+release_pow10(void)
+{
+	int i;
+
+	for (i = POW10_KEEP; i < POW10_LEVELS; i++) {
+		Py_CLEAR(pow10_cache[i]);
+		Py_CLEAR(pow10_recip[i]);
+	}
+}
+
+/* Return |n| shifted right by k digits. */
+static PyLongObject *
+digit_rshift(PyLongObject *n, Py_ssize_t k)
+{
+	Py_ssize_t size = ABS(Py_SIZE(n)) - k;
+	PyLongObject *z;
+
+	if (size < 0)
+		size = 0;
+	z = _PyLong_New(size);
+	if (z != NULL)
+		memcpy(z->ob_digit, n->ob_digit + k, size * sizeof(digit));
+	return z;
+}
+
+/* Return |n| shifted left by k digits. */
+static PyLongObject *
+digit_lshift(PyLongObject *n, Py_ssize_t k)
+{
+	Py_ssize_t size = ABS(Py_SIZE(n));
+	PyLongObject *z;
+
+	if (size == 0)
+		return _PyLong_New(0);
+	z = _PyLong_New(size + k);
+	if (z != NULL) {
+		memset(z->ob_digit, 0, k * sizeof(digit));
+		memcpy(z->ob_digit + k, n->ob_digit, size * sizeof(digit));
+	}
+	return z;
+}
+
+/* Return PyLong_BASE**k. */
+static PyLongObject *
+digit_power(Py_ssize_t k)
+{
+	PyLongObject *z;
+
+	z = _PyLong_New(k + 1);
+	if (z != NULL) {
+		memset(z->ob_digit, 0, k * sizeof(digit));
+		z->ob_digit[k] = 1;
+	}
+	return z;
+}
+
+/* Return floor(PyLong_BASE**(2*nd) / d) for d > 0 of nd digits.  Large
+ * reciprocals start from that of the top half of d, plus guard digits,
+ * which has about nd/2 correct digits, and double that with one Newton
+ * step y += y * (PyLong_BASE**(2*nd) - d*y) / PyLong_BASE**(2*nd).
+ * The last few units are then fixed up against the remainder.
+ */
+static PyLongObject *
+long_reciprocal(PyLongObject *d)
+{
+	Py_ssize_t nd = Py_SIZE(d), h;
+	PyLongObject *num = NULL, *one = NULL;
+	PyLongObject *y = NULL, *e = NULL, *t = NULL;
+
+	assert(nd > 0);
+	LONG_SET(num, digit_power(2 * nd));
+	if (nd <= RECIPROCAL_CUTOFF) {
+		if (long_divrem(num, d, &y, &e) < 0)
+			goto fail;
+		Py_DECREF(num);
+		Py_DECREF(e);
+		return y;
+	}
+
+	h = nd / 2 + 3;
+	LONG_SET(t, digit_rshift(d, nd - h));
+	LONG_SET(t, long_reciprocal(t));
+	LONG_SET(y, digit_lshift(t, nd - h));
+
+	/* Newton step. */
+	LONG_SET(t, k_mul(d, y));
+	LONG_SET(e, x_sub(num, t));
+	LONG_SET(t, k_mul(y, e));
+	LONG_SET(t, digit_rshift(t, 2 * nd));
+	if (Py_SIZE(e) < 0)
+		LONG_SET(y, x_sub(y, t));
+	else
+		LONG_SET(y, x_add(y, t));
+
+	/* Make the remainder e = PyLong_BASE**(2*nd) - d*y satisfy
+	   0 <= e < d. */
+	LONG_SET(t, k_mul(d, y));
+	LONG_SET(e, x_sub(num, t));
+	LONG_SET(one, PyLong_FromLong(1L));
+	while (Py_SIZE(e) < 0) {
+		LONG_SET(y, x_sub(y, one));
+		LONG_SET(e, long_add(e, d));
+	}
+	while (long_compare(e, d) >= 0) {
+		LONG_SET(y, x_add(y, one));
+		LONG_SET(e, x_sub(e, d));
+	}
+	Py_DECREF(num);
+	Py_DECREF(one);
+	Py_DECREF(e);
+	Py_DECREF(t);
+	return y;
+
+ fail:
+	Py_XDECREF(num);
+	Py_XDECREF(one);
+	Py_XDECREF(y);
+	Py_XDECREF(e);
+	Py_XDECREF(t);
+	return NULL;
+}
+
+/* Set *pq and *pr to the quotient and remainder of 0 <= n < d**2 by
+ * d = 10**(DECIMAL_LEAF << level).  Returns 0 on success, -1 on failure.
+ */
+static int
+pow10_divmod(PyLongObject *n, int level, PyLongObject **pq, PyLongObject **pr)
+{
+	PyLongObject *d = pow10_cache[level];
+	PyLongObject *q = NULL, *r = NULL, *t = NULL;
+
+	assert(d != NULL);
+	if (pow10_recip[level] == NULL) {
+		pow10_recip[level] = long_reciprocal(d);
+		if (pow10_recip[level] == NULL)
+			return -1;
+	}
+	/* n < PyLong_BASE**(2*nd), so this estimate is at most a couple of
+	   units short. */
+	LONG_SET(t, k_mul(n, pow10_recip[level]));
+	LONG_SET(q, digit_rshift(t, 2 * Py_SIZE(d)));
+	LONG_SET(t, k_mul(q, d));
+	LONG_SET(r, x_sub(n, t));
+	while (long_compare(r, d) >= 0) {
+		LONG_SET(r, x_sub(r, d));
+		LONG_SET(q, muladd1(q, 1, 1));		/* q + 1 */
+	}
+	Py_DECREF(t);
+	*pq = q;
+	*pr = r;
+	return 0;
+
+ fail:
+	Py_XDECREF(q);
+	Py_XDECREF(r);
+	Py_XDECREF(t);
+	return -1;
+}
+
+/* Write the decimal digits of 0 <= n < 10**DECIMAL_LEAF backwards from
+ * *pp, padded with zeros to DECIMAL_LEAF digits if pad is set, and leave
+ * *pp at the first digit.
+ */
+static void
+leaf_to_decimal(PyLongObject *n, char **pp, int pad)
+{
+	digit scratch[DECIMAL_LEAF_SIZE];
+	Py_ssize_t size = Py_SIZE(n);
+	char *end = *pp, *p = *pp;
+	digit rem;
+	int i;
+
+	assert(size >= 0 && size <= DECIMAL_LEAF_SIZE);
+	memcpy(scratch, n->ob_digit, size * sizeof(digit));
+	while (size > 0) {
+		rem = inplace_divrem1(scratch, scratch, size, DECIMAL_BASE);
+		if (scratch[size - 1] == 0)
+			--size;
+		for (i = 0; i < DECIMAL_BASE_DIGITS; i++) {
+			*--p = (char)('0' + rem % 10);
+			rem /= 10;
+		}
+	}
+	if (pad) {
+		while (p > end - DECIMAL_LEAF)
+			*--p = '0';
+		p = end - DECIMAL_LEAF;
+	}
+	else {
+		while (p < end && *p == '0')
+			++p;
+		if (p == end)
+			*--p = '0';
+	}
+	*pp = p;
+}
+
+/* Write the decimal digits of 0 <= n < 10**(DECIMAL_LEAF << (level+1))
+ * backwards from *pp as leaf_to_decimal does, padding to that many digits
+ * if pad is set.  Returns 0 on success, -1 on failure.
+ */
+static int
+long_to_decimal_rec(PyLongObject *n, int level, char **pp, int pad)
+{
+	PyLongObject *p, *q, *r;
+	int err;
+
+	if (level < 0) {
+		leaf_to_decimal(n, pp, pad);
+		return 0;
+	}
+	p = get_pow10(level);
+	if (p == NULL)
+		return -1;
+	if (!pad && long_compare(n, p) < 0)
+		return long_to_decimal_rec(n, level - 1, pp, 0);
+	if (pow10_divmod(n, level, &q, &r) < 0)
+		return -1;
+	err = long_to_decimal_rec(r, level - 1, pp, 1);
+	Py_DECREF(r);
+	if (err == 0)
+		err = long_to_decimal_rec(q, level - 1, pp, pad);
+	Py_DECREF(q);
+	return err;
+}
+
+/* Write the decimal digits of |a| backwards from *pp, leaving *pp at the
+ * first digit.  The buffer must have room for 5 more characters than
+ * a has decimal digits.  Returns 0 on success, -1 on failure.
+ */
+static int
+long_to_decimal(PyLongObject *a, char **pp)
+{
+	Py_ssize_t bound;	/* an upper bound on the number of digits */
+	PyLongObject *n;
+	int level = 0;
+	int err;
+
+	/* PyLong_SHIFT*3/10 + 1 >= PyLong_SHIFT * log10(2) */
+	bound = ABS(Py_SIZE(a)) * (PyLong_SHIFT * 3 / 10 + 1);
+	while (((Py_ssize_t)DECIMAL_LEAF << (level + 1)) < bound)
+		level++;
+	if (Py_SIZE(a) < 0) {
+		n = (PyLongObject *)_PyLong_Copy(a);
+		if (n == NULL)
+			return -1;
+		Py_SIZE(n) = -Py_SIZE(n);
+	}
+	else {
+		n = a;
+		Py_INCREF(n);
+	}
+	err = long_to_decimal_rec(n, level, pp, 0);
+	Py_DECREF(n);
+	release_pow10();
+	return err;
+}
+
+/* Return the value of the n <= DECIMAL_LEAF decimal digits at s. */
+static PyLongObject *
+leaf_from_decimal(char *s, Py_ssize_t n)
+{
+	PyLongObject *z;
+	Py_ssize_t size = 0, i;
+	twodigits c, mult;
+	int k;
+
+	assert(n <= DECIMAL_LEAF);
+	z = _PyLong_New(DECIMAL_LEAF_SIZE);
+	if (z == NULL)
+		return NULL;
+	/* Take a partial group first so the rest come in full groups. */
+	k = (int)(n % DECIMAL_BASE_DIGITS);
+	if (k == 0)
+		k = DECIMAL_BASE_DIGITS;
+	while (n > 0) {
+		c = 0;
+		mult = 1;
+		for (i = 0; i < k; i++) {
+			c = c * 10 + (*s++ - '0');
+			mult *= 10;
+		}
+		n -= k;
+		k = DECIMAL_BASE_DIGITS;
+		for (i = 0; i < size; i++) {
+			c += (twodigits)z->ob_digit[i] * mult;
+			z->ob_digit[i] = (digit)(c & PyLong_MASK);
+			c >>= PyLong_SHIFT;
+		}
+		if (c != 0) {
+			assert(size < DECIMAL_LEAF_SIZE);
+			z->ob_digit[size++] = (digit)c;
+		}
+	}
+	Py_SIZE(z) = size;
+	return z;
+}
+
+/* Return the value of the n decimal digits at s. */
+static PyLongObject *
+long_from_decimal_rec(char *s, Py_ssize_t n)
+{
+	PyLongObject *hi = NULL, *lo = NULL, *p, *z = NULL;
+	Py_ssize_t m;
+	int level = 0;
+
+	if (n <= DECIMAL_LEAF)
+		return leaf_from_decimal(s, n);
+	/* Split off the largest m = DECIMAL_LEAF << level below n; then
+	   n - m <= m. */
+	while (((Py_ssize_t)DECIMAL_LEAF << (level + 1)) < n)
+		level++;
+	m = (Py_ssize_t)DECIMAL_LEAF << level;
+	LONG_SET(hi, long_from_decimal_rec(s, n - m));
+	LONG_SET(lo, long_from_decimal_rec(s + n - m, m));
+	p = get_pow10(level);
+	if (p == NULL)
+		goto fail;
+	LONG_SET(hi, k_mul(hi, p));
+	z = x_add(hi, lo);
+
+ fail:
+	Py_XDECREF(hi);
+	Py_XDECREF(lo);
+	return z;
+}
+
+/* Parse the run of decimal digits at *str, and leave *str just past it. */
+static PyLongObject *
+long_from_decimal(char **str)
+{
+	Py_ssize_t n;
+	PyLongObject *z;
+
+	n = strspn(*str, "0123456789");
+	z = long_from_decimal_rec(*str, n);
+	release_pow10();
+	*str += n;
+	return z;
+}
+
 static PyObject *
 long_mul(PyLongObject *v, PyLongObject *w)
 {
@@ -4,14 +4,12 @@
 #include "Python.h"
 #include "structmember.h"
 
-/* Free list for method objects to safe malloc/free overhead
- * The m_self element is used to chain the objects.
- */
-static PyCFunctionObject *free_list = NULL;
-static int numfree = 0;
+/* Free list for method objects to safe malloc/free overhead */
 #ifndef PyCFunction_MAXFREELIST
 #define PyCFunction_MAXFREELIST 256
 #endif
+static _PyFreeList free_list = _PyFreeList_INIT(
+	"builtin_function_or_method", PyCFunction_MAXFREELIST, 1);
 
 PyObject *
 PyCFunction_NewEx(PyMethodDef *ml, PyObject *self, PyObject *module)
@@ -29,12 +27,9 @@ PyCFunction_NewEx(PyMethodDef *ml, PyObject *self, PyObject *module)
 		}
 	}
 
-	op = free_list;
-	if (op != NULL) {
-		free_list = (PyCFunctionObject *)(op->m_self);
+	_PyFreeList_POP(&free_list, op);
+	if (op != NULL)
 		PyObject_INIT(op, &PyCFunction_Type);
-		numfree--;
-	}
 	else {
 		op = PyObject_GC_New(PyCFunctionObject, &PyCFunction_Type);
 		if (op == NULL)
@@ -182,14 +177,7 @@ meth_dealloc(PyCFunctionObject *m)
 	_PyObject_GC_UNTRACK(m);
 	Py_XDECREF(m->m_self);
 	Py_XDECREF(m->m_module);
-	if (numfree < PyCFunction_MAXFREELIST) {
-		m->m_self = (PyObject *)free_list;
-		free_list = m;
-		numfree++;
-	}
-	else {
-		PyObject_GC_Del(m);
-	}
+	_PyFreeList_FREE(&free_list, m);
 }
 
 static PyObject *
@@ -442,16 +430,7 @@ Py_FindMethod(PyMethodDef *methods, PyObject *self, const char *name)
 int
 PyCFunction_ClearFreeList(void)
 {
-	int freelist_size = numfree;
-	
-	while (free_list) {
-		PyCFunctionObject *v = free_list;
-		free_list = (PyCFunctionObject *)(v->m_self);
-		PyObject_GC_Del(v);
-		numfree--;
-	}
-	assert(numfree == 0);
-	return freelist_size;
+	return _PyFreeList_Clear(&free_list);
 }
 
 void
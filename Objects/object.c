@@ -15,12 +15,9 @@ _Py_GetRefTotal(void)
 {
 	PyObject *o;
 	Py_ssize_t total = _Py_RefTotal;
-        /* ignore the references to the dummy object of the dicts and sets
+        /* ignore the references to the dummy object of the sets
            because they are not reliable and not useful (now that the
            hash table code is well-tested) */
-	o = _PyDict_Dummy();
-	if (o != NULL)
-		total -= o->ob_refcnt;
 	o = _PySet_Dummy();
 	if (o != NULL)
 		total -= o->ob_refcnt;
@@ -1447,7 +1444,7 @@ PyObject_GenericSetAttr(PyObject *obj, PyObject *name, PyObject *value)
 	if (dictptr != NULL) {
 		PyObject *dict = *dictptr;
 		if (dict == NULL && value != NULL) {
-			dict = PyDict_New();
+			dict = _PyObject_NewInstanceDict(obj);
 			if (dict == NULL)
 				goto done;
 			*dictptr = dict;
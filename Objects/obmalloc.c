@@ -2,6 +2,10 @@
 
 #ifdef WITH_PYMALLOC
 
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
 /* An object allocator for Python.
 
    Here is an introduction to the layers of the Python memory architecture,
@@ -167,9 +171,40 @@
  *
  * Therefore, allocating arenas with malloc is not optimal, because there is
  * some address space wastage, but this is the most portable way to request
- * memory from the system across various platforms.
+ * memory from the system across various platforms.  Where mmap() is
+ * available arenas are mapped directly instead, which gets them page
+ * aligned and lets the allocator hand unused pages back (see
+ * release_pool()).
+ *
+ * With WITH_PYMALLOC_HUGE_PAGES (configure --with-pymalloc-hugepages)
+ * arenas are 2MB and mapped from huge pages where the system allows it, so
+ * that a whole arena needs a single TLB entry.  Pools aren't released in
+ * that mode, since that would split the huge pages up again.
  */
+#ifdef WITH_PYMALLOC_HUGE_PAGES
+#define ARENA_SIZE		(2 << 20)	/* 2MB */
+#else
 #define ARENA_SIZE		(256 << 10)	/* 256KB */
+#endif
+
+#if defined(HAVE_SYS_MMAN_H) && !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS		MAP_ANON
+#endif
+#if defined(HAVE_SYS_MMAN_H) && defined(MAP_ANONYMOUS)
+#define ARENAS_USE_MMAP
+#endif
+
+/*
+ * Empty pools beyond the first MAX_IDLE_POOLS of an arena are given back
+ * to the system with madvise(), so that an arena that is mostly empty but
+ * can't be freed doesn't keep all of its memory.  The address range stays
+ * mapped and is faulted back in, zeroed, when the pool is used again.
+ */
+#if defined(ARENAS_USE_MMAP) && defined(HAVE_MADVISE) && \
+    defined(MADV_DONTNEED) && !defined(WITH_PYMALLOC_HUGE_PAGES)
+#define RELEASE_POOLS
+#define MAX_IDLE_POOLS		4
+#endif
 
 #ifdef WITH_MEMORY_LIMITS
 #define MAX_ARENAS		(SMALL_MEMORY_LIMIT / ARENA_SIZE)
@@ -246,6 +281,8 @@ struct pool_header {
 
 typedef struct pool_header *poolp;
 
+#define RELEASED_BITS		(8 * sizeof(uint))
+
 /* Record keeping for arenas. */
 struct arena_object {
 	/* The address of the arena, as returned by malloc.  Note that 0
@@ -269,6 +306,15 @@ struct arena_object {
 	/* Singly-linked list of available pools. */
 	struct pool_header* freepools;
 
+#ifdef RELEASE_POOLS
+	/* The available pools that have been released instead of linked
+	 * into freepools:  how many, and a bit for each pool of the arena.
+	 */
+	uint nreleasedpools;
+	uint releasedpools[(ARENA_SIZE / POOL_SIZE + RELEASED_BITS - 1) /
+			   RELEASED_BITS];
+#endif
+
 	/* Whenever this arena_object is not associated with an allocated
 	 * arena, the nextarena member is used to link all unassociated
 	 * arena_objects in the singly-linked `unused_arena_objects` list.
@@ -493,12 +539,132 @@ static struct arena_object* usable_arenas = NULL;
 /* Number of arenas allocated that haven't been free()'d. */
 static size_t narenas_currently_allocated = 0;
 
-#ifdef PYMALLOC_DEBUG
 /* Total number of times malloc() called to allocate an arena. */
 static size_t ntimes_arena_allocated = 0;
 /* High water mark (max value ever seen) for narenas_currently_allocated. */
 static size_t narenas_highwater = 0;
+
+/* Number of blocks of each size class taken from the pools, and its high
+ * water mark.
+ */
+static struct {
+	size_t used;
+	size_t highwater;
+} class_usage[NB_SMALL_SIZE_CLASSES];
+
+/* Get the memory for an arena from the system, or NULL. */
+static void *
+arena_map(void)
+{
+#ifdef ARENAS_USE_MMAP
+	void *p;
+#ifdef WITH_PYMALLOC_HUGE_PAGES
+	uptr excess;
+
+#ifdef MAP_HUGETLB
+	/* This only works if the administrator reserved huge pages. */
+	p = mmap(NULL, ARENA_SIZE, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (p != MAP_FAILED)
+		return p;
+#endif
+	/* Else map an arena aligned on a huge page boundary, which the
+	 * system can back with a transparent huge page.
+	 */
+	p = mmap(NULL, 2 * ARENA_SIZE, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		return NULL;
+	excess = (uptr)p & (ARENA_SIZE - 1);
+	if (excess != 0) {
+		/* Trim the head up to the first aligned address; that
+		 * leaves excess bytes of the mapping past the arena.
+		 */
+		munmap(p, ARENA_SIZE - excess);
+		p = (block *)p + ARENA_SIZE - excess;
+		munmap((block *)p + ARENA_SIZE, excess);
+	}
+	else
+		munmap((block *)p + ARENA_SIZE, ARENA_SIZE);
+	assert(((uptr)p & (ARENA_SIZE - 1)) == 0);
+#ifdef MADV_HUGEPAGE
+	madvise(p, ARENA_SIZE, MADV_HUGEPAGE);
 #endif
+	return p;
+#else
+	p = mmap(NULL, ARENA_SIZE, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	return p == MAP_FAILED ? NULL : p;
+#endif
+#else
+	return malloc(ARENA_SIZE);
+#endif
+}
+
+static void
+arena_unmap(void *address)
+{
+#ifdef ARENAS_USE_MMAP
+	munmap(address, ARENA_SIZE);
+#else
+	free(address);
+#endif
+}
+
+#ifdef RELEASE_POOLS
+
+/* Can pools be released?  Only if a pool is made of whole system pages,
+ * else madvise() would drop the pages of neighbouring pools too.  -1 until
+ * the first arena is allocated.
+ */
+static int release_pools = -1;
+
+/* The address of the first pool of an arena */
+#define FIRST_POOL(AO) \
+	(((AO)->address + POOL_SIZE_MASK) & ~(uptr)POOL_SIZE_MASK)
+
+/* Give the memory of empty pool back to the system instead of linking it
+ * into ao->freepools.
+ */
+#define POOL_INDEX(AO, P)	((uint)(((uptr)(P) - FIRST_POOL(AO)) / POOL_SIZE))
+#define POOL_RELEASED(AO, P) \
+	((AO)->releasedpools[POOL_INDEX(AO, P) / RELEASED_BITS] & \
+	 (1U << (POOL_INDEX(AO, P) % RELEASED_BITS)))
+
+static void
+release_pool(struct arena_object *ao, poolp pool)
+{
+	uint i = POOL_INDEX(ao, pool);
+
+	ao->releasedpools[i / RELEASED_BITS] |= 1U << (i % RELEASED_BITS);
+	++ao->nreleasedpools;
+	madvise((void *)pool, POOL_SIZE, MADV_DONTNEED);
+}
+
+/* Take back a released pool of ao.  Its header reads as zeros. */
+static poolp
+unrelease_pool(struct arena_object *ao)
+{
+	uint i, j;
+
+	assert(ao->nreleasedpools > 0);
+	for (i = 0; ao->releasedpools[i] == 0; ++i)
+		;
+	for (j = 0; (ao->releasedpools[i] & (1U << j)) == 0; ++j)
+		;
+	ao->releasedpools[i] &= ~(1U << j);
+	--ao->nreleasedpools;
+	return (poolp)(FIRST_POOL(ao) + (i * RELEASED_BITS + j) * POOL_SIZE);
+}
+
+/* The number of empty pools linked into ao->freepools:  the available pools
+ * that are neither released nor still to be carved off.
+ */
+#define IDLE_POOLS(AO) ((AO)->nfreepools - (AO)->nreleasedpools - \
+	(uint)(((AO)->address + ARENA_SIZE - (uptr)(AO)->pool_address) / \
+	       POOL_SIZE))
+
+#endif /* RELEASE_POOLS */
 
 /* Allocate a new arena.  If we run out of memory, return NULL.  Else
  * allocate a new arena, and return the address of an arena_object
@@ -562,7 +728,7 @@ new_arena(void)
 	arenaobj = unused_arena_objects;
 	unused_arena_objects = arenaobj->nextarena;
 	assert(arenaobj->address == 0);
-	arenaobj->address = (uptr)malloc(ARENA_SIZE);
+	arenaobj->address = (uptr)arena_map();
 	if (arenaobj->address == 0) {
 		/* The allocation failed: return NULL after putting the
 		 * arenaobj back.
@@ -573,11 +739,9 @@ new_arena(void)
 	}
 
 	++narenas_currently_allocated;
-#ifdef PYMALLOC_DEBUG
 	++ntimes_arena_allocated;
 	if (narenas_currently_allocated > narenas_highwater)
 		narenas_highwater = narenas_currently_allocated;
-#endif
 	arenaobj->freepools = NULL;
 	/* pool_address <- first pool-aligned address in the arena
 	   nfreepools <- number of whole pools that fit after alignment */
@@ -590,6 +754,18 @@ new_arena(void)
 		arenaobj->pool_address += POOL_SIZE - excess;
 	}
 	arenaobj->ntotalpools = arenaobj->nfreepools;
+#ifdef RELEASE_POOLS
+	arenaobj->nreleasedpools = 0;
+	memset(arenaobj->releasedpools, 0, sizeof(arenaobj->releasedpools));
+	if (release_pools < 0) {
+#if defined(HAVE_SYSCONF) && defined(_SC_PAGESIZE)
+		long page_size = sysconf(_SC_PAGESIZE);
+		release_pools = page_size > 0 && POOL_SIZE % page_size == 0;
+#else
+		release_pools = 1;
+#endif
+	}
+#endif
 
 	return arenaobj;
 }
@@ -707,6 +883,649 @@ int Py_ADDRESS_IN_RANGE(void *P, poolp pool) Py_NO_INLINE;
 
 /*==========================================================================*/
 
+/* Take a block of size class size from the pools.  Returns NULL if that
+ * needs a new arena and there's no memory for it.
+ */
+static block *
+pool_alloc(uint size)
+{
+	block *bp;
+	poolp pool;
+	poolp next;
+
+	LOCK();
+	if (++class_usage[size].used > class_usage[size].highwater)
+		class_usage[size].highwater = class_usage[size].used;
+	/*
+	 * Most frequent paths first
+	 */
+	pool = usedpools[size + size];
+	if (pool != pool->nextpool) {
+		/*
+		 * There is a used pool for this size class.
+		 * Pick up the head block of its free list.
+		 */
+		++pool->ref.count;
+		bp = pool->freeblock;
+		assert(bp != NULL);
+		if ((pool->freeblock = *(block **)bp) != NULL) {
+			UNLOCK();
+			return bp;
+		}
+		/*
+		 * Reached the end of the free list, try to extend it.
+		 */
+		if (pool->nextoffset <= pool->maxnextoffset) {
+			/* There is room for another block. */
+			pool->freeblock = (block*)pool +
+					  pool->nextoffset;
+			pool->nextoffset += INDEX2SIZE(size);
+			*(block **)(pool->freeblock) = NULL;
+			UNLOCK();
+			return bp;
+		}
+		/* Pool is full, unlink from used pools. */
+		next = pool->nextpool;
+		pool = pool->prevpool;
+		next->prevpool = pool;
+		pool->nextpool = next;
+		UNLOCK();
+		return bp;
+	}
+
+	/* There isn't a pool of the right size class immediately
+	 * available:  use a free pool.
+	 */
+	if (usable_arenas == NULL) {
+		/* No arena has a free pool:  allocate a new arena. */
+#ifdef WITH_MEMORY_LIMITS
+		if (narenas_currently_allocated >= MAX_ARENAS) {
+			--class_usage[size].used;
+			UNLOCK();
+			return NULL;
+		}
+#endif
+		usable_arenas = new_arena();
+		if (usable_arenas == NULL) {
+			--class_usage[size].used;
+			UNLOCK();
+			return NULL;
+		}
+		usable_arenas->nextarena =
+			usable_arenas->prevarena = NULL;
+	}
+	assert(usable_arenas->address != 0);
+
+	/* Try to get a cached free pool. */
+	pool = usable_arenas->freepools;
+	if (pool != NULL) {
+		/* Unlink from cached pools. */
+		usable_arenas->freepools = pool->nextpool;
+
+		/* This arena already had the smallest nfreepools
+		 * value, so decreasing nfreepools doesn't change
+		 * that, and we don't need to rearrange the
+		 * usable_arenas list.  However, if the arena has
+		 * become wholly allocated, we need to remove its
+		 * arena_object from usable_arenas.
+		 */
+		--usable_arenas->nfreepools;
+		if (usable_arenas->nfreepools == 0) {
+			/* Wholly allocated:  remove. */
+			assert(usable_arenas->freepools == NULL);
+			assert(usable_arenas->nextarena == NULL ||
+			       usable_arenas->nextarena->prevarena ==
+				   usable_arenas);
+
+			usable_arenas = usable_arenas->nextarena;
+			if (usable_arenas != NULL) {
+				usable_arenas->prevarena = NULL;
+				assert(usable_arenas->address != 0);
+			}
+		}
+		else {
+			/* nfreepools > 0:  it must be that freepools
+			 * isn't NULL, that some pools were released, or
+			 * that we haven't yet carved off all the
+			 * arena's pools for the first time.
+			 */
+			assert(usable_arenas->freepools != NULL ||
+#ifdef RELEASE_POOLS
+			       usable_arenas->nreleasedpools > 0 ||
+#endif
+			       usable_arenas->pool_address <=
+			           (block*)usable_arenas->address +
+			               ARENA_SIZE - POOL_SIZE);
+		}
+	init_pool:
+		/* Frontlink to used pools. */
+		next = usedpools[size + size]; /* == prev */
+		pool->nextpool = next;
+		pool->prevpool = next;
+		next->nextpool = pool;
+		next->prevpool = pool;
+		pool->ref.count = 1;
+		if (pool->szidx == size) {
+			/* Luckily, this pool last contained blocks
+			 * of the same size class, so its header
+			 * and free list are already initialized.
+			 */
+			bp = pool->freeblock;
+			pool->freeblock = *(block **)bp;
+			UNLOCK();
+			return bp;
+		}
+		/*
+		 * Initialize the pool header, set up the free list to
+		 * contain just the second block, and return the first
+		 * block.
+		 */
+		pool->szidx = size;
+		size = INDEX2SIZE(size);
+		bp = (block *)pool + POOL_OVERHEAD;
+		pool->nextoffset = POOL_OVERHEAD + (size << 1);
+		pool->maxnextoffset = POOL_SIZE - size;
+		pool->freeblock = bp + size;
+		*(block **)(pool->freeblock) = NULL;
+		UNLOCK();
+		return bp;
+	}
+
+	assert(usable_arenas->nfreepools > 0);
+	assert(usable_arenas->freepools == NULL);
+#ifdef RELEASE_POOLS
+	if (usable_arenas->nreleasedpools > 0)
+		/* Reuse a released pool before touching new pages. */
+		pool = unrelease_pool(usable_arenas);
+	else
+#endif
+	{
+		/* Carve off a new pool. */
+		pool = (poolp)usable_arenas->pool_address;
+		assert((block*)pool <= (block*)usable_arenas->address +
+		                       ARENA_SIZE - POOL_SIZE);
+		usable_arenas->pool_address += POOL_SIZE;
+	}
+	pool->arenaindex = usable_arenas - arenas;
+	assert(&arenas[pool->arenaindex] == usable_arenas);
+	pool->szidx = DUMMY_SIZE_IDX;
+	--usable_arenas->nfreepools;
+
+	if (usable_arenas->nfreepools == 0) {
+		assert(usable_arenas->nextarena == NULL ||
+		       usable_arenas->nextarena->prevarena ==
+		       	   usable_arenas);
+		/* Unlink the arena:  it is completely allocated. */
+		usable_arenas = usable_arenas->nextarena;
+		if (usable_arenas != NULL) {
+			usable_arenas->prevarena = NULL;
+			assert(usable_arenas->address != 0);
+		}
+	}
+
+	goto init_pool;
+}
+
+/* Return block p to its pool, which must be POOL_ADDR(p). */
+static void
+pool_free(poolp pool, block *p)
+{
+	block *lastfree;
+	poolp next, prev;
+	uint size;
+
+	LOCK();
+	/* Link p to the start of the pool's freeblock list.  Since
+	 * the pool had at least the p block outstanding, the pool
+	 * wasn't empty (so it's already in a usedpools[] list, or
+	 * was full and is in no list -- it's not in the freeblocks
+	 * list in any case).
+	 */
+	assert(pool->ref.count > 0);	/* else it was empty */
+	--class_usage[pool->szidx].used;
+	*(block **)p = lastfree = pool->freeblock;
+	pool->freeblock = (block *)p;
+	if (lastfree) {
+		struct arena_object* ao;
+		uint nf;  /* ao->nfreepools */
+
+		/* freeblock wasn't NULL, so the pool wasn't full,
+		 * and the pool is in a usedpools[] list.
+		 */
+		if (--pool->ref.count != 0) {
+			/* pool isn't empty:  leave it in usedpools */
+			UNLOCK();
+			return;
+		}
+		/* Pool is now empty:  unlink from usedpools, and
+		 * link to the front of freepools.  This ensures that
+		 * previously freed pools will be allocated later
+		 * (being not referenced, they are perhaps paged out).
+		 */
+		next = pool->nextpool;
+		prev = pool->prevpool;
+		next->prevpool = prev;
+		prev->nextpool = next;
+
+		/* Link the pool to freepools.  This is a singly-linked
+		 * list, and pool->prevpool isn't used there.  If the arena
+		 * has enough empty pools already, and isn't about to be
+		 * freed, release the pool instead.
+		 */
+		ao = &arenas[pool->arenaindex];
+#ifdef RELEASE_POOLS
+		if (release_pools && IDLE_POOLS(ao) >= MAX_IDLE_POOLS &&
+		    ao->nfreepools + 1 < ao->ntotalpools)
+			release_pool(ao, pool);
+		else
+#endif
+		{
+			pool->nextpool = ao->freepools;
+			ao->freepools = pool;
+		}
+		nf = ++ao->nfreepools;
+
+		/* All the rest is arena management.  We just freed
+		 * a pool, and there are 4 cases for arena mgmt:
+		 * 1. If all the pools are free, return the arena to
+		 *    the system free().
+		 * 2. If this is the only free pool in the arena,
+		 *    add the arena back to the `usable_arenas` list.
+		 * 3. If the "next" arena has a smaller count of free
+		 *    pools, we have to "slide this arena right" to
+		 *    restore that usable_arenas is sorted in order of
+		 *    nfreepools.
+		 * 4. Else there's nothing more to do.
+		 */
+		if (nf == ao->ntotalpools) {
+			/* Case 1.  First unlink ao from usable_arenas.
+			 */
+			assert(ao->prevarena == NULL ||
+			       ao->prevarena->address != 0);
+			assert(ao ->nextarena == NULL ||
+			       ao->nextarena->address != 0);
+
+			/* Fix the pointer in the prevarena, or the
+			 * usable_arenas pointer.
+			 */
+			if (ao->prevarena == NULL) {
+				usable_arenas = ao->nextarena;
+				assert(usable_arenas == NULL ||
+				       usable_arenas->address != 0);
+			}
+			else {
+				assert(ao->prevarena->nextarena == ao);
+				ao->prevarena->nextarena =
+					ao->nextarena;
+			}
+			/* Fix the pointer in the nextarena. */
+			if (ao->nextarena != NULL) {
+				assert(ao->nextarena->prevarena == ao);
+				ao->nextarena->prevarena =
+					ao->prevarena;
+			}
+			/* Record that this arena_object slot is
+			 * available to be reused.
+			 */
+			ao->nextarena = unused_arena_objects;
+			unused_arena_objects = ao;
+
+			/* Free the entire arena. */
+			arena_unmap((void *)ao->address);
+			ao->address = 0;	/* mark unassociated */
+			--narenas_currently_allocated;
+
+			UNLOCK();
+			return;
+		}
+		if (nf == 1) {
+			/* Case 2.  Put ao at the head of
+			 * usable_arenas.  Note that because
+			 * ao->nfreepools was 0 before, ao isn't
+			 * currently on the usable_arenas list.
+			 */
+			ao->nextarena = usable_arenas;
+			ao->prevarena = NULL;
+			if (usable_arenas)
+				usable_arenas->prevarena = ao;
+			usable_arenas = ao;
+			assert(usable_arenas->address != 0);
+
+			UNLOCK();
+			return;
+		}
+		/* If this arena is now out of order, we need to keep
+		 * the list sorted.  The list is kept sorted so that
+		 * the "most full" arenas are used first, which allows
+		 * the nearly empty arenas to be completely freed.  In
+		 * a few un-scientific tests, it seems like this
+		 * approach allowed a lot more memory to be freed.
+		 */
+		if (ao->nextarena == NULL ||
+			     nf <= ao->nextarena->nfreepools) {
+			/* Case 4.  Nothing to do. */
+			UNLOCK();
+			return;
+		}
+		/* Case 3:  We have to move the arena towards the end
+		 * of the list, because it has more free pools than
+		 * the arena to its right.
+		 * First unlink ao from usable_arenas.
+		 */
+		if (ao->prevarena != NULL) {
+			/* ao isn't at the head of the list */
+			assert(ao->prevarena->nextarena == ao);
+			ao->prevarena->nextarena = ao->nextarena;
+		}
+		else {
+			/* ao is at the head of the list */
+			assert(usable_arenas == ao);
+			usable_arenas = ao->nextarena;
+		}
+		ao->nextarena->prevarena = ao->prevarena;
+
+		/* Locate the new insertion point by iterating over
+		 * the list, using our nextarena pointer.
+		 */
+		while (ao->nextarena != NULL &&
+				nf > ao->nextarena->nfreepools) {
+			ao->prevarena = ao->nextarena;
+			ao->nextarena = ao->nextarena->nextarena;
+		}
+
+		/* Insert ao at this point. */
+		assert(ao->nextarena == NULL ||
+			ao->prevarena == ao->nextarena->prevarena);
+		assert(ao->prevarena->nextarena == ao->nextarena);
+
+		ao->prevarena->nextarena = ao;
+		if (ao->nextarena != NULL)
+			ao->nextarena->prevarena = ao;
+
+		/* Verify that the swaps worked. */
+		assert(ao->nextarena == NULL ||
+			  nf <= ao->nextarena->nfreepools);
+		assert(ao->prevarena == NULL ||
+			  nf > ao->prevarena->nfreepools);
+		assert(ao->nextarena == NULL ||
+			ao->nextarena->prevarena == ao);
+		assert((usable_arenas == ao &&
+			ao->prevarena == NULL) ||
+			ao->prevarena->nextarena == ao);
+
+		UNLOCK();
+		return;
+	}
+	/* Pool was full, so doesn't currently live in any list:
+	 * link it to the front of the appropriate usedpools[] list.
+	 * This mimics LRU pool usage for new allocations and
+	 * targets optimal filling when several pools contain
+	 * blocks of the same size class.
+	 */
+	--pool->ref.count;
+	assert(pool->ref.count > 0);	/* else the pool is empty */
+	size = pool->szidx;
+	next = usedpools[size + size];
+	prev = next->prevpool;
+	/* insert pool before next:   prev <-> pool <-> next */
+	pool->nextpool = next;
+	pool->prevpool = prev;
+	next->prevpool = pool;
+	prev->nextpool = pool;
+	UNLOCK();
+}
+
+#ifdef WITH_THREAD
+
+/* Thread caches.
+ *
+ * Every thread state has a cache of free blocks for each size class, so
+ * that a thread mostly reuses blocks it freed itself, which are likely
+ * to still be in its CPU's cache, and most allocations don't touch the
+ * pool headers and free lists that all threads share.  An empty cache is
+ * refilled with a batch of blocks from the pools, and a full one gives
+ * its older half back.  Cached blocks count as allocated for their pools.
+ *
+ * This still relies on the GIL:  the cache used is that of the thread
+ * holding it, and refills and flushes go through the pools as usual.
+ */
+
+/* How many bytes worth of blocks of size class I a thread may cache */
+#define THREAD_CACHE_BYTES	(POOL_SIZE / 4)
+#define THREAD_CACHE_BLOCKS(I)	(THREAD_CACHE_BYTES / INDEX2SIZE(I))
+
+struct _obmalloc_cache {
+	struct {
+		block *freeblock;	/* linked like a pool's free list */
+		uint count;
+	} classes[NB_SMALL_SIZE_CLASSES];
+};
+
+static struct _obmalloc_cache *
+current_thread_cache(void)
+{
+	PyThreadState *tstate = _PyThreadState_Current;
+	return tstate == NULL ? NULL : tstate->obmalloc_cache;
+}
+
+static block *
+thread_cache_alloc(uint size)
+{
+	struct _obmalloc_cache *cache = current_thread_cache();
+	block *bp;
+	uint n;
+
+	if (cache == NULL)
+		return pool_alloc(size);
+	bp = cache->classes[size].freeblock;
+	if (bp != NULL) {
+		cache->classes[size].freeblock = *(block **)bp;
+		--cache->classes[size].count;
+		return bp;
+	}
+	/* Refill half the cache, and take one more block for the caller. */
+	assert(cache->classes[size].count == 0);
+	for (n = THREAD_CACHE_BLOCKS(size) / 2; n > 0; --n) {
+		bp = pool_alloc(size);
+		if (bp == NULL)
+			break;
+		*(block **)bp = cache->classes[size].freeblock;
+		cache->classes[size].freeblock = bp;
+		++cache->classes[size].count;
+	}
+	return pool_alloc(size);
+}
+
+static void
+thread_cache_free(poolp pool, block *p)
+{
+	struct _obmalloc_cache *cache = current_thread_cache();
+	uint size = pool->szidx;
+	block *bp, *next;
+	uint n;
+
+	if (cache == NULL) {
+		pool_free(pool, p);
+		return;
+	}
+	n = cache->classes[size].count;
+	if (n >= THREAD_CACHE_BLOCKS(size)) {
+		/* The cache is full.  Keep the blocks freed last, which are
+		 * at the head of the list, and give the others back.
+		 */
+		n /= 2;
+		cache->classes[size].count = n;
+		bp = cache->classes[size].freeblock;
+		while (--n > 0)
+			bp = *(block **)bp;
+		next = *(block **)bp;
+		*(block **)bp = NULL;
+		while ((bp = next) != NULL) {
+			next = *(block **)bp;
+			pool_free(POOL_ADDR(bp), bp);
+		}
+	}
+	*(block **)p = cache->classes[size].freeblock;
+	cache->classes[size].freeblock = p;
+	++cache->classes[size].count;
+}
+
+/* Called for a new thread state.  Returns NULL if there's no memory for the
+ * cache, in which case the thread goes straight to the pools.
+ */
+struct _obmalloc_cache *
+_PyObject_NewThreadCache(void)
+{
+	return (struct _obmalloc_cache *)calloc(1,
+					sizeof(struct _obmalloc_cache));
+}
+
+/* Give all the blocks in cache back to their pools and free it.  The GIL
+ * must be held.
+ */
+void
+_PyObject_FreeThreadCache(struct _obmalloc_cache *cache)
+{
+	block *bp, *next;
+	uint i;
+
+	if (cache == NULL)
+		return;
+	for (i = 0; i < NB_SMALL_SIZE_CLASSES; ++i) {
+		next = cache->classes[i].freeblock;
+		while ((bp = next) != NULL) {
+			next = *(block **)bp;
+			pool_free(POOL_ADDR(bp), bp);
+		}
+	}
+	free(cache);
+}
+
+#else	/* ! WITH_THREAD */
+
+#define thread_cache_alloc(size)	pool_alloc(size)
+#define thread_cache_free(pool, p)	pool_free((pool), (p))
+
+struct _obmalloc_cache *
+_PyObject_NewThreadCache(void)
+{
+	return NULL;
+}
+
+void
+_PyObject_FreeThreadCache(struct _obmalloc_cache *cache)
+{
+}
+
+#endif	/* WITH_THREAD */
+
+/*==========================================================================*/
+
+/* Statistics for sys._malloc_stats(). */
+#if NB_SMALL_SIZE_CLASSES > _PyMalloc_MAX_CLASSES
+#error "_PyMallocStats has too few classes"
+#endif
+
+int
+_PyObject_GetMallocStats(_PyMallocStats *stats)
+{
+	uint i;
+
+	memset(stats, 0, sizeof(*stats));
+	stats->arena_size = ARENA_SIZE;
+	stats->pool_size = POOL_SIZE;
+	stats->arenas = narenas_currently_allocated;
+	stats->arenas_allocated = ntimes_arena_allocated;
+	stats->arenas_highwater = narenas_highwater;
+	stats->nclasses = NB_SMALL_SIZE_CLASSES;
+	for (i = 0; i < NB_SMALL_SIZE_CLASSES; ++i) {
+		stats->classes[i].size = INDEX2SIZE(i);
+		stats->classes[i].blocks_used = class_usage[i].used;
+		stats->classes[i].blocks_highwater = class_usage[i].highwater;
+	}
+
+	/* Full pools aren't linked to from anything, so march over all the
+	 * arenas, as _PyObject_DebugMallocStats() does.
+	 */
+	for (i = 0; i < maxarenas; ++i) {
+		uptr base = arenas[i].address;
+
+		if (base == (uptr)NULL)
+			continue;
+		stats->pools_free += arenas[i].nfreepools;
+#ifdef RELEASE_POOLS
+		stats->pools_released += arenas[i].nreleasedpools;
+#endif
+		if (base & (uptr)POOL_SIZE_MASK) {
+			base &= ~(uptr)POOL_SIZE_MASK;
+			base += POOL_SIZE;
+		}
+		for (; base < (uptr)arenas[i].pool_address;
+		     base += POOL_SIZE) {
+			poolp p = (poolp)base;
+
+#ifdef RELEASE_POOLS
+			if (POOL_RELEASED(&arenas[i], p))
+				continue;
+#endif
+			if (p->ref.count == 0)
+				continue;
+			++stats->classes[p->szidx].pools;
+			stats->classes[p->szidx].blocks_free +=
+				NUMBLOCKS(p->szidx) - p->ref.count;
+		}
+	}
+	return 0;
+}
+
+/* Allocation sampling.  sample_countdown is decremented by the size of
+ * every request, and when it goes negative the request is passed to
+ * sample_hook and the countdown is reset to a random number of bytes
+ * averaging sample_interval.  The randomness keeps allocations that recur
+ * with a fixed period from always, or never, being sampled.
+ */
+static Py_ssize_t sample_countdown = PY_SSIZE_T_MAX;
+static size_t sample_interval = 0;
+static void (*sample_hook)(size_t) = NULL;
+static unsigned long sample_seed = 1;
+static int in_sample_hook = 0;
+
+static void
+reset_sample_countdown(void)
+{
+	if (sample_hook == NULL) {
+		sample_countdown = PY_SSIZE_T_MAX;
+		return;
+	}
+	sample_seed = sample_seed * 1103515245UL + 12345UL;
+	sample_countdown = (Py_ssize_t)(1 + ((sample_seed >> 8) %
+					     (2 * sample_interval)));
+}
+
+static void
+sample_allocation(size_t nbytes)
+{
+	reset_sample_countdown();
+	if (sample_hook != NULL && !in_sample_hook) {
+		/* Don't sample the hook's own allocations. */
+		in_sample_hook = 1;
+		sample_hook(nbytes);
+		in_sample_hook = 0;
+	}
+}
+
+void
+_PyObject_SetMallocSampling(size_t interval, void (*hook)(size_t))
+{
+	if (interval == 0 || interval > PY_SSIZE_T_MAX / 2)
+		hook = NULL;
+	sample_interval = interval;
+	sample_hook = hook;
+	reset_sample_countdown();
+}
+
+/*==========================================================================*/
+
 /* malloc.  Note that nbytes==0 tries to return a non-NULL pointer, distinct
  * from all other currently live pointers.  This may not be possible.
  */
@@ -724,8 +1543,6 @@ void *
 PyObject_Malloc(size_t nbytes)
 {
 	block *bp;
-	poolp pool;
-	poolp next;
 	uint size;
 
 	/*
@@ -737,174 +1554,23 @@ PyObject_Malloc(size_t nbytes)
 	if (nbytes > PY_SSIZE_T_MAX)
 		return NULL;
 
+	if ((sample_countdown -= (Py_ssize_t)nbytes) < 0)
+		sample_allocation(nbytes);
+
 	/*
 	 * This implicitly redirects malloc(0).
 	 */
 	if ((nbytes - 1) < SMALL_REQUEST_THRESHOLD) {
-		LOCK();
-		/*
-		 * Most frequent paths first
-		 */
 		size = (uint)(nbytes - 1) >> ALIGNMENT_SHIFT;
-		pool = usedpools[size + size];
-		if (pool != pool->nextpool) {
-			/*
-			 * There is a used pool for this size class.
-			 * Pick up the head block of its free list.
-			 */
-			++pool->ref.count;
-			bp = pool->freeblock;
-			assert(bp != NULL);
-			if ((pool->freeblock = *(block **)bp) != NULL) {
-				UNLOCK();
-				return (void *)bp;
-			}
-			/*
-			 * Reached the end of the free list, try to extend it.
-			 */
-			if (pool->nextoffset <= pool->maxnextoffset) {
-				/* There is room for another block. */
-				pool->freeblock = (block*)pool +
-						  pool->nextoffset;
-				pool->nextoffset += INDEX2SIZE(size);
-				*(block **)(pool->freeblock) = NULL;
-				UNLOCK();
-				return (void *)bp;
-			}
-			/* Pool is full, unlink from used pools. */
-			next = pool->nextpool;
-			pool = pool->prevpool;
-			next->prevpool = pool;
-			pool->nextpool = next;
-			UNLOCK();
+		bp = thread_cache_alloc(size);
+		if (bp != NULL)
 			return (void *)bp;
-		}
-
-		/* There isn't a pool of the right size class immediately
-		 * available:  use a free pool.
-		 */
-		if (usable_arenas == NULL) {
-			/* No arena has a free pool:  allocate a new arena. */
-#ifdef WITH_MEMORY_LIMITS
-			if (narenas_currently_allocated >= MAX_ARENAS) {
-				UNLOCK();
-				goto redirect;
-			}
-#endif
-			usable_arenas = new_arena();
-			if (usable_arenas == NULL) {
-				UNLOCK();
-				goto redirect;
-			}
-			usable_arenas->nextarena =
-				usable_arenas->prevarena = NULL;
-		}
-		assert(usable_arenas->address != 0);
-
-		/* Try to get a cached free pool. */
-		pool = usable_arenas->freepools;
-		if (pool != NULL) {
-			/* Unlink from cached pools. */
-			usable_arenas->freepools = pool->nextpool;
-
-			/* This arena already had the smallest nfreepools
-			 * value, so decreasing nfreepools doesn't change
-			 * that, and we don't need to rearrange the
-			 * usable_arenas list.  However, if the arena has
-			 * become wholly allocated, we need to remove its
-			 * arena_object from usable_arenas.
-			 */
-			--usable_arenas->nfreepools;
-			if (usable_arenas->nfreepools == 0) {
-				/* Wholly allocated:  remove. */
-				assert(usable_arenas->freepools == NULL);
-				assert(usable_arenas->nextarena == NULL ||
-				       usable_arenas->nextarena->prevarena ==
-					   usable_arenas);
-
-				usable_arenas = usable_arenas->nextarena;
-				if (usable_arenas != NULL) {
-					usable_arenas->prevarena = NULL;
-					assert(usable_arenas->address != 0);
-				}
-			}
-			else {
-				/* nfreepools > 0:  it must be that freepools
-				 * isn't NULL, or that we haven't yet carved
-				 * off all the arena's pools for the first
-				 * time.
-				 */
-				assert(usable_arenas->freepools != NULL ||
-				       usable_arenas->pool_address <=
-				           (block*)usable_arenas->address +
-				               ARENA_SIZE - POOL_SIZE);
-			}
-		init_pool:
-			/* Frontlink to used pools. */
-			next = usedpools[size + size]; /* == prev */
-			pool->nextpool = next;
-			pool->prevpool = next;
-			next->nextpool = pool;
-			next->prevpool = pool;
-			pool->ref.count = 1;
-			if (pool->szidx == size) {
-				/* Luckily, this pool last contained blocks
-				 * of the same size class, so its header
-				 * and free list are already initialized.
-				 */
-				bp = pool->freeblock;
-				pool->freeblock = *(block **)bp;
-				UNLOCK();
-				return (void *)bp;
-			}
-			/*
-			 * Initialize the pool header, set up the free list to
-			 * contain just the second block, and return the first
-			 * block.
-			 */
-			pool->szidx = size;
-			size = INDEX2SIZE(size);
-			bp = (block *)pool + POOL_OVERHEAD;
-			pool->nextoffset = POOL_OVERHEAD + (size << 1);
-			pool->maxnextoffset = POOL_SIZE - size;
-			pool->freeblock = bp + size;
-			*(block **)(pool->freeblock) = NULL;
-			UNLOCK();
-			return (void *)bp;
-		}
-
-		/* Carve off a new pool. */
-		assert(usable_arenas->nfreepools > 0);
-		assert(usable_arenas->freepools == NULL);
-		pool = (poolp)usable_arenas->pool_address;
-		assert((block*)pool <= (block*)usable_arenas->address +
-		                       ARENA_SIZE - POOL_SIZE);
-		pool->arenaindex = usable_arenas - arenas;
-		assert(&arenas[pool->arenaindex] == usable_arenas);
-		pool->szidx = DUMMY_SIZE_IDX;
-		usable_arenas->pool_address += POOL_SIZE;
-		--usable_arenas->nfreepools;
-
-		if (usable_arenas->nfreepools == 0) {
-			assert(usable_arenas->nextarena == NULL ||
-			       usable_arenas->nextarena->prevarena ==
-			       	   usable_arenas);
-			/* Unlink the arena:  it is completely allocated. */
-			usable_arenas = usable_arenas->nextarena;
-			if (usable_arenas != NULL) {
-				usable_arenas->prevarena = NULL;
-				assert(usable_arenas->address != 0);
-			}
-		}
-
-		goto init_pool;
 	}
 
         /* The small block allocator ends here. */
 
-redirect:
 	/* Redirect the original request to the underlying (libc) allocator.
-	 * We jump here on bigger requests, on error in the code above (as a
+	 * We get here on bigger requests, on error in the code above (as a
 	 * last chance to serve the request) or when the max memory limit
 	 * has been reached.
 	 */
@@ -920,9 +1586,6 @@ void
 PyObject_Free(void *p)
 {
 	poolp pool;
-	block *lastfree;
-	poolp next, prev;
-	uint size;
 
 	if (p == NULL)	/* free(NULL) has no effect */
 		return;
@@ -930,194 +1593,7 @@ PyObject_Free(void *p)
 	pool = POOL_ADDR(p);
 	if (Py_ADDRESS_IN_RANGE(p, pool)) {
 		/* We allocated this address. */
-		LOCK();
-		/* Link p to the start of the pool's freeblock list.  Since
-		 * the pool had at least the p block outstanding, the pool
-		 * wasn't empty (so it's already in a usedpools[] list, or
-		 * was full and is in no list -- it's not in the freeblocks
-		 * list in any case).
-		 */
-		assert(pool->ref.count > 0);	/* else it was empty */
-		*(block **)p = lastfree = pool->freeblock;
-		pool->freeblock = (block *)p;
-		if (lastfree) {
-			struct arena_object* ao;
-			uint nf;  /* ao->nfreepools */
-
-			/* freeblock wasn't NULL, so the pool wasn't full,
-			 * and the pool is in a usedpools[] list.
-			 */
-			if (--pool->ref.count != 0) {
-				/* pool isn't empty:  leave it in usedpools */
-				UNLOCK();
-				return;
-			}
-			/* Pool is now empty:  unlink from usedpools, and
-			 * link to the front of freepools.  This ensures that
-			 * previously freed pools will be allocated later
-			 * (being not referenced, they are perhaps paged out).
-			 */
-			next = pool->nextpool;
-			prev = pool->prevpool;
-			next->prevpool = prev;
-			prev->nextpool = next;
-
-			/* Link the pool to freepools.  This is a singly-linked
-			 * list, and pool->prevpool isn't used there.
-			 */
-			ao = &arenas[pool->arenaindex];
-			pool->nextpool = ao->freepools;
-			ao->freepools = pool;
-			nf = ++ao->nfreepools;
-
-			/* All the rest is arena management.  We just freed
-			 * a pool, and there are 4 cases for arena mgmt:
-			 * 1. If all the pools are free, return the arena to
-			 *    the system free().
-			 * 2. If this is the only free pool in the arena,
-			 *    add the arena back to the `usable_arenas` list.
-			 * 3. If the "next" arena has a smaller count of free
-			 *    pools, we have to "slide this arena right" to
-			 *    restore that usable_arenas is sorted in order of
-			 *    nfreepools.
-			 * 4. Else there's nothing more to do.
-			 */
-			if (nf == ao->ntotalpools) {
-				/* Case 1.  First unlink ao from usable_arenas.
-				 */
-				assert(ao->prevarena == NULL ||
-				       ao->prevarena->address != 0);
-				assert(ao ->nextarena == NULL ||
-				       ao->nextarena->address != 0);
-
-				/* Fix the pointer in the prevarena, or the
-				 * usable_arenas pointer.
-				 */
-				if (ao->prevarena == NULL) {
-					usable_arenas = ao->nextarena;
-					assert(usable_arenas == NULL ||
-					       usable_arenas->address != 0);
-				}
-				else {
-					assert(ao->prevarena->nextarena == ao);
-					ao->prevarena->nextarena =
-						ao->nextarena;
-				}
-				/* Fix the pointer in the nextarena. */
-				if (ao->nextarena != NULL) {
-					assert(ao->nextarena->prevarena == ao);
-					ao->nextarena->prevarena =
-						ao->prevarena;
-				}
-				/* Record that this arena_object slot is
-				 * available to be reused.
-				 */
-				ao->nextarena = unused_arena_objects;
-				unused_arena_objects = ao;
-
-				/* Free the entire arena. */
-				free((void *)ao->address);
-				ao->address = 0;	/* mark unassociated */
-				--narenas_currently_allocated;
-
-				UNLOCK();
-				return;
-			}
-			if (nf == 1) {
-				/* Case 2.  Put ao at the head of
-				 * usable_arenas.  Note that because
-				 * ao->nfreepools was 0 before, ao isn't
-				 * currently on the usable_arenas list.
-				 */
-				ao->nextarena = usable_arenas;
-				ao->prevarena = NULL;
-				if (usable_arenas)
-					usable_arenas->prevarena = ao;
-				usable_arenas = ao;
-				assert(usable_arenas->address != 0);
-
-				UNLOCK();
-				return;
-			}
-			/* If this arena is now out of order, we need to keep
-			 * the list sorted.  The list is kept sorted so that
-			 * the "most full" arenas are used first, which allows
-			 * the nearly empty arenas to be completely freed.  In
-			 * a few un-scientific tests, it seems like this
-			 * approach allowed a lot more memory to be freed.
-			 */
-			if (ao->nextarena == NULL ||
-				     nf <= ao->nextarena->nfreepools) {
-				/* Case 4.  Nothing to do. */
-				UNLOCK();
-				return;
-			}
-			/* Case 3:  We have to move the arena towards the end
-			 * of the list, because it has more free pools than
-			 * the arena to its right.
-			 * First unlink ao from usable_arenas.
-			 */
-			if (ao->prevarena != NULL) {
-				/* ao isn't at the head of the list */
-				assert(ao->prevarena->nextarena == ao);
-				ao->prevarena->nextarena = ao->nextarena;
-			}
-			else {
-				/* ao is at the head of the list */
-				assert(usable_arenas == ao);
-				usable_arenas = ao->nextarena;
-			}
-			ao->nextarena->prevarena = ao->prevarena;
-
-			/* Locate the new insertion point by iterating over
-			 * the list, using our nextarena pointer.
-			 */
-			while (ao->nextarena != NULL &&
-					nf > ao->nextarena->nfreepools) {
-				ao->prevarena = ao->nextarena;
-				ao->nextarena = ao->nextarena->nextarena;
-			}
-
-			/* Insert ao at this point. */
-			assert(ao->nextarena == NULL ||
-				ao->prevarena == ao->nextarena->prevarena);
-			assert(ao->prevarena->nextarena == ao->nextarena);
-
-			ao->prevarena->nextarena = ao;
-			if (ao->nextarena != NULL)
-				ao->nextarena->prevarena = ao;
-
-			/* Verify that the swaps worked. */
-			assert(ao->nextarena == NULL ||
-				  nf <= ao->nextarena->nfreepools);
-			assert(ao->prevarena == NULL ||
-				  nf > ao->prevarena->nfreepools);
-			assert(ao->nextarena == NULL ||
-				ao->nextarena->prevarena == ao);
-			assert((usable_arenas == ao &&
-				ao->prevarena == NULL) ||
-				ao->prevarena->nextarena == ao);
-
-			UNLOCK();
-			return;
-		}
-		/* Pool was full, so doesn't currently live in any list:
-		 * link it to the front of the appropriate usedpools[] list.
-		 * This mimics LRU pool usage for new allocations and
-		 * targets optimal filling when several pools contain
-		 * blocks of the same size class.
-		 */
-		--pool->ref.count;
-		assert(pool->ref.count > 0);	/* else the pool is empty */
-		size = pool->szidx;
-		next = usedpools[size + size];
-		prev = next->prevpool;
-		/* insert pool before next:   prev <-> pool <-> next */
-		pool->nextpool = next;
-		pool->prevpool = prev;
-		next->prevpool = pool;
-		prev->nextpool = pool;
-		UNLOCK();
+		thread_cache_free(pool, (block *)p);
 		return;
 	}
 
@@ -1222,6 +1698,28 @@ PyObject_Free(void *p)
 {
 	PyMem_FREE(p);
 }
+
+struct _obmalloc_cache *
+_PyObject_NewThreadCache(void)
+{
+	return NULL;
+}
+
+void
+_PyObject_FreeThreadCache(struct _obmalloc_cache *cache)
+{
+}
+
+int
+_PyObject_GetMallocStats(_PyMallocStats *stats)
+{
+	return -1;
+}
+
+void
+_PyObject_SetMallocSampling(size_t interval, void (*hook)(size_t))
+{
+}
 #endif /* WITH_PYMALLOC */
 
 #ifdef PYMALLOC_DEBUG
@@ -1680,6 +2178,10 @@ _PyObject_DebugMallocStats(void)
 			const uint sz = p->szidx;
 			uint freeblocks;
 
+#ifdef RELEASE_POOLS
+			if (POOL_RELEASED(&arenas[i], p))
+				continue;
+#endif
 			if (p->ref.count == 0) {
 				/* currently unused */
 				assert(pool_is_in_list(p, arenas[i].freepools));
@@ -149,6 +149,8 @@ set_lookkey(PySetObject *so, PyObject *key, register long hash)
 	return entry;
 }
 
+static setentry *set_lookkey_int(PySetObject *so, PyObject *key, long hash);
+
 /*
  * Hacked up version of set_lookkey which can assume keys are always strings;
  * This means we can always use _PyString_Eq directly and not have to check to
@@ -169,8 +171,12 @@ set_lookkey_string(PySetObject *so, PyObject *key, register long hash)
 	   strings is to override __eq__, and for speed we don't cater to
 	   that here. */
 	if (!PyString_CheckExact(key)) {
-		so->lookup = set_lookkey;
-		return set_lookkey(so, key, hash);
+		/* An empty set can start over as a set of ints. */
+		if (PyInt_CheckExact(key) && so->used == 0)
+			so->lookup = set_lookkey_int;
+		else
+			so->lookup = set_lookkey;
+		return so->lookup(so, key, hash);
 	}
 	i = hash & mask;
 	entry = &table[i];
@@ -203,6 +209,57 @@ set_lookkey_string(PySetObject *so, PyObject *key, register long hash)
 	return 0;
 }
 
+/*
+ * Same again for sets whose keys are all ints.  An int's hash is its value,
+ * except that -1 and -2 both hash to -2, so equal hashes mean equal ints
+ * unless the hash is -2; only then are the values compared.
+ */
+static setentry *
+set_lookkey_int(PySetObject *so, PyObject *key, register long hash)
+{
+	register Py_ssize_t i;
+	register size_t perturb;
+	register setentry *freeslot;
+	register size_t mask = so->mask;
+	setentry *table = so->table;
+	register setentry *entry;
+	register long ival;
+
+	if (!PyInt_CheckExact(key)) {
+		so->lookup = set_lookkey;
+		return set_lookkey(so, key, hash);
+	}
+	ival = PyInt_AS_LONG(key);
+	i = hash & mask;
+	entry = &table[i];
+	if (entry->key == NULL || entry->key == key)
+		return entry;
+	if (entry->key == dummy)
+		freeslot = entry;
+	else {
+		if (entry->hash == hash &&
+		    (hash != -2 || PyInt_AS_LONG(entry->key) == ival))
+			return entry;
+		freeslot = NULL;
+	}
+
+	for (perturb = hash; ; perturb >>= PERTURB_SHIFT) {
+		i = (i << 2) + i + perturb + 1;
+		entry = &table[i & mask];
+		if (entry->key == NULL)
+			return freeslot == NULL ? entry : freeslot;
+		if (entry->key == key
+		    || (entry->hash == hash
+			&& entry->key != dummy
+			&& (hash != -2 || PyInt_AS_LONG(entry->key) == ival)))
+			return entry;
+		if (entry->key == dummy && freeslot == NULL)
+			freeslot = entry;
+	}
+	assert(0);	/* NOT REACHED */
+	return 0;
+}
+
 /*
 Internal routine to insert a new key into the table.
 Used by the public insert routine.
@@ -546,6 +603,91 @@ set_next(PySetObject *so, Py_ssize_t *pos_ptr, setentry **entry_ptr)
 	return 1;
 }
 
+/*
+ * Operations between two sets mostly probe one set with every key of the
+ * other.  When both sets use set_lookkey_string, or both set_lookkey_int,
+ * a probe can't fail and can't run Python code, so the probes can go in
+ * batches: prefetch the home slots for a batch of keys first, then look
+ * them up, so that the cache misses overlap instead of coming one at a
+ * time.  Other sets go through set_contains_entry() one key at a time.
+ */
+#define SET_PROBE_BATCH 8
+
+#if defined(__GNUC__)
+#define SET_PREFETCH(p) __builtin_prefetch(p)
+#else
+#define SET_PREFETCH(p)
+#endif
+
+#define SET_BATCH_OK(a, b) ((a)->lookup == (b)->lookup &&		\
+			    (a)->lookup != set_lookkey)
+
+/* Return whether key is in so, for a key of the type so->lookup is
+ * specialized for.  Knowing that up front saves looking at the key object
+ * at all unless the hashes match, and for ints even then: an int's hash
+ * is its value, except that -1 and -2 both hash to -2.
+ */
+Py_LOCAL_INLINE(int)
+set_has_key_known(PySetObject *so, PyObject *key, long hash)
+{
+	register size_t i;
+	register size_t perturb;
+	register size_t mask = so->mask;
+	setentry *table = so->table;
+	register setentry *entry;
+	int isint = so->lookup == set_lookkey_int;
+
+	assert(isint ? PyInt_CheckExact(key) : PyString_CheckExact(key));
+	i = hash & mask;
+	entry = &table[i];
+	for (perturb = hash; ; perturb >>= PERTURB_SHIFT) {
+		if (entry->key == NULL)
+			return 0;
+		if (entry->key == key)
+			return 1;
+		if (entry->hash == hash && entry->key != dummy) {
+			if (isint ? (hash != -2 || PyInt_AS_LONG(entry->key) ==
+						   PyInt_AS_LONG(key))
+				  : _PyString_Eq(entry->key, key))
+				return 1;
+		}
+		i = (i << 2) + i + perturb + 1;
+		entry = &table[i & mask];
+	}
+}
+
+/* Gather up to SET_PROBE_BATCH active entries of other's table, starting
+ * at *pos_ptr, into entries[], and set found[k] to whether entries[k]->key
+ * is in so.  Returns the number gathered, 0 once other is exhausted.
+ * SET_BATCH_OK(so, other) must be true.
+ */
+static Py_ssize_t
+set_probe_batch(PySetObject *so, PySetObject *other, Py_ssize_t *pos_ptr,
+		setentry **entries, int *found)
+{
+	Py_ssize_t i = *pos_ptr, n = 0, k;
+	Py_ssize_t mask = other->mask;
+	setentry *table = other->table;
+	setentry *sotable = so->table;
+	size_t somask = (size_t)so->mask;
+	PyObject *key;
+
+	assert(SET_BATCH_OK(so, other));
+	while (n < SET_PROBE_BATCH && i <= mask) {
+		key = table[i].key;
+		if (key != NULL && key != dummy) {
+			SET_PREFETCH(&sotable[(size_t)table[i].hash & somask]);
+			entries[n++] = &table[i];
+		}
+		i++;
+	}
+	*pos_ptr = i;
+	for (k = 0; k < n; k++)
+		found[k] = set_has_key_known(so, entries[k]->key,
+					     entries[k]->hash);
+	return n;
+}
+
 static void
 set_dealloc(PySetObject *so)
 {
@@ -643,6 +785,86 @@ set_len(PyObject *so)
 	return ((PySetObject *)so)->used;
 }
 
+/* Make so, which must be empty, hold the same keys as other by copying
+ * other's table.  other must not have any dummy entries.
+ */
+static int
+set_copy_table(PySetObject *so, PySetObject *other)
+{
+	setentry *table;
+	Py_ssize_t i;
+
+	assert(so->used == 0 && other->fill == other->used);
+	if (so->fill > 0 || so->table != so->smalltable)
+		set_clear_internal(so);
+	if (other->table == other->smalltable)
+		table = so->smalltable;
+	else {
+		table = PyMem_NEW(setentry, other->mask + 1);
+		if (table == NULL) {
+			PyErr_NoMemory();
+			return -1;
+		}
+	}
+	memcpy(table, other->table, sizeof(setentry) * (other->mask + 1));
+	for (i = 0; i <= other->mask; i++)
+		Py_XINCREF(table[i].key);
+	so->table = table;
+	so->mask = other->mask;
+	so->fill = other->fill;
+	so->used = other->used;
+	so->lookup = other->lookup;
+	return 0;
+}
+
+static PyObject *make_new_set(PyTypeObject *type, PyObject *iterable);
+static void set_swap_bodies(PySetObject *a, PySetObject *b);
+
+/* so |= other when other is the bigger set: copy other's table and insert
+ * so's keys into the copy, then swap the copy into so.  As with inserting
+ * other's keys into so, where the two sets hold equal keys so's is kept.
+ * SET_BATCH_OK(so, other) must be true, and other must not have any dummy
+ * entries.
+ */
+static int
+set_merge_into_copy(PySetObject *so, PySetObject *other)
+{
+	PySetObject *tmp;
+	setentry *entry, *slot;
+	Py_ssize_t pos = 0;
+	PyObject *old_key;
+
+	tmp = (PySetObject *)make_new_set(&PySet_Type, NULL);
+	if (tmp == NULL)
+		return -1;
+	if (set_copy_table(tmp, other) == -1 ||
+	    ((tmp->fill + so->used)*3 >= (tmp->mask+1)*2 &&
+	     set_table_resize(tmp, (tmp->used + so->used)*2) != 0)) {
+		Py_DECREF(tmp);
+		return -1;
+	}
+	assert(tmp->lookup == so->lookup && tmp->fill == tmp->used);
+	while (set_next(so, &pos, &entry)) {
+		slot = (tmp->lookup)(tmp, entry->key, entry->hash);
+		Py_INCREF(entry->key);
+		if (slot->key == NULL) {
+			tmp->fill++;
+			tmp->used++;
+			slot->key = entry->key;
+			slot->hash = entry->hash;
+		}
+		else {
+			/* other still holds a reference to old_key. */
+			old_key = slot->key;
+			slot->key = entry->key;
+			Py_DECREF(old_key);
+		}
+	}
+	set_swap_bodies(so, tmp);
+	Py_DECREF(tmp);
+	return 0;
+}
+
 static int
 set_merge(PySetObject *so, PyObject *otherset)
 {
@@ -657,6 +879,17 @@ set_merge(PySetObject *so, PyObject *otherset)
 	if (other == so || other->used == 0)
 		/* a.update(a) or a.update({}); nothing to do */
 		return 0;
+	if (other->fill == other->used) {
+		/* set(a), a.copy() and friends: take a copy of other's table
+		 * rather than inserting its keys one at a time.  And if other
+		 * is the bigger set and the keys can be looked up without
+		 * calling out to Python, copy other and merge so into that.
+		 */
+		if (so->used == 0)
+			return set_copy_table(so, other);
+		if (other->used > so->used && SET_BATCH_OK(so, other))
+			return set_merge_into_copy(so, other);
+	}
 	/* Do one big resize at the start, rather than
 	 * incrementally resizing as we insert new keys.  Expect
 	 * that there will be no (or few) overlapping keys.
@@ -1247,6 +1480,24 @@ set_intersection(PySetObject *so, PyObject *other)
 			other = tmp;
 		}
 
+		if (SET_BATCH_OK(so, (PySetObject *)other)) {
+			setentry *entries[SET_PROBE_BATCH];
+			int found[SET_PROBE_BATCH];
+			Py_ssize_t k, n;
+
+			while ((n = set_probe_batch(so, (PySetObject *)other,
+						    &pos, entries, found))) {
+				for (k = 0; k < n; k++) {
+					if (found[k] &&
+					    set_add_entry(result, entries[k]) == -1) {
+						Py_DECREF(result);
+						return NULL;
+					}
+				}
+			}
+			return (PyObject *)result;
+		}
+
 		while (set_next((PySetObject *)other, &pos, &entry)) {
 			int rv = set_contains_entry(so, entry);
 			if (rv == -1) {
@@ -1340,6 +1591,36 @@ set_intersection_update(PySetObject *so, PyObject *other)
 {
 	PyObject *tmp;
 
+	if (PyAnySet_Check(other) && (PyObject *)so != other &&
+	    so->used <= PySet_GET_SIZE(other) &&
+	    SET_BATCH_OK((PySetObject *)other, so)) {
+		/* so is the smaller set: drop the keys other doesn't have
+		 * in place, rather than building the result in a new set. */
+		setentry *entries[SET_PROBE_BATCH];
+		int found[SET_PROBE_BATCH];
+		Py_ssize_t k, n, pos = 0;
+		PyObject *old_key;
+
+		while ((n = set_probe_batch((PySetObject *)other, so, &pos,
+					    entries, found))) {
+			for (k = 0; k < n; k++) {
+				if (found[k])
+					continue;
+				old_key = entries[k]->key;
+				Py_INCREF(dummy);
+				entries[k]->key = dummy;
+				so->used--;
+				Py_DECREF(old_key);
+			}
+		}
+		/* If more than 1/5 are dummies, then resize them away. */
+		if ((so->fill - so->used) * 5 >= so->mask &&
+		    set_table_resize(so, so->used>50000 ? so->used*2 :
+						       so->used*4) == -1)
+			return NULL;
+		Py_RETURN_NONE;
+	}
+
 	tmp = set_intersection(so, other);
 	if (tmp == NULL)
 		return NULL;
@@ -1412,6 +1693,20 @@ set_isdisjoint(PySetObject *so, PyObject *other)
 			so = (PySetObject *)other;
 			other = tmp;
 		}
+		if (SET_BATCH_OK(so, (PySetObject *)other)) {
+			setentry *entries[SET_PROBE_BATCH];
+			int found[SET_PROBE_BATCH];
+			Py_ssize_t k, n;
+
+			while ((n = set_probe_batch(so, (PySetObject *)other,
+						    &pos, entries, found))) {
+				for (k = 0; k < n; k++) {
+					if (found[k])
+						Py_RETURN_FALSE;
+				}
+			}
+			Py_RETURN_TRUE;
+		}
 		while (set_next((PySetObject *)other, &pos, &entry)) {
 			int rv = set_contains_entry(so, entry);
 			if (rv == -1)
@@ -1547,6 +1842,25 @@ set_difference(PySetObject *so, PyObject *other)
 		return result;
 	}
 
+	if (SET_BATCH_OK((PySetObject *)other, so)) {
+		setentry *entries[SET_PROBE_BATCH];
+		int found[SET_PROBE_BATCH];
+		Py_ssize_t k, n;
+
+		while ((n = set_probe_batch((PySetObject *)other, so, &pos,
+					    entries, found))) {
+			for (k = 0; k < n; k++) {
+				if (!found[k] &&
+				    set_add_entry((PySetObject *)result,
+						  entries[k]) == -1) {
+					Py_DECREF(result);
+					return NULL;
+				}
+			}
+		}
+		return result;
+	}
+
 	while (set_next(so, &pos, &entry)) {
 		int rv = set_contains_entry((PySetObject *)other, entry);
 		if (rv == -1) {
@@ -1740,6 +2054,21 @@ set_issubset(PySetObject *so, PyObject *other)
 	if (PySet_GET_SIZE(so) > PySet_GET_SIZE(other)) 
 		Py_RETURN_FALSE;
 
+	if (SET_BATCH_OK((PySetObject *)other, so)) {
+		setentry *entries[SET_PROBE_BATCH];
+		int found[SET_PROBE_BATCH];
+		Py_ssize_t k, n;
+
+		while ((n = set_probe_batch((PySetObject *)other, so, &pos,
+					    entries, found))) {
+			for (k = 0; k < n; k++) {
+				if (!found[k])
+					Py_RETURN_FALSE;
+			}
+		}
+		Py_RETURN_TRUE;
+	}
+
 	while (set_next(so, &pos, &entry)) {
 		int rv = set_contains_entry((PySetObject *)other, entry);
 		if (rv == -1)
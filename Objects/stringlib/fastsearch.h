@@ -17,6 +17,236 @@
 #define FAST_COUNT 0
 #define FAST_SEARCH 1
 
+#ifdef Py_HAVE_X86_SIMD
+#include <immintrin.h>
+
+/* vectorized versions of the single character and filtered searches
+   for x86, picked at run time from _Py_cpu_features (see pycpu.h).
+
+   single characters are found and counted a whole vector at a time.
+   longer patterns use their first and last characters as a filter: a
+   vector of the target is compared with the first character, the
+   vector m-1 characters further on with the last one, and only the
+   positions where both match are compared in full.  unlike the scalar
+   code, none of these read past s[n-1]. */
+
+/* the vector operations on lanes of one character; the choice between
+   them folds away at compile time */
+#define FS_LANE ((int) sizeof(STRINGLIB_CHAR))
+#define FS_SET1_128(c)                                                  \
+    (FS_LANE == 1 ? _mm_set1_epi8((char) (c)) :                         \
+     FS_LANE == 2 ? _mm_set1_epi16((short) (c)) :                       \
+     _mm_set1_epi32((int) (c)))
+#define FS_CMPEQ_128(a, b)                                              \
+    (FS_LANE == 1 ? _mm_cmpeq_epi8(a, b) :                              \
+     FS_LANE == 2 ? _mm_cmpeq_epi16(a, b) : _mm_cmpeq_epi32(a, b))
+#define FS_SUB_128(a, b)                                                \
+    (FS_LANE == 1 ? _mm_sub_epi8(a, b) :                                \
+     FS_LANE == 2 ? _mm_sub_epi16(a, b) : _mm_sub_epi32(a, b))
+#define FS_SET1_256(c)                                                  \
+    (FS_LANE == 1 ? _mm256_set1_epi8((char) (c)) :                      \
+     FS_LANE == 2 ? _mm256_set1_epi16((short) (c)) :                    \
+     _mm256_set1_epi32((int) (c)))
+#define FS_CMPEQ_256(a, b)                                              \
+    (FS_LANE == 1 ? _mm256_cmpeq_epi8(a, b) :                           \
+     FS_LANE == 2 ? _mm256_cmpeq_epi16(a, b) : _mm256_cmpeq_epi32(a, b))
+#define FS_SUB_256(a, b)                                                \
+    (FS_LANE == 1 ? _mm256_sub_epi8(a, b) :                             \
+     FS_LANE == 2 ? _mm256_sub_epi16(a, b) : _mm256_sub_epi32(a, b))
+
+/* movemask sets FS_LANE bits per matching character */
+#define FS_LANE_BITS ((1U << FS_LANE) - 1)
+
+Py_LOCAL(Py_ssize_t) Py_TARGET_SSE2
+find_char_sse2(const STRINGLIB_CHAR* s, Py_ssize_t n, STRINGLIB_CHAR ch)
+{
+    const Py_ssize_t step = 16 / sizeof(STRINGLIB_CHAR);
+    const __m128i c = FS_SET1_128(ch);
+    Py_ssize_t i;
+    unsigned int bits;
+
+    for (i = 0; i + step <= n; i += step) {
+        __m128i v = _mm_loadu_si128((const __m128i*) (s + i));
+        bits = _mm_movemask_epi8(FS_CMPEQ_128(v, c));
+        if (bits)
+            return i + __builtin_ctz(bits) / FS_LANE;
+    }
+    for (; i < n; i++)
+        if (s[i] == ch)
+            return i;
+    return -1;
+}
+
+Py_LOCAL(Py_ssize_t) Py_TARGET_AVX2
+find_char_avx2(const STRINGLIB_CHAR* s, Py_ssize_t n, STRINGLIB_CHAR ch)
+{
+    const Py_ssize_t step = 32 / sizeof(STRINGLIB_CHAR);
+    const __m256i c = FS_SET1_256(ch);
+    Py_ssize_t i;
+    unsigned int bits;
+
+    for (i = 0; i + step <= n; i += step) {
+        __m256i v = _mm256_loadu_si256((const __m256i*) (s + i));
+        bits = _mm256_movemask_epi8(FS_CMPEQ_256(v, c));
+        if (bits)
+            return i + __builtin_ctz(bits) / FS_LANE;
+    }
+    for (; i < n; i++)
+        if (s[i] == ch)
+            return i;
+    return -1;
+}
+
+/* the matches are counted per lane, by subtracting the all-ones compare
+   results, and the lanes are summed before they can wrap around, so no
+   lane ever holds more than 255. */
+
+Py_LOCAL(Py_ssize_t) Py_TARGET_SSE2
+count_char_sse2(const STRINGLIB_CHAR* s, Py_ssize_t n, STRINGLIB_CHAR ch)
+{
+    const Py_ssize_t step = 16 / sizeof(STRINGLIB_CHAR);
+    const __m128i c = FS_SET1_128(ch);
+    STRINGLIB_CHAR lanes[16 / sizeof(STRINGLIB_CHAR)];
+    Py_ssize_t i = 0, j, count = 0;
+    int k;
+
+    while (i + step <= n) {
+        __m128i acc = _mm_setzero_si128();
+        for (k = 0; k < 255 && i + step <= n; k++, i += step) {
+            __m128i v = _mm_loadu_si128((const __m128i*) (s + i));
+            acc = FS_SUB_128(acc, FS_CMPEQ_128(v, c));
+        }
+        _mm_storeu_si128((__m128i*) lanes, acc);
+        for (j = 0; j < step; j++)
+            count += lanes[j] & 0xFF;
+    }
+    for (; i < n; i++)
+        if (s[i] == ch)
+            count++;
+    return count;
+}
+
+Py_LOCAL(Py_ssize_t) Py_TARGET_AVX2
+count_char_avx2(const STRINGLIB_CHAR* s, Py_ssize_t n, STRINGLIB_CHAR ch)
+{
+    const Py_ssize_t step = 32 / sizeof(STRINGLIB_CHAR);
+    const __m256i c = FS_SET1_256(ch);
+    STRINGLIB_CHAR lanes[32 / sizeof(STRINGLIB_CHAR)];
+    Py_ssize_t i = 0, j, count = 0;
+    int k;
+
+    while (i + step <= n) {
+        __m256i acc = _mm256_setzero_si256();
+        for (k = 0; k < 255 && i + step <= n; k++, i += step) {
+            __m256i v = _mm256_loadu_si256((const __m256i*) (s + i));
+            acc = FS_SUB_256(acc, FS_CMPEQ_256(v, c));
+        }
+        _mm256_storeu_si256((__m256i*) lanes, acc);
+        for (j = 0; j < step; j++)
+            count += lanes[j] & 0xFF;
+    }
+    for (; i < n; i++)
+        if (s[i] == ch)
+            count++;
+    return count;
+}
+
+/* filtered search for m >= 2, with the same results as fastsearch.  in
+   count mode, next is where the next match may start, so that matches
+   don't overlap. */
+
+Py_LOCAL(Py_ssize_t) Py_TARGET_SSE2
+filtered_search_sse2(const STRINGLIB_CHAR* s, Py_ssize_t n,
+                     const STRINGLIB_CHAR* p, Py_ssize_t m,
+                     int mode)
+{
+    const Py_ssize_t step = 16 / sizeof(STRINGLIB_CHAR);
+    const Py_ssize_t mlast = m - 1, w = n - m;
+    const size_t rest = (m - 2) * sizeof(STRINGLIB_CHAR);
+    const __m128i first = FS_SET1_128(p[0]);
+    const __m128i last = FS_SET1_128(p[mlast]);
+    Py_ssize_t i, j, next = 0, count = 0;
+    unsigned int bits;
+    int k;
+
+    for (i = 0; i + step - 1 <= w; i += step) {
+        __m128i f = _mm_loadu_si128((const __m128i*) (s + i));
+        __m128i l = _mm_loadu_si128((const __m128i*) (s + i + mlast));
+        bits = _mm_movemask_epi8(_mm_and_si128(FS_CMPEQ_128(f, first),
+                                               FS_CMPEQ_128(l, last)));
+        while (bits) {
+            k = __builtin_ctz(bits);
+            bits &= ~(FS_LANE_BITS << k);
+            j = i + k / FS_LANE;
+            if (j >= next && memcmp(s + j + 1, p + 1, rest) == 0) {
+                if (mode != FAST_COUNT)
+                    return j;
+                count++;
+                next = j + m;
+            }
+        }
+    }
+    for (; i <= w; i++) {
+        if (s[i] == p[0] && s[i+mlast] == p[mlast] && i >= next &&
+            memcmp(s + i + 1, p + 1, rest) == 0) {
+            if (mode != FAST_COUNT)
+                return i;
+            count++;
+            next = i + m;
+        }
+    }
+    if (mode != FAST_COUNT)
+        return -1;
+    return count;
+}
+
+Py_LOCAL(Py_ssize_t) Py_TARGET_AVX2
+filtered_search_avx2(const STRINGLIB_CHAR* s, Py_ssize_t n,
+                     const STRINGLIB_CHAR* p, Py_ssize_t m,
+                     int mode)
+{
+    const Py_ssize_t step = 32 / sizeof(STRINGLIB_CHAR);
+    const Py_ssize_t mlast = m - 1, w = n - m;
+    const size_t rest = (m - 2) * sizeof(STRINGLIB_CHAR);
+    const __m256i first = FS_SET1_256(p[0]);
+    const __m256i last = FS_SET1_256(p[mlast]);
+    Py_ssize_t i, j, next = 0, count = 0;
+    unsigned int bits;
+    int k;
+
+    for (i = 0; i + step - 1 <= w; i += step) {
+        __m256i f = _mm256_loadu_si256((const __m256i*) (s + i));
+        __m256i l = _mm256_loadu_si256((const __m256i*) (s + i + mlast));
+        bits = _mm256_movemask_epi8(_mm256_and_si256(FS_CMPEQ_256(f, first),
+                                                     FS_CMPEQ_256(l, last)));
+        while (bits) {
+            k = __builtin_ctz(bits);
+            bits &= ~(FS_LANE_BITS << k);
+            j = i + k / FS_LANE;
+            if (j >= next && memcmp(s + j + 1, p + 1, rest) == 0) {
+                if (mode != FAST_COUNT)
+                    return j;
+                count++;
+                next = j + m;
+            }
+        }
+    }
+    for (; i <= w; i++) {
+        if (s[i] == p[0] && s[i+mlast] == p[mlast] && i >= next &&
+            memcmp(s + i + 1, p + 1, rest) == 0) {
+            if (mode != FAST_COUNT)
+                return i;
+            count++;
+            next = i + m;
+        }
+    }
+    if (mode != FAST_COUNT)
+        return -1;
+    return count;
+}
+
+#endif /* Py_HAVE_X86_SIMD */
+
 Py_LOCAL_INLINE(Py_ssize_t)
 fastsearch(const STRINGLIB_CHAR* s, Py_ssize_t n,
            const STRINGLIB_CHAR* p, Py_ssize_t m,
@@ -37,11 +267,29 @@ fastsearch(const STRINGLIB_CHAR* s, Py_ssize_t n,
             return -1;
         /* use special case for 1-character strings */
         if (mode == FAST_COUNT) {
+#ifdef Py_HAVE_X86_SIMD
+            if (_Py_cpu_features & PY_CPU_AVX2)
+                return count_char_avx2(s, n, p[0]);
+            if (_Py_cpu_features & PY_CPU_SSE2)
+                return count_char_sse2(s, n, p[0]);
+#endif
             for (i = 0; i < n; i++)
                 if (s[i] == p[0])
                     count++;
             return count;
         } else {
+            if (sizeof(STRINGLIB_CHAR) == 1) {
+                /* the C library's memchr is vectorized already */
+                const STRINGLIB_CHAR* q;
+                q = (const STRINGLIB_CHAR*) memchr(s, p[0], n);
+                return q != NULL ? q - s : -1;
+            }
+#ifdef Py_HAVE_X86_SIMD
+            if (_Py_cpu_features & PY_CPU_AVX2)
+                return find_char_avx2(s, n, p[0]);
+            if (_Py_cpu_features & PY_CPU_SSE2)
+                return find_char_sse2(s, n, p[0]);
+#endif
             for (i = 0; i < n; i++)
                 if (s[i] == p[0])
                     return i;
@@ -49,6 +297,13 @@ fastsearch(const STRINGLIB_CHAR* s, Py_ssize_t n,
         return -1;
     }
 
+#ifdef Py_HAVE_X86_SIMD
+    if (_Py_cpu_features & PY_CPU_AVX2)
+        return filtered_search_avx2(s, n, p, m, mode);
+    if (_Py_cpu_features & PY_CPU_SSE2)
+        return filtered_search_sse2(s, n, p, m, mode);
+#endif
+
     mlast = m - 1;
 
     /* create compressed boyer-moore delta 1 table */
@@ -12,15 +12,176 @@ int null_strings, one_strings;
 static PyStringObject *characters[UCHAR_MAX + 1];
 static PyStringObject *nullstring;
 
-/* This dictionary holds all interned strings.  Note that references to
-   strings in this dictionary are *not* counted in the string's ob_refcnt.
-   When the interned string reaches a refcnt of 0 the string deallocation
-   function will delete the reference from this dictionary.
-
-   Another way to look at this is that to say that the actual reference
-   count of a string is:  s->ob_refcnt + (s->ob_sstate?2:0)
+/* All interned strings live in an open addressing hash table keyed on the
+   string contents.  Each slot keeps the string's hash next to the pointer,
+   so a probe only touches a string whose hash matches, and a lookup can be
+   made from a plain char buffer (see _PyString_InternFromStringAndSize())
+   without first building a string object to look up.
+
+   References to strings in this table are *not* counted in the string's
+   ob_refcnt.  When an interned string reaches a refcnt of 0 the string
+   deallocation function removes it from the table, leaving a dummy slot
+   behind that the next resize drops.
 */
-static PyObject *interned;
+typedef struct {
+	long hash;
+	PyStringObject *str;	/* NULL, INTERNED_DUMMY or a string */
+} interned_entry;
+
+static char interned_dummy_storage;
+#define INTERNED_DUMMY ((PyStringObject *)&interned_dummy_storage)
+#define INTERNED_MINSIZE 1024
+#define INTERNED_PERTURB_SHIFT 5
+
+static interned_entry *interned = NULL;
+static size_t interned_mask = 0;	/* number of slots - 1 */
+static Py_ssize_t interned_used = 0;	/* strings in the table */
+static Py_ssize_t interned_fill = 0;	/* strings plus dummy slots */
+static Py_ssize_t interned_immortal = 0;
+static Py_ssize_t interned_bytes = 0;	/* total length of the strings */
+
+/* Counters reported by _PyString_InternStats(). */
+static struct {
+	size_t lookups;		/* interning requests */
+	size_t hits;		/* ... that found the string already there */
+	size_t probes;		/* slots looked at past the first */
+	size_t resizes;
+} interned_stats;
+
+Py_LOCAL_INLINE(long)
+string_hash_bytes(const unsigned char *p, Py_ssize_t len)
+{
+	register Py_ssize_t n = len;
+	register long x;
+
+	/* ob_sval is NUL terminated, so for strings this is the same as
+	   reading *p; buffers passed in by other callers may not be. */
+	x = len ? *p << 7 : 0;
+	while (--n >= 0)
+		x = (1000003*x) ^ *p++;
+	x ^= len;
+	if (x == -1)
+		x = -2;
+	return x;
+}
+
+/* Return the slot holding the interned string equal to str[0:len], or the
+   slot where such a string would go: the first dummy seen on the way, else
+   the free slot that ended the probe.  The table must exist. */
+static interned_entry *
+interned_lookup(const char *str, Py_ssize_t len, long hash)
+{
+	register size_t i = (size_t)hash & interned_mask;
+	register size_t perturb;
+	register interned_entry *entry = &interned[i];
+	interned_entry *freeslot = NULL;
+	PyStringObject *s;
+
+	for (perturb = hash; ; perturb >>= INTERNED_PERTURB_SHIFT) {
+		s = entry->str;
+		if (s == NULL)
+			return freeslot != NULL ? freeslot : entry;
+		if (s == INTERNED_DUMMY) {
+			if (freeslot == NULL)
+				freeslot = entry;
+		}
+		else if (entry->hash == hash && Py_SIZE(s) == len &&
+			 memcmp(s->ob_sval, str, len) == 0)
+			return entry;
+		i = (i << 2) + i + perturb + 1;
+		entry = &interned[i & interned_mask];
+		interned_stats.probes++;
+	}
+}
+
+/* Rebuild the table with room for more than minused strings, dropping the
+   dummies.  Returns -1, with no exception set, if memory runs out. */
+static int
+interned_resize(Py_ssize_t minused)
+{
+	interned_entry *oldtable = interned, *newtable, *entry;
+	size_t oldsize = oldtable == NULL ? 0 : interned_mask + 1;
+	size_t newsize, i, j, perturb, mask;
+
+	for (newsize = INTERNED_MINSIZE;
+	     newsize <= (size_t)minused && newsize > 0;
+	     newsize <<= 1)
+		;
+	if (newsize == 0)
+		return -1;
+	newtable = PyMem_NEW(interned_entry, newsize);
+	if (newtable == NULL)
+		return -1;
+	memset(newtable, 0, sizeof(interned_entry) * newsize);
+	mask = newsize - 1;
+	for (i = 0; i < oldsize; i++) {
+		if (oldtable[i].str == NULL || oldtable[i].str == INTERNED_DUMMY)
+			continue;
+		/* No equal strings and no dummies in the new table, so the
+		   first free slot is the one. */
+		perturb = oldtable[i].hash;
+		j = (size_t)oldtable[i].hash & mask;
+		entry = &newtable[j];
+		while (entry->str != NULL) {
+			j = (j << 2) + j + perturb + 1;
+			entry = &newtable[j & mask];
+			perturb >>= INTERNED_PERTURB_SHIFT;
+		}
+		*entry = oldtable[i];
+	}
+	PyMem_FREE(oldtable);
+	interned = newtable;
+	interned_mask = mask;
+	interned_fill = interned_used;
+	interned_stats.resizes++;
+	return 0;
+}
+
+/* Put s, which isn't interned yet and whose ob_shash is set, in the slot
+   the lookup for it returned, growing the table first if it's too full.
+   Returns -1, with no exception set, if the table can't grow. */
+static int
+interned_insert(PyStringObject *s, interned_entry *entry)
+{
+	if (entry->str == NULL &&
+	    (size_t)(interned_fill + 1) * 3 >= (interned_mask + 1) * 2) {
+		/* Grow quickly while the table is small: most strings get
+		   interned while the first modules are imported. */
+		if (interned_resize(interned_used *
+				    (interned_used > 50000 ? 2 : 4)) < 0)
+			return -1;
+		entry = interned_lookup(s->ob_sval, Py_SIZE(s), s->ob_shash);
+	}
+	if (entry->str == NULL)
+		interned_fill++;
+	entry->hash = s->ob_shash;
+	entry->str = s;
+	interned_used++;
+	interned_bytes += Py_SIZE(s);
+	s->ob_sstate = SSTATE_INTERNED_MORTAL;
+	return 0;
+}
+
+/* Drop op, a dead mortal interned string, from the table. */
+static void
+interned_remove(PyStringObject *op)
+{
+	long hash = op->ob_shash;
+	register size_t i = (size_t)hash & interned_mask;
+	register size_t perturb;
+	register interned_entry *entry = &interned[i];
+
+	for (perturb = hash; entry->str != op;
+	     perturb >>= INTERNED_PERTURB_SHIFT) {
+		if (entry->str == NULL)
+			Py_FatalError("deletion of interned string failed");
+		i = (i << 2) + i + perturb + 1;
+		entry = &interned[i & interned_mask];
+	}
+	entry->str = INTERNED_DUMMY;
+	interned_used--;
+	interned_bytes -= Py_SIZE(op);
+}
 
 /*
    For both PyString_FromString() and PyString_FromStringAndSize(), the
@@ -528,11 +689,7 @@ string_dealloc(PyObject *op)
 			break;
 
 		case SSTATE_INTERNED_MORTAL:
-			/* revive dead object temporarily for DelItem */
-			Py_REFCNT(op) = 3;
-			if (PyDict_DelItem(interned, op) != 0)
-				Py_FatalError(
-					"deletion of interned string failed");
+			interned_remove((PyStringObject *)op);
 			break;
 
 		case SSTATE_INTERNED_IMMORTAL:
@@ -1205,22 +1362,11 @@ _PyString_Eq(PyObject *o1, PyObject *o2)
 static long
 string_hash(PyStringObject *a)
 {
-	register Py_ssize_t len;
-	register unsigned char *p;
-	register long x;
-
 	if (a->ob_shash != -1)
 		return a->ob_shash;
-	len = Py_SIZE(a);
-	p = (unsigned char *) a->ob_sval;
-	x = *p << 7;
-	while (--len >= 0)
-		x = (1000003*x) ^ *p++;
-	x ^= Py_SIZE(a);
-	if (x == -1)
-		x = -2;
-	a->ob_shash = x;
-	return x;
+	a->ob_shash = string_hash_bytes((unsigned char *)a->ob_sval,
+					Py_SIZE(a));
+	return a->ob_shash;
 }
 
 static PyObject*
@@ -1475,22 +1621,21 @@ split_char(PyStringObject *self, Py_ssize_t len, char ch, Py_ssize_t maxcount)
 {
 	const char *s = PyString_AS_STRING(self);
 	register Py_ssize_t i, j, count=0;
+	Py_ssize_t pos;
 	PyObject *str;
 	PyObject *list = PyList_New(PREALLOC_SIZE(maxcount));
 
 	if (list == NULL)
 		return NULL;
 
-	i = j = 0;
-	while ((j < len) && (maxcount-- > 0)) {
-		for(; j<len; j++) {
-			/* I found that using memchr makes no difference */
-			if (s[j] == ch) {
-				SPLIT_ADD(s, i, j);
-				i = j = j + 1;
-				break;
-			}
-		}
+	i = 0;
+	while (maxcount-- > 0) {
+		pos = fastsearch(s+i, len-i, &ch, 1, FAST_SEARCH);
+		if (pos < 0)
+			break;
+		j = i+pos;
+		SPLIT_ADD(s, i, j);
+		i = j + 1;
 	}
 	if (i == 0 && count == 0 && PyString_CheckExact(self)) {
 		/* ch not in self, so just use self as list[0] */
@@ -5112,38 +5257,68 @@ void
 PyString_InternInPlace(PyObject **p)
 {
 	register PyStringObject *s = (PyStringObject *)(*p);
+	interned_entry *entry;
 	PyObject *t;
 	if (s == NULL || !PyString_Check(s))
 		Py_FatalError("PyString_InternInPlace: strings only please!");
 	/* If it's a string subclass, we don't really know what putting
-	   it in the interned dict might do. */
+	   it in the interned table might do. */
 	if (!PyString_CheckExact(s))
 		return;
 	if (PyString_CHECK_INTERNED(s))
 		return;
-	if (interned == NULL) {
-		interned = PyDict_New();
-		if (interned == NULL) {
-			PyErr_Clear(); /* Don't leave an exception */
-			return;
-		}
-	}
-	t = PyDict_GetItem(interned, (PyObject *)s);
-	if (t) {
+	if (interned == NULL && interned_resize(0) < 0)
+		return;
+	interned_stats.lookups++;
+	entry = interned_lookup(s->ob_sval, Py_SIZE(s), string_hash(s));
+	if (entry->str != NULL && entry->str != INTERNED_DUMMY) {
+		interned_stats.hits++;
+		t = (PyObject *)entry->str;
 		Py_INCREF(t);
 		Py_DECREF(*p);
 		*p = t;
 		return;
 	}
+	interned_insert(s, entry);
+}
 
-	if (PyDict_SetItem(interned, (PyObject *)s, (PyObject *)s) < 0) {
-		PyErr_Clear();
-		return;
-	}
-	/* The two references in interned are not counted by refcnt.
-	   The string deallocator will take care of this */
-	Py_REFCNT(s) -= 2;
-	PyString_CHECK_INTERNED(s) = SSTATE_INTERNED_MORTAL;
+/* Return the interned string equal to str[0:size], creating and interning
+   it only when there isn't one yet.  Unlike PyString_FromStringAndSize()
+   followed by PyString_InternInPlace(), the common case of the string
+   being interned already allocates nothing. */
+PyObject *
+_PyString_InternFromStringAndSize(const char *str, Py_ssize_t size)
+{
+	interned_entry *entry;
+	PyStringObject *s;
+	long hash;
+
+	if (interned == NULL && interned_resize(0) < 0)
+		return PyErr_NoMemory();
+	hash = string_hash_bytes((const unsigned char *)str, size);
+	interned_stats.lookups++;
+	entry = interned_lookup(str, size, hash);
+	if (entry->str != NULL && entry->str != INTERNED_DUMMY) {
+		interned_stats.hits++;
+		Py_INCREF(entry->str);
+		return (PyObject *)entry->str;
+	}
+	s = (PyStringObject *)PyString_FromStringAndSize(str, size);
+	if (s == NULL)
+		return NULL;
+	if (size <= 1) {
+		/* Filling the nullstring or characters[] cache interns the
+		   string, which can resize the table; look it up again. */
+		entry = interned_lookup(str, size, hash);
+		if (entry->str == s)
+			return (PyObject *)s;
+	}
+	/* Otherwise creating the string doesn't touch the table, so entry
+	   is still where it goes.  If the table can't grow, the string
+	   just stays uninterned. */
+	s->ob_shash = hash;
+	interned_insert(s, entry);
+	return (PyObject *)s;
 }
 
 void
@@ -5153,6 +5328,7 @@ PyString_InternImmortal(PyObject **p)
 	if (PyString_CHECK_INTERNED(*p) != SSTATE_INTERNED_IMMORTAL) {
 		PyString_CHECK_INTERNED(*p) = SSTATE_INTERNED_IMMORTAL;
 		Py_INCREF(*p);
+		interned_immortal++;
 	}
 }
 
@@ -5181,51 +5357,65 @@ PyString_Fini(void)
 
 void _Py_ReleaseInternedStrings(void)
 {
-	PyObject *keys;
+	interned_entry *table = interned;
+	size_t i, size = interned_mask + 1;
 	PyStringObject *s;
-	Py_ssize_t i, n;
 	Py_ssize_t immortal_size = 0, mortal_size = 0;
 
-	if (interned == NULL || !PyDict_Check(interned))
-		return;
-	keys = PyDict_Keys(interned);
-	if (keys == NULL || !PyList_Check(keys)) {
-		PyErr_Clear();
+	if (table == NULL)
 		return;
-	}
 
 	/* Since _Py_ReleaseInternedStrings() is intended to help a leak
-	   detector, interned strings are not forcibly deallocated; rather, we
-	   give them their stolen references back, and then clear and DECREF
-	   the interned dict. */
+	   detector, interned strings are not forcibly deallocated; rather,
+	   immortal strings give up the reference they hold on themselves,
+	   and then the table is freed.  It is detached first so that strings
+	   dying here don't look for themselves in it. */
 
-	n = PyList_GET_SIZE(keys);
 	fprintf(stderr, "releasing %" PY_FORMAT_SIZE_T "d interned strings\n",
-		n);
-	for (i = 0; i < n; i++) {
-		s = (PyStringObject *) PyList_GET_ITEM(keys, i);
+		interned_used);
+	interned = NULL;
+	interned_mask = 0;
+	interned_used = interned_fill = 0;
+	interned_immortal = interned_bytes = 0;
+	for (i = 0; i < size; i++) {
+		s = table[i].str;
+		if (s == NULL || s == INTERNED_DUMMY)
+			continue;
 		switch (s->ob_sstate) {
-		case SSTATE_NOT_INTERNED:
-			/* XXX Shouldn't happen */
-			break;
 		case SSTATE_INTERNED_IMMORTAL:
-			Py_REFCNT(s) += 1;
 			immortal_size += Py_SIZE(s);
+			s->ob_sstate = SSTATE_NOT_INTERNED;
+			Py_DECREF(s);
 			break;
 		case SSTATE_INTERNED_MORTAL:
-			Py_REFCNT(s) += 2;
 			mortal_size += Py_SIZE(s);
+			s->ob_sstate = SSTATE_NOT_INTERNED;
 			break;
 		default:
 			Py_FatalError("Inconsistent interned string state.");
 		}
-		s->ob_sstate = SSTATE_NOT_INTERNED;
 	}
 	fprintf(stderr, "total size of all interned strings: "
 			"%" PY_FORMAT_SIZE_T "d/%" PY_FORMAT_SIZE_T "d "
 			"mortal/immortal\n", mortal_size, immortal_size);
-	Py_DECREF(keys);
-	PyDict_Clear(interned);
-	Py_DECREF(interned);
-	interned = NULL;
+	PyMem_FREE(table);
+}
+
+/* Return a dict describing the interned string table, for
+   sys._interned_stats(). */
+PyObject *
+_PyString_InternStats(void)
+{
+	size_t slots = interned == NULL ? 0 : interned_mask + 1;
+
+	return Py_BuildValue("{s:n,s:n,s:n,s:n,s:n,s:n,s:n,s:n,s:n}",
+		"strings", interned_used,
+		"immortal", interned_immortal,
+		"string_bytes", interned_bytes,
+		"slots", (Py_ssize_t)slots,
+		"table_bytes", (Py_ssize_t)(slots * sizeof(interned_entry)),
+		"lookups", (Py_ssize_t)interned_stats.lookups,
+		"hits", (Py_ssize_t)interned_stats.hits,
+		"probes", (Py_ssize_t)interned_stats.probes,
+		"resizes", (Py_ssize_t)interned_stats.resizes);
 }
@@ -12,11 +12,14 @@
 #endif
 
 #if PyTuple_MAXSAVESIZE > 0
-/* Entries 1 up to PyTuple_MAXSAVESIZE are free lists, entry 0 is the empty
-   tuple () of which at most one instance will be allocated.
+/* Entries 1 up to PyTuple_MAXSAVESIZE are free lists, initialized by
+   _PyTuple_Init() before any tuple is made, since tupledealloc() may put
+   a tuple on the list for a size PyTuple_New() never made, such as one
+   shrunk by _PyTuple_Resize().  The empty tuple () is allocated at most
+   once.
 */
-static PyTupleObject *free_list[PyTuple_MAXSAVESIZE];
-static int numfree[PyTuple_MAXSAVESIZE];
+static _PyFreeList free_list[PyTuple_MAXSAVESIZE];
+static PyTupleObject *empty_tuple = NULL;
 #endif
 #ifdef COUNT_ALLOCS
 int fast_tuple_allocs;
@@ -33,17 +36,18 @@ PyTuple_New(register Py_ssize_t size)
 		return NULL;
 	}
 #if PyTuple_MAXSAVESIZE > 0
-	if (size == 0 && free_list[0]) {
-		op = free_list[0];
+	if (size == 0 && empty_tuple) {
+		op = empty_tuple;
 		Py_INCREF(op);
 #ifdef COUNT_ALLOCS
 		tuple_zero_allocs++;
 #endif
 		return (PyObject *) op;
 	}
-	if (size < PyTuple_MAXSAVESIZE && (op = free_list[size]) != NULL) {
-		free_list[size] = (PyTupleObject *) op->ob_item[0];
-		numfree[size]--;
+	op = NULL;
+	if (size > 0 && size < PyTuple_MAXSAVESIZE)
+		_PyFreeList_POP(&free_list[size], op);
+	if (op != NULL) {
 #ifdef COUNT_ALLOCS
 		fast_tuple_allocs++;
 #endif
@@ -72,10 +76,10 @@ PyTuple_New(register Py_ssize_t size)
 	}
 	for (i=0; i < size; i++)
 		op->ob_item[i] = NULL;
+	op->ob_hash = -1;
 #if PyTuple_MAXSAVESIZE > 0
 	if (size == 0) {
-		free_list[0] = op;
-		++numfree[0];
+		empty_tuple = op;
 		Py_INCREF(op);	/* extra INCREF so that this is never freed */
 	}
 #endif
@@ -127,6 +131,7 @@ PyTuple_SetItem(register PyObject *op, register Py_ssize_t i, PyObject *newitem)
 	p = ((PyTupleObject *)op) -> ob_item + i;
 	olditem = *p;
 	*p = newitem;
+	((PyTupleObject *)op)->ob_hash = -1;
 	Py_XDECREF(olditem);
 	return 0;
 }
@@ -170,12 +175,9 @@ tupledealloc(register PyTupleObject *op)
 			Py_XDECREF(op->ob_item[i]);
 #if PyTuple_MAXSAVESIZE > 0
 		if (len < PyTuple_MAXSAVESIZE &&
-		    numfree[len] < PyTuple_MAXFREELIST &&
 		    Py_TYPE(op) == &PyTuple_Type)
 		{
-			op->ob_item[0] = (PyObject *) free_list[len];
-			numfree[len]++;
-			free_list[len] = op;
+			_PyFreeList_FREE(&free_list[len], op);
 			goto done; /* return */
 		}
 #endif
@@ -286,6 +288,17 @@ Done:
      1330111, 1412633, 1165069, 1247599, 1495177, 1577699
 */
 
+/* True if the hash of o can't change while a tuple holds it, which lets
+   a tuple of such items cache its own hash: o is of a built-in immutable
+   type, or is a tuple that has cached its hash already. */
+#define HASH_IS_STABLE(o) \
+	(PyString_CheckExact(o) || PyInt_CheckExact(o) || \
+	 PyUnicode_CheckExact(o) || PyLong_CheckExact(o) || \
+	 PyFloat_CheckExact(o) || PyComplex_CheckExact(o) || \
+	 PyBool_Check(o) || (o) == Py_None || \
+	 PyFrozenSet_CheckExact(o) || PyType_CheckExact(o) || \
+	 (PyTuple_CheckExact(o) && ((PyTupleObject *)(o))->ob_hash != -1))
+
 static long
 tuplehash(PyTupleObject *v)
 {
@@ -293,12 +306,19 @@ tuplehash(PyTupleObject *v)
 	register Py_ssize_t len = Py_SIZE(v);
 	register PyObject **p;
 	long mult = 1000003L;
+	int stable = PyTuple_CheckExact(v);
+
+	if (stable && v->ob_hash != -1)
+		return v->ob_hash;
 	x = 0x345678L;
 	p = v->ob_item;
 	while (--len >= 0) {
-		y = PyObject_Hash(*p++);
+		y = PyObject_Hash(*p);
 		if (y == -1)
 			return -1;
+		if (stable && !HASH_IS_STABLE(*p))
+			stable = 0;
+		p++;
 		x = (x ^ y) * mult;
 		/* the cast might truncate len; that doesn't change hash stability */
 		mult += (long)(82520L + len + len);
@@ -306,9 +326,13 @@ tuplehash(PyTupleObject *v)
 	x += 97531L;
 	if (x == -1)
 		x = -2;
+	if (stable)
+		v->ob_hash = x;
 	return x;
 }
 
+#undef HASH_IS_STABLE
+
 static Py_ssize_t
 tuplelength(PyTupleObject *a)
 {
@@ -838,6 +862,7 @@ _PyTuple_Resize(PyObject **pv, Py_ssize_t newsize)
 		return -1;
 	}
 	_Py_NewReference((PyObject *) sv);
+	sv->ob_hash = -1;
 	/* Zero out items added by growing */
 	if (newsize > oldsize)
 		memset(&sv->ob_item[oldsize], 0,
@@ -853,30 +878,30 @@ PyTuple_ClearFreeList(void)
 	int freelist_size = 0;
 #if PyTuple_MAXSAVESIZE > 0
 	int i;
-	for (i = 1; i < PyTuple_MAXSAVESIZE; i++) {
-		PyTupleObject *p, *q;
-		p = free_list[i];
-		freelist_size += numfree[i];
-		free_list[i] = NULL;
-		numfree[i] = 0;
-		while (p) {
-			q = p;
-			p = (PyTupleObject *)(p->ob_item[0]);
-			PyObject_GC_Del(q);
-		}
-	}
+	for (i = 1; i < PyTuple_MAXSAVESIZE; i++)
+		freelist_size += _PyFreeList_Clear(&free_list[i]);
 #endif
 	return freelist_size;
 }
 	
+void
+_PyTuple_Init(void)
+{
+#if PyTuple_MAXSAVESIZE > 0
+	int i;
+	for (i = 1; i < PyTuple_MAXSAVESIZE; i++)
+		_PyFreeList_Init(&free_list[i], "tuple",
+				 PyTuple_MAXFREELIST, 1);
+#endif
+}
+
 void
 PyTuple_Fini(void)
 {
 #if PyTuple_MAXSAVESIZE > 0
 	/* empty tuples are used all over the place and applications may
 	 * rely on the fact that an empty tuple is a singleton. */
-	Py_XDECREF(free_list[0]);
-	free_list[0] = NULL;
+	Py_CLEAR(empty_tuple);
 
 	(void)PyTuple_ClearFreeList();
 #endif
@@ -1841,6 +1841,26 @@ raise_dict_descr_error(PyObject *obj)
 		     "'%.200s' objects", obj->ob_type->tp_name);
 }
 
+PyObject *
+_PyObject_NewInstanceDict(PyObject *obj)
+{
+	PyTypeObject *type = Py_TYPE(obj);
+	PyHeapTypeObject *et;
+	PyDictSharedKeys *cached;
+	PyObject *dict;
+
+	if (!(type->tp_flags & Py_TPFLAGS_HEAPTYPE))
+		return PyDict_New();
+	et = (PyHeapTypeObject *)type;
+	cached = et->ht_cached_keys;
+	dict = _PyDict_NewShared(&et->ht_cached_keys);
+	/* Machine code may have the indices of keys in the old table
+	   built in; see LOAD_ATTR_fast. */
+	if (cached != NULL && et->ht_cached_keys != cached)
+		PyType_Modified(type);
+	return dict;
+}
+
 static PyObject *
 subtype_dict(PyObject *obj, void *context)
 {
@@ -1872,7 +1892,7 @@ subtype_dict(PyObject *obj, void *context)
 	}
 	dict = *dictptr;
 	if (dict == NULL)
-		*dictptr = dict = PyDict_New();
+		*dictptr = dict = _PyObject_NewInstanceDict(obj);
 	Py_XINCREF(dict);
 	return dict;
 }
@@ -2658,6 +2678,7 @@ type_dealloc(PyTypeObject *type)
 	PyObject_Free((char *)type->tp_doc);
 	Py_XDECREF(et->ht_name);
 	Py_XDECREF(et->ht_slots);
+	_PyDict_ClearSharedKeys(&et->ht_cached_keys);
 	Py_TYPE(type)->tp_free((PyObject *)type);
 }
 
@@ -49,6 +49,10 @@ OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
 #include <windows.h>
 #endif
 
+#ifdef Py_HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
 /* Limit for the Unicode object free list */
 
 #define PyUnicode_MAXFREELIST       1024
@@ -1745,6 +1749,150 @@ PyObject *PyUnicode_EncodeUTF7(const Py_UNICODE *s,
 #undef ENCODE
 #undef DECODE
 
+/* --- ASCII and Latin-1 runs ------------------------------------------- */
+
+/* The ASCII, Latin-1 and UTF-8 codecs spend most of their time on runs
+   of characters below 128 or 256, which they copy one to one.  These
+   helpers copy such runs 16 characters at a time with SSE2 where the
+   CPU has it (see pycpu.h), and finish the last few characters, or all
+   of them elsewhere, one at a time. */
+
+#ifdef Py_HAVE_X86_SIMD
+
+/* store the 16 bytes of v as 16 Py_UNICODE characters at p */
+#define WIDEN_SSE2(v, p)                                                \
+    do {                                                                \
+        const __m128i zero_ = _mm_setzero_si128();                      \
+        const __m128i lo_ = _mm_unpacklo_epi8((v), zero_);              \
+        const __m128i hi_ = _mm_unpackhi_epi8((v), zero_);              \
+        WIDEN_STORE_SSE2(lo_, hi_, zero_, (p));                         \
+    } while (0)
+
+#ifdef Py_UNICODE_WIDE
+#define WIDEN_STORE_SSE2(lo, hi, zero, p)                               \
+    do {                                                                \
+        _mm_storeu_si128((__m128i *) (p), _mm_unpacklo_epi16(lo, zero)); \
+        _mm_storeu_si128((__m128i *) ((p) + 4),                         \
+                         _mm_unpackhi_epi16(lo, zero));                 \
+        _mm_storeu_si128((__m128i *) ((p) + 8),                         \
+                         _mm_unpacklo_epi16(hi, zero));                 \
+        _mm_storeu_si128((__m128i *) ((p) + 12),                        \
+                         _mm_unpackhi_epi16(hi, zero));                 \
+    } while (0)
+#else
+#define WIDEN_STORE_SSE2(lo, hi, zero, p)                               \
+    do {                                                                \
+        _mm_storeu_si128((__m128i *) (p), lo);                          \
+        _mm_storeu_si128((__m128i *) ((p) + 8), hi);                    \
+    } while (0)
+#endif
+
+/* widen whole blocks of 16 bytes up to the first one with a byte of 128
+   or more (all of them if check is 0); returns the bytes widened */
+Py_LOCAL(Py_ssize_t) Py_TARGET_SSE2
+widen_sse2(const char *s, Py_ssize_t n, Py_UNICODE *p, int check)
+{
+    Py_ssize_t i;
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (s + i));
+        if (check && _mm_movemask_epi8(v))
+            break;
+        WIDEN_SSE2(v, p + i);
+    }
+    return i;
+}
+
+/* narrow whole blocks of 16 characters up to the first one with a
+   character of limit or more; returns the characters narrowed */
+Py_LOCAL(Py_ssize_t) Py_TARGET_SSE2
+narrow_sse2(const Py_UNICODE *p, Py_ssize_t n, char *s, int limit)
+{
+    const __m128i zero = _mm_setzero_si128();
+    Py_ssize_t i;
+#ifdef Py_UNICODE_WIDE
+    const __m128i high = _mm_set1_epi32(~(limit - 1));
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (p + i));
+        __m128i b = _mm_loadu_si128((const __m128i *) (p + i + 4));
+        __m128i c = _mm_loadu_si128((const __m128i *) (p + i + 8));
+        __m128i d = _mm_loadu_si128((const __m128i *) (p + i + 12));
+        __m128i any = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+        any = _mm_cmpeq_epi8(_mm_and_si128(any, high), zero);
+        if (_mm_movemask_epi8(any) != 0xFFFF)
+            break;
+        _mm_storeu_si128((__m128i *) (s + i),
+                         _mm_packus_epi16(_mm_packs_epi32(a, b),
+                                          _mm_packs_epi32(c, d)));
+    }
+#else
+    const __m128i high = _mm_set1_epi16((short) ~(limit - 1));
+
+    for (i = 0; i + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *) (p + i));
+        __m128i b = _mm_loadu_si128((const __m128i *) (p + i + 8));
+        __m128i any = _mm_cmpeq_epi8(_mm_and_si128(_mm_or_si128(a, b), high),
+                                     zero);
+        if (_mm_movemask_epi8(any) != 0xFFFF)
+            break;
+        _mm_storeu_si128((__m128i *) (s + i), _mm_packus_epi16(a, b));
+    }
+#endif
+    return i;
+}
+
+#undef WIDEN_SSE2
+#undef WIDEN_STORE_SSE2
+
+#endif /* Py_HAVE_X86_SIMD */
+
+/* Copy the bytes of s[0:n] up to the first one of 128 or more to p;
+   returns how many were copied. */
+Py_LOCAL_INLINE(Py_ssize_t)
+ascii_decode(const char *s, Py_ssize_t n, Py_UNICODE *p)
+{
+    Py_ssize_t i = 0;
+
+#ifdef Py_HAVE_X86_SIMD
+    if (n >= 16 && (_Py_cpu_features & PY_CPU_SSE2))
+        i = widen_sse2(s, n, p, 1);
+#endif
+    for (; i < n && (unsigned char) s[i] < 0x80; i++)
+        p[i] = (unsigned char) s[i];
+    return i;
+}
+
+/* Copy all of s[0:n] to p. */
+Py_LOCAL_INLINE(void)
+latin1_decode(const char *s, Py_ssize_t n, Py_UNICODE *p)
+{
+    Py_ssize_t i = 0;
+
+#ifdef Py_HAVE_X86_SIMD
+    if (n >= 16 && (_Py_cpu_features & PY_CPU_SSE2))
+        i = widen_sse2(s, n, p, 0);
+#endif
+    for (; i < n; i++)
+        p[i] = (unsigned char) s[i];
+}
+
+/* Copy the characters of p[0:n] up to the first one of limit or more
+   to s; returns how many were copied. */
+Py_LOCAL_INLINE(Py_ssize_t)
+ucs1_encode(const Py_UNICODE *p, Py_ssize_t n, char *s, int limit)
+{
+    Py_ssize_t i = 0;
+
+#ifdef Py_HAVE_X86_SIMD
+    if (n >= 16 && (_Py_cpu_features & PY_CPU_SSE2))
+        i = narrow_sse2(p, n, s, limit);
+#endif
+    for (; i < n && p[i] < limit; i++)
+        s[i] = (char) p[i];
+    return i;
+}
+
 /* --- UTF-8 Codec -------------------------------------------------------- */
 
 static
@@ -1812,8 +1960,9 @@ PyObject *PyUnicode_DecodeUTF8Stateful(const char *s,
         Py_UCS4 ch = (unsigned char)*s;
 
         if (ch < 0x80) {
-            *p++ = (Py_UNICODE)ch;
-            s++;
+            Py_ssize_t run = ascii_decode(s, e - s, p);
+            s += run;
+            p += run;
             continue;
         }
 
@@ -2008,9 +2157,12 @@ PyUnicode_EncodeUTF8(const Py_UNICODE *s,
     for (i = 0; i < size;) {
         Py_UCS4 ch = s[i++];
 
-        if (ch < 0x80)
+        if (ch < 0x80) {
             /* Encode ASCII */
-            *p++ = (char) ch;
+            Py_ssize_t run = ucs1_encode(s + i - 1, size - i + 1, p, 0x80);
+            i += run - 1;
+            p += run;
+        }
 
         else if (ch < 0x0800) {
             /* Encode Latin-1 */
@@ -3359,8 +3511,7 @@ PyObject *PyUnicode_DecodeLatin1(const char *s,
     if (size == 0)
 	return (PyObject *)v;
     p = PyUnicode_AS_UNICODE(v);
-    while (size-- > 0)
-	*p++ = (unsigned char)*s++;
+    latin1_decode(s, size, p);
     return (PyObject *)v;
 
  onError:
@@ -3500,8 +3651,9 @@ static PyObject *unicode_encode_ucs1(const Py_UNICODE *p,
 	/* can we encode this? */
 	if (c<limit) {
 	    /* no overflow check, because we know that the space is enough */
-	    *str++ = (char)c;
-	    ++p;
+	    Py_ssize_t run = ucs1_encode(p, endp-p, str, limit);
+	    str += run;
+	    p += run;
 	}
 	else {
 	    Py_ssize_t unicodepos = p-startp;
@@ -3684,8 +3836,9 @@ PyObject *PyUnicode_DecodeASCII(const char *s,
     while (s < e) {
 	register unsigned char c = (unsigned char)*s;
 	if (c < 128) {
-	    *p++ = c;
-	    ++s;
+	    Py_ssize_t run = ascii_decode(s, e-s, p);
+	    p += run;
+	    s += run;
 	}
 	else {
 	    startinpos = s-starts;
@@ -5735,14 +5888,12 @@ PyObject *split_char(PyUnicodeObject *self,
     PyObject *str;
     register const Py_UNICODE *buf = self->str;
 
-    for (i = j = 0; i < len; ) {
-	if (buf[i] == ch) {
-	    if (maxcount-- <= 0)
-		break;
-	    SPLIT_APPEND(buf, j, i);
-	    i = j = i + 1;
-	} else
-	    i++;
+    for (j = 0; maxcount-- > 0; j = i + 1) {
+	i = fastsearch(buf + j, len - j, &ch, 1, FAST_SEARCH);
+	if (i < 0)
+	    break;
+	i += j;
+	SPLIT_APPEND(buf, j, i);
     }
     if (j <= len) {
 	SPLIT_APPEND(buf, j, len);
@@ -5766,14 +5917,13 @@ PyObject *split_substring(PyUnicodeObject *self,
     Py_ssize_t sublen = substring->length;
     PyObject *str;
 
-    for (i = j = 0; i <= len - sublen; ) {
-	if (Py_UNICODE_MATCH(self, i, substring)) {
-	    if (maxcount-- <= 0)
-		break;
-	    SPLIT_APPEND(self->str, j, i);
-	    i = j = i + sublen;
-	} else
-	    i++;
+    for (j = 0; maxcount-- > 0; j = i + sublen) {
+	i = fastsearch(self->str + j, len - j,
+		       substring->str, sublen, FAST_SEARCH);
+	if (i < 0)
+	    break;
+	i += j;
+	SPLIT_APPEND(self->str, j, i);
     }
     if (j <= len) {
 	SPLIT_APPEND(self->str, j, len);
@@ -44,6 +44,7 @@ extern void inititertools(void);
 extern void init_collections(void);
 extern void init_heapq(void);
 extern void init_bisect(void);
+extern void init_stringbuilder(void);
 extern void init_symtable(void);
 extern void initmmap(void);
 extern void init_csv(void);
@@ -121,6 +122,7 @@ struct _inittab _PyImport_Inittab[] = {
 	{"_random", init_random},
         {"_bisect", init_bisect},
         {"_heapq", init_heapq},
+	{"_stringbuilder", init_stringbuilder},
 	{"_lsprof", init_lsprof},
 	{"itertools", inititertools},
         {"_collections", init_collections},
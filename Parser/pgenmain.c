@@ -24,6 +24,11 @@ int Py_DebugFlag;
 int Py_VerboseFlag;
 int Py_IgnoreEnvironmentFlag;
 
+#ifdef WITH_THREAD
+/* obmalloc.c looks for the current thread's cache here */
+PyThreadState *_PyThreadState_Current = NULL;
+#endif
+
 /* Forward */
 grammar *getgrammar(char *filename);
 
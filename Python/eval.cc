@@ -361,6 +361,22 @@ PyEval_GetCallStats(PyObject *self)
 #endif
 
 
+/* How long a thread waits for the GIL before asking the thread holding
+   it to drop it, in microseconds.  See eval_gil.h. */
+static unsigned long gil_interval = 5000;
+
+void
+_PyEval_SetSwitchInterval(unsigned long microseconds)
+{
+	gil_interval = microseconds;
+}
+
+unsigned long
+_PyEval_GetSwitchInterval(void)
+{
+	return gil_interval;
+}
+
 #ifdef WITH_THREAD
 
 #ifdef HAVE_ERRNO_H
@@ -368,35 +384,36 @@ PyEval_GetCallStats(PyObject *self)
 #endif
 #include "pythread.h"
 
-static PyThread_type_lock interpreter_lock = 0; /* This is the GIL */
+#include "eval_gil.h" /* This is the GIL */
 long _PyEval_main_thread = 0;
 
 int
 PyEval_ThreadsInitialized(void)
 {
-	return interpreter_lock != 0;
+	return gil_created();
 }
 
 void
 PyEval_InitThreads(void)
 {
-	if (interpreter_lock)
+	if (gil_created())
 		return;
-	interpreter_lock = PyThread_allocate_lock();
-	PyThread_acquire_lock(interpreter_lock, 1);
+	create_gil();
+	take_gil(PyThreadState_GET());
 	_PyEval_main_thread = PyThread_get_thread_ident();
 }
 
 void
 PyEval_AcquireLock(void)
 {
-	PyThread_acquire_lock(interpreter_lock, 1);
+	take_gil(PyThreadState_GET());
 }
 
 void
 PyEval_ReleaseLock(void)
 {
-	PyThread_release_lock(interpreter_lock);
+	/* The thread state may already be NULL here */
+	drop_gil(NULL);
 }
 
 void
@@ -405,8 +422,8 @@ PyEval_AcquireThread(PyThreadState *tstate)
 	if (tstate == NULL)
 		Py_FatalError("PyEval_AcquireThread: NULL new thread state");
 	/* Check someone has called PyEval_InitThreads() to create the lock */
-	assert(interpreter_lock);
-	PyThread_acquire_lock(interpreter_lock, 1);
+	assert(gil_created());
+	take_gil(tstate);
 	if (PyThreadState_Swap(tstate) != NULL)
 		Py_FatalError(
 			"PyEval_AcquireThread: non-NULL old thread state");
@@ -419,7 +436,7 @@ PyEval_ReleaseThread(PyThreadState *tstate)
 		Py_FatalError("PyEval_ReleaseThread: NULL thread state");
 	if (PyThreadState_Swap(NULL) != tstate)
 		Py_FatalError("PyEval_ReleaseThread: wrong thread state");
-	PyThread_release_lock(interpreter_lock);
+	drop_gil(tstate);
 }
 
 /* This function is called from PyOS_AfterFork to ensure that newly
@@ -433,19 +450,15 @@ PyEval_ReInitThreads(void)
 	PyObject *threading, *result;
 	PyThreadState *tstate;
 
-	if (!interpreter_lock)
+	if (!gil_created())
 		return;
-	/*XXX Can't use PyThread_free_lock here because it does too
-	  much error-checking.  Doing this cleanly would require
-	  adding a new function to each thread_*.h.  Instead, just
-	  create a new lock and waste a little bit of memory */
-	interpreter_lock = PyThread_allocate_lock();
-	PyThread_acquire_lock(interpreter_lock, 1);
+	recreate_gil();
+	tstate = PyThreadState_GET();
+	take_gil(tstate);
 	_PyEval_main_thread = PyThread_get_thread_ident();
 
 	/* Update the threading module with the new state.
 	 */
-	tstate = PyThreadState_GET();
 	threading = PyMapping_GetItemString(tstate->interp->modules,
 					    "threading");
 	if (threading == NULL) {
@@ -473,8 +486,8 @@ PyEval_SaveThread(void)
 	if (tstate == NULL)
 		Py_FatalError("PyEval_SaveThread: NULL tstate");
 #ifdef WITH_THREAD
-	if (interpreter_lock)
-		PyThread_release_lock(interpreter_lock);
+	if (gil_created())
+		drop_gil(tstate);
 #endif
 	return tstate;
 }
@@ -485,11 +498,8 @@ PyEval_RestoreThread(PyThreadState *tstate)
 	if (tstate == NULL)
 		Py_FatalError("PyEval_RestoreThread: NULL tstate");
 #ifdef WITH_THREAD
-	if (interpreter_lock) {
-		int err = errno;
-		PyThread_acquire_lock(interpreter_lock, 1);
-		errno = err;
-	}
+	if (gil_created())
+		take_gil(tstate);
 #endif
 	PyThreadState_Swap(tstate);
 }
@@ -1466,8 +1476,10 @@ PyEval_EvalFrame(PyFrameObject *f)
 					goto slow_add;
 				x = PyInt_FromLong(i);
 			}
-			else if (PyString_CheckExact(v) &&
-				 PyString_CheckExact(w)) {
+			else if ((PyString_CheckExact(v) &&
+				  PyString_CheckExact(w)) ||
+				 (PyUnicode_CheckExact(v) &&
+				  PyUnicode_CheckExact(w))) {
 				x = string_concatenate(v, w, f, next_instr);
 				/* string_concatenate consumed the ref to v */
 				goto skip_decref_vx;
@@ -1743,8 +1755,10 @@ PyEval_EvalFrame(PyFrameObject *f)
 					goto slow_iadd;
 				x = PyInt_FromLong(i);
 			}
-			else if (PyString_CheckExact(v) &&
-				 PyString_CheckExact(w)) {
+			else if ((PyString_CheckExact(v) &&
+				  PyString_CheckExact(w)) ||
+				 (PyUnicode_CheckExact(v) &&
+				  PyUnicode_CheckExact(w))) {
 				x = string_concatenate(v, w, f, next_instr);
 				/* string_concatenate consumed the ref to v */
 				goto skip_decref_v;
@@ -2194,14 +2208,14 @@ PyEval_EvalFrame(PyFrameObject *f)
 				long hash = ((PyStringObject *)w)->ob_shash;
 				if (hash != -1) {
 					PyDictObject *d;
-					PyDictEntry *e;
+					Py_ssize_t ix;
 					d = (PyDictObject *)(f->f_globals);
-					e = d->ma_lookup(d, w, hash);
-					if (e == NULL) {
+					ix = d->ma_lookup(d, w, hash);
+					if (ix == _PyDict_IX_ERROR) {
 						why = UNWIND_EXCEPTION;
 						break;
 					}
-					x = e->me_value;
+					x = ix < 0 ? NULL : _PyDict_VALUE(d, ix);
 					if (x != NULL) {
 						Py_INCREF(x);
 						PUSH(x);
@@ -2210,12 +2224,12 @@ PyEval_EvalFrame(PyFrameObject *f)
 						DISPATCH();
 					}
 					d = (PyDictObject *)(f->f_builtins);
-					e = d->ma_lookup(d, w, hash);
-					if (e == NULL) {
+					ix = d->ma_lookup(d, w, hash);
+					if (ix == _PyDict_IX_ERROR) {
 						why = UNWIND_EXCEPTION;
 						break;
 					}
-					x = e->me_value;
+					x = ix < 0 ? NULL : _PyDict_VALUE(d, ix);
 					if (x != NULL) {
 						Py_INCREF(x);
 						PUSH(x);
@@ -3645,28 +3659,28 @@ _PyEval_HandlePyTickerExpired(PyThreadState *tstate)
 		}
 	}
 #ifdef WITH_THREAD
-	if (interpreter_lock) {
+	if (gil_created() && GIL_DROP_REQUESTED()) {
 		/* Give another thread a chance */
 
 		if (PyThreadState_Swap(NULL) != tstate)
 			Py_FatalError("ceval: tstate mix-up");
-		PyThread_release_lock(interpreter_lock);
+		drop_gil(tstate);
 
 		/* Other threads may run now */
 
-		PyThread_acquire_lock(interpreter_lock, 1);
+		take_gil(tstate);
 		if (PyThreadState_Swap(tstate) != NULL)
 			Py_FatalError("ceval: orphan tstate");
+	}
 
-		/* Check for thread interrupts */
+	/* Check for thread interrupts */
 
-		if (tstate->async_exc != NULL) {
-			PyObject *x = tstate->async_exc;
-			tstate->async_exc = NULL;
-			PyErr_SetNone(x);
-			Py_DECREF(x);
-			return -1;
-		}
+	if (gil_created() && tstate->async_exc != NULL) {
+		PyObject *x = tstate->async_exc;
+		tstate->async_exc = NULL;
+		PyErr_SetNone(x);
+		Py_DECREF(x);
+		return -1;
 	}
 #endif
 	return 0;
@@ -5048,16 +5062,7 @@ string_concatenate(PyObject *v, PyObject *w,
 		   PyFrameObject *f, unsigned char *next_instr)
 {
 	/* This function implements 'variable += expr' when both arguments
-	   are strings. */
-	Py_ssize_t v_len = PyString_GET_SIZE(v);
-	Py_ssize_t w_len = PyString_GET_SIZE(w);
-	Py_ssize_t new_len = v_len + w_len;
-	if (new_len < 0) {
-		PyErr_SetString(PyExc_OverflowError,
-				"strings are too large to concat");
-		return NULL;
-	}
-
+	   are strings, or both are unicode. */
 	if (v->ob_refcnt == 2) {
 		/* In the common case, there are 2 references to the value
 		 * stored in 'variable' when the += is performed: one on the
@@ -5098,6 +5103,46 @@ string_concatenate(PyObject *v, PyObject *w,
 		}
 		}
 	}
+	return _PyEval_ConcatStrings(v, w);
+}
+
+/* Concatenate two exact str or two exact unicode objects.  If the caller
+   owns the only reference to 'v', 'v' is resized in place, which keeps
+   repeated 'variable += expr' linear.  Steals the reference to 'v'. */
+PyObject *
+_PyEval_ConcatStrings(PyObject *v, PyObject *w)
+{
+	int is_unicode = PyUnicode_CheckExact(v);
+	Py_ssize_t v_len = is_unicode ? PyUnicode_GET_SIZE(v) :
+					PyString_GET_SIZE(v);
+	Py_ssize_t w_len = is_unicode ? PyUnicode_GET_SIZE(w) :
+					PyString_GET_SIZE(w);
+	Py_ssize_t new_len = v_len + w_len;
+	if (new_len < 0) {
+		PyErr_SetString(PyExc_OverflowError,
+				"strings are too large to concat");
+		Py_DECREF(v);
+		return NULL;
+	}
+
+	if (is_unicode) {
+		if (v->ob_refcnt == 1) {
+			/* PyUnicode_Resize() reallocates the buffer in place
+			 * unless 'v' is one of the shared empty or
+			 * single-character objects, which it copies.
+			 */
+			if (PyUnicode_Resize(&v, new_len) != 0) {
+				Py_DECREF(v);
+				return NULL;
+			}
+			Py_UNICODE_COPY(PyUnicode_AS_UNICODE(v) + v_len,
+					PyUnicode_AS_UNICODE(w), w_len);
+			return v;
+		}
+		w = PyUnicode_Concat(v, w);
+		Py_DECREF(v);
+		return w;
+	}
 
 	if (v->ob_refcnt == 1 && !PyString_CHECK_INTERNED(v)) {
 		/* Now we own the last reference to 'v', so we can resize it
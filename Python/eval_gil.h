@@ -0,0 +1,203 @@
+
+/* The global interpreter lock, included by eval.cc.
+
+   With POSIX threads the GIL is a flag protected by a mutex, with
+   condition variables to wait on, instead of a plain lock.  The thread
+   holding it no longer releases it every _Py_CheckInterval ticks:
+
+   - A thread that wants the GIL waits on gil_cond for up to
+     gil_interval microseconds.  If the GIL hasn't changed hands in that
+     time it sets gil_drop_request and zeroes _Py_Ticker, so that the
+     holder notices at its next periodic check.
+
+   - The holder then drops the GIL and waits on switch_cond until some
+     other thread has taken it.  Without that handoff the holder, which
+     is already running, nearly always takes the GIL straight back before
+     the waiting thread has even been scheduled, and an I/O thread that
+     wakes up behind a CPU-bound one can wait for a very long time.
+
+   Elsewhere the GIL is still a PyThread lock that is released at every
+   periodic check. */
+
+/* set by a thread that has waited gil_interval for the GIL */
+static volatile int gil_drop_request = 0;
+
+#ifdef _POSIX_THREADS
+
+#include <pthread.h>
+#include <sys/time.h>
+
+/* -1 until the GIL has been created, then whether it is held */
+static volatile int gil_locked = -1;
+/* the thread that took the GIL last, and how many times it has been
+   taken, to tell whether it has changed hands */
+static PyThreadState *volatile gil_last_holder = NULL;
+static volatile unsigned long gil_switch_number = 0;
+
+/* gil_mutex protects the variables above, gil_cond is signalled when the
+   GIL is released */
+static pthread_mutex_t gil_mutex;
+static pthread_cond_t gil_cond;
+/* switch_cond is signalled when the GIL is taken, switch_mutex makes sure
+   that a thread waiting for that doesn't miss it */
+static pthread_mutex_t switch_mutex;
+static pthread_cond_t switch_cond;
+
+#define GIL_CHECK(status, name) \
+	if (status) { perror(name); Py_FatalError("GIL: " name " failed"); }
+
+static int
+gil_created(void)
+{
+	return gil_locked >= 0;
+}
+
+static void
+create_gil(void)
+{
+	GIL_CHECK(pthread_mutex_init(&gil_mutex, NULL),
+		  "pthread_mutex_init(gil_mutex)");
+	GIL_CHECK(pthread_mutex_init(&switch_mutex, NULL),
+		  "pthread_mutex_init(switch_mutex)");
+	GIL_CHECK(pthread_cond_init(&gil_cond, NULL),
+		  "pthread_cond_init(gil_cond)");
+	GIL_CHECK(pthread_cond_init(&switch_cond, NULL),
+		  "pthread_cond_init(switch_cond)");
+	gil_last_holder = NULL;
+	gil_drop_request = 0;
+	gil_locked = 0;
+}
+
+static void
+recreate_gil(void)
+{
+	/* after a fork the other threads are gone, but the mutexes and
+	   conditions may have been in use by them.  Like the lock this
+	   replaced, just make new ones. */
+	create_gil();
+}
+
+static void
+drop_gil(PyThreadState *tstate)
+{
+	if (!gil_locked)
+		Py_FatalError("drop_gil: GIL is not locked");
+
+	GIL_CHECK(pthread_mutex_lock(&gil_mutex), "pthread_mutex_lock");
+	gil_locked = 0;
+	GIL_CHECK(pthread_cond_signal(&gil_cond), "pthread_cond_signal");
+	GIL_CHECK(pthread_mutex_unlock(&gil_mutex), "pthread_mutex_unlock");
+
+	if (gil_drop_request && tstate != NULL) {
+		/* another thread asked for the GIL, don't take it back
+		   before it has had it */
+		GIL_CHECK(pthread_mutex_lock(&switch_mutex),
+			  "pthread_mutex_lock");
+		if (gil_last_holder == tstate) {
+			gil_drop_request = 0;
+			GIL_CHECK(pthread_cond_wait(&switch_cond,
+						    &switch_mutex),
+				  "pthread_cond_wait");
+		}
+		GIL_CHECK(pthread_mutex_unlock(&switch_mutex),
+			  "pthread_mutex_unlock");
+	}
+}
+
+static void
+take_gil(PyThreadState *tstate)
+{
+	int err = errno;
+
+	GIL_CHECK(pthread_mutex_lock(&gil_mutex), "pthread_mutex_lock");
+	while (gil_locked) {
+		unsigned long switch_number = gil_switch_number;
+		struct timeval now;
+		struct timespec deadline;
+		int status;
+
+		gettimeofday(&now, NULL);
+		deadline.tv_sec = now.tv_sec + gil_interval / 1000000;
+		deadline.tv_nsec = (now.tv_usec + gil_interval % 1000000) * 1000;
+		if (deadline.tv_nsec >= 1000000000) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000;
+		}
+		status = pthread_cond_timedwait(&gil_cond, &gil_mutex,
+						&deadline);
+		if (status == ETIMEDOUT) {
+			/* the holder has had it for a whole interval, ask
+			   for it */
+			if (gil_locked && gil_switch_number == switch_number) {
+				gil_drop_request = 1;
+				_Py_Ticker = 0;
+			}
+		}
+		else
+			GIL_CHECK(status, "pthread_cond_timedwait");
+	}
+
+	/* take the GIL, and tell a thread waiting to hand it over that it
+	   has been */
+	GIL_CHECK(pthread_mutex_lock(&switch_mutex), "pthread_mutex_lock");
+	gil_locked = 1;
+	if (tstate != gil_last_holder) {
+		gil_last_holder = tstate;
+		gil_switch_number++;
+	}
+	GIL_CHECK(pthread_cond_signal(&switch_cond), "pthread_cond_signal");
+	GIL_CHECK(pthread_mutex_unlock(&switch_mutex), "pthread_mutex_unlock");
+
+	/* the request was for the thread that has just got the GIL */
+	gil_drop_request = 0;
+	GIL_CHECK(pthread_mutex_unlock(&gil_mutex), "pthread_mutex_unlock");
+	errno = err;
+}
+
+/* should the thread holding the GIL drop it at its periodic check? */
+#define GIL_DROP_REQUESTED() (gil_drop_request)
+
+#else /* !_POSIX_THREADS */
+
+static PyThread_type_lock interpreter_lock = 0;
+
+static int
+gil_created(void)
+{
+	return interpreter_lock != 0;
+}
+
+static void
+create_gil(void)
+{
+	interpreter_lock = PyThread_allocate_lock();
+}
+
+static void
+recreate_gil(void)
+{
+	/*XXX Can't use PyThread_free_lock here because it does too
+	  much error-checking.  Doing this cleanly would require
+	  adding a new function to each thread_*.h.  Instead, just
+	  create a new lock and waste a little bit of memory */
+	create_gil();
+}
+
+static void
+drop_gil(PyThreadState *tstate)
+{
+	PyThread_release_lock(interpreter_lock);
+}
+
+static void
+take_gil(PyThreadState *tstate)
+{
+	int err = errno;
+	PyThread_acquire_lock(interpreter_lock, 1);
+	errno = err;
+}
+
+/* give other threads a chance at every periodic check */
+#define GIL_DROP_REQUESTED() (1)
+
+#endif /* _POSIX_THREADS */
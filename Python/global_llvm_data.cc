@@ -56,7 +56,15 @@ PyGlobalLlvmData_Free(PyGlobalLlvmData * global_data)
 PyGlobalLlvmData *
 PyGlobalLlvmData::Get()
 {
-    return PyThreadState_GET()->interp->global_llvm_data;
+    PyThreadState *tstate = PyThreadState_GET();
+#ifdef WITH_THREAD
+    // Threads give up their thread state along with the GIL while they
+    // optimize or JIT code.  They only do that once there are other
+    // threads, long after PyGILState has been set up.
+    if (tstate == NULL)
+        tstate = PyGILState_GetThisThreadState();
+#endif
+    return tstate->interp->global_llvm_data;
 }
 
 #define STRINGIFY(X) STRINGIFY2(X)
@@ -101,6 +109,7 @@ find_stdlib_bc()
 
 PyGlobalLlvmData::PyGlobalLlvmData()
     : optimizations_(4, (FunctionPassManager*)NULL),
+      optimizations_initialized_(false),
       num_globals_after_last_gc_(0)
 {
     std::string error;
@@ -304,7 +313,23 @@ PyGlobalLlvmData::Optimize(llvm::Function &f, int level)
     assert(opts_pm != NULL && "Optimization was NULL");
     assert(this->module_ == f.getParent() &&
            "We assume that all functions belong to the same module.");
+    if (!this->optimizations_initialized_) {
+        // Don't let the passes initialize themselves lazily without the
+        // GIL: PyAliasAnalysis mirrors some type objects.
+        for (size_t i = 0; i < this->optimizations_.size(); ++i) {
+            this->optimizations_[i]->doInitialization();
+        }
+        this->optimizations_initialized_ = true;
+    }
+    // The passes only look at the IR, so let any other threads run
+    // while they do.
+    if (!PyEval_ThreadsInitialized()) {
+        opts_pm->run(f);
+        return 0;
+    }
+    Py_BEGIN_ALLOW_THREADS
     opts_pm->run(f);
+    Py_END_ALLOW_THREADS
     return 0;
 }
 
@@ -316,6 +341,34 @@ PyGlobalLlvmData_Optimize(struct PyGlobalLlvmData *global_data,
     return _LlvmFunction_Optimize(global_data, llvm_function, level);
 }
 
+void
+PyGlobalLlvmData::Lock()
+{
+    if (this->lock_.tryacquire())
+        return;
+    // Another thread is using LLVM, possibly without the GIL.  Let the
+    // rest of the interpreter run while we wait for it.
+    if (PyThreadState_GET() == NULL) {
+        this->lock_.acquire();
+        return;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    this->lock_.acquire();
+    Py_END_ALLOW_THREADS
+}
+
+void
+PyGlobalLlvmData_Lock(struct PyGlobalLlvmData *global_data)
+{
+    global_data->Lock();
+}
+
+void
+PyGlobalLlvmData_Unlock(struct PyGlobalLlvmData *global_data)
+{
+    global_data->Unlock();
+}
+
 #ifdef Py_WITH_INSTRUMENTATION
 // Collect statistics about the time it takes to collect unused globals.
 class GlobalGCTimes : public DataVectorStats<int64_t> {
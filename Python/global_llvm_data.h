@@ -18,6 +18,7 @@
 #include "llvm/ADT/OwningPtr.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/Support/ValueHandle.h"
+#include "llvm/System/Mutex.h"
 
 #include <string>
 
@@ -42,12 +43,34 @@ public:
     ~PyGlobalLlvmData();
 
     // Optimize f to a particular level. Currently, levels from 0 to 3
-    // are valid.
+    // are valid.  The caller must hold the GIL and the lock below; the
+    // GIL is released while the passes run.
     //
     // Returns 0 on success or -1 on failure (if level is out of
     // range, for example).
     int Optimize(llvm::Function &f, int level);
 
+    // Serializes everything that touches the module, the
+    // ExecutionEngine or the pass managers.  Optimizing a function and
+    // emitting its machine code don't look at any Python objects, so
+    // Optimize() and _LlvmFunction_Jit() release the GIL while they
+    // work and hold only this lock; any other use of LLVM holds both.
+    // Lock() releases the GIL while it waits, so the two can't
+    // deadlock.  The lock is recursive because a decref made while
+    // holding it can run arbitrary Python code.
+    void Lock();
+    void Unlock() { this->lock_.release(); }
+
+    // Holds the lock for as long as it's in scope.
+    class ScopedLock {
+    public:
+        explicit ScopedLock(PyGlobalLlvmData *llvm_data)
+            : llvm_data_(llvm_data) { llvm_data_->Lock(); }
+        ~ScopedLock() { llvm_data_->Unlock(); }
+    private:
+        PyGlobalLlvmData *llvm_data_;
+    };
+
     llvm::ExecutionEngine *getExecutionEngine() { return this->engine_; }
 
     // Use this accessor for the LLVMContext rather than
@@ -99,6 +122,7 @@ private:
     llvm::ExecutionEngine *engine_;  // Not modified after the constructor.
 
     std::vector<llvm::FunctionPassManager *> optimizations_;
+    bool optimizations_initialized_;
     llvm::PassManager gc_;
 
     // Cached data in module_.  The WeakVH should only hold GlobalVariables.
@@ -111,6 +135,8 @@ private:
     llvm::OwningPtr<PyConstantMirror> constant_mirror_;
 
     unsigned num_globals_after_last_gc_;
+
+    llvm::sys::Mutex lock_;
 };
 #endif  /* WITH_LLVM */
 
@@ -23,6 +23,10 @@ void PyGlobalLlvmData_Free(struct PyGlobalLlvmData *);
 PyAPI_FUNC(int) PyGlobalLlvmData_Optimize(struct PyGlobalLlvmData *,
                                           _LlvmFunction *, int);
 
+/* See global_llvm_data.h:PyGlobalLlvmData::Lock for documentation. */
+PyAPI_FUNC(void) PyGlobalLlvmData_Lock(struct PyGlobalLlvmData *);
+PyAPI_FUNC(void) PyGlobalLlvmData_Unlock(struct PyGlobalLlvmData *);
+
 /* Initializes LLVM and all of the LLVM wrapper types. */
 int _PyLlvm_Init(void);
 
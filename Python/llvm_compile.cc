@@ -174,6 +174,26 @@ find_basic_blocks(PyObject *bytecode, py::LlvmFunctionBuilder &fbuilder,
     return 0;
 }
 
+// If the instruction after iter's is a STORE_FAST that doesn't start a
+// basic block, returns the index of the local it stores to, otherwise -1.
+static int
+next_store_fast(const PyBytecodeIterator &iter,
+                const std::vector<InstrInfo>& instr_info)
+{
+    if (iter.NextIndex() >= instr_info.size() ||
+        instr_info[iter.NextIndex()].block_ != NULL) {
+        return -1;
+    }
+    PyBytecodeIterator next(iter);
+    next.Advance();
+    if (next.Error()) {
+        // The main loop will report this when it gets there.
+        PyErr_Clear();
+        return -1;
+    }
+    return next.Opcode() == STORE_FAST ? next.Oparg() : -1;
+}
+
 extern "C" _LlvmFunction *
 _PyCode_ToLlvmIr(PyCodeObject *code)
 {
@@ -189,6 +209,7 @@ _PyCode_ToLlvmIr(PyCodeObject *code)
     }
 
     PyGlobalLlvmData *global_data = PyGlobalLlvmData::Get();
+    PyGlobalLlvmData::ScopedLock lock(global_data);
     global_data->MaybeCollectUnusedGlobals();
 
     py::LlvmFunctionBuilder fbuilder(global_data, code);
@@ -243,7 +264,6 @@ _PyCode_ToLlvmIr(PyCodeObject *code)
         OPCODE(BINARY_MULTIPLY)
         OPCODE(BINARY_DIVIDE)
         OPCODE(BINARY_MODULO)
-        OPCODE(BINARY_ADD)
         OPCODE(BINARY_SUBTRACT)
         OPCODE(BINARY_SUBSCR)
         OPCODE(BINARY_FLOOR_DIVIDE)
@@ -270,7 +290,6 @@ _PyCode_ToLlvmIr(PyCodeObject *code)
         OPCODE(DELETE_SLICE_BOTH)
         OPCODE(STORE_MAP)
         OPCODE(IMPORT_NAME)
-        OPCODE(INPLACE_ADD)
         OPCODE(INPLACE_SUBTRACT)
         OPCODE(INPLACE_MULTIPLY)
         OPCODE(INPLACE_DIVIDE)
@@ -297,6 +316,13 @@ _PyCode_ToLlvmIr(PyCodeObject *code)
         OPCODE(END_FINALLY)
 #undef OPCODE
 
+        case BINARY_ADD:
+            fbuilder.BINARY_ADD(next_store_fast(iter, instr_info));
+            break;
+        case INPLACE_ADD:
+            fbuilder.INPLACE_ADD(next_store_fast(iter, instr_info));
+            break;
+
 #define OPCODE_WITH_ARG(opname)				\
     case opname:					\
         fbuilder.opname(iter.Oparg());			\
@@ -1398,7 +1398,8 @@ LlvmFunctionBuilder::LOAD_ATTR_fast(int names_index)
     Value *getattr_func = this->GetGlobalFunction<
         PyObject *(PyObject *obj, PyTypeObject *type, PyObject *name,
                    long dictoffset, PyObject *descr, descrgetfunc descr_get,
-                   char is_data_descr)>("_PyLlvm_Object_GenericGetAttr");
+                   char is_data_descr, void *shared_table,
+                   long shared_index)>("_PyLlvm_Object_GenericGetAttr");
     Value *args[] = {
         obj_v,
         accessor.guard_type_v_,
@@ -1406,7 +1407,9 @@ LlvmFunctionBuilder::LOAD_ATTR_fast(int names_index)
         accessor.dictoffset_v_, 
         accessor.descr_v_,
         descr_get_v,
-        accessor.is_data_descr_v_
+        accessor.is_data_descr_v_,
+        accessor.shared_table_v_,
+        accessor.shared_index_v_
     };
     Value *result = this->CreateCall(getattr_func, args, array_endof(args));
 
@@ -1585,6 +1588,13 @@ LlvmFunctionBuilder::AttributeAccessor::CacheTypeLookup()
             }
         }
     }
+    if (PyType_HasFeature(this->guard_type_, Py_TPFLAGS_HEAPTYPE)) {
+        PyDictSharedKeys *keys =
+            ((PyHeapTypeObject *)this->guard_type_)->ht_cached_keys;
+        this->shared_index_ = _PyDict_SharedKeysIndex(keys, this->name_);
+        if (this->shared_index_ >= 0)
+            this->shared_table_ = _PyDict_SharedTable(keys);
+    }
 }
 
 void
@@ -1600,6 +1610,11 @@ LlvmFunctionBuilder::AttributeAccessor::MakeLlvmValues()
     this->is_data_descr_v_ =
         ConstantInt::get(PyTypeBuilder<char>::get(this->fbuilder_->context_),
                          this->is_data_descr_);
+    this->shared_table_v_ =
+        this->fbuilder_->EmbedPointer<void*>(this->shared_table_);
+    this->shared_index_v_ =
+        ConstantInt::get(PyTypeBuilder<long>::get(this->fbuilder_->context_),
+                         this->shared_index_);
 }
 
 void
@@ -3029,6 +3044,53 @@ LlvmFunctionBuilder::GenericBinOp(const char *apifunc)
     this->Push(result);
 }
 
+void
+LlvmFunctionBuilder::GenericAdd(const char *apifunc, bool inplace,
+                                int store_index)
+{
+    if (store_index < 0) {
+        this->GenericBinOp(apifunc);
+        return;
+    }
+    // 'x = x + y' or 'x += y' on a local: _PyLlvm_AddToLocal() clears the
+    // local when that lets it resize a string in place, the way
+    // string_concatenate() does in eval.cc.  The STORE_FAST that follows
+    // then fills the local back in.
+    Value *rhs = this->Pop();
+    Value *lhs = this->Pop();
+    Function *op = this->GetGlobalFunction<
+        PyObject *(PyObject *, PyObject *, PyObject **, PyObject **, int)>(
+            "_PyLlvm_AddToLocal");
+    Value *frame_local_slot = this->builder_.CreateGEP(
+        this->fastlocals_, ConstantInt::get(Type::getInt32Ty(this->context_),
+                                            store_index));
+    Value *args[] = {
+        lhs,
+        rhs,
+        this->locals_[store_index],
+        frame_local_slot,
+        ConstantInt::get(PyTypeBuilder<int>::get(this->context_), inplace)
+    };
+    Value *result = this->CreateCall(op, args, array_endof(args),
+                                     "add_result");
+    // _PyLlvm_AddToLocal() stole the reference to lhs.
+    this->DecRef(rhs);
+    this->PropagateExceptionOnNull(result);
+    this->Push(result);
+}
+
+void
+LlvmFunctionBuilder::BINARY_ADD(int store_index)
+{
+    this->GenericAdd("PyNumber_Add", false, store_index);
+}
+
+void
+LlvmFunctionBuilder::INPLACE_ADD(int store_index)
+{
+    this->GenericAdd("PyNumber_InPlaceAdd", true, store_index);
+}
+
 #define BINOP_METH(OPCODE, APIFUNC) 		\
 void						\
 LlvmFunctionBuilder::OPCODE()			\
@@ -3036,7 +3098,6 @@ LlvmFunctionBuilder::OPCODE()			\
     this->GenericBinOp(#APIFUNC);		\
 }
 
-BINOP_METH(BINARY_ADD, PyNumber_Add)
 BINOP_METH(BINARY_SUBTRACT, PyNumber_Subtract)
 BINOP_METH(BINARY_MULTIPLY, PyNumber_Multiply)
 BINOP_METH(BINARY_TRUE_DIVIDE, PyNumber_TrueDivide)
@@ -3050,7 +3111,6 @@ BINOP_METH(BINARY_AND, PyNumber_And)
 BINOP_METH(BINARY_FLOOR_DIVIDE, PyNumber_FloorDivide)
 BINOP_METH(BINARY_SUBSCR, PyObject_GetItem)
 
-BINOP_METH(INPLACE_ADD, PyNumber_InPlaceAdd)
 BINOP_METH(INPLACE_SUBTRACT, PyNumber_InPlaceSubtract)
 BINOP_METH(INPLACE_MULTIPLY, PyNumber_InPlaceMultiply)
 BINOP_METH(INPLACE_TRUE_DIVIDE, PyNumber_InPlaceTrueDivide)
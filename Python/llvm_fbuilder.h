@@ -132,7 +132,9 @@ public:
     void ROT_THREE();
     void ROT_FOUR();
 
-    void BINARY_ADD();
+    // store_index is the local that the STORE_FAST right after the add
+    // stores the sum to, or -1 if there is none.
+    void BINARY_ADD(int store_index);
     void BINARY_SUBTRACT();
     void BINARY_MULTIPLY();
     void BINARY_TRUE_DIVIDE();
@@ -147,7 +149,7 @@ public:
     void BINARY_FLOOR_DIVIDE();
     void BINARY_SUBSCR();
 
-    void INPLACE_ADD();
+    void INPLACE_ADD(int store_index);
     void INPLACE_SUBTRACT();
     void INPLACE_MULTIPLY();
     void INPLACE_TRUE_DIVIDE();
@@ -478,6 +480,9 @@ private:
     void GenericPowOp(const char *apifunc);
     // GenericUnaryOp's is "PyObject *(*)(PyObject *)"
     void GenericUnaryOp(const char *apifunc);
+    // BINARY_ADD and INPLACE_ADD use GenericBinOp unless the sum goes
+    // straight into a local, when they let strings be resized in place.
+    void GenericAdd(const char *apifunc, bool inplace, int store_index);
 
     // Call PyObject_RichCompare(lhs, rhs, cmp_op), pushing the result
     // onto the stack. cmp_op is one of Py_EQ, Py_NE, Py_LT, Py_LE, Py_GT
@@ -577,11 +582,15 @@ private:
               is_data_descr_(false),
               descr_get_(0),
               descr_set_(0),
+              shared_table_(0),
+              shared_index_(-1),
               guard_type_v_(0),
               name_v_(0),
               dictoffset_v_(0),
               descr_v_(0),
-              is_data_descr_v_(0) { }
+              is_data_descr_v_(0),
+              shared_table_v_(0),
+              shared_index_v_(0) { }
 
         // This helper method returns false if a LOAD_ATTR or STORE_ATTR opcode
         // cannot be optimized.  If the opcode can be optimized, it fills in
@@ -618,6 +627,12 @@ private:
         bool is_data_descr_;
         descrgetfunc descr_get_;
         descrsetfunc descr_set_;
+        // If the type's instance dicts share a table of keys holding the
+        // name, this is that table and the name's index in it.  Replacing
+        // the table modifies the type, so the index holds for the life of
+        // the code.
+        PyDictEntry *shared_table_;
+        Py_ssize_t shared_index_;
 
         // llvm::Value versions of the above data created with EmbedPointer or
         // ConstantInt::get.
@@ -626,6 +641,8 @@ private:
         llvm::Value *dictoffset_v_;
         llvm::Value *descr_v_;
         llvm::Value *is_data_descr_v_;
+        llvm::Value *shared_table_v_;
+        llvm::Value *shared_index_v_;
 
     private:
         // Cache all of the data required to do attribute access.  This fills
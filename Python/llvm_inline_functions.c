@@ -84,6 +84,35 @@ _PyLlvm_FastUnpackIterable(PyObject *iter, int argcount,
     }
 }
 
+/* Implements 'x = x + y' and 'x += y' when the sum is stored straight
+   back into the local x.  Like string_concatenate() in eval.cc, if x and
+   the value stack hold the only references to a string v, this clears
+   the local so that _PyEval_ConcatStrings() can resize v in place.
+   llvm_local and frame_local are the two copies of the local kept by
+   LlvmFunctionBuilder::SetLocal().  Steals the reference to v. */
+PyObject * __attribute__((always_inline))
+_PyLlvm_AddToLocal(PyObject *v, PyObject *w, PyObject **llvm_local,
+                   PyObject **frame_local, int inplace)
+{
+    PyObject *result;
+
+    if ((PyString_CheckExact(v) && PyString_CheckExact(w)) ||
+        (PyUnicode_CheckExact(v) && PyUnicode_CheckExact(w))) {
+        if (v->ob_refcnt == 2 && *llvm_local == v) {
+            *llvm_local = NULL;
+            *frame_local = NULL;
+            Py_DECREF(v);
+        }
+        return _PyEval_ConcatStrings(v, w);
+    }
+    if (inplace)
+        result = PyNumber_InPlaceAdd(v, w);
+    else
+        result = PyNumber_Add(v, w);
+    Py_DECREF(v);
+    return result;
+}
+
 /* This type collects the set of three values that constitute an
    exception.  So far, it's only used for
    _PyLlvm_WrapEnterExceptOrFinally().  If we use it for more, we
@@ -201,11 +230,15 @@ _PyLlvm_Object_GetDictPtr(PyObject *obj, PyTypeObject *tp, long dictoffset)
  * extra arguments is to allow LLVM optimizers to notice that all of these
  * things are constant.  By passing them as parameters and always inlining this
  * function, we ensure that they will benefit from constant propagation.
+ *
+ * If shared_table isn't NULL, it's the table of keys shared by the instance
+ * dicts of type, in which name has the index shared_index.
  */
 PyObject * __attribute__((always_inline))
 _PyLlvm_Object_GenericGetAttr(PyObject *obj, PyTypeObject *type,
                               PyObject *name, long dictoffset, PyObject *descr,
-                              descrgetfunc descr_get, char is_data_descr)
+                              descrgetfunc descr_get, char is_data_descr,
+                              void *shared_table, long shared_index)
 {
     PyObject *res = NULL;
     PyObject **dictptr;
@@ -220,11 +253,18 @@ _PyLlvm_Object_GenericGetAttr(PyObject *obj, PyTypeObject *type,
     dictptr = _PyLlvm_Object_GetDictPtr(obj, type, dictoffset);
     dict = dictptr == NULL ? NULL : *dictptr;
 
-    /* If the object has a dict, and the attribute is in it, return it.  */
+    /* If the object has a dict, and the attribute is in it, return it.  A
+     * split dict sharing shared_table has the value at a known index.  */
     if (dict != NULL) {
-        Py_INCREF(dict);
-        res = PyDict_GetItem(dict, name);
-        Py_DECREF(dict);
+        PyDictObject *mp = (PyDictObject *)dict;
+        if (shared_table != NULL && (void *)mp->ma_table == shared_table) {
+            res = mp->ma_values[shared_index];
+        }
+        else {
+            Py_INCREF(dict);
+            res = PyDict_GetItem(dict, name);
+            Py_DECREF(dict);
+        }
         if (res != NULL) {
             Py_INCREF(res);
             return res;
@@ -272,7 +312,7 @@ _PyLlvm_Object_GenericSetAttr(PyObject *obj, PyObject *value,
     if (dictptr != NULL) {
         PyObject *dict = *dictptr;
         if (dict == NULL && value != NULL) {
-            dict = PyDict_New();
+            dict = _PyObject_NewInstanceDict(obj);
             if (dict == NULL)
                 return -1;
             *dictptr = dict;
@@ -351,3 +391,14 @@ _PyLlvm_UNICODE_ISALNUM(Py_UNICODE ch) {
   return Py_UNICODE_ISALNUM(ch) != 0;
 }
 
+int __attribute__((always_inline))
+_PyLlvm_UNICODE_TOLOWER(Py_UNICODE ch) {
+  return Py_UNICODE_TOLOWER(ch);
+}
+
+/* sre's lower case for LOCALE patterns */
+int __attribute__((always_inline))
+_PyLlvm_LOCALE_TOLOWER(int ch) {
+  return ch < 256 ? tolower(ch) : ch;
+}
+
@@ -713,20 +713,35 @@ r_object(RFILE *p)
 			retval = NULL;
 			break;
 		}
-		v = PyString_FromStringAndSize((char *)NULL, n);
-		if (v == NULL) {
-			retval = NULL;
-			break;
+		if (type == TYPE_INTERNED && p->fp == NULL &&
+		    n <= p->end - p->ptr) {
+			/* Names in code objects repeat across modules, so
+			   look them up straight from the buffer; most are
+			   interned already and nothing gets allocated. */
+			v = _PyString_InternFromStringAndSize(p->ptr, n);
+			if (v == NULL) {
+				retval = NULL;
+				break;
+			}
+			p->ptr += n;
 		}
-		if (r_string(PyString_AS_STRING(v), (int)n, p) != n) {
-			Py_DECREF(v);
-			PyErr_SetString(PyExc_EOFError,
+		else {
+			v = PyString_FromStringAndSize((char *)NULL, n);
+			if (v == NULL) {
+				retval = NULL;
+				break;
+			}
+			if (r_string(PyString_AS_STRING(v), (int)n, p) != n) {
+				Py_DECREF(v);
+				PyErr_SetString(PyExc_EOFError,
 					"EOF read where object expected");
-			retval = NULL;
-			break;
+				retval = NULL;
+				break;
+			}
+			if (type == TYPE_INTERNED)
+				PyString_InternInPlace(&v);
 		}
 		if (type == TYPE_INTERNED) {
-			PyString_InternInPlace(&v);
 			if (PyList_Append(p->strings, v) < 0) {
 				retval = NULL;
 				break;
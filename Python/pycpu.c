@@ -0,0 +1,48 @@
+
+/* Detection of the CPU features used by vectorized loops; see pycpu.h. */
+
+#include "Python.h"
+
+#ifdef Py_HAVE_X86_SIMD
+#include <cpuid.h>
+
+#ifndef bit_OSXSAVE
+#define bit_OSXSAVE (1 << 27)
+#endif
+#ifndef bit_AVX
+#define bit_AVX (1 << 28)
+#endif
+#ifndef bit_AVX2
+#define bit_AVX2 (1 << 5)
+#endif
+#endif /* Py_HAVE_X86_SIMD */
+
+int _Py_cpu_features = 0;
+
+void
+_PyCPU_Init(void)
+{
+#ifdef Py_HAVE_X86_SIMD
+	unsigned int eax, ebx, ecx, edx;
+	unsigned int xcr0_lo, xcr0_hi;
+	int features = 0;
+
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return;
+	if (edx & bit_SSE2)
+		features |= PY_CPU_SSE2;
+
+	/* AVX2 also needs the OS to save the YMM registers on context
+	   switches, which it announces through XCR0. */
+	if ((ecx & bit_OSXSAVE) && (ecx & bit_AVX) &&
+	    __get_cpuid_max(0, NULL) >= 7) {
+		__asm__ __volatile__ ("xgetbv"
+				      : "=a" (xcr0_lo), "=d" (xcr0_hi)
+				      : "c" (0));
+		__cpuid_count(7, 0, eax, ebx, ecx, edx);
+		if ((xcr0_lo & 0x6) == 0x6 && (ebx & bit_AVX2))
+			features |= PY_CPU_AVX2;
+	}
+	_Py_cpu_features = features;
+#endif
+}
@@ -188,6 +188,7 @@ PyThreadState_New(PyInterpreterState *interp)
 #else
 		tstate->thread_id = 0;
 #endif
+		tstate->obmalloc_cache = _PyObject_NewThreadCache();
 
 		tstate->dict = NULL;
 
@@ -242,6 +243,9 @@ PyThreadState_Clear(PyThreadState *tstate)
 	tstate->c_tracefunc = NULL;
 	Py_CLEAR(tstate->c_profileobj);
 	Py_CLEAR(tstate->c_traceobj);
+
+	_PyObject_FreeThreadCache(tstate->obmalloc_cache);
+	tstate->obmalloc_cache = NULL;
 }
 
 
@@ -161,6 +161,8 @@ Py_InitializeEx(int install_sigs)
 	if (initialized)
 		return;
 	initialized = 1;
+	_PyCPU_Init();
+	_PyTuple_Init();
 
 	if ((p = Py_GETENV("PYTHONDEBUG")) && *p != '\0')
 		Py_DebugFlag = add_flag(Py_DebugFlag, p);
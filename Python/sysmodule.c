@@ -474,7 +474,7 @@ PyDoc_STRVAR(setcheckinterval_doc,
 "setcheckinterval(n)\n\
 \n\
 Tell the Python interpreter to check for asynchronous events every\n\
-n instructions.  This also affects how often thread switches occur."
+n instructions.  Thread switches are controlled by setswitchinterval()."
 );
 
 static PyObject *
@@ -487,6 +487,43 @@ PyDoc_STRVAR(getcheckinterval_doc,
 "getcheckinterval() -> current check interval; see setcheckinterval()."
 );
 
+static PyObject *
+sys_setswitchinterval(PyObject *self, PyObject *args)
+{
+	double d;
+	if (!PyArg_ParseTuple(args, "d:setswitchinterval", &d))
+		return NULL;
+	if (d <= 0.0) {
+		PyErr_SetString(PyExc_ValueError,
+				"switch interval must be strictly positive");
+		return NULL;
+	}
+	if (d * 1e6 < 1.0)
+		d = 1e-6;
+	_PyEval_SetSwitchInterval((unsigned long) (d * 1e6));
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+PyDoc_STRVAR(setswitchinterval_doc,
+"setswitchinterval(n)\n\
+\n\
+Set the ideal thread switching delay inside the Python interpreter.\n\
+A thread that has waited n seconds for the interpreter lock asks the\n\
+thread running Python code to give it up, at its next check for\n\
+asynchronous events."
+);
+
+static PyObject *
+sys_getswitchinterval(PyObject *self, PyObject *args)
+{
+	return PyFloat_FromDouble(1e-6 * _PyEval_GetSwitchInterval());
+}
+
+PyDoc_STRVAR(getswitchinterval_doc,
+"getswitchinterval() -> current thread switch interval; see setswitchinterval()."
+);
+
 #ifdef WITH_TSC
 static PyObject *
 sys_settscdump(PyObject *self, PyObject *args)
@@ -859,6 +896,266 @@ PyDoc_STRVAR(sys_clear_type_cache__doc__,
 "_clear_type_cache() -> None\n\
 Clear the internal type lookup cache.");
 
+static PyObject *
+sys_malloc_stats(PyObject *self, PyObject *args)
+{
+	_PyMallocStats stats;
+	PyObject *classes, *c, *free_lists, *result;
+	size_t i;
+
+	if (_PyObject_GetMallocStats(&stats) < 0)
+		Py_RETURN_NONE;
+
+	classes = PyList_New(stats.nclasses);
+	if (classes == NULL)
+		return NULL;
+	for (i = 0; i < stats.nclasses; i++) {
+		c = Py_BuildValue("{s:n,s:n,s:n,s:n,s:n}",
+			"size", (Py_ssize_t)stats.classes[i].size,
+			"pools", (Py_ssize_t)stats.classes[i].pools,
+			"blocks_used", (Py_ssize_t)stats.classes[i].blocks_used,
+			"blocks_free", (Py_ssize_t)stats.classes[i].blocks_free,
+			"blocks_highwater",
+			(Py_ssize_t)stats.classes[i].blocks_highwater);
+		if (c == NULL) {
+			Py_DECREF(classes);
+			return NULL;
+		}
+		PyList_SET_ITEM(classes, i, c);
+	}
+	free_lists = _PyFreeList_GetStats();
+	if (free_lists == NULL) {
+		Py_DECREF(classes);
+		return NULL;
+	}
+	result = Py_BuildValue("{s:n,s:n,s:n,s:n,s:n,s:n,s:n,s:n,s:N,s:N}",
+		"arena_size", (Py_ssize_t)stats.arena_size,
+		"pool_size", (Py_ssize_t)stats.pool_size,
+		"arenas", (Py_ssize_t)stats.arenas,
+		"arenas_allocated", (Py_ssize_t)stats.arenas_allocated,
+		"arenas_freed",
+		(Py_ssize_t)(stats.arenas_allocated - stats.arenas),
+		"arenas_highwater", (Py_ssize_t)stats.arenas_highwater,
+		"pools_free", (Py_ssize_t)stats.pools_free,
+		"pools_released", (Py_ssize_t)stats.pools_released,
+		"size_classes", classes,
+		"free_lists", free_lists);
+	return result;
+}
+
+PyDoc_STRVAR(malloc_stats_doc,
+"_malloc_stats() -> dict\n\
+\n\
+Return statistics about the small object allocator: its arenas, its\n\
+pools, for each size class the blocks in use and free, and the use of\n\
+the free lists of dead objects.  Return None if Python was built without\n\
+pymalloc.");
+
+static PyObject *
+sys_interned_stats(PyObject *self)
+{
+	return _PyString_InternStats();
+}
+
+PyDoc_STRVAR(interned_stats_doc,
+"_interned_stats() -> dict\n\
+\n\
+Return statistics about the table of interned strings: the strings in it,\n\
+its size, and the lookups made in it.");
+
+
+/* Allocation sampling.  The hook records the code object and line that
+   made each sampled allocation in an open addressing table.  It runs
+   inside PyObject_Malloc(), so it uses malloc() for the table and does
+   nothing that could allocate Python objects or run Python code. */
+
+typedef struct {
+	PyCodeObject *code;	/* owned; NULL for allocations outside Python
+				   code, or an empty slot if count is 0 */
+	int lineno;
+	size_t count;
+} malloc_sample;
+
+static malloc_sample *malloc_samples = NULL;
+static size_t malloc_samples_mask = 0;	/* size of the table - 1 */
+static size_t malloc_samples_used = 0;
+static size_t malloc_sample_interval = 0;
+
+static malloc_sample *
+find_malloc_sample(malloc_sample *table, size_t mask,
+		   PyCodeObject *code, int lineno)
+{
+	size_t i = ((size_t)code >> 4) ^ (size_t)lineno * 1000003;
+	malloc_sample *s;
+
+	for (;; i++) {
+		s = &table[i & mask];
+		if (s->count == 0 ||
+		    (s->code == code && s->lineno == lineno))
+			return s;
+	}
+}
+
+static int
+grow_malloc_samples(void)
+{
+	size_t newmask = malloc_samples_mask ? malloc_samples_mask * 2 + 1
+					     : 255;
+	malloc_sample *table, *s;
+	size_t i;
+
+	table = (malloc_sample *)calloc(newmask + 1, sizeof(malloc_sample));
+	if (table == NULL)
+		return -1;
+	if (malloc_samples != NULL) {
+		for (i = 0; i <= malloc_samples_mask; i++) {
+			s = &malloc_samples[i];
+			if (s->count != 0)
+				*find_malloc_sample(table, newmask, s->code,
+						    s->lineno) = *s;
+		}
+		free(malloc_samples);
+	}
+	malloc_samples = table;
+	malloc_samples_mask = newmask;
+	return 0;
+}
+
+static void
+record_malloc_sample(size_t nbytes)
+{
+	PyThreadState *tstate = _PyThreadState_Current;
+	PyCodeObject *code = NULL;
+	int lineno = 0;
+	malloc_sample *s;
+
+	if (tstate != NULL && tstate->frame != NULL) {
+		code = tstate->frame->f_code;
+		lineno = PyFrame_GetLineNumber(tstate->frame);
+	}
+	if ((malloc_samples_used + 1) * 3 > malloc_samples_mask * 2 &&
+	    grow_malloc_samples() < 0)
+		return;
+	s = find_malloc_sample(malloc_samples, malloc_samples_mask,
+			       code, lineno);
+	if (s->count == 0) {
+		Py_XINCREF(code);
+		s->code = code;
+		s->lineno = lineno;
+		malloc_samples_used++;
+	}
+	s->count++;
+}
+
+static void
+clear_malloc_samples(void)
+{
+	malloc_sample *table = malloc_samples;
+	size_t i;
+
+	if (table == NULL)
+		return;
+	/* Detach the table first, the decrefs can free memory */
+	malloc_samples = NULL;
+	for (i = 0; i <= malloc_samples_mask; i++) {
+		if (table[i].count != 0) {
+			Py_XDECREF(table[i].code);
+		}
+	}
+	free(table);
+	malloc_samples_mask = 0;
+	malloc_samples_used = 0;
+}
+
+static PyObject *
+sys_malloc_sampling(PyObject *self, PyObject *args)
+{
+	Py_ssize_t interval;
+
+	if (!PyArg_ParseTuple(args, "n:_malloc_sampling", &interval))
+		return NULL;
+	if (interval < 0) {
+		PyErr_SetString(PyExc_ValueError,
+				"sampling interval must be >= 0");
+		return NULL;
+	}
+	_PyObject_SetMallocSampling(0, NULL);
+	clear_malloc_samples();
+	malloc_sample_interval = interval;
+	if (interval > 0)
+		_PyObject_SetMallocSampling(interval, record_malloc_sample);
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(malloc_sampling_doc,
+"_malloc_sampling(interval)\n\
+\n\
+Sample one object allocation for every interval bytes allocated, on\n\
+average, recording the file and line of the Python code that made it.\n\
+Discard the samples taken so far.  An interval of 0 stops sampling.");
+
+static PyObject *
+sys_malloc_samples(PyObject *self, PyObject *args)
+{
+	PyObject *result, *key, *value;
+	malloc_sample *s;
+	size_t i, count;
+	int err;
+
+	result = PyDict_New();
+	if (result == NULL)
+		return NULL;
+	/* Building the result allocates, and may grow the table. */
+	_PyObject_SetMallocSampling(0, NULL);
+	for (i = 0; malloc_samples != NULL && i <= malloc_samples_mask; i++) {
+		s = &malloc_samples[i];
+		if (s->count == 0)
+			continue;
+		if (s->code == NULL)
+			key = Py_BuildValue("(OO)", Py_None, Py_None);
+		else
+			key = Py_BuildValue("(Oi)", s->code->co_filename,
+					    s->lineno);
+		if (key == NULL)
+			goto error;
+		/* Different code objects can share a line. */
+		count = s->count;
+		value = PyDict_GetItem(result, key);
+		if (value != NULL)
+			count += PyInt_AsSsize_t(value);
+		value = PyInt_FromSize_t(count);
+		if (value == NULL) {
+			Py_DECREF(key);
+			goto error;
+		}
+		err = PyDict_SetItem(result, key, value);
+		Py_DECREF(key);
+		Py_DECREF(value);
+		if (err < 0)
+			goto error;
+	}
+	if (malloc_sample_interval > 0)
+		_PyObject_SetMallocSampling(malloc_sample_interval,
+					    record_malloc_sample);
+	return result;
+
+error:
+	if (malloc_sample_interval > 0)
+		_PyObject_SetMallocSampling(malloc_sample_interval,
+					    record_malloc_sample);
+	Py_DECREF(result);
+	return NULL;
+}
+
+PyDoc_STRVAR(malloc_samples_doc,
+"_malloc_samples() -> dict\n\
+\n\
+Return a dictionary mapping (filename, lineno) to the number of\n\
+allocations sampled there since _malloc_sampling() was called.\n\
+Allocations made outside Python code are counted under (None, None).\n\
+Multiplying a count by the sampling interval estimates the bytes\n\
+allocated.");
+
 
 #ifdef WITH_LLVM
 static PyObject *
@@ -895,6 +1192,13 @@ static PyMethodDef sys_methods[] = {
 	 sys_clear_type_cache__doc__},
 	{"_current_frames", sys_current_frames, METH_NOARGS,
 	 current_frames_doc},
+	{"_malloc_samples", sys_malloc_samples, METH_NOARGS,
+	 malloc_samples_doc},
+	{"_malloc_sampling", sys_malloc_sampling, METH_VARARGS,
+	 malloc_sampling_doc},
+	{"_interned_stats", (PyCFunction)sys_interned_stats, METH_NOARGS,
+	 interned_stats_doc},
+	{"_malloc_stats", sys_malloc_stats, METH_NOARGS, malloc_stats_doc},
 	{"displayhook",	sys_displayhook, METH_O, displayhook_doc},
 	{"exc_info",	sys_exc_info, METH_NOARGS, exc_info_doc},
 	{"exc_clear",	sys_exc_clear, METH_NOARGS, exc_clear_doc},
@@ -945,6 +1249,10 @@ static PyMethodDef sys_methods[] = {
 	 setcheckinterval_doc},
 	{"getcheckinterval",	sys_getcheckinterval, METH_NOARGS,
 	 getcheckinterval_doc},
+	{"setswitchinterval",	sys_setswitchinterval, METH_VARARGS,
+	 setswitchinterval_doc},
+	{"getswitchinterval",	sys_getswitchinterval, METH_NOARGS,
+	 getswitchinterval_doc},
 #ifdef HAVE_DLOPEN
 	{"setdlopenflags", sys_setdlopenflags, METH_VARARGS,
 	 setdlopenflags_doc},
@@ -1118,6 +1426,7 @@ getrecursionlimit() -- return the max recursion depth for the interpreter\n\
 getsizeof() -- return the size of an object in bytes\n\
 gettrace() -- get the global debug tracing function\n\
 setcheckinterval() -- control how often the interpreter checks for events\n\
+setswitchinterval() -- control how long a thread waits for another to yield\n\
 setdlopenflags() -- set the flags to be used for dlopen() calls\n\
 setprofile() -- set the global profiling function\n\
 setrecursionlimit() -- set the max recursion depth for the interpreter\n\
@@ -177,6 +177,52 @@ PyThread_set_stacksize(size_t size)
 #endif
 }
 
+#ifndef Py_HAVE_NATIVE_TIMED_LOCK
+/* If the platform can't wait for a lock with a timeout, poll it,
+   sleeping a little longer each time up to 50ms. */
+
+#ifdef MS_WINDOWS
+#include <windows.h>
+#elif defined(HAVE_SELECT)
+#ifdef HAVE_SYS_SELECT_H
+#include <sys/select.h>
+#endif
+#include <sys/time.h>
+#endif
+
+static void
+timed_lock_sleep(long microseconds)
+{
+#ifdef MS_WINDOWS
+	Sleep(microseconds / 1000);
+#elif defined(HAVE_SELECT)
+	struct timeval t;
+	t.tv_sec = 0;
+	t.tv_usec = microseconds;
+	select(0, (fd_set *)0, (fd_set *)0, (fd_set *)0, &t);
+#endif
+}
+
+int
+PyThread_acquire_lock_timed(PyThread_type_lock lock, PY_TIMEOUT_T microseconds)
+{
+	long delay = 500;
+
+	if (microseconds <= 0)
+		return PyThread_acquire_lock(lock, microseconds < 0);
+	while (!PyThread_acquire_lock(lock, NOWAIT_LOCK)) {
+		if (microseconds <= 0)
+			return 0;
+		if (delay > microseconds)
+			delay = (long)microseconds;
+		timed_lock_sleep(delay);
+		microseconds -= delay;
+		delay = delay * 2 < 50000 ? delay * 2 : 50000;
+	}
+	return 1;
+}
+#endif /* Py_HAVE_NATIVE_TIMED_LOCK */
+
 #ifndef Py_HAVE_NATIVE_TLS
 /* If the platform has not supplied a platform specific
    TLS implementation, provide our own.
@@ -0,0 +1,109 @@
+from pybench import Test
+
+class BigLongMultiplication(Test):
+
+    version = 2.0
+    operations = 5 * 2
+    rounds = 150
+
+    def test(self):
+
+        a = 7L ** 12000
+        b = 11L ** 10000
+
+        for i in xrange(self.rounds):
+
+            a * b
+            a * a
+
+            a * b
+            a * a
+
+            a * b
+            a * a
+
+            a * b
+            a * a
+
+            a * b
+            a * a
+
+    def calibrate(self):
+
+        a = 7L ** 12000
+        b = 11L ** 10000
+
+        for i in xrange(self.rounds):
+            pass
+
+class BigLongToString(Test):
+
+    version = 2.0
+    operations = 5 * 2
+    rounds = 50
+
+    def test(self):
+
+        a = 7L ** 12000
+        b = -(11L ** 3000)
+
+        for i in xrange(self.rounds):
+
+            str(a)
+            str(b)
+
+            str(a)
+            str(b)
+
+            str(a)
+            str(b)
+
+            str(a)
+            str(b)
+
+            str(a)
+            str(b)
+
+    def calibrate(self):
+
+        a = 7L ** 12000
+        b = -(11L ** 3000)
+
+        for i in xrange(self.rounds):
+            pass
+
+class BigLongFromString(Test):
+
+    version = 2.0
+    operations = 5 * 2
+    rounds = 200
+
+    def test(self):
+
+        s = str(7L ** 12000)
+        t = str(-(11L ** 3000))
+
+        for i in xrange(self.rounds):
+
+            long(s)
+            long(t)
+
+            long(s)
+            long(t)
+
+            long(s)
+            long(t)
+
+            long(s)
+            long(t)
+
+            long(s)
+            long(t)
+
+    def calibrate(self):
+
+        s = str(7L ** 12000)
+        t = str(-(11L ** 3000))
+
+        for i in xrange(self.rounds):
+            pass
@@ -37,6 +37,7 @@ except SyntaxError:
 from Imports import *
 from Strings import *
 from Numbers import *
+from BigIntegers import *
 try:
     from Unicode import *
 except (ImportError, SyntaxError):
@@ -125,6 +125,7 @@ private:
     bool FullyConstant(const SCEV*, const SCEV*) { return true; }
     bool IsConstStringField(const SCEV *string_gv, const SCEV *field);
     bool IsConstUnicodeField(const SCEV *unicode_gv, const SCEV *field);
+    bool IsConstTupleField(const SCEV *tuple_gv, const SCEV *field);
 
     // Registers a builtin type that's known not to change.  This returns the
     // GlobalVariable for the type so we can insert it into the constant-values
@@ -195,7 +196,7 @@ PyAliasAnalysis::doInitialization(Module& module)
         &PyAliasAnalysis::IsConstUnicodeField;
     this->types_with_constant_values_[
         this->RegisterConstantType(&PyTuple_Type)] =
-        &PyAliasAnalysis::FullyConstant;
+        &PyAliasAnalysis::IsConstTupleField;
     this->RegisterConstantType(&PyType_Type);
     this->RegisterConstantType(&PyList_Type);
     this->RegisterConstantType(&PyDict_Type);
@@ -436,6 +437,20 @@ PyAliasAnalysis::IsConstUnicodeField(const SCEV *unicode_gv, const SCEV *field)
     return !this->MayOverlapByteRange(unicode_gv, field, defenc_range);
 }
 
+bool
+PyAliasAnalysis::IsConstTupleField(const SCEV *tuple_gv, const SCEV *field)
+{
+    // ob_hash is the only mutable field in PyTupleObject because tuplehash
+    // caches the hash there the first time it's asked for. Unlike strings,
+    // ConstantMirror doesn't hash tuples up front, since hashing their items
+    // can run arbitrary code.
+    std::pair<uint64_t, uint64_t> hash_range =
+        this->GetByteRangeOfField(
+            PyTypeBuilder<PyTupleObject>::get(*this->context_),
+            PyTypeBuilder<PyTupleObject>::ob_hash_index(*this->context_));
+    return !this->MayOverlapByteRange(tuple_gv, field, hash_range);
+}
+
 bool
 PyAliasAnalysis::IsPyObject(const GlobalVariable *gv)
 {
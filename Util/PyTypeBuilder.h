@@ -199,6 +199,7 @@ public:
 
     DEFINE_OBJECT_HEAD_FIELDS(PyTupleObject)
     DEFINE_FIELD(PyTupleObject, ob_size)
+    DEFINE_FIELD(PyTupleObject, ob_hash)
     DEFINE_FIELD(PyTupleObject, ob_item)
 };
 
@@ -542,7 +543,7 @@ public:
     DEFINE_FIELD(PyMethodDef, ml_doc)
 };
 
-// We happen to have two functions with these types, so we must define type
+// We happen to have functions with these types, so we must define type
 // builder specializations for them.
 template<typename R, typename A1, typename A2, typename A3, typename A4,
          typename A5, typename A6, typename A7, bool cross>
@@ -583,6 +584,28 @@ public:
     }
 };
 
+template<typename R, typename A1, typename A2, typename A3, typename A4,
+         typename A5, typename A6, typename A7, typename A8, typename A9,
+         bool cross>
+class TypeBuilder<R(A1, A2, A3, A4, A5, A6, A7, A8, A9), cross> {
+public:
+    static const FunctionType *get(llvm::LLVMContext &Context) {
+        std::vector<const Type*> params;
+        params.reserve(9);
+        params.push_back(TypeBuilder<A1, cross>::get(Context));
+        params.push_back(TypeBuilder<A2, cross>::get(Context));
+        params.push_back(TypeBuilder<A3, cross>::get(Context));
+        params.push_back(TypeBuilder<A4, cross>::get(Context));
+        params.push_back(TypeBuilder<A5, cross>::get(Context));
+        params.push_back(TypeBuilder<A6, cross>::get(Context));
+        params.push_back(TypeBuilder<A7, cross>::get(Context));
+        params.push_back(TypeBuilder<A8, cross>::get(Context));
+        params.push_back(TypeBuilder<A9, cross>::get(Context));
+        return FunctionType::get(TypeBuilder<R, cross>::get(Context),
+                                 params, false);
+    }
+};
+
 #undef DEFINE_OBJECT_HEAD_FIELDS
 #undef DEFINE_FIELD
 
@@ -474,6 +474,8 @@ class PyBuildExt(build_ext):
         exts.append( Extension("_bisect", ["_bisectmodule.c"]) )
         # heapq
         exts.append( Extension("_heapq", ["_heapqmodule.c"]) )
+        # str and unicode builders
+        exts.append( Extension("_stringbuilder", ["_stringbuildermodule.c"]) )
         # operator.add() and similar goodies
         exts.append( Extension('operator', ['operator.c']) )
         # Python 3.0 _fileio module